@@ -15,13 +15,29 @@ typedef struct
   int8_t xOffset, yOffset; // Dist from cursor pos to UL corner
 } GFXglyph;
 
+// JSB added. Glyph data formats:
+// => gffBitmap: Adafruit 1-bpp bitmaps, rows concatenated, MSB first.
+// => gffRuns: Horizontal runs of set pixels, produced by Tools/JSB_FontCompiler.c. Each row of the glyph is either:
+//    => A sequence of run bytes: (EndOfRow << 7) | (Skip << 4) | Length. Skip Skip pixels from the end of the previous run (or the start of the row), then set Length pixels.
+//       Longer skips and runs are split, using zero length runs for skips and zero skips for runs. An empty row is 0x80.
+//    => 0x00: The same runs as the previous row that was not 0x00.
+// => gffAntialiased4bpp: 4-bpp coverage (0 = background, 15 = text color), produced by Tools/JSB_FontConverterAA.c.
+//    Rows concatenated, two pixels per byte, first pixel in the high nibble.
+typedef enum
+{
+  gffBitmap,
+  gffRuns,
+  gffAntialiased4bpp
+} GFXfontFormat_t;
+
 typedef struct
 { // Data stored for FONT AS A WHOLE:
   uint8_t *pBitmap;      // Glyph bitmaps, concatenated
   GFXglyph *pGlyph;       // Glyph array
   uint8_t first, last; // ASCII extents
   uint8_t yAdvance;    // Newline distance (y axis)
-  int8_t yOffsetMin, yOffsetMax; // JSB added. Used to clear background.
+  int8_t yOffsetMin, yOffsetMax; // JSB added. Used to clear background. The top and bottom rows of any glyph, inclusive, relative to the baseline.
+  uint8_t format; // JSB added. GFXfontFormat_t. pBitmap holds the glyph data in this format and GFXglyph::bitmapOffset indexes it.
 } GFXfont;
 
 #endif // _GFXFONT_H_
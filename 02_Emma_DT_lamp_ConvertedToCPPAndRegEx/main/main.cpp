@@ -7,36 +7,56 @@
 //
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#ifndef JSB_HAL_Linux // Not in a host build (see Host/CMakeLists.txt).
 #include "freertos/event_groups.h"
+#endif
 //
 #include <esp_system.h>
 #include <esp_log.h>
+#ifndef JSB_HAL_Linux
 #include <esp_wifi.h>
 #include <esp_event.h>
+#endif
 //
 #include <lwip/sockets.h>
 #include <sys/errno.h>
 //
+#ifndef JSB_HAL_Linux
 #include <nvs_flash.h>
+#endif
+#include <esp_random.h>
+#include <esp_attr.h>
 //
+#ifndef JSB_HAL_Linux
 #include "hal/spi_types.h"
 #include "driver/spi_master.h"
 #include "driver/gpio.h"
-#include "driver/ledc.h"
 //
 #include "soc/gpio_struct.h"
+#endif
 //
 #include "gfxfont.h"
-#include "FreeSans9pt7b.h"
+#include "FreeSans9pt7b.h" // Bitmaps, as they are smaller than runs for these fonts (see Tools/JSB_FontCompiler.c).
 #include "FreeSans12pt7b.h"
 //
+#include "JSB_HAL.h"
 #include "JSB_ILI9341.h"
+#include "JSB_ILI9341_Compositor.h"
+#include "JSB_ILI9341_GlyphCache.h"
 #include "JSB_XPT2046.h"
+#include "JSB_HTTP.h"
+#include "JSB_JSON.h"
+#include "JSB_WebSocket.h"
+#include "JSB_LampPacket.h"
+#include "JSB_LampMix.h"
 //
+#ifndef JSB_HAL_Linux
 #include "sdkconfig.h"
+#endif
 //
 #include <string>
-#include <regex>
+#include <vector>
+#include <atomic>
 
 static const char DefaultLogTag[] = "";
 static const char WiFiLogTag[] = "WiFi";
@@ -49,7 +69,9 @@ static const char WiFiLogTag[] = "WiFi";
 ///////////////////////////////////////////////////////////////////////////////
 // Configuration:
 
+#ifndef JSB_HAL_Linux
 #include "../../WiFiCredentials.h"
+#endif
 
 #define ProductName "Emma's DT lamp!"
 
@@ -81,6 +103,9 @@ static const char WiFiLogTag[] = "WiFi";
 #define Display_D_CX_GPIO 27
 #define Display_BacklightX_GPIO 16
 
+// Glyph cache:
+#define Display_GlyphCache_MaxNumBytes 24576 // Heap budget. About 21KB holds all of the UI's glyphs. Check against the free heap logged by WifiServer_Go().
+
 ///////////////////////////////////////////////////////////////////////////////
 // TouchPanelSPI:
 
@@ -113,7 +138,143 @@ static const char WiFiLogTag[] = "WiFi";
 static int Off = 0;
 static float WarmBrightness = 0, NaturalBrightness = 0;
 static float RedBrightness = 0, GreenBrightness = 0, BlueBrightness = 0;
-static uint8_t OffChanged = 0;
+static std::atomic<uint8_t> OffChanged(0); // Set when the lamp is turned on or off, so that the screen is drawn again.
+static std::atomic<uint32_t> LampState_Version(1); // Incremented once by each change to the state above, so that what has been rendered from it can be reused until then.
+
+// The state above is only changed by LampState_Apply(), which holds LampState_Lock while it does, and read by LampState_Get().
+
+static uint8_t LampState_SetBrightness(float *pBrightness, float Value)
+// Returns 1 if it changed.
+{
+  if (*pBrightness == Value)
+    return 0;
+  *pBrightness = Value;
+  return 1;
+}
+
+static uint8_t LampState_SetOff(int Value)
+// Returns 1 if it changed.
+{
+  if (Off == Value)
+    return 0;
+  Off = Value;
+  return 1;
+}
+
+// Channels, for changing or reading several brightnesses together:
+typedef enum
+{
+  lcNatural,
+  lcWarm,
+  lcRed,
+  lcGreen,
+  lcBlue,
+  lcNumChannels
+} LampChannel_t;
+
+static constexpr float *LampState_pChannels[lcNumChannels] = { &NaturalBrightness, &WarmBrightness, &RedBrightness, &GreenBrightness, &BlueBrightness };
+static constexpr const char *LampState_ChannelNames[lcNumChannels] = { "Natural", "Warm", "Red", "Green", "Blue" }; // Must be lamp parameters (see LampCommands).
+
+typedef struct
+{
+  int Off;
+  float Brightnesses[lcNumChannels];
+} LampState_t;
+
+typedef struct
+{
+  uint8_t SetOff;
+  uint8_t ChannelMask; // Bit n set => State.Brightnesses[n] is to be set.
+  LampState_t State;
+} LampState_Change_t;
+
+static void LampState_Change_SetBrightness(LampState_Change_t *pChange, LampChannel_t Channel, float Brightness)
+{
+  pChange->ChannelMask |= 1 << Channel;
+  pChange->State.Brightnesses[Channel] = Brightness;
+}
+
+static void LampState_Change_SetOff(LampState_Change_t *pChange, int Off)
+{
+  pChange->SetOff = 1;
+  pChange->State.Off = Off;
+}
+
+static portMUX_TYPE LampState_Lock = portMUX_INITIALIZER_UNLOCKED; // Held while several values are changed or read together.
+static LampState_Change_t LampState_RequestedChange; // Not yet applied. See LampState_Request().
+static uint32_t LampState_NumRequestedChanges = 0;
+static uint32_t LampState_NumAppliedChanges = 0; // Of those requested. Fewer, when requests arrive faster than the LEDs are updated.
+
+static int8_t LampState_FindChannel(const float *pBrightness)
+// Returns -1 if pBrightness is not a channel.
+{
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    if (LampState_pChannels[Channel] == pBrightness)
+      return Channel;
+  return -1;
+}
+
+static void LampState_Apply(const LampState_Change_t *pChange)
+// Makes the whole change at once, as one version, so that neither the LEDs nor a client are ever shown only part of it.
+{
+  uint8_t Changed = 0;
+
+  portENTER_CRITICAL(&LampState_Lock);
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    if (pChange->ChannelMask & (1 << Channel))
+      Changed |= LampState_SetBrightness(LampState_pChannels[Channel], pChange->State.Brightnesses[Channel]);
+  if (pChange->SetOff)
+  {
+    Changed |= LampState_SetOff(pChange->State.Off);
+    OffChanged = 1;
+  }
+  if (Changed)
+    ++LampState_Version;
+  portEXIT_CRITICAL(&LampState_Lock);
+}
+
+static void LampState_Request(const LampState_Change_t *pChange)
+// For a stream of changes: merges the change into any not yet applied, so that however fast they arrive, the LEDs are updated at most once per LED loop.
+{
+  portENTER_CRITICAL(&LampState_Lock);
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    if (pChange->ChannelMask & (1 << Channel))
+      LampState_RequestedChange.State.Brightnesses[Channel] = pChange->State.Brightnesses[Channel];
+  LampState_RequestedChange.ChannelMask |= pChange->ChannelMask;
+  if (pChange->SetOff)
+  {
+    LampState_RequestedChange.SetOff = 1;
+    LampState_RequestedChange.State.Off = pChange->State.Off;
+  }
+  ++LampState_NumRequestedChanges;
+  portEXIT_CRITICAL(&LampState_Lock);
+}
+
+static void LampState_ApplyRequested()
+// Called by the LED loop.
+{
+  LampState_Change_t Change;
+
+  portENTER_CRITICAL(&LampState_Lock);
+  Change = LampState_RequestedChange;
+  memset(&LampState_RequestedChange, 0, sizeof(LampState_RequestedChange));
+  portEXIT_CRITICAL(&LampState_Lock);
+
+  if (!Change.ChannelMask && !Change.SetOff)
+    return;
+
+  ++LampState_NumAppliedChanges;
+  LampState_Apply(&Change);
+}
+
+static void LampState_Get(LampState_t *pState)
+{
+  portENTER_CRITICAL(&LampState_Lock);
+  pState->Off = Off;
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    pState->Brightnesses[Channel] = *LampState_pChannels[Channel];
+  portEXIT_CRITICAL(&LampState_Lock);
+}
 ///////////////////////////////////////////////////////////////////////////////
 // Utility functions:
 
@@ -136,11 +297,6 @@ static float CalculateInterpolationCoefficient(float Value, float MinValue, floa
 //  return x * x;
 //}
 
-static float cube(float x)
-{
-  return x * x * x;
-}
-
 static char Yes[] = "Yes";
 static char No[] = "No";
 
@@ -153,6 +309,7 @@ static char *BooleanToNoYes(uint8_t Value)
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#ifndef JSB_HAL_Linux
 void NVS_Initialize()
 {
   esp_err_t ret;
@@ -167,12 +324,402 @@ void NVS_Initialize()
 
   ESP_ERROR_CHECK(ret);
 }
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Brightness curves:
+//
+// => Map a brightness [0, 1], as perceived, to a drive [0, 1], proportional to light output. Most of the LEDs' range is needed for the
+//    top of the brightness range, and fine control at the bottom.
+// => Tabulated at compile time, as 16 bit drives, and interpolated in fixed point, so that no float maths is done per LED update.
+
+typedef enum
+{
+  bcCIELightness, // CIE 1976 L*.
+  bcGamma22, // sRGB-like.
+  bcCubic,
+  bcNumCurves
+} BrightnessCurve_t;
+
+#define BrightnessTable_Index_bits 8
+#define BrightnessTable_NumEntries ((1 << BrightnessTable_Index_bits) + 1) // Including both ends.
+#define BrightnessTable_Fraction_bits 8
+#define BrightnessTable_MaxDrive 65535
+#define BrightnessTable_MaxError 2 // Of an interpolated drive, against the curve itself, in drive units.
+
+typedef struct
+{
+  uint16_t Drives[BrightnessTable_NumEntries];
+} BrightnessTable_t;
+
+static constexpr BrightnessCurve_t LampChannel_Curves[lcNumChannels] = { bcCubic, bcCubic, bcCubic, bcCubic, bcCubic }; // By LampChannel_t.
+
+static constexpr double GetFifthRoot(double x)
+// Newton's method, for x in [0, 1]. Only for building the tables.
+{
+  double y = 1.0;
+
+  if (x <= 0.0)
+    return 0.0;
+
+  for (uint8_t Iteration = 0; Iteration < 100; ++Iteration)
+  {
+    double y4 = y * y * y * y;
+    double Next = y - (y4 * y - x) / (5.0 * y4);
+
+    if (Next == y)
+      break;
+    y = Next;
+  }
+  return y;
+}
+
+static constexpr double GetCurveDrive(BrightnessCurve_t Curve, double Brightness)
+// The reference the tables are built from, and checked against.
+{
+  switch (Curve)
+  {
+    case bcCIELightness:
+      if (Brightness <= 0.08)
+        return Brightness / 9.033;
+      Brightness = (Brightness + 0.16) / 1.16;
+      return Brightness * Brightness * Brightness;
+    case bcGamma22:
+      return Brightness * Brightness * GetFifthRoot(Brightness); // x^2.2 = x^2 * x^(1/5).
+    case bcCubic:
+    default:
+      return Brightness * Brightness * Brightness;
+  }
+}
+
+static constexpr BrightnessTable_t BuildBrightnessTable(BrightnessCurve_t Curve)
+{
+  BrightnessTable_t Table = {};
+
+  for (uint16_t Index = 0; Index < BrightnessTable_NumEntries; ++Index)
+    Table.Drives[Index] = (uint16_t)(GetCurveDrive(Curve, (double)Index / (BrightnessTable_NumEntries - 1)) * BrightnessTable_MaxDrive + 0.5);
+  return Table;
+}
+
+static constexpr BrightnessTable_t BrightnessTables[bcNumCurves] = { BuildBrightnessTable(bcCIELightness), BuildBrightnessTable(bcGamma22), BuildBrightnessTable(bcCubic) };
+
+static constexpr uint16_t InterpolateBrightnessTable(BrightnessCurve_t Curve, uint32_t Position)
+// Position is the brightness in [0, 1] << (BrightnessTable_Index_bits + BrightnessTable_Fraction_bits).
+{
+  const uint16_t *pDrives = BrightnessTables[Curve].Drives;
+  uint32_t Index = Position >> BrightnessTable_Fraction_bits;
+  uint32_t Fraction = Position & ((1 << BrightnessTable_Fraction_bits) - 1);
+
+  if (Index >= BrightnessTable_NumEntries - 1)
+    return pDrives[BrightnessTable_NumEntries - 1];
+  return pDrives[Index] + (((pDrives[Index + 1] - pDrives[Index]) * Fraction + (1 << (BrightnessTable_Fraction_bits - 1))) >> BrightnessTable_Fraction_bits);
+}
+
+static constexpr uint8_t AllBrightnessTablesValid()
+// Each table must run from off to fully on, never dim as the brightness rises, and, interpolated, stay close to its curve.
+{
+  for (uint8_t Curve = 0; Curve < bcNumCurves; ++Curve)
+  {
+    const uint16_t *pDrives = BrightnessTables[Curve].Drives;
+
+    if ((pDrives[0] != 0) || (pDrives[BrightnessTable_NumEntries - 1] != BrightnessTable_MaxDrive))
+      return 0;
+
+    for (uint16_t Index = 0; Index < BrightnessTable_NumEntries - 1; ++Index)
+    {
+      if (pDrives[Index + 1] < pDrives[Index])
+        return 0;
+
+      for (uint32_t Fraction = 0; Fraction < (1 << BrightnessTable_Fraction_bits); Fraction += 1 << (BrightnessTable_Fraction_bits - 3))
+      {
+        uint32_t Position = (Index << BrightnessTable_Fraction_bits) + Fraction;
+        double Error = InterpolateBrightnessTable((BrightnessCurve_t)Curve, Position) -
+          GetCurveDrive((BrightnessCurve_t)Curve, (double)Position / ((BrightnessTable_NumEntries - 1) << BrightnessTable_Fraction_bits)) * BrightnessTable_MaxDrive;
+
+        if ((Error > BrightnessTable_MaxError) || (Error < -BrightnessTable_MaxError))
+          return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+static_assert(AllBrightnessTablesValid(), "A brightness table is not monotonic, or is too far from its curve.");
+
+///////////////////////////////////////////////////////////////////////////////
+// Colour mixing:
+//
+// => A colour temperature and intensity, or an sRGB or HSV colour, can be asked for rather than channel brightnesses (see
+//    WifiServer_ParseStateChange()). Shared/JSB_LampMix.c works out the channel levels, linear in light output, from the channels'
+//    calibration, and they are then converted to brightnesses through each channel's curve.
+
+#define LampMix_Intensity_Curve bcCIELightness // An intensity is a brightness, as perceived, of the mix as a whole.
+
+static float GetChannelBrightness(LampChannel_t Channel, uint16_t Level)
+// The inverse of the channel's curve, by bisection of its table.
+{
+  const uint16_t *pDrives = BrightnessTables[LampChannel_Curves[Channel]].Drives;
+  uint16_t Low = 0, High = BrightnessTable_NumEntries - 1;
+
+  if (!Level)
+    return 0.0f;
+
+  while (High - Low > 1) // pDrives[Low] < Level <= pDrives[High].
+  {
+    uint16_t Middle = (Low + High) / 2;
+
+    if (pDrives[Middle] < Level)
+      Low = Middle;
+    else
+      High = Middle;
+  }
+
+  return (Low + (float)(Level - pDrives[Low]) / (pDrives[High] - pDrives[Low])) / (BrightnessTable_NumEntries - 1);
+}
+
+static uint16_t GetMixIntensity(float Brightness)
+{
+  uint32_t Position = clamp_f(Brightness, 0.0f, 1.0f) * ((BrightnessTable_NumEntries - 1) << BrightnessTable_Fraction_bits);
+
+  return InterpolateBrightnessTable(LampMix_Intensity_Curve, Position);
+}
+
+static_assert((LampMix_NumChannels == lcNumChannels) && ((int)lmcNatural == lcNatural) && ((int)lmcWarm == lcWarm) && ((int)lmcRed == lcRed) &&
+  ((int)lmcGreen == lcGreen) && ((int)lmcBlue == lcBlue), "LampMix_Channel_t does not match LampChannel_t.");
+
+static void LampState_AddMix(LampState_Change_t *pChange, const uint16_t *pLevels, uint8_t ChannelMask)
+// Channels already in the change are left as they are.
+{
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    if ((ChannelMask & (1 << Channel)) && !(pChange->ChannelMask & (1 << Channel)))
+    {
+      pChange->ChannelMask |= 1 << Channel;
+      pChange->State.Brightnesses[Channel] = GetChannelBrightness((LampChannel_t)Channel, pLevels[Channel]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp commands:
+//
+// => Requested over WiFi as e.g. <IP_Address>/Night, with parameters set as e.g. <IP_Address>/State?N=0.5&W=0.25.
+// => Parameters can also be set together by POSTing JSON to <IP_Address>/State, e.g. {"Natural":0.5,"Warm":0.25}.
+//    Or a colour temperature or colour can be asked for, e.g. {"CCT":2700,"Intensity":0.4} (see Colour mixing).
+// => To add a command or parameter (or an alias for one), add it to LampCommands only. Names are case insensitive.
+// => LampCommandTable is a perfect hash table built at compile time, so finding a name takes one hash and one comparison.
+
+typedef struct
+{
+  const char *pName;
+  float *pParameter; // Parameter: set to the value, clamped to [0, 1]. NULL for a command.
+  void (*pHandler)(); // Command. NULL for a parameter.
+} LampCommand_t;
+
+static void LampCommand_Off()
+{
+  LampState_Change_t Change = {};
+
+  LampState_Change_SetOff(&Change, 1);
+  LampState_Apply(&Change);
+}
+
+static void LampCommand_On()
+{
+  LampState_Change_t Change = {};
+
+  LampState_Change_SetOff(&Change, 0);
+  LampState_Apply(&Change);
+}
+
+static void LampCommand_Night()
+{
+  LampState_Change_t Change = {};
+
+  LampState_Change_SetBrightness(&Change, lcNatural, 0.0f);
+  LampState_Change_SetBrightness(&Change, lcWarm, 0.3f);
+  LampState_Apply(&Change);
+}
+
+static void LampCommand_Bright()
+{
+  LampState_Change_t Change = {};
+
+  LampState_Change_SetBrightness(&Change, lcNatural, 1.0f);
+  LampState_Change_SetBrightness(&Change, lcWarm, 1.0f);
+  LampState_Change_SetOff(&Change, 0);
+  LampState_Apply(&Change);
+}
+
+static constexpr LampCommand_t LampCommands[] =
+{
+  { "N", &NaturalBrightness, NULL },
+  { "Natural", &NaturalBrightness, NULL },
+  { "NaturalBrightness", &NaturalBrightness, NULL },
+  { "W", &WarmBrightness, NULL },
+  { "Warm", &WarmBrightness, NULL },
+  { "WarmBrightness", &WarmBrightness, NULL },
+  { "R", &RedBrightness, NULL },
+  { "Red", &RedBrightness, NULL },
+  { "RedBrightness", &RedBrightness, NULL },
+  { "G", &GreenBrightness, NULL },
+  { "Green", &GreenBrightness, NULL },
+  { "GreenBrightness", &GreenBrightness, NULL },
+  { "B", &BlueBrightness, NULL },
+  { "Blue", &BlueBrightness, NULL },
+  { "BlueBrightness", &BlueBrightness, NULL },
+  { "Off", NULL, LampCommand_Off },
+  { "On", NULL, LampCommand_On },
+  { "Night", NULL, LampCommand_Night },
+  { "Bright", NULL, LampCommand_Bright }
+};
+
+#define LampCommands_NumCommands (sizeof(LampCommands) / sizeof(LampCommands[0]))
+#define LampCommandTable_NumSlots 64 // Power of two. Plenty of free slots make a perfect hash easy to find.
+#define LampCommandTable_MaxSeed 1000
+
+typedef struct
+{
+  uint32_t Seed;
+  int8_t Slots[LampCommandTable_NumSlots]; // Index into LampCommands. -1 => empty.
+} LampCommandTable_t;
+
+static constexpr char ToLower(char Ch)
+{
+  return ((Ch >= 'A') && (Ch <= 'Z')) ? Ch - 'A' + 'a' : Ch;
+}
+
+static constexpr uint16_t GetNumChars(const char *pChars)
+{
+  uint16_t NumChars = 0;
+
+  while (pChars[NumChars])
+    ++NumChars;
+  return NumChars;
+}
+
+static constexpr uint32_t HashLampCommandName(uint32_t Seed, const char *pChars, uint16_t NumChars)
+// Case insensitive FNV-1a.
+{
+  uint32_t Hash = 2166136261u ^ Seed;
+
+  for (uint16_t Index = 0; Index < NumChars; ++Index)
+    Hash = (Hash ^ (uint8_t)ToLower(pChars[Index])) * 16777619u;
+  return Hash;
+}
+
+static constexpr LampCommandTable_t BuildLampCommandTable()
+// Tries seeds until every name has a slot of its own. Duplicate names never do, so they fail the static_assert below.
+{
+  LampCommandTable_t Table = {};
+
+  for (Table.Seed = 0; Table.Seed < LampCommandTable_MaxSeed; ++Table.Seed)
+  {
+    uint8_t Collision = 0;
+
+    for (uint16_t Index = 0; Index < LampCommandTable_NumSlots; ++Index)
+      Table.Slots[Index] = -1;
+
+    for (uint16_t Index = 0; (Index < LampCommands_NumCommands) && !Collision; ++Index)
+    {
+      uint32_t Slot = HashLampCommandName(Table.Seed, LampCommands[Index].pName, GetNumChars(LampCommands[Index].pName)) & (LampCommandTable_NumSlots - 1);
+
+      if (Table.Slots[Slot] >= 0)
+        Collision = 1;
+      else
+        Table.Slots[Slot] = Index;
+    }
+
+    if (!Collision)
+      break;
+  }
+
+  return Table;
+}
+
+static constexpr LampCommandTable_t LampCommandTable = BuildLampCommandTable();
+static_assert(LampCommandTable.Seed < LampCommandTable_MaxSeed, "No perfect hash found for LampCommands. Are there duplicate names?");
+
+static constexpr int16_t FindLampCommandIndex(const char *pChars, uint16_t NumChars)
+// Returns -1 if not found.
+{
+  int8_t Index = LampCommandTable.Slots[HashLampCommandName(LampCommandTable.Seed, pChars, NumChars) & (LampCommandTable_NumSlots - 1)];
+  const char *pName;
+
+  if (Index < 0)
+    return -1;
+
+  pName = LampCommands[Index].pName;
+  for (uint16_t CharIndex = 0; CharIndex < NumChars; ++CharIndex)
+    if (!pName[CharIndex] || (ToLower(pName[CharIndex]) != ToLower(pChars[CharIndex])))
+      return -1;
+  return pName[NumChars] ? -1 : Index;
+}
+
+static constexpr uint8_t AllLampCommandsFound()
+// Every name, in any case, must find its own entry.
+{
+  for (uint16_t Index = 0; Index < LampCommands_NumCommands; ++Index)
+  {
+    const char *pName = LampCommands[Index].pName;
+    char UpperName[32] = {};
+    uint16_t NumChars = GetNumChars(pName);
+
+    for (uint16_t CharIndex = 0; (CharIndex < NumChars) && (CharIndex < sizeof(UpperName)); ++CharIndex)
+      UpperName[CharIndex] = ((pName[CharIndex] >= 'a') && (pName[CharIndex] <= 'z')) ? pName[CharIndex] - 'a' + 'A' : pName[CharIndex];
+
+    if ((NumChars > sizeof(UpperName)) || (FindLampCommandIndex(pName, NumChars) != Index) || (FindLampCommandIndex(UpperName, NumChars) != Index))
+      return 0;
+    if (!LampCommands[Index].pParameter == !LampCommands[Index].pHandler) // Exactly one of them.
+      return 0;
+  }
+  return FindLampCommandIndex("State", 5) < 0;
+}
+
+static_assert(AllLampCommandsFound(), "LampCommands is not consistent.");
+
+static constexpr uint8_t AllLampChannelsNamed()
+// Every channel's name must find its parameter.
+{
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+  {
+    int16_t Index = FindLampCommandIndex(LampState_ChannelNames[Channel], GetNumChars(LampState_ChannelNames[Channel]));
+
+    if ((Index < 0) || (LampCommands[Index].pParameter != LampState_pChannels[Channel]))
+      return 0;
+  }
+  return 1;
+}
+
+static_assert(AllLampChannelsNamed(), "LampState_ChannelNames does not match LampCommands.");
+
+static const LampCommand_t *FindLampCommand(HTTP_String_t Name)
+// Returns NULL if not found.
+{
+  int16_t Index = FindLampCommandIndex(Name.pChars, Name.NumChars);
+
+  return (Index < 0) ? NULL : &LampCommands[Index];
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // WiFi:
 
+#ifndef WiFi_PortNumber // A host build's tests use one of their own.
 #define WiFi_PortNumber (80)
-
+#endif
+#define WifiServer_MaxNumConnections (4) // Further clients wait in the listen backlog until a connection closes.
+#define WifiServer_InputBuffer_SizeInBytes (1024) // Per connection, which is all the memory a connection needs. Bounds the size of a request's headers and body.
+#define WifiServer_IdleTimeout_s (10) // A persistent connection is closed if no request arrives within this time. WebSocket connections are pinged instead:
+#define WifiServer_PingInterval_s (10) // A WebSocket client that has sent nothing for this long is sent a ping,
+#define WifiServer_PongTimeout_s (5) // and the connection is closed if no pong arrives within this time, so that a client gone without closing does not hold it.
+#define WifiServer_PushInterval_ms (10) // While WebSocket clients are connected, how often the lamp state is checked for changes to push to them. As the LED loop.
+#define WifiServer_MaxHeaderNumBytes (192) // Room left for the header at the start of the output buffer.
+#define WifiServer_CachedBody_MaxNumChars (256)
+#define WifiServer_OutputBacklog_SizeInBytes (512) // Per connection. Output the socket cannot take at once waits here, rather than the server waiting for the client.
+#define WifiServer_SendTimeout_s (2) // A connection is closed if its client does not take any of its output backlog within this time.
+#define WifiServer_StackSize (4096) // Bytes. Requests are parsed in place (see JSB_HTTP.c), so the line length does not affect this. Check against the high water mark logged by WifiServer_Go().
+// Serving every kind of request and frame peaks at 1983 bytes on a host (Host/JSB_LampServerTest.cpp Stack), which checks it is under half. Not measured on an ESP32 here.
+// Handlers that only some requests need are NOINLINE_ATTR, so that their locals are not on the stack under every other request.
+
+#ifndef JSB_HAL_Linux
 typedef struct 
 {
     std::string ssid;
@@ -259,219 +806,1138 @@ void WiFi_Initialize(void)
   ConfigureWiFi(&WiFiCredentials[WiFi_CurrentCredentialIndex]);
   ESP_ERROR_CHECK(esp_wifi_start());
 }
+#endif
 
-void WifiServer_Go(void *)
+typedef struct
 {
-  int rc;
+  int Socket; // -1 => not in use.
+  int64_t LastActivityTime_us;
+  uint8_t RequestPending; // A pipelined request may be waiting in the input buffer.
+  uint8_t IsWebSocket; // After the opening handshake, WebSocket frames are read rather than HTTP requests.
+  uint8_t PingSent; // Awaiting a pong, since PingTime_us.
+  int64_t PingTime_us;
+  uint8_t StatePushed; // PushedState is valid.
+  uint32_t PushedVersion; // LampState_Version when PushedState was read.
+  LampState_t PushedState; // As last sent to the WebSocket client, so that only changes need be sent.
+  HTTP_RequestReader_t RequestReader; // Progress through the request at the start of the input buffer.
+  uint32_t InputBuffer_NumBytes;
+  char InputBuffer[WifiServer_InputBuffer_SizeInBytes];
+  uint8_t SendFailed; // The connection is to be closed, as its output could not be sent or kept.
+  int64_t LastSendTime_us; // When the output backlog was last added to while empty, or last sent from.
+  uint32_t OutputBacklog_NumBytes; // Further input is not handled until this is sent.
+  char OutputBacklog[WifiServer_OutputBacklog_SizeInBytes];
+} WifiServer_Connection_t;
 
-  struct sockaddr_in clientAddress;
-  struct sockaddr_in serverAddress;
+typedef enum
+{
+  hrNeedMoreInput, // No complete request in the input buffer.
+  hrHandled, // Another request may follow in the input buffer.
+  hrClose
+} WifiServer_HandleResult_t;
+
+static WifiServer_Connection_t WifiServer_Connections[WifiServer_MaxNumConnections];
+static uint32_t WifiServer_NumConnections = 0;
+static uint32_t WifiServer_NumOpenConnections = 0;
+static uint32_t WifiServer_NumRequests = 0;
+static uint32_t WifiServer_NumSends = 0; // send() calls, of which there should be one per response.
+static uint32_t WifiServer_NumBytesSent = 0;
+static uint32_t WifiServer_NumBacklogged = 0; // Sends that the socket could not take all of.
+static uint32_t WifiServer_NumSendsFailed = 0; // Connections closed as their output could not be sent or kept.
+
+// Bodies rendered from the lamp state are kept until the state changes, and identified to clients by ETags:
+typedef struct
+{
+  const char *pName; // In its ETag, so that it differs from other bodies of the same version.
+  uint32_t Version; // LampState_Version rendered. 0 => none.
+  uint16_t NumChars;
+  char Chars[WifiServer_CachedBody_MaxNumChars];
+} WifiServer_CachedBody_t;
+
+static WifiServer_CachedBody_t WifiServer_StatusPage = { "page" };
+static WifiServer_CachedBody_t WifiServer_StateJSON = { "state" };
+static uint32_t WifiServer_BootID = 0; // In ETags, so that a version from before a restart does not match.
+static uint32_t WifiServer_NumCacheHits = 0;
+static uint32_t WifiServer_NumCacheMisses = 0;
+static uint32_t WifiServer_NumNotModified = 0; // 304 responses.
+static uint32_t WifiServer_NumStateChanges = 0; // POST /State.
+static uint32_t WifiServer_NumBadStateChanges = 0;
+static uint32_t WifiServer_NumWebSockets = 0; // Open.
+static uint32_t WifiServer_NumFramesReceived = 0;
+static uint32_t WifiServer_NumBadFrames = 0; // Text frames that were not state changes.
+static uint32_t WifiServer_NumStatePushes = 0;
+static uint32_t WifiServer_NumPings = 0;
+static uint32_t WifiServer_NumPingTimeouts = 0; // WebSocket connections closed as no pong arrived.
+
+static void WifiServer_Send(WifiServer_Connection_t *pConnection, const void *pData, uint32_t NumBytes)
+// Sockets are non-blocking, and the server never waits for one, so that a client that does not read cannot hold up the others. What the socket cannot
+// take is kept in the connection's output backlog, and sent as the client makes room (see WifiServer_SendBacklog()). If it does not fit, or on error,
+// the connection is marked to be closed.
+{
+  ssize_t NumBytesSent = 0;
+
+  if (pConnection->SendFailed)
+    return;
+
+  if (!pConnection->OutputBacklog_NumBytes) // Otherwise, this must follow the backlog.
+  {
+    NumBytesSent = send(pConnection->Socket, pData, NumBytes, 0);
+    ++WifiServer_NumSends;
+
+    if (NumBytesSent < 0)
+    {
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+      {
+        pConnection->SendFailed = 1;
+        ++WifiServer_NumSendsFailed;
+        return;
+      }
+      NumBytesSent = 0;
+    }
+    WifiServer_NumBytesSent += NumBytesSent;
+    if (NumBytesSent == NumBytes)
+      return;
+  }
+
+  NumBytes -= NumBytesSent;
+  if (pConnection->OutputBacklog_NumBytes + NumBytes > WifiServer_OutputBacklog_SizeInBytes)
+  {
+    pConnection->SendFailed = 1;
+    ++WifiServer_NumSendsFailed;
+    return;
+  }
+
+  if (!pConnection->OutputBacklog_NumBytes)
+    pConnection->LastSendTime_us = HAL_GetTime_us();
+  memcpy(pConnection->OutputBacklog + pConnection->OutputBacklog_NumBytes, (const char *)pData + NumBytesSent, NumBytes);
+  pConnection->OutputBacklog_NumBytes += NumBytes;
+  ++WifiServer_NumBacklogged;
+}
+
+static void WifiServer_SendBacklog(WifiServer_Connection_t *pConnection)
+// When the socket has room for some of the output backlog.
+{
+  ssize_t NumBytesSent = send(pConnection->Socket, pConnection->OutputBacklog, pConnection->OutputBacklog_NumBytes, 0);
+
+  ++WifiServer_NumSends;
+
+  if (NumBytesSent < 0)
+  {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+    {
+      pConnection->SendFailed = 1;
+      ++WifiServer_NumSendsFailed;
+    }
+    return;
+  }
+
+  WifiServer_NumBytesSent += NumBytesSent;
+  pConnection->OutputBacklog_NumBytes -= NumBytesSent;
+  memmove(pConnection->OutputBacklog, pConnection->OutputBacklog + NumBytesSent, pConnection->OutputBacklog_NumBytes);
+  pConnection->LastSendTime_us = HAL_GetTime_us();
+}
+
+static void WifiServer_SendResponse(WifiServer_Connection_t *pConnection, const char *pStatus, const char *pContentType, HTTP_Buffer_t *pBody, uint8_t SendBody, uint8_t KeepAlive, const char *pETag)
+// pStatus: E.g. "200 OK". Content-Length frames the body, so that the connection can be kept alive for further requests. A 304 response has neither.
+// pContentType: E.g. "text/html". NULL for none.
+// pBody: NULL for none. Must have been initialized WifiServer_MaxHeaderNumBytes into the output buffer, so that the header can be put in front of it.
+// pETag: NULL for none.
+// The whole response is sent with one send(), so that a short one leaves in one segment.
+{
+  char HeaderChars[WifiServer_MaxHeaderNumBytes];
+  HTTP_Buffer_t Header;
+  uint32_t BodyNumBytes = pBody ? pBody->NumChars : 0;
+
+  HTTP_Buffer_Initialize(&Header, HeaderChars, sizeof(HeaderChars));
+  HTTP_Buffer_AppendText(&Header, "HTTP/1.1 ");
+  HTTP_Buffer_AppendText(&Header, pStatus);
+  if (pContentType)
+  {
+    HTTP_Buffer_AppendText(&Header, "\r\nContent-type:");
+    HTTP_Buffer_AppendText(&Header, pContentType);
+  }
+  if (strncmp(pStatus, "304", 3) != 0)
+  {
+    HTTP_Buffer_AppendText(&Header, "\r\nContent-Length: ");
+    HTTP_Buffer_AppendUnsigned(&Header, BodyNumBytes);
+  }
+  if (pETag)
+  {
+    HTTP_Buffer_AppendText(&Header, "\r\nETag: ");
+    HTTP_Buffer_AppendText(&Header, pETag);
+  }
+  HTTP_Buffer_AppendText(&Header, KeepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+  assert(!Header.Overflowed);
+
+  if (!SendBody || !BodyNumBytes)
+  {
+    WifiServer_Send(pConnection, Header.pChars, Header.NumChars);
+    return;
+  }
+
+  memcpy(pBody->pChars - Header.NumChars, Header.pChars, Header.NumChars);
+  WifiServer_Send(pConnection, pBody->pChars - Header.NumChars, Header.NumChars + BodyNumBytes);
+}
+
+static void WifiServer_RenderStatusPage(HTTP_Buffer_t *pBody)
+// Up to the end of the HTML, which depends only on the lamp state.
+{
+  LampState_t State;
+
+  LampState_Get(&State); // All at once, so that the page shows one state.
+  HTTP_Buffer_AppendText(pBody, "<html><body>" ProductName "<br>On: ");
+  HTTP_Buffer_AppendText(pBody, BooleanToNoYes(!State.Off));
+  HTTP_Buffer_AppendText(pBody, "<br>Natural brightness: ");
+  HTTP_Buffer_AppendFixedPoint(pBody, State.Brightnesses[lcNatural], 2);
+  HTTP_Buffer_AppendText(pBody, "<br>Warm brightness: ");
+  HTTP_Buffer_AppendFixedPoint(pBody, State.Brightnesses[lcWarm], 2);
+  HTTP_Buffer_AppendText(pBody, "<br>Red brightness: ");
+  HTTP_Buffer_AppendFixedPoint(pBody, State.Brightnesses[lcRed], 2);
+  HTTP_Buffer_AppendText(pBody, "<br>Green brightness: ");
+  HTTP_Buffer_AppendFixedPoint(pBody, State.Brightnesses[lcGreen], 2);
+  HTTP_Buffer_AppendText(pBody, "<br>Blue brightness: ");
+  HTTP_Buffer_AppendFixedPoint(pBody, State.Brightnesses[lcBlue], 2);
+  HTTP_Buffer_AppendText(pBody, "</body></html>\r\n");
+}
+
+static void WifiServer_UpdateCachedBody(WifiServer_CachedBody_t *pCachedBody, void (*pRender)(HTTP_Buffer_t *pBody))
+// Renders the body again only if the lamp state has changed since it was last rendered.
+{
+  uint32_t Version = LampState_Version; // Read before the state, so that a change while rendering is caught next time.
+  HTTP_Buffer_t Buffer;
+
+  if (pCachedBody->Version == Version)
+  {
+    ++WifiServer_NumCacheHits;
+    return;
+  }
+
+  ++WifiServer_NumCacheMisses;
+  HTTP_Buffer_Initialize(&Buffer, pCachedBody->Chars, sizeof(pCachedBody->Chars));
+  pRender(&Buffer);
+  pCachedBody->NumChars = Buffer.NumChars;
+  pCachedBody->Version = Version;
+}
+
+static void WifiServer_GetETag(const WifiServer_CachedBody_t *pCachedBody, char *pETag, uint16_t MaxNumChars)
+// E.g. "2864434397-42-page", quotes included.
+{
+  HTTP_Buffer_t ETag;
+
+  HTTP_Buffer_Initialize(&ETag, pETag, MaxNumChars - 1);
+  HTTP_Buffer_AppendText(&ETag, "\"");
+  HTTP_Buffer_AppendUnsigned(&ETag, WifiServer_BootID);
+  HTTP_Buffer_AppendText(&ETag, "-");
+  HTTP_Buffer_AppendUnsigned(&ETag, pCachedBody->Version);
+  HTTP_Buffer_AppendText(&ETag, "-");
+  HTTP_Buffer_AppendText(&ETag, pCachedBody->pName);
+  HTTP_Buffer_AppendText(&ETag, "\"");
+  pETag[ETag.NumChars] = '\0';
+}
+
+static void WifiServer_RenderStateJSON(HTTP_Buffer_t *pBody)
+// E.g. {"Off":false,"Natural":0.500,"Warm":0.250,"Red":0.000,"Green":0.000,"Blue":0.000}
+{
+  LampState_t State;
+
+  LampState_Get(&State);
+  HTTP_Buffer_AppendText(pBody, State.Off ? "{\"Off\":true" : "{\"Off\":false");
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+  {
+    HTTP_Buffer_AppendText(pBody, ",\"");
+    HTTP_Buffer_AppendText(pBody, LampState_ChannelNames[Channel]);
+    HTTP_Buffer_AppendText(pBody, "\":");
+    HTTP_Buffer_AppendFixedPoint(pBody, State.Brightnesses[Channel], 3);
+  }
+  HTTP_Buffer_AppendText(pBody, "}\r\n");
+}
+
+static uint8_t WifiServer_ParseHexColour(HTTP_String_t Value, uint16_t *pRGB)
+// E.g. #FF8000, to 16 bit components.
+{
+  if ((Value.NumChars != 7) || (Value.pChars[0] != '#'))
+    return 0;
+
+  for (uint8_t Component = 0; Component < 3; ++Component)
+  {
+    uint8_t Byte = 0;
+
+    for (uint8_t Index = 1 + 2 * Component; Index < 3 + 2 * Component; ++Index)
+    {
+      char Ch = Value.pChars[Index];
+
+      if ((Ch >= '0') && (Ch <= '9'))
+        Byte = 16 * Byte + Ch - '0';
+      else if ((Ch >= 'a') && (Ch <= 'f'))
+        Byte = 16 * Byte + Ch - 'a' + 10;
+      else if ((Ch >= 'A') && (Ch <= 'F'))
+        Byte = 16 * Byte + Ch - 'A' + 10;
+      else
+        return 0;
+    }
+    pRGB[Component] = 257 * Byte;
+  }
+  return 1;
+}
+
+static NOINLINE_ATTR uint8_t WifiServer_ApplyStateQuery(HTTP_String_t Query)
+// Query: E.g. N=0.5&W=0.25. Applied together, as for POST /State, and only if all are valid.
+// Returns 0 if it is not valid, in which case none of it is applied.
+{
+  HTTP_String_t ParameterName, strParameterValue;
+  LampState_Change_t Change = {};
+
+  if (!Query.NumChars)
+    return 0;
+  while (HTTP_GetNextQueryParameter(&Query, &ParameterName, &strParameterValue))
+  {
+    const LampCommand_t *pLampCommand = FindLampCommand(ParameterName);
+    int8_t Channel = pLampCommand ? LampState_FindChannel(pLampCommand->pParameter) : -1;
+    float ParameterValue;
+
+    if ((Channel < 0) || !HTTP_StringToFloat(strParameterValue, &ParameterValue))
+      return 0;
+    LampState_Change_SetBrightness(&Change, (LampChannel_t)Channel, clamp_f(ParameterValue, 0.0f, 1.0f));
+  }
+  LampState_Apply(&Change);
+  return 1;
+}
+
+static uint8_t WifiServer_ParseStateChange(HTTP_String_t Content, LampState_Change_t *pChange)
+// Content: A JSON object with any of the members that GET /State returns, e.g. {"Natural":0.5,"Warm":0.25}. Brightnesses can be named as in LampCommands.
+// It can instead ask for a mix (see LampMix_Initialize()), e.g. {"CCT":2700,"Intensity":0.4} for the whites, and {"RGB":"#FF8000"} or
+// {"HSV":[30,1,0.8]} (hue in degrees) for the colours. Channels named as well take precedence over the mix.
+// Returns 0 if Content is anything else, in which case none of it is to be applied.
+{
+  JSON_Tokenizer_t Tokenizer;
+  JSON_Token_t Token;
+  float Temperature_K = 0.0f, Intensity = 1.0f; // Mixed at the end, as the intensity may follow the temperature.
+  uint8_t HasTemperature = 0, HasColour = 0;
+  uint16_t Levels[LampMix_NumChannels], ColourLevels[LampMix_NumChannels];
+
+  memset(pChange, 0, sizeof(*pChange));
+  JSON_Tokenizer_Initialize(&Tokenizer, Content.pChars, Content.NumChars);
+  if (JSON_GetNextToken(&Tokenizer, &Token) != jtObjectStart)
+    return 0;
+
+  while (JSON_GetNextToken(&Tokenizer, &Token) == jtKey)
+  {
+    HTTP_String_t Name = { Token.pChars, Token.NumChars };
+    JSON_TokenType_t ValueType = JSON_GetNextToken(&Tokenizer, &Token);
+    HTTP_String_t Value = { Token.pChars, Token.NumChars };
+
+    if (HTTP_StringEquals(Name, "Off") && ((ValueType == jtTrue) || (ValueType == jtFalse)))
+    {
+      pChange->SetOff = 1;
+      pChange->State.Off = ValueType == jtTrue;
+    }
+    else if (HTTP_StringEquals(Name, "CCT"))
+    {
+      if ((ValueType != jtNumber) || !HTTP_StringToFloat(Value, &Temperature_K))
+        return 0;
+      HasTemperature = 1;
+    }
+    else if (HTTP_StringEquals(Name, "Intensity"))
+    {
+      if ((ValueType != jtNumber) || !HTTP_StringToFloat(Value, &Intensity))
+        return 0;
+    }
+    else if (HTTP_StringEquals(Name, "RGB"))
+    {
+      uint16_t RGB[3];
+
+      if ((ValueType != jtString) || !WifiServer_ParseHexColour(Value, RGB))
+        return 0;
+      LampMix_FromSRGB(RGB[0], RGB[1], RGB[2], ColourLevels);
+      HasColour = 1;
+    }
+    else if (HTTP_StringEquals(Name, "HSV"))
+    {
+      float HSV[3];
+
+      if (ValueType != jtArrayStart)
+        return 0;
+      for (uint8_t Index = 0; Index < 3; ++Index)
+      {
+        HTTP_String_t Number;
+
+        if (JSON_GetNextToken(&Tokenizer, &Token) != jtNumber)
+          return 0;
+        Number = { Token.pChars, Token.NumChars };
+        if (!HTTP_StringToFloat(Number, &HSV[Index]))
+          return 0;
+      }
+      if (JSON_GetNextToken(&Tokenizer, &Token) != jtArrayEnd)
+        return 0;
+
+      // The hue wraps, as uint16_t:
+      LampMix_FromHSV((int32_t)(clamp_f(HSV[0], -3600.0f, 3600.0f) / 360.0f * 65536.0f), clamp_f(HSV[1], 0.0f, 1.0f) * 65535, clamp_f(HSV[2], 0.0f, 1.0f) * 65535,
+        ColourLevels);
+      HasColour = 1;
+    }
+    else
+    {
+      const LampCommand_t *pLampCommand = FindLampCommand(Name);
+      int8_t Channel = pLampCommand ? LampState_FindChannel(pLampCommand->pParameter) : -1;
+      float Brightness;
+
+      if ((Channel < 0) || (ValueType != jtNumber) || !HTTP_StringToFloat(Value, &Brightness))
+        return 0;
+
+      pChange->ChannelMask |= 1 << Channel;
+      pChange->State.Brightnesses[Channel] = clamp_f(Brightness, 0.0f, 1.0f);
+    }
+  }
+
+  if ((Token.Type != jtObjectEnd) || (JSON_GetNextToken(&Tokenizer, &Token) != jtEnd))
+    return 0;
+
+  if (HasTemperature)
+  {
+    LampMix_FromTemperature(clamp_f(Temperature_K, 0.0f, 65535.0f), GetMixIntensity(Intensity), Levels);
+    LampState_AddMix(pChange, Levels, (1 << lcNatural) | (1 << lcWarm));
+  }
+
+  if (HasColour)
+    LampState_AddMix(pChange, ColourLevels, (1 << lcRed) | (1 << lcGreen) | (1 << lcBlue));
+
+  return 1;
+}
+
+static NOINLINE_ATTR void WifiServer_SendStateJSON(WifiServer_Connection_t *pConnection, HTTP_String_t IfNoneMatch, uint8_t SendBody, uint8_t KeepAlive, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes)
+{
+  HTTP_Buffer_t Body;
+  char ETag[40];
+
+  WifiServer_UpdateCachedBody(&WifiServer_StateJSON, WifiServer_RenderStateJSON);
+  WifiServer_GetETag(&WifiServer_StateJSON, ETag, sizeof(ETag));
+
+  if (HTTP_HasToken(IfNoneMatch, ETag) || HTTP_HasToken(IfNoneMatch, "*"))
+  {
+    ++WifiServer_NumNotModified;
+    WifiServer_SendResponse(pConnection, "304 Not Modified", NULL, NULL, 0, KeepAlive, ETag);
+    return;
+  }
+
+  HTTP_Buffer_Initialize(&Body, pOutputBuffer + WifiServer_MaxHeaderNumBytes, OutputBuffer_SizeInBytes - WifiServer_MaxHeaderNumBytes);
+  HTTP_Buffer_Append(&Body, WifiServer_StateJSON.Chars, WifiServer_StateJSON.NumChars);
+  WifiServer_SendResponse(pConnection, "200 OK", "application/json", &Body, SendBody, KeepAlive, ETag);
+}
+
+static NOINLINE_ATTR uint8_t WifiServer_AcceptWebSocket(WifiServer_Connection_t *pConnection, HTTP_String_t Key)
+// Completes the opening handshake. Returns 0 if Key is not valid.
+{
+  char HeaderChars[WifiServer_MaxHeaderNumBytes];
+  char AcceptKey[WebSocket_AcceptKey_NumChars + 1];
+  HTTP_Buffer_t Header;
+
+  if (!WebSocket_GetAcceptKey(Key.pChars, Key.NumChars, AcceptKey))
+    return 0;
+
+  HTTP_Buffer_Initialize(&Header, HeaderChars, sizeof(HeaderChars));
+  HTTP_Buffer_AppendText(&Header, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: ");
+  HTTP_Buffer_AppendText(&Header, AcceptKey);
+  HTTP_Buffer_AppendText(&Header, "\r\n\r\n");
+  assert(!Header.Overflowed);
+
+  WifiServer_Send(pConnection, Header.pChars, Header.NumChars);
+  return 1;
+}
+
+static uint8_t WifiServer_HandleRequest(WifiServer_Connection_t *pConnection, HTTP_String_t Head, HTTP_String_t Content, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes, uint8_t *pIsWebSocket)
+// Head: The request line and headers, up to and including the blank line.
+// Content: The body, if any.
+// *pIsWebSocket: Set if the connection has become a WebSocket connection.
+// Returns 0 if the connection is to be closed.
+{
+  const char *pCommandErrorMessage = "";
+  HTTP_String_t Line, Name, Value;
+  HTTP_String_t IfNoneMatch = { NULL, 0 };
+  HTTP_String_t Connection = { NULL, 0 }, Upgrade = { NULL, 0 }, WebSocketKey = { NULL, 0 }, WebSocketVersion = { NULL, 0 };
+  HTTP_RequestLine_t RequestLine;
+  uint8_t KeepAlive;
+  char ETag[40];
+
+  ++WifiServer_NumRequests;
+
+  HTTP_GetNextLine(&Head, &Line);
+  ESP_LOGI(WiFiLogTag, "Line: %.*s", Line.NumChars, Line.pChars);
+  if (!HTTP_ParseRequestLine(Line, &RequestLine))
+  {
+    WifiServer_SendResponse(pConnection, "400 Bad Request", NULL, NULL, 0, 0, NULL);
+    return 0;
+  }
+
+  // Persistent connections are the default for HTTP/1.1, and must be asked for by HTTP/1.0 clients:
+  KeepAlive = HTTP_StringEquals(RequestLine.Version, "HTTP/1.1");
+  while (HTTP_GetNextLine(&Head, &Line) && Line.NumChars)
+  {
+    ESP_LOGI(WiFiLogTag, "Line: %.*s", Line.NumChars, Line.pChars);
+    if (!HTTP_ParseHeader(Line, &Name, &Value))
+      continue;
+
+    if (HTTP_StringEquals(Name, "Connection"))
+    {
+      Connection = Value;
+      if (HTTP_HasToken(Value, "close"))
+        KeepAlive = 0;
+      else if (HTTP_HasToken(Value, "keep-alive"))
+        KeepAlive = 1;
+    }
+    else if (HTTP_StringEquals(Name, "If-None-Match"))
+      IfNoneMatch = Value;
+    else if (HTTP_StringEquals(Name, "Upgrade"))
+      Upgrade = Value;
+    else if (HTTP_StringEquals(Name, "Sec-WebSocket-Key"))
+      WebSocketKey = Value;
+    else if (HTTP_StringEquals(Name, "Sec-WebSocket-Version"))
+      WebSocketVersion = Value;
+  }
+
+  // WebSocket: the lamp state is pushed to the client as it changes, and the client can send state changes. Both are as for /State.
+  if (HTTP_StringEquals(RequestLine.Path, "WebSocket"))
+  {
+    if ((RequestLine.Method != hmGET) || !HTTP_HasToken(Connection, "Upgrade") || !HTTP_HasToken(Upgrade, "websocket") || !HTTP_StringEquals(WebSocketVersion, "13") ||
+      !WifiServer_AcceptWebSocket(pConnection, WebSocketKey))
+    {
+      WifiServer_SendResponse(pConnection, "400 Bad Request", NULL, NULL, 0, 0, NULL);
+      return 0;
+    }
+
+    *pIsWebSocket = 1;
+    return 1;
+  }
+
+  // JSON: GET /State returns the lamp state, and POST /State changes any part of it at once:
+  if (HTTP_StringEquals(RequestLine.Path, "State") && !RequestLine.Query.NumChars && (RequestLine.Method != hmUnknown))
+  {
+    if (RequestLine.Method == hmPOST)
+    {
+      LampState_Change_t Change;
+
+      if (!WifiServer_ParseStateChange(Content, &Change))
+      {
+        ++WifiServer_NumBadStateChanges;
+        WifiServer_SendResponse(pConnection, "400 Bad Request", NULL, NULL, 0, KeepAlive, NULL);
+        return KeepAlive;
+      }
+
+      ++WifiServer_NumStateChanges;
+      LampState_Apply(&Change);
+      IfNoneMatch.NumChars = 0; // The new state is always sent.
+    }
+
+    WifiServer_SendStateJSON(pConnection, IfNoneMatch, RequestLine.Method != hmHEAD, KeepAlive, pOutputBuffer, OutputBuffer_SizeInBytes);
+    return KeepAlive;
+  }
+
+  // Handle requests ("request methods") e.g. GET. See: https://en.wikipedia.org/wiki/Hypertext_Transfer_Protocol for more information.
+
+  if ((RequestLine.Method == hmGET) && RequestLine.Path.NumChars)
+  {
+    HTTP_String_t Command = RequestLine.Path;
+    uint8_t ValidCommand = 1;
+
+    ESP_LOGI(WiFiLogTag, "Command: %.*s", Command.NumChars, Command.pChars);
+
+    if (HTTP_StringEquals(Command, "State"))
+      ValidCommand = WifiServer_ApplyStateQuery(RequestLine.Query);
+    else
+    {
+      const LampCommand_t *pLampCommand = FindLampCommand(Command);
+
+      if (pLampCommand && pLampCommand->pHandler)
+        pLampCommand->pHandler();
+      else
+        ValidCommand = 0; // Non-existent command.
+    }
+    //
+    if (!ValidCommand)
+      pCommandErrorMessage = "Invalid command.";
+  }
+
+  WifiServer_UpdateCachedBody(&WifiServer_StatusPage, WifiServer_RenderStatusPage);
+  WifiServer_GetETag(&WifiServer_StatusPage, ETag, sizeof(ETag));
+
+  // A client that already has this version of the page need not be sent it again:
+  if (!*pCommandErrorMessage && (HTTP_HasToken(IfNoneMatch, ETag) || HTTP_HasToken(IfNoneMatch, "*")))
+  {
+    ++WifiServer_NumNotModified;
+    WifiServer_SendResponse(pConnection, "304 Not Modified", NULL, NULL, 0, KeepAlive, ETag);
+    return KeepAlive;
+  }
+
+  HTTP_Buffer_t Body;
+
+  HTTP_Buffer_Initialize(&Body, pOutputBuffer + WifiServer_MaxHeaderNumBytes, OutputBuffer_SizeInBytes - WifiServer_MaxHeaderNumBytes);
+  HTTP_Buffer_Append(&Body, WifiServer_StatusPage.Chars, WifiServer_StatusPage.NumChars);
+  if (*pCommandErrorMessage)
+  {
+    HTTP_Buffer_AppendText(&Body, "<BR>Command error message: ");
+    HTTP_Buffer_AppendText(&Body, pCommandErrorMessage);
+  }
+  HTTP_Buffer_AppendText(&Body, "\r\n");
+  WifiServer_SendResponse(pConnection, "200 OK", "text/html", &Body, RequestLine.Method != hmHEAD, KeepAlive, *pCommandErrorMessage ? NULL : ETag);
+
+  return KeepAlive;
+}
+
+static WifiServer_HandleResult_t WifiServer_HandleNextRequest(WifiServer_Connection_t *pConnection, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes)
+// Handles the first request in the connection's input buffer, as soon as it has been received completely.
+{
+  HTTP_String_t Received = { pConnection->InputBuffer, (uint16_t)pConnection->InputBuffer_NumBytes };
+  HTTP_RequestReader_t *pReader = &pConnection->RequestReader;
+  uint32_t RequestNumBytes;
+  uint8_t KeepAlive, IsWebSocket = 0;
+
+  switch (HTTP_ReadRequest(pReader, Received, WifiServer_InputBuffer_SizeInBytes))
+  {
+    case rrNeedMoreInput:
+      return hrNeedMoreInput;
+    case rrComplete:
+      break;
+    case rrHeadersTooLarge:
+      WifiServer_SendResponse(pConnection, "431 Request Header Fields Too Large", NULL, NULL, 0, 0, NULL);
+      return hrClose;
+    case rrContentTooLarge:
+      WifiServer_SendResponse(pConnection, "413 Content Too Large", NULL, NULL, 0, 0, NULL);
+      return hrClose;
+    default:
+      WifiServer_SendResponse(pConnection, "400 Bad Request", NULL, NULL, 0, 0, NULL);
+      return hrClose;
+  }
+
+  HTTP_String_t Head = { pConnection->InputBuffer + pReader->StartIndex, pReader->HeadNumChars };
+  HTTP_String_t Content = { Head.pChars + Head.NumChars, (uint16_t)pReader->ContentLength };
+  KeepAlive = WifiServer_HandleRequest(pConnection, Head, Content, pOutputBuffer, OutputBuffer_SizeInBytes, &IsWebSocket);
+
+  // Discard the request, keeping any that follow it:
+  RequestNumBytes = pReader->StartIndex + pReader->HeadNumChars + pReader->ContentLength;
+  pConnection->InputBuffer_NumBytes -= RequestNumBytes;
+  memmove(pConnection->InputBuffer, pConnection->InputBuffer + RequestNumBytes, pConnection->InputBuffer_NumBytes);
+  memset(pReader, 0, sizeof(*pReader));
+
+  if (IsWebSocket)
+  {
+    pConnection->IsWebSocket = 1;
+    pConnection->StatePushed = 0;
+    ++WifiServer_NumWebSockets;
+  }
+
+  return KeepAlive ? hrHandled : hrClose;
+}
+
+static void WifiServer_SendFrame(WifiServer_Connection_t *pConnection, WebSocket_Opcode_t Opcode, HTTP_Buffer_t *pPayload)
+// pPayload: As pBody for WifiServer_SendResponse(). The frame is sent with one send().
+{
+  uint8_t Header[WebSocket_MaxFrameHeaderNumBytes];
+  uint8_t HeaderNumBytes = WebSocket_GetFrameHeader(Opcode, pPayload->NumChars, Header);
+
+  memcpy(pPayload->pChars - HeaderNumBytes, Header, HeaderNumBytes);
+  WifiServer_Send(pConnection, pPayload->pChars - HeaderNumBytes, HeaderNumBytes + pPayload->NumChars);
+}
+
+static void WifiServer_SendCloseFrame(WifiServer_Connection_t *pConnection, uint16_t StatusCode, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes)
+// StatusCode: E.g. 1000 (normal closure). See RFC 6455 section 7.4.
+{
+  HTTP_Buffer_t Payload;
+  char StatusCodeChars[2] = { (char)(StatusCode >> 8), (char)(StatusCode & 0xFF) };
+
+  HTTP_Buffer_Initialize(&Payload, pOutputBuffer + WifiServer_MaxHeaderNumBytes, OutputBuffer_SizeInBytes - WifiServer_MaxHeaderNumBytes);
+  HTTP_Buffer_Append(&Payload, StatusCodeChars, sizeof(StatusCodeChars));
+  WifiServer_SendFrame(pConnection, woClose, &Payload);
+}
+
+static void WifiServer_SendPing(WifiServer_Connection_t *pConnection, int64_t Time_us, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes)
+// The client is to answer with a pong, which it is given WifiServer_PongTimeout_s to do.
+{
+  HTTP_Buffer_t Payload;
+
+  HTTP_Buffer_Initialize(&Payload, pOutputBuffer + WifiServer_MaxHeaderNumBytes, OutputBuffer_SizeInBytes - WifiServer_MaxHeaderNumBytes);
+  WifiServer_SendFrame(pConnection, woPing, &Payload);
+  pConnection->PingSent = 1;
+  pConnection->PingTime_us = Time_us;
+  ++WifiServer_NumPings;
+}
+
+static WifiServer_HandleResult_t WifiServer_HandleNextFrame(WifiServer_Connection_t *pConnection, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes)
+// Handles the first WebSocket frame in the connection's input buffer, as soon as it has been received completely.
+// A text frame is a state change, as for POST /State. It is requested rather than applied, so that a client streaming changes (e.g. from a slider) cannot update the LEDs faster than the LED loop.
+{
+  WebSocket_Frame_t Frame;
+  HTTP_Buffer_t Payload;
+
+  switch (WebSocket_ReadFrame(pConnection->InputBuffer, pConnection->InputBuffer_NumBytes, WifiServer_InputBuffer_SizeInBytes, &Frame))
+  {
+    case wrNeedMoreInput:
+      return hrNeedMoreInput;
+    case wrComplete:
+      break;
+    case wrTooLarge:
+      WifiServer_SendCloseFrame(pConnection, 1009, pOutputBuffer, OutputBuffer_SizeInBytes); // Message too big.
+      return hrClose;
+    default:
+      WifiServer_SendCloseFrame(pConnection, 1002, pOutputBuffer, OutputBuffer_SizeInBytes); // Protocol error.
+      return hrClose;
+  }
+
+  ++WifiServer_NumFramesReceived;
+
+  switch (Frame.Opcode)
+  {
+    case woText:
+    {
+      HTTP_String_t Content = { Frame.pPayload, (uint16_t)Frame.PayloadNumChars };
+      LampState_Change_t Change;
+
+      if (!Frame.Final) // Messages are small, so are not expected to be fragmented.
+      {
+        WifiServer_SendCloseFrame(pConnection, 1009, pOutputBuffer, OutputBuffer_SizeInBytes);
+        return hrClose;
+      }
+
+      if (WifiServer_ParseStateChange(Content, &Change))
+        LampState_Request(&Change);
+      else
+        ++WifiServer_NumBadFrames;
+      break;
+    }
+
+    case woPing:
+      HTTP_Buffer_Initialize(&Payload, pOutputBuffer + WifiServer_MaxHeaderNumBytes, OutputBuffer_SizeInBytes - WifiServer_MaxHeaderNumBytes);
+      HTTP_Buffer_Append(&Payload, Frame.pPayload, Frame.PayloadNumChars);
+      WifiServer_SendFrame(pConnection, woPong, &Payload);
+      break;
+
+    case woPong:
+      pConnection->PingSent = 0;
+      break;
+
+    case woClose:
+      WifiServer_SendCloseFrame(pConnection, 1000, pOutputBuffer, OutputBuffer_SizeInBytes);
+      return hrClose;
+
+    default:
+      WifiServer_SendCloseFrame(pConnection, 1003, pOutputBuffer, OutputBuffer_SizeInBytes); // Unsupported data.
+      return hrClose;
+  }
+
+  // Discard the frame, keeping any that follow it:
+  pConnection->InputBuffer_NumBytes -= Frame.NumChars;
+  memmove(pConnection->InputBuffer, pConnection->InputBuffer + Frame.NumChars, pConnection->InputBuffer_NumBytes);
+
+  return hrHandled;
+}
+
+static void WifiServer_PushState(WifiServer_Connection_t *pConnection, char *pOutputBuffer, uint32_t OutputBuffer_SizeInBytes)
+// Sends a WebSocket client the members of the lamp state that have changed since it was last sent them (the first time, all of them), as JSON in a text frame.
+// E.g. {"Natural":0.500,"Warm":0.250}
+{
+  uint32_t Version = LampState_Version; // Read before the state, as for WifiServer_UpdateCachedBody().
+  const char *pSeparator = "{";
+  HTTP_Buffer_t Payload;
+  LampState_t State;
+
+  if (pConnection->StatePushed && (pConnection->PushedVersion == Version))
+    return;
+
+  LampState_Get(&State);
+  HTTP_Buffer_Initialize(&Payload, pOutputBuffer + WifiServer_MaxHeaderNumBytes, OutputBuffer_SizeInBytes - WifiServer_MaxHeaderNumBytes);
+
+  if (!pConnection->StatePushed || (State.Off != pConnection->PushedState.Off))
+  {
+    HTTP_Buffer_AppendText(&Payload, pSeparator);
+    HTTP_Buffer_AppendText(&Payload, State.Off ? "\"Off\":true" : "\"Off\":false");
+    pSeparator = ",";
+  }
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    if (!pConnection->StatePushed || (State.Brightnesses[Channel] != pConnection->PushedState.Brightnesses[Channel]))
+    {
+      HTTP_Buffer_AppendText(&Payload, pSeparator);
+      HTTP_Buffer_AppendText(&Payload, "\"");
+      HTTP_Buffer_AppendText(&Payload, LampState_ChannelNames[Channel]);
+      HTTP_Buffer_AppendText(&Payload, "\":");
+      HTTP_Buffer_AppendFixedPoint(&Payload, State.Brightnesses[Channel], 3);
+      pSeparator = ",";
+    }
+
+  pConnection->StatePushed = 1;
+  pConnection->PushedVersion = Version;
+  pConnection->PushedState = State;
+
+  if (*pSeparator == '{') // Changed back, so nothing to send.
+    return;
+
+  HTTP_Buffer_AppendText(&Payload, "}");
+  ++WifiServer_NumStatePushes;
+  WifiServer_SendFrame(pConnection, woText, &Payload);
+}
+
+static void WifiServer_LogStatistics()
+{
+  ESP_LOGI(WiFiLogTag, "esp_get_free_heap_size(): %lu", esp_get_free_heap_size());
+  ESP_LOGI(WiFiLogTag, "esp_get_minimum_free_heap_size(): %lu", esp_get_minimum_free_heap_size());
+  ESP_LOGI(WiFiLogTag, "uxTaskGetStackHighWaterMark(): %lu", (unsigned long)uxTaskGetStackHighWaterMark(NULL));
+  ESP_LOGI(WiFiLogTag, "Status page: %lu cache hits, %lu cache misses, %lu not modified", (unsigned long)WifiServer_NumCacheHits, (unsigned long)WifiServer_NumCacheMisses, (unsigned long)WifiServer_NumNotModified);
+  ESP_LOGI(WiFiLogTag, "State changes: %lu, rejected: %lu", (unsigned long)WifiServer_NumStateChanges, (unsigned long)WifiServer_NumBadStateChanges);
+  ESP_LOGI(WiFiLogTag, "WebSockets: %lu open, frames: %lu received, %lu rejected, state changes: %lu requested, %lu applied, pushes: %lu", (unsigned long)WifiServer_NumWebSockets,
+    (unsigned long)WifiServer_NumFramesReceived, (unsigned long)WifiServer_NumBadFrames, (unsigned long)LampState_NumRequestedChanges, (unsigned long)LampState_NumAppliedChanges,
+    (unsigned long)WifiServer_NumStatePushes);
+  ESP_LOGI(WiFiLogTag, "WebSocket pings: %lu, closed as not answered: %lu", (unsigned long)WifiServer_NumPings, (unsigned long)WifiServer_NumPingTimeouts);
+  ESP_LOGI(WiFiLogTag, "Connections: %lu open, %lu total, requests: %lu, sends: %lu, bytes sent: %lu", (unsigned long)WifiServer_NumOpenConnections, (unsigned long)WifiServer_NumConnections,
+    (unsigned long)WifiServer_NumRequests, (unsigned long)WifiServer_NumSends, (unsigned long)WifiServer_NumBytesSent);
+  ESP_LOGI(WiFiLogTag, "Sends backlogged: %lu, connections closed as their output could not be sent: %lu", (unsigned long)WifiServer_NumBacklogged,
+    (unsigned long)WifiServer_NumSendsFailed);
+  {
+    ILI9341_GlyphCacheStatistics_t GlyphCacheStatistics;
+
+    ILI9341_GlyphCache_GetStatistics(&GlyphCacheStatistics);
+    ESP_LOGI(WiFiLogTag, "Glyph cache: %lu / %lu bytes, %lu entries, %lu hits, %lu misses, %lu evictions",
+      (unsigned long)GlyphCacheStatistics.NumBytes, (unsigned long)GlyphCacheStatistics.MaxNumBytes, (unsigned long)GlyphCacheStatistics.NumEntries,
+      (unsigned long)GlyphCacheStatistics.NumHits, (unsigned long)GlyphCacheStatistics.NumMisses, (unsigned long)GlyphCacheStatistics.NumEvictions);
+  }
+}
+
+static void WifiServer_CloseConnection(WifiServer_Connection_t *pConnection)
+{
+  shutdown(pConnection->Socket, 2); //??? I want the equivalent of Arduino Client.Stop().
+  closesocket(pConnection->Socket);
+  pConnection->Socket = -1;
+  --WifiServer_NumOpenConnections;
+  if (pConnection->IsWebSocket)
+    --WifiServer_NumWebSockets;
+}
+
+void WifiServer_Go(void *)
+// Serves several clients at once from a single select() loop. Each connection has its own input buffer, and is served in turn.
+{
+  int rc;
+
+  struct sockaddr_in clientAddress;
+  struct sockaddr_in serverAddress;
+
+  uint32_t OutputBuffer_SizeInBytes = 1024;
+  char *pOutputBuffer = (char *)malloc(OutputBuffer_SizeInBytes);
+  uint32_t FirstConnectionIndex = 0;
+
+  for (uint32_t Index = 0; Index < WifiServer_MaxNumConnections; ++Index)
+    WifiServer_Connections[Index].Socket = -1;
+  WifiServer_BootID = esp_random();
+
+  // Create a listening socket.
+  ESP_LOGI(WiFiLogTag, "Creating socket");
+  int ListeningSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (ListeningSocket < 0)
+  {
+    ESP_LOGE(WiFiLogTag, "socket(): %d %s", ListeningSocket, strerror(errno));
+    goto END;
+  }
+
+  // Bind this socket to a port.
+  serverAddress.sin_family = AF_INET;
+  serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  serverAddress.sin_port = htons(WiFi_PortNumber);
+  ESP_LOGI(WiFiLogTag, "Binding socket");
+  rc = bind(ListeningSocket, (struct sockaddr * ) &serverAddress, sizeof(serverAddress));
+  if (rc < 0)
+  {
+    ESP_LOGE(WiFiLogTag, "bind(): %d %s", rc, strerror(errno));
+    goto END;
+  }
+
+  // Listen.
+  ESP_LOGI(WiFiLogTag, "Listening");
+  rc = listen(ListeningSocket, 5);
+  if (rc < 0)
+  {
+    ESP_LOGE(WiFiLogTag, "listen(): %d %s", rc, strerror(errno));
+    goto END;
+  }
+
+  WifiServer_LogStatistics();
+
+  while (1)
+  {
+    fd_set ReadSockets, WriteSockets;
+    int MaxSocket = -1;
+    uint8_t RequestPending = 0;
+
+    // Wait for input on any connection with room for it, room to send any output backlog or, if there is room for one, a new connection:
+    FD_ZERO(&ReadSockets);
+    FD_ZERO(&WriteSockets);
+    if (WifiServer_NumOpenConnections < WifiServer_MaxNumConnections)
+    {
+      FD_SET(ListeningSocket, &ReadSockets);
+      MaxSocket = ListeningSocket;
+    }
+    for (uint32_t Index = 0; Index < WifiServer_MaxNumConnections; ++Index)
+    {
+      WifiServer_Connection_t *pConnection = &WifiServer_Connections[Index];
+
+      if (pConnection->Socket < 0)
+        continue;
+      if (pConnection->InputBuffer_NumBytes < WifiServer_InputBuffer_SizeInBytes)
+        FD_SET(pConnection->Socket, &ReadSockets);
+      if (pConnection->OutputBacklog_NumBytes)
+        FD_SET(pConnection->Socket, &WriteSockets);
+      if (pConnection->Socket > MaxSocket)
+        MaxSocket = pConnection->Socket;
+      RequestPending |= pConnection->RequestPending && !pConnection->OutputBacklog_NumBytes;
+    }
+
+    // Wake up regularly to close idle connections and, more often, to push changes to WebSocket clients:
+    struct timeval Timeout = { WifiServer_NumWebSockets ? 0 : 1, WifiServer_NumWebSockets ? WifiServer_PushInterval_ms * 1000 : 0 };
+    if (RequestPending)
+      Timeout.tv_sec = Timeout.tv_usec = 0;
+    rc = select(MaxSocket + 1, &ReadSockets, &WriteSockets, NULL, &Timeout);
+    if (rc < 0)
+    {
+      ESP_LOGE(WiFiLogTag, "select(): %d %s", rc, strerror(errno));
+      vTaskDelay(100 / portTICK_PERIOD_MS);
+      continue;
+    }
+
+    // New connection:
+    if (FD_ISSET(ListeningSocket, &ReadSockets))
+    {
+      socklen_t clientAddressLength = sizeof(clientAddress);
+      int ClientSocket = accept(ListeningSocket, (struct sockaddr *)&clientAddress, &clientAddressLength);
+
+      if (ClientSocket < 0)
+        ESP_LOGE(WiFiLogTag, "Accept: %d %s", ClientSocket, strerror(errno));
+      else
+      {
+        WifiServer_Connection_t *pConnection = WifiServer_Connections;
+
+        while (pConnection->Socket >= 0)
+          ++pConnection;
+
+        fcntl(ClientSocket, F_SETFL, fcntl(ClientSocket, F_GETFL, 0) | O_NONBLOCK);
+        pConnection->Socket = ClientSocket;
+        pConnection->LastActivityTime_us = HAL_GetTime_us();
+        pConnection->RequestPending = 0;
+        pConnection->IsWebSocket = 0;
+        pConnection->PingSent = 0;
+        pConnection->InputBuffer_NumBytes = 0;
+        memset(&pConnection->RequestReader, 0, sizeof(pConnection->RequestReader));
+        pConnection->SendFailed = 0;
+        pConnection->OutputBacklog_NumBytes = 0;
+        ++WifiServer_NumOpenConnections;
+        ++WifiServer_NumConnections;
+
+        ESP_LOGI(WiFiLogTag, "Client connection accepted");
+        WifiServer_LogStatistics();
+      }
+    }
+
+    // Serve the connections in turn, starting with a different one each time. At most one request is handled per connection per turn, so that none can hold up the others.
+    for (uint32_t Count = 0; Count < WifiServer_MaxNumConnections; ++Count)
+    {
+      WifiServer_Connection_t *pConnection = &WifiServer_Connections[(FirstConnectionIndex + Count) % WifiServer_MaxNumConnections];
+      int64_t Time_us = HAL_GetTime_us();
+
+      if (pConnection->Socket < 0)
+        continue;
+
+      if (FD_ISSET(pConnection->Socket, &WriteSockets))
+        WifiServer_SendBacklog(pConnection);
+
+      if (FD_ISSET(pConnection->Socket, &ReadSockets))
+      {
+        ssize_t NumBytesRead = recv(pConnection->Socket, pConnection->InputBuffer + pConnection->InputBuffer_NumBytes, WifiServer_InputBuffer_SizeInBytes - pConnection->InputBuffer_NumBytes, 0);
+
+        if ((NumBytesRead == 0) || ((NumBytesRead < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))) // Connection closed or error condition.
+        {
+          WifiServer_CloseConnection(pConnection);
+          continue;
+        }
+        if (NumBytesRead > 0)
+        {
+          pConnection->InputBuffer_NumBytes += NumBytesRead;
+          pConnection->LastActivityTime_us = Time_us;
+        }
+      }
+
+      // Until the client has taken the output backlog, its further requests wait, as does anything to be pushed to it:
+      if (pConnection->SendFailed || (pConnection->OutputBacklog_NumBytes && (Time_us - pConnection->LastSendTime_us > WifiServer_SendTimeout_s * 1000000LL)))
+      {
+        WifiServer_CloseConnection(pConnection);
+        continue;
+      }
+      if (pConnection->OutputBacklog_NumBytes)
+        continue;
+
+      WifiServer_HandleResult_t Result = pConnection->IsWebSocket ? WifiServer_HandleNextFrame(pConnection, pOutputBuffer, OutputBuffer_SizeInBytes) :
+        WifiServer_HandleNextRequest(pConnection, pOutputBuffer, OutputBuffer_SizeInBytes);
+
+      if ((Result != hrClose) && pConnection->IsWebSocket)
+        WifiServer_PushState(pConnection, pOutputBuffer, OutputBuffer_SizeInBytes);
+      if (pConnection->SendFailed)
+        Result = hrClose;
+      pConnection->RequestPending = Result == hrHandled;
+
+      switch (Result)
+      {
+        case hrNeedMoreInput:
+          if (!pConnection->IsWebSocket)
+          {
+            if (Time_us - pConnection->LastActivityTime_us > WifiServer_IdleTimeout_s * 1000000LL)
+              WifiServer_CloseConnection(pConnection);
+          }
+          else if (pConnection->PingSent)
+          {
+            if (Time_us - pConnection->PingTime_us > WifiServer_PongTimeout_s * 1000000LL)
+            {
+              ++WifiServer_NumPingTimeouts;
+              WifiServer_CloseConnection(pConnection);
+            }
+          }
+          else if (Time_us - pConnection->LastActivityTime_us > WifiServer_PingInterval_s * 1000000LL)
+            WifiServer_SendPing(pConnection, Time_us, pOutputBuffer, OutputBuffer_SizeInBytes);
+          break;
+        case hrHandled:
+          pConnection->LastActivityTime_us = Time_us;
+          break;
+        case hrClose:
+          WifiServer_CloseConnection(pConnection);
+          break;
+      }
+    }
+    FirstConnectionIndex = (FirstConnectionIndex + 1) % WifiServer_MaxNumConnections;
+  }
+
+  free(pOutputBuffer);
+
+END:
+  vTaskDelete(NULL);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UDP:
+//
+// => Lamp packets (see JSB_LampPacket.c) sent to UdpServer_PortNumber set the channels, e.g. 50-100 times a second for effects driven from a PC.
+// => Packets from one sender at a time are expected. Stale ones are dropped, and of those waiting, only the newest is applied, with
+//    LampState_Apply() as for HTTP commands. They are not requested as WebSocket frames are, as that would only coalesce them a second time.
+
+#ifndef UdpServer_PortNumber
+#define UdpServer_PortNumber (4210)
+#endif
+#define UdpServer_StreamTimeout_ms (2000) // After this long without a packet, the sender may have restarted its sequence.
+#define UdpServer_LogInterval_s (10) // Statistics are logged this often while packets arrive.
+#define UdpServer_StackSize (3072) // Peaks at 375 bytes on a host (Host/JSB_LampServerTest.cpp Stack). Not measured on an ESP32 here.
+
+static LampPacket_Sequencer_t UdpServer_Sequencer;
+static uint32_t UdpServer_NumPacketsReceived = 0;
+static uint32_t UdpServer_NumBadPackets = 0;
+static uint32_t UdpServer_NumSuperseded = 0; // Accepted, but a newer packet was waiting too.
+static uint32_t UdpServer_NumApplied = 0;
+
+static void UdpServer_LogStatistics()
+{
+  ESP_LOGI(WiFiLogTag, "UDP: %lu packets received, %lu bad, %lu accepted, %lu stale, %lu lost, %lu superseded, %lu applied", (unsigned long)UdpServer_NumPacketsReceived,
+    (unsigned long)UdpServer_NumBadPackets, (unsigned long)UdpServer_Sequencer.NumAccepted, (unsigned long)UdpServer_Sequencer.NumStale, (unsigned long)UdpServer_Sequencer.NumLost,
+    (unsigned long)UdpServer_NumSuperseded, (unsigned long)UdpServer_NumApplied);
+}
 
-  uint32_t InputBuffer_SizeInBytes = 1024;
-  char *pInputBuffer = (char *)malloc(InputBuffer_SizeInBytes);
-  uint32_t OutputBuffer_SizeInBytes = 1024;
-  char *pOutputBuffer = (char *)malloc(OutputBuffer_SizeInBytes);
+static void UdpServer_GetChange(const LampPacket_t *pPacket, LampState_Change_t *pChange)
+{
+  memset(pChange, 0, sizeof(*pChange));
+  pChange->SetOff = (pPacket->Flags & lpfSetOff) != 0;
+  pChange->State.Off = (pPacket->Flags & lpfOff) != 0;
+  pChange->ChannelMask = pPacket->ChannelMask;
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    pChange->State.Brightnesses[Channel] = pPacket->Intensities[Channel] / 65535.0f;
+}
 
-  // Create a listening socket.
-  ESP_LOGI(WiFiLogTag, "Creating socket");
-  int ListeningSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-  if (ListeningSocket < 0)
-  {
-    ESP_LOGE(WiFiLogTag, "socket(): %d %s", ListeningSocket, strerror(errno));
-    goto END;
-  }
+void UdpServer_Go(void *)
+{
+  struct sockaddr_in ServerAddress, SenderAddress, StreamAddress;
+  uint8_t Bytes[LampPacket_MaxNumBytes + 1]; // One more, so that a packet too long to be valid is seen to be.
+  int64_t LastPacketTime_us = 0, LastLogTime_us = 0;
+  int Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
 
-  // Bind this socket to a port.
-  serverAddress.sin_family = AF_INET;
-  serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
-  serverAddress.sin_port = htons(WiFi_PortNumber);
-  ESP_LOGI(WiFiLogTag, "Binding socket");
-  rc = bind(ListeningSocket, (struct sockaddr * ) &serverAddress, sizeof(serverAddress));
-  if (rc < 0)
+  if (Socket < 0)
   {
-    ESP_LOGE(WiFiLogTag, "bind(): %d %s", rc, strerror(errno));
-    goto END;
+    ESP_LOGE(WiFiLogTag, "UDP socket(): %d %s", Socket, strerror(errno));
+    vTaskDelete(NULL);
+    return;
   }
 
-  // Listen.
-  ESP_LOGI(WiFiLogTag, "Listening");
-  rc = listen(ListeningSocket, 5);
-  if (rc < 0)
+  memset(&ServerAddress, 0, sizeof(ServerAddress));
+  ServerAddress.sin_family = AF_INET;
+  ServerAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+  ServerAddress.sin_port = htons(UdpServer_PortNumber);
+  if (bind(Socket, (struct sockaddr *)&ServerAddress, sizeof(ServerAddress)) < 0)
   {
-    ESP_LOGE(WiFiLogTag, "listen(): %d %s", rc, strerror(errno));
-    goto END;
+    ESP_LOGE(WiFiLogTag, "UDP bind(): %s", strerror(errno));
+    closesocket(Socket);
+    vTaskDelete(NULL);
+    return;
   }
+  memset(&StreamAddress, 0, sizeof(StreamAddress));
 
   while (1)
   {
-    ESP_LOGI(WiFiLogTag, "esp_get_free_heap_size(): %lu", esp_get_free_heap_size());
-    ESP_LOGI(WiFiLogTag, "esp_get_minimum_free_heap_size(): %lu", esp_get_minimum_free_heap_size());
-
-    // Wait for a new client connection.
-    socklen_t clientAddressLength = sizeof(clientAddress);
-    int ClientSocket = accept(ListeningSocket, (struct sockaddr *)&clientAddress, &clientAddressLength);
-    if (ClientSocket < 0)
-    {
-      ESP_LOGE(WiFiLogTag, "Accept: %d %s", ClientSocket, strerror(errno));
-      continue;
-    }
-
-    ESP_LOGI(WiFiLogTag, "Client connection accepted");
-
-    int InputBuffer_NumBytes = 0;
-
-    std::string CommandErrorMessage;
-
-    ssize_t NumBytesRead = recv(ClientSocket, pInputBuffer, InputBuffer_SizeInBytes - 1, MSG_WAITALL);
-    if (NumBytesRead <= 0) // Connection broken or error condition.
-      break;
-    InputBuffer_NumBytes = NumBytesRead;
-    pInputBuffer[InputBuffer_NumBytes] = '\0'; // Ensure string is terminated.
-
-    uint32_t InputBufferIndex = 0;
-    std::string Line;
-    uint8_t IsFirstLine = 1;
-
-#define MaxLineNumCharsSupported (64) // Not too long or else regex_search can use vast amounts of stack.
+    LampPacket_t Packet, NewestPacket = {}; // Only read once valid, but initialized as the compiler cannot tell.
+    uint8_t NewestPacketValid = 0;
+    int RecvFlags = 0; // Wait for a packet, then take any others already waiting.
+    int64_t Time_us;
 
     while (1)
     {
-      if (InputBufferIndex >= InputBuffer_NumBytes)
-        break;
+      socklen_t SenderAddressLength = sizeof(SenderAddress);
+      ssize_t NumBytes = recvfrom(Socket, Bytes, sizeof(Bytes), RecvFlags, (struct sockaddr *)&SenderAddress, &SenderAddressLength);
 
-      Line.clear();
-      char *pLineStart = &pInputBuffer[InputBufferIndex];
-      char *pLineEnd = strpbrk(pLineStart, "\r");
-      if (!pLineEnd)
-        break;
-      uint32_t LineNumChars = pLineEnd - pLineStart; // Don't include terminator character.
-      Line.append(pLineStart, LineNumChars > MaxLineNumCharsSupported ? MaxLineNumCharsSupported : LineNumChars);
-      InputBufferIndex += LineNumChars + 2; // Skip \r\n. Ugly!
-
-      if (!Line.size())
+      Time_us = HAL_GetTime_us();
+      if (NumBytes < 0)
       {
-        snprintf(pOutputBuffer, OutputBuffer_SizeInBytes, "HTTP/1.1 200 OK\r\nContent-type:text/html\r\n\r\n");
-        send(ClientSocket, pOutputBuffer, strlen(pOutputBuffer), 0);
-
-        char *pOnAsYesNo = BooleanToNoYes(!Off);
-        snprintf(pOutputBuffer, OutputBuffer_SizeInBytes, "<html><body>%s<br>On: %s<br>Natural brightness: %0.2f<br>Warm brightness: %0.2f<br>Red brightness: %0.2f<br>Green brightness: %0.2f<br>Blue brightness: %0.2f</body></html>\r\n", ProductName, pOnAsYesNo, NaturalBrightness, WarmBrightness, RedBrightness, GreenBrightness, BlueBrightness);
-        send(ClientSocket, pOutputBuffer, strlen(pOutputBuffer), 0);
-
-        if (!CommandErrorMessage.empty())
+        if (!RecvFlags)
         {
-          snprintf(pOutputBuffer, OutputBuffer_SizeInBytes, "<BR>Command error message: %s", CommandErrorMessage.c_str());
-          send(ClientSocket, pOutputBuffer, strlen(pOutputBuffer), 0);
+          ESP_LOGE(WiFiLogTag, "UDP recvfrom(): %s", strerror(errno));
+          vTaskDelay(100 / portTICK_PERIOD_MS);
         }
-
-        snprintf(pOutputBuffer, OutputBuffer_SizeInBytes, "\r\n");
-        send(ClientSocket, pOutputBuffer, strlen(pOutputBuffer), 0);
-
         break;
       }
+      RecvFlags = MSG_DONTWAIT;
+      ++UdpServer_NumPacketsReceived;
 
-      ESP_LOGI(WiFiLogTag, "Line: %s", Line.c_str());
-
-      // Handle requests ("request methods") e.g. GET. See: https://en.wikipedia.org/wiki/Hypertext_Transfer_Protocol for more information.
+      if (!LampPacket_Decode(Bytes, NumBytes, &Packet) || (Packet.ChannelMask >> lcNumChannels))
+      {
+        ++UdpServer_NumBadPackets;
+        continue;
+      }
 
-      if (IsFirstLine) // Only check first line of request.
+      if ((SenderAddress.sin_addr.s_addr != StreamAddress.sin_addr.s_addr) || (SenderAddress.sin_port != StreamAddress.sin_port) ||
+        (Time_us - LastPacketTime_us > UdpServer_StreamTimeout_ms * 1000LL))
       {
-        CommandErrorMessage = "Invalid command.";
+        LampPacket_RestartSequence(&UdpServer_Sequencer);
+        StreamAddress = SenderAddress;
+      }
+      LastPacketTime_us = Time_us;
 
-        std::smatch SearchResults;
+      if (!LampPacket_AcceptSequence(&UdpServer_Sequencer, Packet.Sequence))
+        continue;
 
-        if (regex_search(Line, SearchResults, std::regex("^GET /(\\S+)", std::regex_constants::icase))) // Causes stack overflow with 257 byte input string, even with 32768 byte stack!
-        {
-          if (SearchResults.size() > 1)
-          {
-            std::string Command(SearchResults.str(1));
-            ESP_LOGI(WiFiLogTag, "Command: SearchResults: %s", Command.c_str());
+      if (NewestPacketValid)
+        ++UdpServer_NumSuperseded;
+      NewestPacket = Packet;
+      NewestPacketValid = 1;
+    }
 
-            if (regex_search(Command, SearchResults, std::regex("^State\\?(\\S+?)=(\\S+)$", std::regex_constants::icase)))
-            {
-              if (SearchResults.size() > 1)
-              {
-                std::string ParameterName(SearchResults.str(1));
-                std::string strParameterValue (SearchResults.str(2));
-
-                float ParameterValue;
-                if (sscanf(strParameterValue.c_str(), "%f", &ParameterValue))
-                {
-                  if (ParameterValue < 0.0f)
-                    ParameterValue = 0.0f;
-                  else if (ParameterValue > 1.0f)
-                    ParameterValue = 1.0f;
-
-                  // NB: Shared variables are not protected from simultaneous access!
-                  uint8_t ValidCommand = 1;
-                  //
-                  if ((strcasecmp(ParameterName.c_str(), "N") == 0) || (strcasecmp(ParameterName.c_str(), "NaturalBrightness") == 0))
-                    NaturalBrightness = ParameterValue;
-                  else if ((strcasecmp(ParameterName.c_str(), "W") == 0) || (strcasecmp(ParameterName.c_str(), "WarmBrightness") == 0))
-                    WarmBrightness = ParameterValue;
-                  else if ((strcasecmp(ParameterName.c_str(), "R") == 0) || (strcasecmp(ParameterName.c_str(), "RedBrightness") == 0))
-                    RedBrightness = ParameterValue;
-                  else if ((strcasecmp(ParameterName.c_str(), "G") == 0) || (strcasecmp(ParameterName.c_str(), "GreenBrightness") == 0))
-                    GreenBrightness = ParameterValue;
-                  else if ((strcasecmp(ParameterName.c_str(), "B") == 0) || (strcasecmp(ParameterName.c_str(), "BlueBrightness") == 0))
-                    BlueBrightness = ParameterValue;
-                  else
-                    ValidCommand = 0;
-                  //
-                  if (ValidCommand)
-                    CommandErrorMessage = "";
-                }
-              }
-            }
-            else
-            {
-              uint8_t ValidCommand = 1;
-              //
-              if (strcasecmp(Command.c_str(), "Off") == 0)
-              {
-                Off = 1;
-                OffChanged = 1;
-              }
-              else if (strcasecmp(Command.c_str(), "On") == 0)
-              {
-                Off = 0;
-                OffChanged = 1;
-              }
-              else if (strcasecmp(Command.c_str(), "Night") == 0)
-              {
-               NaturalBrightness = 0.0f;
-               WarmBrightness = 0.3f;
-              }
-              else if (strcasecmp(Command.c_str(), "Bright") == 0)
-              {
-               NaturalBrightness = 1.0f;
-               WarmBrightness = 1.0f;
-               Off = 0;
-               OffChanged = 1;
-              }
-              else
-                ValidCommand = 0; // Non-existent command.
-              //
-              if (ValidCommand)
-                CommandErrorMessage = "";
-            }
-          }
-        }
-        else
-          CommandErrorMessage = ""; // No command is OK.
-      }
+    if (NewestPacketValid)
+    {
+      LampState_Change_t Change;
 
-      IsFirstLine = 0;
+      UdpServer_GetChange(&NewestPacket, &Change);
+      LampState_Apply(&Change);
+      ++UdpServer_NumApplied;
     }
 
-    shutdown(ClientSocket, 2); //??? I want the equivalent of Arduino Client.Stop().
-    closesocket(ClientSocket);
+    if (Time_us - LastLogTime_us > UdpServer_LogInterval_s * 1000000LL)
+    {
+      UdpServer_LogStatistics();
+      LastLogTime_us = Time_us;
+    }
   }
-
-  free(pInputBuffer);
-  free(pOutputBuffer);
-
-END:
-  vTaskDelete(NULL);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -503,84 +1969,365 @@ static uint8_t IsPointInButton(uint16_t X, uint16_t Y, uint16_t Left, uint16_t T
 typedef enum
 {
   LED_None,
-  LED_WarmWhite = LEDC_CHANNEL_0,
-  LED_NaturalWhite = LEDC_CHANNEL_1,
-  LED_Red = LEDC_CHANNEL_2,
-  LED_Green = LEDC_CHANNEL_3,
-  LED_Blue = LEDC_CHANNEL_4
+  LED_WarmWhite = 0, // LEDC channel.
+  LED_NaturalWhite = 1,
+  LED_Red = 2,
+  LED_Green = 3,
+  LED_Blue = 4
 } LED_t;
 
+#define LED_NumLEDs 5
+#define LED_LogInterval_s (60) // How often Go() logs the counts below.
+#define LED_Frequency_Hz 5000
+#define LED_Resolution_bits 12
+#define LED_MaxDuty (1 << LED_Resolution_bits) // Fully on.
+#define LED_Dither_bits 2 // Resolution of the duties worked out, beyond the LEDC's, which dithering shows (see LED_DitherTick()).
+
+static uint32_t LED_Duties[LED_NumLEDs]; // In 1 / (1 << LED_Dither_bits) steps, whole ones unless dithered. As last written, or at the end of the ramp in progress, so that the LEDC is only written when a duty changes. InitializeLEDControl() sets them all to 0.
+static uint32_t LED_NumUpdates = 0; // Lamp state changes shown.
+static uint32_t LED_NumDutyWrites = 0;
+
+// Fades:
+// => A lamp state change fades each LED to its new brightness, along an easing curve over LED_FadeTime_ms. A change made during a fade
+//    retargets it from where it has got to.
+// => Changes that follow each other more closely than that (a slider being dragged, a UDP stream) fade over the time between them, so
+//    that they are followed without lag.
+// => The LEDC hardware ramps duty linearly, with no CPU involvement, but on the ESP32 a hardware fade cannot be stopped once started.
+//    So a fade is run as a chain of hardware ramps of at most LED_FadeSegment_ms, each ending on the curve: a retarget waits for
+//    the ramp in progress, at most that long, and the curve is followed piecewise linearly, whatever its shape.
+// => The software fallback, for when the hardware fade is not available or an LED is dithered, and for remnants too short for a ramp:
+//    Go() writes the duty on the curve each time round.
+
+typedef enum
+{
+  feLinear, // In brightness, as perceived.
+  feSmoothStep // Eases in and out.
+} LED_Easing_t;
+
+#define LED_FadeTime_ms 300 // 0 => changes are shown at once.
+#define LED_FadeEasing feSmoothStep
+#define LED_FadeSegment_ms 50 // Longest hardware ramp.
+#define LED_MinHardwareFade_ms 20 // Shortest.
+#define LED_Position_Max ((BrightnessTable_NumEntries - 1) << BrightnessTable_Fraction_bits) // Brightness 1, as a table position.
+#define LED_Fraction_One (1 << 16) // Fractions of a fade are Q16.
+
+typedef struct
+{
+  uint8_t Active;
+  uint32_t FromPosition, ToPosition; // Brightness, as table positions.
+  int64_t StartTime_us;
+  uint32_t Time_us;
+} LED_Fade_t;
+
+static LED_Fade_t LED_Fades[LED_NumLEDs];
+static constexpr LampChannel_t LED_Channels[LED_NumLEDs] = { lcWarm, lcNatural, lcRed, lcGreen, lcBlue }; // By LED_t.
+static uint8_t LED_HardwareFade = 0; // Set by InitializeLEDControl(), if the LEDC fade is available.
+static uint32_t LED_NumFadeRamps = 0;
+
+static constexpr uint32_t GetEasedFraction(LED_Easing_t Easing, uint32_t Fraction)
+// Fraction, of the time, to fraction of the way. Both Q16, [0, LED_Fraction_One].
+{
+  switch (Easing)
+  {
+    case feSmoothStep: // 3f^2 - 2f^3, rounded once so that it stays monotonic.
+      return ((uint64_t)Fraction * Fraction * (3 * LED_Fraction_One - 2 * Fraction)) >> 32;
+    case feLinear:
+    default:
+      return Fraction;
+  }
+}
+
+static constexpr uint8_t AllEasingsValid()
+// Each easing must start at the start, end at the end, and never go backwards.
+{
+  for (uint8_t Easing = feLinear; Easing <= feSmoothStep; ++Easing)
+  {
+    if ((GetEasedFraction((LED_Easing_t)Easing, 0) != 0) || (GetEasedFraction((LED_Easing_t)Easing, LED_Fraction_One) != LED_Fraction_One))
+      return 0;
+
+    for (uint32_t Fraction = 0; Fraction < LED_Fraction_One; Fraction += 16)
+      if (GetEasedFraction((LED_Easing_t)Easing, Fraction + 16) < GetEasedFraction((LED_Easing_t)Easing, Fraction))
+        return 0;
+  }
+  return 1;
+}
+
+static_assert(AllEasingsValid(), "An easing is not monotonic, or does not run from start to end.");
+
+static uint32_t GetFadePosition(const LED_Fade_t *pFade, int64_t Time_us)
+{
+  uint32_t Fraction;
+
+  if (!pFade->Active || (Time_us - pFade->StartTime_us >= pFade->Time_us))
+    return pFade->ToPosition;
+  if (Time_us <= pFade->StartTime_us)
+    return pFade->FromPosition;
+
+  Fraction = ((uint64_t)(Time_us - pFade->StartTime_us) << 16) / pFade->Time_us;
+  return pFade->FromPosition + (((int64_t)pFade->ToPosition - pFade->FromPosition) * GetEasedFraction(LED_FadeEasing, Fraction) >> 16);
+}
+
+static uint32_t GetLEDDuty(LED_t LED, uint32_t Position)
+// In 1 / (1 << LED_Dither_bits) steps.
+{
+  return ((uint64_t)InterpolateBrightnessTable(LampChannel_Curves[LED_Channels[LED]], Position) * (LED_MaxDuty << LED_Dither_bits) + BrightnessTable_MaxDrive / 2) / BrightnessTable_MaxDrive;
+}
+
+static constexpr uint32_t GetWholeDuty(uint32_t Duty)
+// Duty in 1 / (1 << LED_Dither_bits) steps, rounded to the LEDC's.
+{
+  return (Duty + (1 << (LED_Dither_bits - 1))) >> LED_Dither_bits;
+}
+
+// Dithering:
+// => At the very bottom of the range a step in duty is a visible step in brightness: below LED_DitherMaxDuty, one is over 3% of the light.
+// => Off unless LED_SetDithering() turns it on. Then LED_DitherTick() runs every LED_DitherPeriod_us, from a timer, and writes each LED
+//    whose duty is below LED_DitherMaxDuty the duty either side of its fractional one, first order sigma-delta, so that on average it is
+//    the fractional duty: LED_Dither_bits more resolution. Other LEDs are written and faded as without it, so a constant state above
+//    the bottom of the range writes nothing.
+// => It does all the writing of those LEDs' duties, each tick, and only of those that change. Their fades are run in software, as the
+//    LEDC driver cannot write a duty to a channel that is fading.
+// => The LEDC driver's writes may block, so they are made after LED_DitherLock is released: it is only held to hand LEDs over and back,
+//    and to read their duties. An LED is handed back by LED_DitherTick() itself, at the start of a tick, so that none of its writes can
+//    follow Go()'s.
+// => The tick is LED_DitherPeriod_us, whole PWM periods, as a duty written takes effect at the end of one, and as few as keeps the
+//    slowest pattern, one step in 1 << LED_Dither_bits, well above flicker fusion: it repeats at 250 Hz. The step it alternates
+//    between is at most one in LED_MaxDuty of the light.
+
+#define LED_DitherPeriod_us 1000 // 1 kHz, 5 PWM periods.
+#define LED_DitherMaxDuty 32 // Whole steps.
+
+static_assert(LED_Dither_bits > 0, "Duties are worked out in finer steps than the LEDC's.");
+static_assert(LED_DitherPeriod_us % (1000000 / LED_Frequency_Hz) == 0, "The dither tick is not whole PWM periods.");
+
+static uint8_t LED_Dithering = 0; // See LED_SetDithering().
+static uint8_t LED_DitherTimerStarted = 0;
+static portMUX_TYPE LED_DitherLock = portMUX_INITIALIZER_UNLOCKED; // Held while LEDs are handed over or back, and their duties read. No LEDC call is made while it is held.
+static volatile uint8_t LED_Dithered[LED_NumLEDs]; // LED_DitherTick() writes these LEDs, and Go() does not.
+static volatile uint8_t LED_DitherReleases[LED_NumLEDs]; // Go() wants these LEDs back. LED_DitherTick() clears LED_Dithered[] for them.
+static volatile uint32_t LED_DitherDuties[LED_NumLEDs]; // As LED_Duties, for LED_DitherTick().
+static uint32_t LED_DitherErrors[LED_NumLEDs]; // Only used by LED_DitherTick(), and by Go() before handing it an LED, as are the below.
+static uint32_t LED_DitherWrittenDuties[LED_NumLEDs];
+static uint32_t LED_DitherNumTicks = 0;
+static uint32_t LED_DitherNumDutyWrites = 0;
+static int64_t LED_DitherTotalTime_us = 0;
+static uint32_t LED_DitherMaxTime_us = 0;
+
+static constexpr uint32_t GetDitheredDuty(uint32_t Duty, uint32_t *pError)
+// Duty in 1 / (1 << LED_Dither_bits) steps, to whole steps. The fraction left over is carried, in *pError, to the next tick.
+{
+  uint32_t Sum = *pError + (Duty & ((1 << LED_Dither_bits) - 1));
+
+  *pError = Sum & ((1 << LED_Dither_bits) - 1);
+  return (Duty >> LED_Dither_bits) + (Sum >> LED_Dither_bits);
+}
+
+static constexpr uint8_t DitheringAveragesExactly()
+// Over 1 << LED_Dither_bits ticks, the duties written must add up to the fractional duty, for every fraction, and never be more
+// than one step apart.
+{
+  for (uint32_t Duty = 0; Duty <= 4 << LED_Dither_bits; ++Duty)
+  {
+    uint32_t Error = 0;
+    uint32_t Sum = 0;
+
+    for (uint32_t Tick = 0; Tick < (1 << LED_Dither_bits); ++Tick)
+    {
+      uint32_t DitheredDuty = GetDitheredDuty(Duty, &Error);
+
+      if ((DitheredDuty < (Duty >> LED_Dither_bits)) || (DitheredDuty > (Duty >> LED_Dither_bits) + 1))
+        return 0;
+      Sum += DitheredDuty;
+    }
+
+    if (Sum != Duty)
+      return 0;
+  }
+  return 1;
+}
+
+static_assert(DitheringAveragesExactly(), "Dithering does not average to the duty.");
+
+static void LED_DitherTick(void *pArgument)
+{
+  int64_t StartTime_us = HAL_GetTime_us();
+  uint32_t Duties[LED_NumLEDs];
+  uint8_t Dithered[LED_NumLEDs];
+  uint32_t Time_us;
+
+  portENTER_CRITICAL(&LED_DitherLock);
+  for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+  {
+    if (LED_DitherReleases[LED])
+      LED_Dithered[LED] = 0;
+    Dithered[LED] = LED_Dithered[LED];
+    Duties[LED] = LED_DitherDuties[LED];
+  }
+  portEXIT_CRITICAL(&LED_DitherLock);
+
+  for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+  {
+    if (!Dithered[LED])
+      continue;
+
+    uint32_t Duty = GetDitheredDuty(Duties[LED], &LED_DitherErrors[LED]);
+
+    if (Duty != LED_DitherWrittenDuties[LED])
+    {
+      LED_DitherWrittenDuties[LED] = Duty;
+      ++LED_DitherNumDutyWrites;
+      HAL_LEDC_SetDuty(LED, Duty);
+    }
+  }
+
+  Time_us = HAL_GetTime_us() - StartTime_us;
+  LED_DitherTotalTime_us += Time_us;
+  if (Time_us > LED_DitherMaxTime_us)
+    LED_DitherMaxTime_us = Time_us;
+  ++LED_DitherNumTicks;
+}
+
+static void LED_LogDithering()
+// The counts are read while LED_DitherTick() may be updating them, which only matters to the log.
+{
+  uint32_t NumTicks = LED_DitherNumTicks;
+
+  if (!NumTicks)
+    return;
+
+  ESP_LOGI(DefaultLogTag, "LED dithering: %lu ticks, %lu duty writes, %.1f us per tick average, %lu us max, %.2f%% of a core", (unsigned long)NumTicks,
+    (unsigned long)LED_DitherNumDutyWrites, (double)LED_DitherTotalTime_us / NumTicks, (unsigned long)LED_DitherMaxTime_us,
+    100.0 * LED_DitherTotalTime_us / ((double)NumTicks * LED_DitherPeriod_us));
+}
+
 static void InitializeLEDControl()
 {
-  ledc_timer_config_t timer_conf = {};
-  ledc_channel_config_t ledc_conf = {};
-
-  timer_conf.duty_resolution = LEDC_TIMER_12_BIT;
-  timer_conf.freq_hz = 5000;
-  timer_conf.speed_mode = LEDC_HIGH_SPEED_MODE;
-  timer_conf.timer_num = LEDC_TIMER_0;
-  timer_conf.clk_cfg = LEDC_USE_APB_CLK;
-  ESP_ERROR_CHECK(ledc_timer_config(&timer_conf));
-
-  ledc_conf.channel = LEDC_CHANNEL_0;
-  ledc_conf.duty = 0;
-  ledc_conf.gpio_num = LED_Head_WarmWhite_GPIO;
-  ledc_conf.intr_type = LEDC_INTR_DISABLE;
-  ledc_conf.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_conf.timer_sel = LEDC_TIMER_0;
-  ledc_channel_config(&ledc_conf);
-  //
-  ledc_conf.channel = LEDC_CHANNEL_1;
-  ledc_conf.duty = 0;
-  ledc_conf.gpio_num = LED_Head_NaturalWhite_GPIO;
-  ledc_conf.intr_type = LEDC_INTR_DISABLE;
-  ledc_conf.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_conf.timer_sel = LEDC_TIMER_0;
-  ledc_channel_config(&ledc_conf);
-  //
-  ledc_conf.channel = LEDC_CHANNEL_2;
-  ledc_conf.duty = 0;
-  ledc_conf.gpio_num = LED_Head_Red_GPIO;
-  ledc_conf.intr_type = LEDC_INTR_DISABLE;
-  ledc_conf.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_conf.timer_sel = LEDC_TIMER_0;
-  ledc_channel_config(&ledc_conf);
-  //
-  ledc_conf.channel = LEDC_CHANNEL_3;
-  ledc_conf.duty = 0;
-  ledc_conf.gpio_num = LED_Head_Green_GPIO;
-  ledc_conf.intr_type = LEDC_INTR_DISABLE;
-  ledc_conf.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_conf.timer_sel = LEDC_TIMER_0;
-  ledc_channel_config(&ledc_conf);
-  //
-  ledc_conf.channel = LEDC_CHANNEL_4;
-  ledc_conf.duty = 0;
-  ledc_conf.gpio_num = LED_Head_Blue_GPIO;
-  ledc_conf.intr_type = LEDC_INTR_DISABLE;
-  ledc_conf.speed_mode = LEDC_HIGH_SPEED_MODE;
-  ledc_conf.timer_sel = LEDC_TIMER_0;
-  ledc_channel_config(&ledc_conf);
+  HAL_LEDC_InitializeTimer(LED_Frequency_Hz, LED_Resolution_bits);
+
+  HAL_LEDC_InitializeChannel(LED_WarmWhite, LED_Head_WarmWhite_GPIO);
+  HAL_LEDC_InitializeChannel(LED_NaturalWhite, LED_Head_NaturalWhite_GPIO);
+  HAL_LEDC_InitializeChannel(LED_Red, LED_Head_Red_GPIO);
+  HAL_LEDC_InitializeChannel(LED_Green, LED_Head_Green_GPIO);
+  HAL_LEDC_InitializeChannel(LED_Blue, LED_Head_Blue_GPIO);
+
+  LED_HardwareFade = HAL_LEDC_InstallFade(LED_NumLEDs);
+  if (!LED_HardwareFade)
+    ESP_LOGW(DefaultLogTag, "LEDC fade not available: fading in software.");
+}
+
+void LED_SetDithering(uint8_t On)
+// Each LED is handed to LED_DitherTick(), or back, the next time round Go(). The timer is started the first time, and then runs on, doing
+// nothing while no LED is dithered.
+{
+  LED_Dithering = On;
+  if (On && !LED_DitherTimerStarted)
+  {
+    HAL_StartPeriodicTimer(LED_DitherTick, NULL, LED_DitherPeriod_us);
+    LED_DitherTimerStarted = 1;
+  }
+
+  for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+    LED_Fades[LED].Active = 1; // Looked at again, even if not fading.
+}
+
+static void SetLEDBrightness(LED_t LED, float Brightness, uint32_t FadeTime_us, int64_t Time_us)
+// Starts a fade, from wherever any fade in progress has got to. UpdateLEDFade() then runs it.
+{
+  LED_Fade_t *pFade = &LED_Fades[LED];
+  uint32_t Position = 0;
+
+  if (Brightness > 0.0f) // Also excludes NaN.
+    Position = (Brightness < 1.0f) ? (uint32_t)(Brightness * LED_Position_Max) : LED_Position_Max;
+
+  pFade->FromPosition = GetFadePosition(pFade, Time_us);
+  pFade->ToPosition = Position;
+  pFade->StartTime_us = Time_us;
+  pFade->Time_us = FadeTime_us;
+  pFade->Active = 1;
+}
+
+static uint8_t LED_SetDithered(LED_t LED, uint8_t Dithered)
+// Hands the LED to LED_DitherTick(), or asks for it back. Returns 0 while it is still to be given back, at the next tick. Once handed
+// either way, its duty is written (see UpdateLEDFade()).
+{
+  if (!Dithered && LED_Dithered[LED])
+  {
+    LED_DitherReleases[LED] = 1;
+    return 0;
+  }
+  if (!Dithered && LED_DitherReleases[LED]) // Given back.
+  {
+    LED_DitherReleases[LED] = 0;
+    LED_Duties[LED] = UINT32_MAX;
+    return 1;
+  }
+  if (!Dithered || (LED_Dithered[LED] && !LED_DitherReleases[LED]))
+    return 1;
+
+  portENTER_CRITICAL(&LED_DitherLock);
+  if (!LED_DitherReleases[LED]) // Rather than asked back, in which case LED_DitherTick()'s state is still that of the LEDC.
+  {
+    LED_DitherErrors[LED] = 0;
+    LED_DitherWrittenDuties[LED] = GetWholeDuty(LED_Duties[LED]); // As written by Go() until now.
+    LED_DitherDuties[LED] = LED_Duties[LED];
+  }
+  LED_Dithered[LED] = 1;
+  LED_DitherReleases[LED] = 0;
+  portEXIT_CRITICAL(&LED_DitherLock);
+  LED_Duties[LED] = UINT32_MAX;
+  return 1;
 }
 
-static void SetLEDBrightness(LED_t LED, float Brightness)
+static void UpdateLEDFade(LED_t LED, int64_t Time_us)
+// Called each time round Go(). Only writes the LEDC when the duty is to change.
 {
-  float Drive;
+  LED_Fade_t *pFade = &LED_Fades[LED];
+  int64_t EndTime_us = pFade->StartTime_us + pFade->Time_us;
+  int64_t RampEndTime_us;
+  uint32_t Duty;
+
+  if (!pFade->Active || HAL_LEDC_IsFading(LED)) // A ramp in progress must be waited for.
+    return;
+
+  if (!LED_SetDithered(LED, LED_Dithering && (GetLEDDuty(LED, pFade->ToPosition) < (LED_DitherMaxDuty << LED_Dither_bits))))
+    return; // Looked at again next time round.
+
+  if (!LED_HardwareFade || LED_Dithered[LED] || (EndTime_us - Time_us < LED_MinHardwareFade_ms * 1000LL))
+  {
+    // Software:
+    Duty = GetLEDDuty(LED, GetFadePosition(pFade, Time_us));
+    if (Time_us >= EndTime_us)
+      pFade->Active = 0;
+
+    if (!LED_Dithered[LED])
+      Duty = GetWholeDuty(Duty) << LED_Dither_bits;
+    if (Duty == LED_Duties[LED])
+      return;
+
+    LED_Duties[LED] = Duty;
+    ++LED_NumDutyWrites;
+    if (LED_Dithered[LED])
+      LED_DitherDuties[LED] = Duty; // LED_DitherTick() writes it.
+    else
+      HAL_LEDC_SetDuty(LED, Duty >> LED_Dither_bits);
+    return;
+  }
 
-  Brightness = clamp_f(Brightness, 0.0f, 1.0f);
+  // Hardware, a ramp at a time. One that would leave too short a remnant runs to the end:
+  RampEndTime_us = Time_us + LED_FadeSegment_ms * 1000LL;
+  if (EndTime_us - RampEndTime_us < LED_MinHardwareFade_ms * 1000LL)
+    RampEndTime_us = EndTime_us;
 
-  Drive = cube(Brightness); // Obtain good brightness control at low brightness values.
+  Duty = GetWholeDuty(GetLEDDuty(LED, GetFadePosition(pFade, RampEndTime_us))) << LED_Dither_bits;
+  if (RampEndTime_us == EndTime_us)
+    pFade->Active = 0;
 
-// For debugging:
-//  char S[64];
-//  if (LED == LED_WarmWhite)
-//  {
-//    sprintf(S, "Brightness Drive: %f %d           ", Brightness, (int)(4096 * Drive));
-//    ILI9341_DrawTextAtXY(S, 0, 160, tpLeft);
-//  }
+  if (Duty == LED_Duties[LED]) // Flat: looked at again next time round.
+    return;
 
-  ledc_set_duty(LEDC_HIGH_SPEED_MODE, ledc_channel_t(LED), 4096 * Drive);
-  ledc_update_duty(LEDC_HIGH_SPEED_MODE, ledc_channel_t(LED));
+  LED_Duties[LED] = Duty;
+  ++LED_NumFadeRamps;
+  HAL_LEDC_StartFade(LED, Duty >> LED_Dither_bits, (RampEndTime_us - Time_us) / 1000);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -658,7 +2405,10 @@ typedef enum
 static Mode_t Mode = mdNone;
 
 static void DrawScreen()
+// The whole screen is composed as one frame so that only pixels that have changed are sent to the display.
 {
+  ILI9341_Compositor_BeginFrame();
+
   ILI9341_SetFont(&FreeSans12pt7b);
   ILI9341_DrawTextAtXY(ProductName, 0, 30, tpLeft);
   ILI9341_DrawTextAtXY("Hello Emma!", 0, 65, tpLeft);
@@ -685,6 +2435,8 @@ static void DrawScreen()
   DrawButton(Button_White_Left, Button_White_Top, Button_White_Width, Button_White_Height, Button_White_Color, Button_White_Text);
   DrawButton(Button_Off_Left, Button_Off_Top, Button_Off_Width, Button_Off_Height, Button_Off_Color, Button_Off_Text);
   DrawButton(Button_Color_Left, Button_Color_Top, Button_Color_Width, Button_Color_Height, Button_Color_Color, Button_Color_Text);
+
+  ILI9341_Compositor_EndFrame();
 }
 
 static void SetMode(Mode_t Value)
@@ -701,15 +2453,20 @@ static void SetMode(Mode_t Value)
 
 void ProcessTouch(int16_t Touch_X, int16_t Touch_Y)
 {
+  LampState_Change_t Change = {};
+
   if (!ButtonPressed)
   {
+    LampState_t State;
+
     PressedButton = pbNone; // Default.
 
-    if (Off) // Turn on.
+    LampState_Get(&State);
+    if (State.Off) // Turn on.
     {
       ButtonPressed = 1;
-      Off = 0;
-      OffChanged = 1;
+      LampState_Change_SetOff(&Change, 0);
+      LampState_Apply(&Change);
       return;
     }
 
@@ -722,7 +2479,8 @@ void ProcessTouch(int16_t Touch_X, int16_t Touch_Y)
     {
       ButtonPressed = 1;
       ILI9341_Clear(ILI9341_COLOR_BLACK);
-      Off = 1;
+      LampState_Change_SetOff(&Change, 1);
+      LampState_Apply(&Change);
     }
     else if (IsPointInButton(Touch_X, Touch_Y, Button_Color_Left, Button_Color_Top, Button_Color_Width, Button_Color_Height))
     {
@@ -759,158 +2517,138 @@ void ProcessTouch(int16_t Touch_X, int16_t Touch_Y)
     switch (PressedButton)
     {
       case pbWhites:
-        WarmBrightness = CalculateInterpolationCoefficient(Touch_X, Button_Whites_Left, Button_Whites_Left + Button_Whites_Width);
-        NaturalBrightness = 1.0f - CalculateInterpolationCoefficient(Touch_Y, Button_Whites_Top, Button_Whites_Top + Button_Whites_Height);
+        LampState_Change_SetBrightness(&Change, lcWarm, CalculateInterpolationCoefficient(Touch_X, Button_Whites_Left, Button_Whites_Left + Button_Whites_Width));
+        LampState_Change_SetBrightness(&Change, lcNatural, 1.0f - CalculateInterpolationCoefficient(Touch_Y, Button_Whites_Top, Button_Whites_Top + Button_Whites_Height));
         break;
 
       case pbRed:
-        RedBrightness = CalculateInterpolationCoefficient(Touch_X, Button_Red_Left, Button_Red_Left + Button_Red_Width);
+        LampState_Change_SetBrightness(&Change, lcRed, CalculateInterpolationCoefficient(Touch_X, Button_Red_Left, Button_Red_Left + Button_Red_Width));
         break;
 
       case pbGreen:
-        GreenBrightness = CalculateInterpolationCoefficient(Touch_X, Button_Green_Left, Button_Green_Left + Button_Green_Width);
+        LampState_Change_SetBrightness(&Change, lcGreen, CalculateInterpolationCoefficient(Touch_X, Button_Green_Left, Button_Green_Left + Button_Green_Width));
         break;
 
       case pbBlue:
-        BlueBrightness = CalculateInterpolationCoefficient(Touch_X, Button_Blue_Left, Button_Blue_Left + Button_Blue_Width);
+        LampState_Change_SetBrightness(&Change, lcBlue, CalculateInterpolationCoefficient(Touch_X, Button_Blue_Left, Button_Blue_Left + Button_Blue_Width));
         break;
 
       default:
         break;
     }
+    if (Change.ChannelMask)
+      LampState_Apply(&Change);
   }
 }
 
-static void Go()
+#define Go_Period_ms 10 // How often Go() goes round: the touch panel is sampled, and the LEDs updated.
+
+// Go() state:
+static uint32_t LEDs_Version = 0; // LampState_Version shown by the LEDs. 0 => none yet.
+static int64_t LEDs_LastUpdateTime_us = 0;
+static int64_t Go_LastLogTime_us = 0;
+
+static void Go_Begin()
 {
-  int16_t Touch_RawX, Touch_RawY, Touch_RawZ;
-  int16_t Touch_X, Touch_Y;
+  float PixelsPerSecond, BusUtilization;
+  LampState_Change_t Change = {};
 
+  ILI9341_ResetStatistics();
   ILI9341_Clear(ILI9341_COLOR_BLACK);
+  ILI9341_GetThroughput(&PixelsPerSecond, &BusUtilization);
+  ESP_LOGI(DefaultLogTag, "Display clear: %0.0f pixels/s, bus utilization %0.0f%%", PixelsPerSecond, 100.0f * BusUtilization);
 
-  WarmBrightness = 0.0f;
-  NaturalBrightness = 0.0f;
-  RedBrightness = 0.0f;
-  GreenBrightness = 0.0f;
-  BlueBrightness = 0.0f;
-
-  Off = 0;
-  OffChanged = 1;
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    LampState_Change_SetBrightness(&Change, (LampChannel_t)Channel, 0.0f);
+  LampState_Change_SetOff(&Change, 0);
+  LampState_Apply(&Change);
 
   SetMode(mdWhites);
 
   ILI9341_SetFont(&FreeSans9pt7b);
   ILI9341_SetTextDrawMode(tdmAnyCharBar);
 
-  while (1)
+  Go_LastLogTime_us = HAL_GetTime_us();
+}
+
+static void Go_Iterate()
+// Once round Go(). Separate, so that a host build's tests can run the loop in simulated time.
+{
+  int16_t Touch_RawX, Touch_RawY, Touch_RawZ;
+  int16_t Touch_X, Touch_Y;
+  LampState_t State;
+
+  if (XPT2046_Sample(&Touch_RawX, &Touch_RawY, &Touch_RawZ))
   {
-    if (XPT2046_Sample(&Touch_RawX, &Touch_RawY, &Touch_RawZ))
-    {
-      XPT2046_ConvertRawToScreen(Touch_RawX, Touch_RawY, &Touch_X, &Touch_Y);
+    XPT2046_ConvertRawToScreen(Touch_RawX, Touch_RawY, &Touch_X, &Touch_Y);
 
 #ifdef DebugTouchScreen
-        ILI9341_SetFont(&FreeSans9pt7b);
-        
-        char S[64];
-        sESP_LOGI(DefaultLogTag, S, "Raw XYZ: %d %d %d           ", Touch_RawX, Touch_RawY, Touch_RawZ);
-        ILI9341_DrawTextAtXY(S, 0, 140, tpLeft);
-
-        sESP_LOGI(DefaultLogTag, S, "XY: %d %d           ", Touch_X, Touch_Y);
-        ILI9341_DrawTextAtXY(S, 0, 200, tpLeft);
+      ILI9341_SetFont(&FreeSans9pt7b);
+      
+      char S[64];
+      sESP_LOGI(DefaultLogTag, S, "Raw XYZ: %d %d %d           ", Touch_RawX, Touch_RawY, Touch_RawZ);
+      ILI9341_DrawTextAtXY(S, 0, 140, tpLeft);
+
+      sESP_LOGI(DefaultLogTag, S, "XY: %d %d           ", Touch_X, Touch_Y);
+      ILI9341_DrawTextAtXY(S, 0, 200, tpLeft);
 #endif
 
-      ProcessTouch(Touch_X, Touch_Y);
-    }
-    else
-    {
-      ButtonPressed = 0;
-    }
+    ProcessTouch(Touch_X, Touch_Y);
+  }
+  else
+  {
+    ButtonPressed = 0;
+  }
 
-    if (OffChanged)
-    {
-      OffChanged = 0;
+  if (OffChanged.exchange(0))
+  {
+    LampState_Get(&State);
+    if (!State.Off) // Turned on. While off, the backlight is (see below).
       DrawScreen();
-    }
+  }
 
-    if (Off)
-    {
-      gpio_set_level(gpio_num_t(Display_BacklightX_GPIO), 0);
-      SetLEDBrightness(LED_WarmWhite, 0.0f);
-      SetLEDBrightness(LED_NaturalWhite, 0.0f);
-      SetLEDBrightness(LED_Red, 0.0f);
-      SetLEDBrightness(LED_Green, 0.0f);
-      SetLEDBrightness(LED_Blue, 0.0f);
-    }
-    else
-    {
-      gpio_set_level(gpio_num_t(Display_BacklightX_GPIO), 1);
-      SetLEDBrightness(LED_WarmWhite, WarmBrightness);
-      SetLEDBrightness(LED_NaturalWhite, NaturalBrightness);
-      SetLEDBrightness(LED_Red, RedBrightness);
-      SetLEDBrightness(LED_Green, GreenBrightness);
-      SetLEDBrightness(LED_Blue, BlueBrightness);
-    }
+  LampState_ApplyRequested();
+
+  // The LEDs (and backlight) are only updated when the lamp state changes:
+  uint32_t Version = LampState_Version; // Read before the state, as for WifiServer_UpdateCachedBody().
+  int64_t Time_us = HAL_GetTime_us();
+
+  if (Version != LEDs_Version)
+  {
+    uint32_t FadeTime_us = (Time_us - LEDs_LastUpdateTime_us < LED_FadeTime_ms * 1000LL) ? Time_us - LEDs_LastUpdateTime_us : LED_FadeTime_ms * 1000;
+
+    LampState_Get(&State); // All at once, so that a change made elsewhere is shown whole.
+    LEDs_Version = Version;
+    LEDs_LastUpdateTime_us = Time_us;
+    ++LED_NumUpdates;
 
-    vTaskDelay(10 / portTICK_PERIOD_MS); // Feed watchdog.
+    HAL_GPIO_SetLevel(Display_BacklightX_GPIO, !State.Off);
+    for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+      SetLEDBrightness((LED_t)LED, State.Off ? 0.0f : State.Brightnesses[LED_Channels[LED]], FadeTime_us, Time_us);
   }
-}
 
-extern "C"
-{
-  void app_main();
+  for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+    UpdateLEDFade((LED_t)LED, Time_us);
+
+  if (Time_us - Go_LastLogTime_us > LED_LogInterval_s * 1000000LL)
+  {
+    ESP_LOGI(DefaultLogTag, "LEDs: %lu updates, %lu duty writes, %lu fade ramps", (unsigned long)LED_NumUpdates, (unsigned long)LED_NumDutyWrites,
+      (unsigned long)LED_NumFadeRamps);
+    LED_LogDithering();
+    Go_LastLogTime_us = Time_us;
+  }
 }
 
-void app_main()
+static void InitializeLamp()
+// All but NVS and WiFi, which a host build does not have.
 {
-  esp_err_t ret;
-
-  ESP_LOGI(DefaultLogTag, "Initializing NVS:");
-  NVS_Initialize();
-  ESP_LOGI(DefaultLogTag, "Done");
-
   // Initialize the SPI buses:
   ESP_LOGI(DefaultLogTag, "Initializing DisplaySPI bus:");
-  spi_bus_config_t DisplaySPI_BusConfiguration =
-  {
-	  .mosi_io_num = DisplaySPI_MOSI_GPIO,
-	  .miso_io_num = DisplaySPI_MISO_GPIO,
-	  .sclk_io_num = DisplaySPI_SCK_GPIO,
-	  .quadwp_io_num = -1,
-	  .quadhd_io_num = -1,
-	  .data4_io_num = -1,
-	  .data5_io_num = -1,
-	  .data6_io_num = -1,
-	  .data7_io_num = -1,
-    .data_io_default_level = 0,
-	  .max_transfer_sz = 0,
-	  .flags = 0,
-      .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO,
-	  .intr_flags = 0
-  };
-  ret = spi_bus_initialize(DisplaySPI_HostDevice, &DisplaySPI_BusConfiguration, DisplaySPI_DMAChannel);
-  assert(ret==ESP_OK);
+  HAL_SPI_InitializeBus(DisplaySPI_HostDevice, DisplaySPI_MOSI_GPIO, DisplaySPI_MISO_GPIO, DisplaySPI_SCK_GPIO, DisplaySPI_DMAChannel);
   ESP_LOGI(DefaultLogTag, "Done");
   //
   ESP_LOGI(DefaultLogTag, "Initializing TouchPanelSPI bus:");
-  spi_bus_config_t TouchPanelSPI_BusConfiguration =
-  {
-    .mosi_io_num = TouchPanelSPI_MOSI_GPIO,
-    .miso_io_num = TouchPanelSPI_MISO_GPIO,
-    .sclk_io_num = TouchPanelSPI_SCK_GPIO,
-    .quadwp_io_num = -1,
-    .quadhd_io_num = -1,
-    .data4_io_num = -1,
-    .data5_io_num = -1,
-    .data6_io_num = -1,
-    .data7_io_num = -1,
-    .data_io_default_level = 0,
-    .max_transfer_sz = 0,
-    .flags = 0,
-    .isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO,
-    .intr_flags = 0
-  };
-  ret = spi_bus_initialize(TouchPanelSPI_HostDevice, &TouchPanelSPI_BusConfiguration, TouchPanelSPI_DMAChannel);
-  assert(ret==ESP_OK);
+  HAL_SPI_InitializeBus(TouchPanelSPI_HostDevice, TouchPanelSPI_MOSI_GPIO, TouchPanelSPI_MISO_GPIO, TouchPanelSPI_SCK_GPIO, TouchPanelSPI_DMAChannel);
   ESP_LOGI(DefaultLogTag, "Done");
   fflush(stdout);
 
@@ -925,6 +2663,12 @@ void app_main()
   ILI9341_Initialize(DisplaySPI_HostDevice, Display_ResetX_GPIO, Display_CSX_GPIO, Display_D_CX_GPIO, Display_BacklightX_GPIO);
   ESP_LOGI(DefaultLogTag, "Done");
 
+  ESP_LOGI(DefaultLogTag, "Initializing Display compositor:");
+  ILI9341_Compositor_Initialize(); // If this fails, drawing goes directly to the display.
+  ESP_LOGI(DefaultLogTag, "Done");
+
+  ILI9341_GlyphCache_Initialize(Display_GlyphCache_MaxNumBytes);
+
   ESP_LOGI(DefaultLogTag, "Initializing TouchPanel device:");
   XPT2046_Initialize(TouchPanelSPI_HostDevice, TouchPanel_CSX_GPIO);
   ESP_LOGI(DefaultLogTag, "Done");
@@ -933,11 +2677,42 @@ void app_main()
   InitializeLEDControl();
   ESP_LOGI(DefaultLogTag, "Done");
 
+  LampMix_Initialize(LampMix_DefaultEmitters);
+  ESP_LOGI(DefaultLogTag, "Colour temperatures: %u K to %u K", LampMix_GetMinTemperature_K(), LampMix_GetMaxTemperature_K());
+}
+
+#ifndef JSB_HAL_Linux
+static void Go()
+{
+  Go_Begin();
+
+  while (1)
+  {
+    Go_Iterate();
+    HAL_Delay_ms(Go_Period_ms); // Feed watchdog.
+  }
+}
+
+extern "C"
+{
+  void app_main();
+}
+
+void app_main()
+{
+  ESP_LOGI(DefaultLogTag, "Initializing NVS:");
+  NVS_Initialize();
+  ESP_LOGI(DefaultLogTag, "Done");
+
+  InitializeLamp();
+
   ESP_LOGI(DefaultLogTag, "Initializing WiFi:");
   WiFi_Initialize();
   ESP_LOGI(DefaultLogTag, "Done");
 
-  xTaskCreate(WifiServer_Go, "WifiServer", 32768, NULL, tskIDLE_PRIORITY, NULL); // Huge stack of 32768 due to stack usage of regex_search() for 100+ char input strings.
+  xTaskCreate(WifiServer_Go, "WifiServer", WifiServer_StackSize, NULL, tskIDLE_PRIORITY, NULL);
+  xTaskCreate(UdpServer_Go, "UdpServer", UdpServer_StackSize, NULL, tskIDLE_PRIORITY, NULL);
 
   Go();
 }
+#endif
@@ -0,0 +1,17 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host stand-in for esp-idf's esp_attr.h. Memory placement means nothing on a host.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_ESP_ATTR_H
+#define __HOST_ESP_ATTR_H
+
+#define DRAM_ATTR
+#define IRAM_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
+#define NOINLINE_ATTR __attribute__((noinline))
+
+#endif
@@ -0,0 +1,14 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host stand-in for esp-idf's esp_log.h (see Host/JSB_HostPlatform.c).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_ESP_LOG_H
+#define __HOST_ESP_LOG_H
+
+#include "JSB_HostPlatform.h"
+
+#endif
@@ -0,0 +1,14 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host stand-in for FreeRTOS.h (see Host/JSB_HostPlatform.c).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_FREERTOS_H
+#define __HOST_FREERTOS_H
+
+#include "JSB_HostPlatform.h"
+
+#endif
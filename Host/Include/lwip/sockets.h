@@ -0,0 +1,22 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host stand-in for lwip/sockets.h: the host's own BSD sockets.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_LWIP_SOCKETS_H
+#define __HOST_LWIP_SOCKETS_H
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define closesocket close
+
+#endif
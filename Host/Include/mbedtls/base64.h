@@ -0,0 +1,14 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host stand-in for mbedtls/base64.h, just the function JSB_WebSocket.c uses (see Host/JSB_HostPlatform.c).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_MBEDTLS_BASE64_H
+#define __HOST_MBEDTLS_BASE64_H
+
+#include "JSB_HostPlatform.h"
+
+#endif
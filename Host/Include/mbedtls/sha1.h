@@ -0,0 +1,14 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host stand-in for mbedtls/sha1.h, just the function JSB_WebSocket.c uses (see Host/JSB_HostPlatform.c).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __HOST_MBEDTLS_SHA1_H
+#define __HOST_MBEDTLS_SHA1_H
+
+#include "JSB_HostPlatform.h"
+
+#endif
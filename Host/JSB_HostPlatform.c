@@ -0,0 +1,322 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host platform. See JSB_HostPlatform.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+//
+#include "JSB_HostPlatform.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define Task_MaxNumTasks 8
+#define Task_StackPattern 0xA5
+#define Task_HostStackScale 4 // Host frames are larger than the ESP32's, and the C library needs some too, so give plenty.
+#define Task_HostStackExtra_bytes 65536
+
+typedef struct
+{
+  const char *pName;
+  TaskFunction_t pCode;
+  void *pParameters;
+  uint32_t StackSize; // As asked for.
+  uint8_t *pStack; // Lowest address. Stacks grow down.
+  uint8_t *pStackTop; // When the task started.
+} Task_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static Task_t Tasks[Task_MaxNumTasks];
+static uint8_t NumTasks = 0;
+static pthread_mutex_t Tasks_Lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread Task_t *pCurrentTask = NULL;
+static __thread uint32_t NumCriticalSections = 0;
+static uint32_t RandomState = 0x12345678;
+
+///////////////////////////////////////////////////////////////////////////////
+// esp_log.h:
+
+void HostPlatform_Log(char Level, const char *pTag, const char *pFormat, ...)
+{
+  static int8_t Verbose = -1; // Unknown.
+  va_list Arguments;
+
+  if (Verbose < 0)
+    Verbose = getenv("JSB_HOST_LOG") != NULL;
+  if (!Verbose && (Level != 'E'))
+    return;
+
+  va_start(Arguments, pFormat);
+  fprintf(stderr, "%c (%s) ", Level, pTag);
+  vfprintf(stderr, pFormat, Arguments);
+  fprintf(stderr, "\n");
+  va_end(Arguments);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// esp_system.h and esp_random.h:
+
+uint32_t esp_get_free_heap_size()
+{
+  return 0;
+}
+
+uint32_t esp_get_minimum_free_heap_size()
+{
+  return 0;
+}
+
+uint32_t esp_random()
+// xorshift32.
+{
+  RandomState ^= RandomState << 13;
+  RandomState ^= RandomState >> 17;
+  RandomState ^= RandomState << 5;
+  return RandomState;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeRTOS:
+
+static void *Task_Run(void *pArgument)
+{
+  Task_t *pTask = (Task_t *)pArgument;
+  uint8_t Top;
+
+  pTask->pStackTop = &Top; // Below the C library's own use of the stack.
+  pCurrentTask = pTask;
+  pTask->pCode(pTask->pParameters);
+  return NULL;
+}
+
+static uint32_t Task_GetStackPeak(const Task_t *pTask)
+{
+  const uint8_t *pByte = pTask->pStack;
+
+  if (!pTask->pStackTop)
+    return 0;
+
+  while ((pByte < pTask->pStackTop) && (*pByte == Task_StackPattern))
+    ++pByte;
+  return pTask->pStackTop - pByte;
+}
+
+void vTaskDelay(uint32_t NumTicks)
+{
+  usleep(NumTicks * portTICK_PERIOD_MS * 1000);
+}
+
+void vTaskDelete(TaskHandle_t Task)
+{
+  assert(!Task);
+  pthread_exit(NULL);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t pCode, const char *pName, uint32_t StackSize, void *pParameters, UBaseType_t Priority, TaskHandle_t *pTask)
+{
+  size_t HostStackSize = (size_t)StackSize * Task_HostStackScale + Task_HostStackExtra_bytes;
+  pthread_attr_t Attributes;
+  pthread_t Thread;
+  Task_t *pNewTask;
+
+  pthread_mutex_lock(&Tasks_Lock);
+  if (NumTasks == Task_MaxNumTasks)
+  {
+    pthread_mutex_unlock(&Tasks_Lock);
+    return pdFAIL;
+  }
+  pNewTask = &Tasks[NumTasks++];
+  pthread_mutex_unlock(&Tasks_Lock);
+
+  pNewTask->pName = pName;
+  pNewTask->pCode = pCode;
+  pNewTask->pParameters = pParameters;
+  pNewTask->StackSize = StackSize;
+  pNewTask->pStack = (uint8_t *)malloc(HostStackSize);
+  if (!pNewTask->pStack)
+    return pdFAIL;
+  memset(pNewTask->pStack, Task_StackPattern, HostStackSize);
+
+  pthread_attr_init(&Attributes);
+  pthread_attr_setstack(&Attributes, pNewTask->pStack, HostStackSize);
+  pthread_attr_setdetachstate(&Attributes, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&Thread, &Attributes, Task_Run, pNewTask) != 0)
+  {
+    pthread_attr_destroy(&Attributes);
+    return pdFAIL;
+  }
+  pthread_attr_destroy(&Attributes);
+
+  if (pTask)
+    *pTask = pNewTask;
+  return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t Task)
+{
+  uint32_t Peak;
+
+  assert(!Task);
+  if (!pCurrentTask)
+    return 0;
+
+  Peak = Task_GetStackPeak(pCurrentTask);
+  return (Peak < pCurrentTask->StackSize) ? pCurrentTask->StackSize - Peak : 0;
+}
+
+void HostPlatform_EnterCritical(portMUX_TYPE *pMux)
+{
+  pthread_mutex_lock(pMux);
+  ++NumCriticalSections;
+}
+
+void HostPlatform_ExitCritical(portMUX_TYPE *pMux)
+{
+  assert(NumCriticalSections);
+  --NumCriticalSections;
+  pthread_mutex_unlock(pMux);
+}
+
+uint32_t HostPlatform_GetNumCriticalSections()
+{
+  return NumCriticalSections;
+}
+
+uint32_t HostPlatform_GetTaskStackPeak_bytes(const char *pName)
+{
+  uint32_t Peak = 0;
+
+  pthread_mutex_lock(&Tasks_Lock);
+  for (uint8_t Index = 0; Index < NumTasks; ++Index)
+    if (strcmp(Tasks[Index].pName, pName) == 0)
+      Peak = Task_GetStackPeak(&Tasks[Index]);
+  pthread_mutex_unlock(&Tasks_Lock);
+  return Peak;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// mbedtls:
+
+static uint32_t RotateLeft(uint32_t Value, uint8_t NumBits)
+{
+  return (Value << NumBits) | (Value >> (32 - NumBits));
+}
+
+static void SHA1_ProcessBlock(uint32_t *pHash, const uint8_t *pBlock)
+{
+  uint32_t W[80], a = pHash[0], b = pHash[1], c = pHash[2], d = pHash[3], e = pHash[4];
+
+  for (uint8_t Index = 0; Index < 16; ++Index)
+    W[Index] = ((uint32_t)pBlock[4 * Index] << 24) | ((uint32_t)pBlock[4 * Index + 1] << 16) | ((uint32_t)pBlock[4 * Index + 2] << 8) | pBlock[4 * Index + 3];
+  for (uint8_t Index = 16; Index < 80; ++Index)
+    W[Index] = RotateLeft(W[Index - 3] ^ W[Index - 8] ^ W[Index - 14] ^ W[Index - 16], 1);
+
+  for (uint8_t Index = 0; Index < 80; ++Index)
+  {
+    uint32_t f, k, Temp;
+
+    if (Index < 20)
+    {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    }
+    else if (Index < 40)
+    {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    }
+    else if (Index < 60)
+    {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    }
+    else
+    {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+
+    Temp = RotateLeft(a, 5) + f + e + k + W[Index];
+    e = d;
+    d = c;
+    c = RotateLeft(b, 30);
+    b = a;
+    a = Temp;
+  }
+
+  pHash[0] += a;
+  pHash[1] += b;
+  pHash[2] += c;
+  pHash[3] += d;
+  pHash[4] += e;
+}
+
+int mbedtls_sha1(const unsigned char *pInput, size_t NumBytes, unsigned char Output[20])
+{
+  uint32_t Hash[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+  uint64_t NumBits = (uint64_t)NumBytes * 8;
+  uint8_t Block[64];
+  size_t Index;
+
+  for (Index = 0; Index + 64 <= NumBytes; Index += 64)
+    SHA1_ProcessBlock(Hash, pInput + Index);
+
+  // The rest, then a 1 bit, padding, and the length in bits, in one or two blocks:
+  memset(Block, 0, sizeof(Block));
+  memcpy(Block, pInput + Index, NumBytes - Index);
+  Block[NumBytes - Index] = 0x80;
+  if (NumBytes - Index >= 56)
+  {
+    SHA1_ProcessBlock(Hash, Block);
+    memset(Block, 0, sizeof(Block));
+  }
+  for (uint8_t Byte = 0; Byte < 8; ++Byte)
+    Block[63 - Byte] = (uint8_t)(NumBits >> (8 * Byte));
+  SHA1_ProcessBlock(Hash, Block);
+
+  for (uint8_t Word = 0; Word < 5; ++Word)
+    for (uint8_t Byte = 0; Byte < 4; ++Byte)
+      Output[4 * Word + Byte] = (uint8_t)(Hash[Word] >> (24 - 8 * Byte));
+  return 0;
+}
+
+int mbedtls_base64_encode(unsigned char *pDestination, size_t DestinationNumBytes, size_t *pNumChars, const unsigned char *pSource, size_t SourceNumBytes)
+// As mbedtls: the result is NUL terminated, and *pNumChars excludes the NUL. If there is not room, *pNumChars is the room needed, including the NUL.
+{
+  static const char Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t NumChars = 4 * ((SourceNumBytes + 2) / 3);
+
+  if (DestinationNumBytes < NumChars + 1)
+  {
+    *pNumChars = NumChars + 1;
+    return MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL;
+  }
+
+  for (size_t Index = 0, CharIndex = 0; Index < SourceNumBytes; Index += 3, CharIndex += 4)
+  {
+    uint32_t Bits = (uint32_t)pSource[Index] << 16;
+
+    if (Index + 1 < SourceNumBytes)
+      Bits |= (uint32_t)pSource[Index + 1] << 8;
+    if (Index + 2 < SourceNumBytes)
+      Bits |= pSource[Index + 2];
+
+    pDestination[CharIndex] = Alphabet[(Bits >> 18) & 0x3F];
+    pDestination[CharIndex + 1] = Alphabet[(Bits >> 12) & 0x3F];
+    pDestination[CharIndex + 2] = (Index + 1 < SourceNumBytes) ? Alphabet[(Bits >> 6) & 0x3F] : '=';
+    pDestination[CharIndex + 3] = (Index + 2 < SourceNumBytes) ? Alphabet[Bits & 0x3F] : '=';
+  }
+
+  pDestination[NumChars] = '\0';
+  *pNumChars = NumChars;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
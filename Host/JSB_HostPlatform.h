@@ -0,0 +1,98 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host platform:
+//
+// => What the app and the Shared drivers use of esp-idf, FreeRTOS and mbedtls, besides the hardware (see Shared/JSB_HAL_Linux.c), for a host build.
+//    The headers in Host/Include stand in for theirs, and all include this.
+// => Tasks are threads. Each has a stack of its own, filled with a pattern, so that how much of it has been used can be measured as on the ESP32.
+//    Stack use differs between the host and the ESP32's Xtensa, so the host's figure is a guide to the ESP32's, not a measurement of it.
+// => Logging is only printed if the environment variable JSB_HOST_LOG is set, except for errors.
+// => A critical section is a mutex, and each thread counts those it holds, so that the HAL can refuse calls which may block on the ESP32
+//    (see HostPlatform_GetNumCriticalSections()).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_HOST_PLATFORM_H
+#define __JSB_HOST_PLATFORM_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <pthread.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// esp_log.h:
+
+void HostPlatform_Log(char Level, const char *pTag, const char *pFormat, ...);
+
+#define ESP_LOGE(pTag, ...) HostPlatform_Log('E', pTag, __VA_ARGS__)
+#define ESP_LOGW(pTag, ...) HostPlatform_Log('W', pTag, __VA_ARGS__)
+#define ESP_LOGI(pTag, ...) HostPlatform_Log('I', pTag, __VA_ARGS__)
+#define ESP_LOGD(pTag, ...) HostPlatform_Log('D', pTag, __VA_ARGS__)
+#define ESP_LOGV(pTag, ...) HostPlatform_Log('V', pTag, __VA_ARGS__)
+
+///////////////////////////////////////////////////////////////////////////////
+// esp_system.h and esp_random.h:
+
+uint32_t esp_get_free_heap_size(); // Not known on a host: 0.
+uint32_t esp_get_minimum_free_heap_size(); // Likewise.
+uint32_t esp_random(); // Repeatable.
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeRTOS:
+
+typedef pthread_mutex_t portMUX_TYPE;
+typedef void (*TaskFunction_t)(void *pParameters);
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portMUX_INITIALIZER_UNLOCKED PTHREAD_MUTEX_INITIALIZER
+#define portENTER_CRITICAL(pMux) HostPlatform_EnterCritical(pMux)
+#define portEXIT_CRITICAL(pMux) HostPlatform_ExitCritical(pMux)
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define tskIDLE_PRIORITY 0
+#define pdPASS 1
+#define pdFAIL 0
+
+void vTaskDelay(uint32_t NumTicks); // Real time, as a server task waits for its sockets in real time. The lamp's time is simulated (see JSB_HAL_Linux.h).
+void vTaskDelete(TaskHandle_t Task); // Only NULL, for the calling task.
+BaseType_t xTaskCreate(TaskFunction_t pCode, const char *pName, uint32_t StackSize, void *pParameters, UBaseType_t Priority, TaskHandle_t *pTask); // StackSize in bytes, as esp-idf.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t Task); // Only NULL, for the calling task. Bytes, as esp-idf.
+
+uint32_t HostPlatform_GetTaskStackPeak_bytes(const char *pName); // Most of its stack a task has used so far. 0 if there is no such task.
+
+void HostPlatform_EnterCritical(portMUX_TYPE *pMux);
+void HostPlatform_ExitCritical(portMUX_TYPE *pMux);
+uint32_t HostPlatform_GetNumCriticalSections(); // Held by the calling thread.
+
+///////////////////////////////////////////////////////////////////////////////
+// mbedtls:
+
+#define MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL -0x002A
+
+int mbedtls_sha1(const unsigned char *pInput, size_t NumBytes, unsigned char Output[20]);
+int mbedtls_base64_encode(unsigned char *pDestination, size_t DestinationNumBytes, size_t *pNumChars, const unsigned char *pSource, size_t SourceNumBytes);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,129 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host tests. See JSB_HostTest.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+//
+#include "JSB_HostTest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t NumFailures = 0;
+static uint32_t NumHeapAllocations = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Heap:
+//
+// glibc's allocator is replaced by these, which count and pass on to it. Every thread's allocations are counted, including the C library's own.
+
+extern void *__libc_malloc(size_t NumBytes);
+extern void *__libc_calloc(size_t NumElements, size_t NumBytes);
+extern void *__libc_realloc(void *pMemory, size_t NumBytes);
+extern void __libc_free(void *pMemory);
+
+void *malloc(size_t NumBytes)
+{
+  __atomic_add_fetch(&NumHeapAllocations, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(NumBytes);
+}
+
+void *calloc(size_t NumElements, size_t NumBytes)
+{
+  __atomic_add_fetch(&NumHeapAllocations, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(NumElements, NumBytes);
+}
+
+void *realloc(void *pMemory, size_t NumBytes)
+{
+  __atomic_add_fetch(&NumHeapAllocations, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(pMemory, NumBytes);
+}
+
+void free(void *pMemory)
+{
+  __libc_free(pMemory);
+}
+
+uint32_t HostTest_GetNumHeapAllocations()
+{
+  return __atomic_load_n(&NumHeapAllocations, __ATOMIC_RELAXED);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Checks and reports:
+
+void HostTest_Check(const char *pName, double Value, double MaxValue)
+{
+  uint8_t Failed = !(Value <= MaxValue); // Also fails NaN.
+
+  printf("  %-56s %12.4f (limit %.4f)%s\n", pName, Value, MaxValue, Failed ? " FAILED" : "");
+  NumFailures += Failed;
+}
+
+void HostTest_CheckMin(const char *pName, double Value, double MinValue)
+{
+  uint8_t Failed = !(Value >= MinValue);
+
+  printf("  %-56s %12.4f (minimum %.4f)%s\n", pName, Value, MinValue, Failed ? " FAILED" : "");
+  NumFailures += Failed;
+}
+
+void HostTest_CheckTrue(const char *pName, uint8_t Condition)
+{
+  printf("  %-56s %s\n", pName, Condition ? "yes" : "no FAILED");
+  NumFailures += !Condition;
+}
+
+void HostTest_Report(const char *pName, double Value, const char *pUnits)
+{
+  printf("  %-56s %12.2f %s\n", pName, Value, pUnits);
+}
+
+double HostTest_GetTime_s()
+{
+  struct timespec Time;
+
+  clock_gettime(CLOCK_MONOTONIC, &Time);
+  return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+
+int HostTest_Main(int argc, char **argv, const HostTest_Test_t *pTests, uint32_t NumTests)
+{
+  for (int Argument = 1; Argument < argc; ++Argument)
+  {
+    uint8_t Found = 0;
+
+    for (uint32_t Index = 0; Index < NumTests; ++Index)
+      Found |= strcmp(argv[Argument], pTests[Index].pName) == 0;
+    if (!Found)
+    {
+      printf("No test named %s\n", argv[Argument]);
+      return 1;
+    }
+  }
+
+  for (uint32_t Index = 0; Index < NumTests; ++Index)
+  {
+    uint8_t Run = argc < 2;
+
+    for (int Argument = 1; Argument < argc; ++Argument)
+      Run |= strcmp(argv[Argument], pTests[Index].pName) == 0;
+    if (!Run)
+      continue;
+
+    printf("%s:\n", pTests[Index].pName);
+    pTests[Index].pRun();
+  }
+
+  printf(NumFailures ? "%u checks FAILED\n" : "All checks passed\n", NumFailures);
+  return NumFailures != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Host tests: checks, benchmark reports, and running tests by name.
+//
+// => Each test program has a table of tests. With no arguments it runs them all, otherwise those named, e.g. JSB_LampTest Display Touch.
+//    Host/CMakeLists.txt registers each test with ctest separately, so each starts from a freshly initialized app.
+// => Checks print their value and limit, as Tools/JSB_LampMixTest.c does. Benchmarks print, and are not checked.
+// => Heap allocations are counted, so that a test can check that something does not allocate.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_HOST_TEST_H
+#define __JSB_HOST_TEST_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  const char *pName;
+  void (*pRun)();
+} HostTest_Test_t;
+
+void HostTest_Check(const char *pName, double Value, double MaxValue); // Fails if Value > MaxValue.
+void HostTest_CheckMin(const char *pName, double Value, double MinValue); // Fails if Value < MinValue.
+void HostTest_CheckTrue(const char *pName, uint8_t Condition);
+void HostTest_Report(const char *pName, double Value, const char *pUnits);
+double HostTest_GetTime_s(); // Real time, for benchmarks.
+uint32_t HostTest_GetNumHeapAllocations(); // malloc(), calloc() and realloc() calls so far, by any thread. C++'s new uses malloc().
+int HostTest_Main(int argc, char **argv, const HostTest_Test_t *pTests, uint32_t NumTests); // Returns non-zero if any check fails.
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,422 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// ILI9341 driver tests and benchmarks, on the simulated display (see Shared/JSB_HAL_Linux.h):
+//
+// => The driver is used on its own, without the compositor or the glyph cache, so that what is counted is what the driver sends. Except
+//    in GlyphCache.
+// => Transactions and windows are counted by the simulated SPI bus. Times are the host's CPU time, without the time on the wire,
+//    so only compare with each other. Except in Throughput, which has the simulated bus take the time (see HAL_Linux_SetSPITimed()).
+// => Run as e.g. JSB_ILI9341Test Text. See JSB_HostTest.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <string.h>
+//
+#include "JSB_HAL.h"
+#include "JSB_ILI9341.h"
+#include "JSB_ILI9341_GlyphCache.h"
+#include "FreeSans9pt7b.h"
+#include "FreeSans12pt7b.h"
+//
+#include "JSB_HostTest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// As the lamp app:
+#define DisplaySPI_HostDevice HSPI_HOST
+#define DisplaySPI_SCK_GPIO 32
+#define DisplaySPI_MOSI_GPIO 33
+#define DisplaySPI_MISO_GPIO 34
+#define DisplaySPI_DMAChannel 1
+#define Display_ResetX_GPIO 25
+#define Display_CSX_GPIO 26
+#define Display_D_CX_GPIO 27
+#define Display_BacklightX_GPIO 16
+#define Display_SPIClockSpeed_Hz 20000000 // As the driver.
+
+#define Label "Hello Emma!"
+#define Label_X 10
+#define Label_Y 40
+#define NumBenchmarkDraws 1000
+#define NumBenchmarkLayouts 1000000
+#define NumThroughputClears 20
+#define CacheLabel "HelloEmma!" // No space, which has no pixels in tdmThisCharBar, so is not cached.
+#define CacheEntry_NumPixels 50 // For entries inserted directly.
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void StartDisplay()
+{
+  HAL_Linux_AttachDisplay(Display_CSX_GPIO, Display_D_CX_GPIO);
+  HAL_SPI_InitializeBus(DisplaySPI_HostDevice, DisplaySPI_MOSI_GPIO, DisplaySPI_MISO_GPIO, DisplaySPI_SCK_GPIO, DisplaySPI_DMAChannel);
+  ILI9341_Initialize(DisplaySPI_HostDevice, Display_ResetX_GPIO, Display_CSX_GPIO, Display_D_CX_GPIO, Display_BacklightX_GPIO);
+  ILI9341_SetFont(&FreeSans12pt7b);
+  ILI9341_SetTextColor(ILI9341_COLOR_WHITE);
+  ILI9341_SetTextBackgroundColor(ILI9341_COLOR_NAVY);
+  ILI9341_Clear(ILI9341_COLOR_BLACK);
+}
+
+static uint32_t CountPixels(uint16_t Color)
+{
+  uint32_t NumPixels = 0;
+
+  for (uint16_t Y = 0; Y < HAL_Linux_Display_Height; ++Y)
+    for (uint16_t X = 0; X < HAL_Linux_Display_Width; ++X)
+      NumPixels += HAL_Linux_Framebuffer[Y][X] == Color;
+  return NumPixels;
+}
+
+static void DrawLabelByChar(uint16_t X, uint16_t Y)
+// A char at a time, as strings were drawn before they were sent as one window.
+{
+  for (const char *pText = Label; *pText; ++pText)
+    X += ILI9341_DrawCharAtXY(*pText, X, Y, ILI9341_COLOR_WHITE);
+}
+
+static uint32_t DrawGlyphByPixel(uint8_t Ch, uint16_t X, uint16_t Y, uint16_t Color)
+// A pixel at a time, as tdmMergeWithExistingPixels drew glyphs before they were sent as spans. Returns the number of pixels.
+{
+  const GFXglyph *pGlyph = &FreeSans12pt7b.pGlyph[Ch - FreeSans12pt7b.first];
+  const uint8_t *pBitmap = &FreeSans12pt7b.pBitmap[pGlyph->bitmapOffset];
+  uint32_t NumPixels = 0, BitIndex = 0;
+
+  for (uint8_t Row = 0; Row < pGlyph->height; ++Row)
+    for (uint8_t Column = 0; Column < pGlyph->width; ++Column, ++BitIndex)
+      if (pBitmap[BitIndex / 8] & (0x80 >> (BitIndex % 8)))
+      {
+        ILI9341_DrawPixel(X + pGlyph->xOffset + Column, Y + pGlyph->yOffset + Row, Color);
+        ++NumPixels;
+      }
+
+  return NumPixels;
+}
+
+static uint16_t GetTextWidthByGlyph(const GFXfont *pFont, const char *pText)
+// As ILI9341_GetTextWidth() was before it had a width table: strlen(), then each char range-checked and looked up in the glyph table.
+{
+  uint16_t TotalWidth = 0, NumChars = strlen(pText);
+
+  for (uint16_t CharIndex = 0; CharIndex < NumChars; ++CharIndex)
+  {
+    uint8_t Ch = pText[CharIndex];
+    const GFXglyph *pGlyph;
+
+    if ((Ch < pFont->first) || (Ch > pFont->last))
+      continue;
+    pGlyph = &pFont->pGlyph[Ch - pFont->first];
+    TotalWidth += pGlyph->width ? pGlyph->xOffset + pGlyph->width : pGlyph->xAdvance;
+  }
+
+  return TotalWidth;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Test_Text()
+// A label in tdmAnyCharBar mode: as one window, and a char at a time.
+{
+  HAL_Linux_SPIStatistics_t String, ByChar;
+  uint32_t NumStringTextPixels, NumByCharTextPixels;
+  double StartTime_s, String_us, ByChar_us;
+
+  StartDisplay();
+  ILI9341_SetTextDrawMode(tdmAnyCharBar);
+
+  HAL_Linux_ResetSPIStatistics();
+  ILI9341_DrawTextAtXY(Label, Label_X, Label_Y, tpLeft);
+  HAL_Linux_GetSPIStatistics(&String);
+  NumStringTextPixels = CountPixels(ILI9341_COLOR_WHITE);
+
+  ILI9341_Clear(ILI9341_COLOR_BLACK);
+  HAL_Linux_ResetSPIStatistics();
+  DrawLabelByChar(Label_X, Label_Y);
+  HAL_Linux_GetSPIStatistics(&ByChar);
+  NumByCharTextPixels = CountPixels(ILI9341_COLOR_WHITE);
+
+  StartTime_s = HostTest_GetTime_s();
+  for (uint16_t Count = 0; Count < NumBenchmarkDraws; ++Count)
+    ILI9341_DrawTextAtXY(Label, Label_X, Label_Y, tpLeft);
+  String_us = (HostTest_GetTime_s() - StartTime_s) * 1e6 / NumBenchmarkDraws;
+  StartTime_s = HostTest_GetTime_s();
+  for (uint16_t Count = 0; Count < NumBenchmarkDraws; ++Count)
+    DrawLabelByChar(Label_X, Label_Y);
+  ByChar_us = (HostTest_GetTime_s() - StartTime_s) * 1e6 / NumBenchmarkDraws;
+
+  HostTest_Report("Transactions for \"" Label "\", as one window", String.NumTransactions, "");
+  HostTest_Report("Transactions for \"" Label "\", a char at a time", ByChar.NumTransactions, "");
+  HostTest_Report("Bytes sent, as one window", String.NumBytes, "");
+  HostTest_Report("Bytes sent, a char at a time", ByChar.NumBytes, "");
+  HostTest_Report("CPU time to draw it, as one window (host)", String_us, "us");
+  HostTest_Report("CPU time to draw it, a char at a time (host)", ByChar_us, "us");
+  HostTest_Check("Windows for the label", String.NumDisplayWindows, 1);
+  HostTest_Check("Transactions as one window, over a char at a time", (double)String.NumTransactions / ByChar.NumTransactions, 0.5);
+  HostTest_CheckTrue("Same text pixels either way", NumStringTextPixels == NumByCharTextPixels);
+  HostTest_CheckMin("Text pixels", NumStringTextPixels, 200);
+}
+
+static void Test_Throughput()
+// The driver's own measure of the bus, over clears, with the simulated bus taking the time for each transfer. Commands sent during
+// initialization, by HAL_SPI_Transmit(), must not put its count of transactions in flight out.
+{
+  ILI9341_Statistics_t Statistics;
+  float PixelsPerSecond, BusUtilization;
+
+  StartDisplay();
+  HAL_Linux_SetSPITimed(1);
+  ILI9341_ResetStatistics();
+  for (uint8_t Count = 0; Count < NumThroughputClears; ++Count)
+    ILI9341_Clear(Count & 1 ? ILI9341_COLOR_BLACK : ILI9341_COLOR_NAVY);
+  ILI9341_GetStatistics(&Statistics);
+  ILI9341_GetThroughput(&PixelsPerSecond, &BusUtilization);
+  HAL_Linux_SetSPITimed(0);
+
+  HostTest_CheckTrue("Pixels counted, all those cleared", Statistics.NumPixels == NumThroughputClears * HAL_Linux_Display_Width * HAL_Linux_Display_Height);
+  HostTest_CheckMin("Bus busy time (us)", Statistics.BusyTime_us, 1);
+  HostTest_Report("Pixels per second", PixelsPerSecond, "");
+  HostTest_CheckMin("Pixels per second, over the bus's 16 bit pixel rate", PixelsPerSecond * 16 / Display_SPIClockSpeed_Hz, 0.9);
+  HostTest_CheckMin("Bus utilization", BusUtilization, 0.9);
+  HostTest_Check("Bus utilization", BusUtilization, 1.0);
+}
+
+static void Test_GlyphCache()
+// Redrawn from the cache, text is the same as drawn without it, and only hits. Then the least recently used entry is evicted first, within
+// the budget, and a glyph too large for it is not cached.
+{
+  static uint16_t Uncached[HAL_Linux_Display_Height][HAL_Linux_Display_Width];
+  static const TextDrawMode_t Modes[] = { tdmThisCharBar, tdmAnyCharBar };
+  static const char *pModeNames[] = { "tdmThisCharBar", "tdmAnyCharBar" };
+  static const uint8_t Glyphs[5] = {}; // Their addresses are keys.
+  ILI9341_GlyphCacheStatistics_t First, Second, Statistics;
+  uint32_t NumDifferent;
+  char Name[96];
+
+  StartDisplay();
+  for (uint8_t Mode = 0; Mode < sizeof(Modes) / sizeof(Modes[0]); ++Mode)
+  {
+    ILI9341_SetTextDrawMode(Modes[Mode]);
+    ILI9341_GlyphCache_Initialize(0);
+    ILI9341_Clear(ILI9341_COLOR_BLACK);
+    ILI9341_DrawTextAtXY(CacheLabel, Label_X, Label_Y, tpLeft);
+    memcpy(Uncached, HAL_Linux_Framebuffer, sizeof(Uncached));
+
+    ILI9341_GlyphCache_Initialize(65536);
+    ILI9341_GlyphCache_ResetStatistics();
+    ILI9341_Clear(ILI9341_COLOR_BLACK);
+    ILI9341_DrawTextAtXY(CacheLabel, Label_X, Label_Y, tpLeft);
+    ILI9341_GlyphCache_GetStatistics(&First);
+    ILI9341_Clear(ILI9341_COLOR_BLACK);
+    ILI9341_DrawTextAtXY(CacheLabel, Label_X, Label_Y, tpLeft);
+    ILI9341_GlyphCache_GetStatistics(&Second);
+    NumDifferent = 0;
+    for (uint16_t Y = 0; Y < HAL_Linux_Display_Height; ++Y)
+      for (uint16_t X = 0; X < HAL_Linux_Display_Width; ++X)
+        NumDifferent += HAL_Linux_Framebuffer[Y][X] != Uncached[Y][X];
+
+    snprintf(Name, sizeof(Name), "Misses drawing it again, %s", pModeNames[Mode]);
+    HostTest_Check(Name, Second.NumMisses - First.NumMisses, 0);
+    snprintf(Name, sizeof(Name), "Hits drawing it again, %s", pModeNames[Mode]);
+    HostTest_CheckMin(Name, Second.NumHits - First.NumHits, strlen(CacheLabel));
+    snprintf(Name, sizeof(Name), "Entries, %s", pModeNames[Mode]);
+    HostTest_CheckTrue(Name, (Second.NumEntries == First.NumEntries) && (Second.NumEntries == First.NumMisses));
+    snprintf(Name, sizeof(Name), "Pixels that differ from it drawn uncached, %s", pModeNames[Mode]);
+    HostTest_Check(Name, NumDifferent, 0);
+  }
+
+  // Within a small budget, the text is still the same, from fewer entries:
+  ILI9341_GlyphCache_Initialize(First.NumBytes / 2);
+  ILI9341_GlyphCache_ResetStatistics();
+  ILI9341_Clear(ILI9341_COLOR_BLACK);
+  ILI9341_DrawTextAtXY(CacheLabel, Label_X, Label_Y, tpLeft);
+  ILI9341_DrawTextAtXY(CacheLabel, Label_X, Label_Y, tpLeft);
+  ILI9341_GlyphCache_GetStatistics(&Statistics);
+  NumDifferent = 0;
+  for (uint16_t Y = 0; Y < HAL_Linux_Display_Height; ++Y)
+    for (uint16_t X = 0; X < HAL_Linux_Display_Width; ++X)
+      NumDifferent += HAL_Linux_Framebuffer[Y][X] != Uncached[Y][X];
+  HostTest_CheckMin("Evictions drawing it in half the bytes", Statistics.NumEvictions, 1);
+  HostTest_Check("Bytes cached, over the budget", (double)Statistics.NumBytes / Statistics.MaxNumBytes, 1.0);
+  HostTest_Check("Pixels that differ from it drawn uncached, in half the bytes", NumDifferent, 0);
+
+  // Entries directly, in a budget of three:
+  ILI9341_GlyphCache_Initialize(3 * CacheEntry_NumPixels * sizeof(uint16_t));
+  ILI9341_GlyphCache_ResetStatistics();
+  for (uint8_t Index = 0; Index < 3; ++Index)
+    ILI9341_GlyphCache_Insert(&Glyphs[Index], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK, CacheEntry_NumPixels);
+  ILI9341_GlyphCache_Find(&Glyphs[0], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK); // Now 1 is the least recently used.
+  ILI9341_GlyphCache_Insert(&Glyphs[3], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK, CacheEntry_NumPixels);
+  ILI9341_GlyphCache_GetStatistics(&Statistics);
+  HostTest_Check("Evictions inserting a fourth", Statistics.NumEvictions, 1);
+  HostTest_Check("Bytes cached, over the budget, with a fourth", (double)Statistics.NumBytes / Statistics.MaxNumBytes, 1.0);
+  HostTest_CheckTrue("Least recently used evicted", !ILI9341_GlyphCache_Find(&Glyphs[1], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK));
+  HostTest_CheckTrue("Others kept", ILI9341_GlyphCache_Find(&Glyphs[0], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK) &&
+    ILI9341_GlyphCache_Find(&Glyphs[2], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK) && ILI9341_GlyphCache_Find(&Glyphs[3], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK));
+  HostTest_CheckTrue("Same glyph in another color missed", !ILI9341_GlyphCache_Find(&Glyphs[0], 0, ILI9341_COLOR_RED, ILI9341_COLOR_BLACK));
+  ILI9341_GlyphCache_GetStatistics(&Statistics);
+  HostTest_CheckTrue("Hits and misses counted", (Statistics.NumHits == 4) && (Statistics.NumMisses == 2));
+
+  HostTest_CheckTrue("Entry larger than the budget refused",
+    !ILI9341_GlyphCache_Insert(&Glyphs[4], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK, 3 * CacheEntry_NumPixels + 1));
+  ILI9341_GlyphCache_GetStatistics(&Statistics);
+  HostTest_CheckTrue("Nothing evicted for it", (Statistics.NumEvictions == 1) && (Statistics.NumEntries == 3));
+
+  ILI9341_GlyphCache_Clear();
+  ILI9341_GlyphCache_GetStatistics(&Statistics);
+  HostTest_CheckTrue("Cleared", !Statistics.NumEntries && !Statistics.NumBytes && !ILI9341_GlyphCache_Find(&Glyphs[0], 0, ILI9341_COLOR_WHITE, ILI9341_COLOR_BLACK));
+  ILI9341_GlyphCache_Initialize(0);
+}
+
+static void Test_Merge()
+// The label's glyphs in tdmMergeWithExistingPixels mode, over a button's color, as spans and a pixel at a time.
+{
+  const uint16_t ByPixel_Y = Label_Y + 60;
+  HAL_Linux_SPIStatistics_t Statistics;
+  uint32_t NumSpanTransactions = 0, MaxSpanTransactions = 0, NumPixels = 0, PixelTransactions, NumDifferentPixels = 0;
+  uint16_t X = Label_X;
+
+  StartDisplay();
+  ILI9341_SetTextDrawMode(tdmMergeWithExistingPixels);
+  ILI9341_DrawBar(0, 0, ILI9341_Width, ByPixel_Y + 30, ILI9341_COLOR_DARKGREEN);
+
+  HAL_Linux_ResetSPIStatistics();
+  ILI9341_DrawPixel(0, 0, ILI9341_COLOR_DARKGREEN);
+  HAL_Linux_GetSPIStatistics(&Statistics);
+  PixelTransactions = Statistics.NumTransactions;
+
+  for (const char *pText = Label; *pText; ++pText)
+  {
+    HAL_Linux_ResetSPIStatistics();
+    X += ILI9341_DrawCharAtXY(*pText, X, Label_Y, ILI9341_COLOR_WHITE);
+    HAL_Linux_GetSPIStatistics(&Statistics);
+    NumSpanTransactions += Statistics.NumTransactions;
+    if (Statistics.NumTransactions > MaxSpanTransactions)
+      MaxSpanTransactions = Statistics.NumTransactions;
+  }
+
+  X = Label_X;
+  for (const char *pText = Label; *pText; ++pText)
+  {
+    NumPixels += DrawGlyphByPixel(*pText, X, ByPixel_Y, ILI9341_COLOR_WHITE);
+    X += ILI9341_GetCharWidth(*pText);
+  }
+
+  for (uint16_t Y = 0; Y < ByPixel_Y - Label_Y; ++Y) // Each label with the rows above and below it.
+    for (uint16_t X = 0; X < ILI9341_Width; ++X)
+      NumDifferentPixels += HAL_Linux_Framebuffer[Label_Y - 30 + Y][X] != HAL_Linux_Framebuffer[ByPixel_Y - 30 + Y][X];
+
+  HostTest_Report("Transactions per glyph, as spans (mean)", (double)NumSpanTransactions / strlen(Label), "");
+  HostTest_Report("Transactions per glyph, as spans (most)", MaxSpanTransactions, "");
+  HostTest_Report("Transactions per glyph, a pixel at a time (mean)", (double)NumPixels * PixelTransactions / strlen(Label), "");
+  HostTest_Check("Transactions as spans, over a pixel at a time", (double)NumSpanTransactions / (NumPixels * PixelTransactions), 0.25);
+  HostTest_Check("Pixels that differ between the two", NumDifferentPixels, 0);
+  HostTest_CheckTrue("Text pixels twice the glyphs' set bits", (CountPixels(ILI9341_COLOR_WHITE) == 2 * NumPixels) && NumPixels);
+}
+
+static void Test_Antialiased()
+// A gffAntialiased4bpp font's char cells are from yOffsetMin to yOffsetMax inclusive, and its levels are blended between the text colors.
+{
+  static const uint8_t Data[] =
+  {
+    0xF8, 0x0F, 0xFF, 0xFF, 0x10, 0x0F, // 'A': 4 x 3, rows -2 to 0.
+    0xFF, 0xFF // 'B': 2 x 2, rows 0 to 1.
+  };
+  static const GFXglyph Glyphs[] =
+  {
+    { 0, 4, 3, 5, 0, -2 },
+    { 6, 2, 2, 3, 0, 0 }
+  };
+  static const GFXfont Font = { (uint8_t *)Data, (GFXglyph *)Glyphs, 'A', 'B', 4, -2, 1, gffAntialiased4bpp };
+  const uint16_t X = Label_X, Y = Label_Y;
+  uint16_t Level8;
+  uint8_t Undrawn = 0;
+
+  StartDisplay();
+  ILI9341_Clear(ILI9341_COLOR_RED); // Not drawn over.
+  ILI9341_SetFont(&Font);
+  ILI9341_SetTextColor(ILI9341_COLOR_WHITE);
+  ILI9341_SetTextBackgroundColor(ILI9341_COLOR_BLACK);
+  ILI9341_SetTextDrawMode(tdmAnyCharBar);
+  ILI9341_DrawTextAtXY("AB", X, Y, tpLeft);
+
+  for (uint16_t Row = Y - 2; Row <= Y + 1; ++Row)
+    for (uint16_t Column = X; Column < X + ILI9341_GetTextWidth("AB"); ++Column)
+      Undrawn |= HAL_Linux_Framebuffer[Row][Column] == ILI9341_COLOR_RED;
+  HostTest_CheckTrue("Cell rows all drawn", !Undrawn);
+  HostTest_CheckTrue("Rows above and below the cells not drawn", (HAL_Linux_Framebuffer[Y - 3][X] == ILI9341_COLOR_RED) &&
+    (HAL_Linux_Framebuffer[Y + 2][X] == ILI9341_COLOR_RED));
+  HostTest_CheckTrue("Top row of A", (HAL_Linux_Framebuffer[Y - 2][X] == ILI9341_COLOR_WHITE) && (HAL_Linux_Framebuffer[Y - 2][X + 2] == ILI9341_COLOR_BLACK));
+  HostTest_CheckTrue("Bottom row of B", HAL_Linux_Framebuffer[Y + 1][X + 5] == ILI9341_COLOR_WHITE);
+
+  Level8 = HAL_Linux_Framebuffer[Y - 2][X + 1];
+  HostTest_CheckTrue("Level 8 blended, green between black and white", (((Level8 >> 5) & 0x3F) > 0x10) && (((Level8 >> 5) & 0x3F) < 0x30));
+}
+
+static void Test_Layout()
+// Centring the app's button labels: the X of each label's left edge, as ILI9341_DrawTextAtXY() works it out for tpCentre.
+{
+  static const char *Labels[] = { "White", "Off", "Colour", "Red", "Green", "Blue", Label };
+  const uint8_t NumLabels = sizeof(Labels) / sizeof(Labels[0]);
+  volatile uint16_t Sink = 0; // So that the layouts are not optimized away.
+  uint32_t NumDifferences = 0;
+  double StartTime_s, Table_ns, ByGlyph_ns, Switching_ns;
+  char Chars[2] = { 0, 0 };
+
+  StartDisplay();
+  ILI9341_SetFont(&FreeSans9pt7b);
+
+  for (uint16_t Ch = 1; Ch < 256; ++Ch)
+  {
+    Chars[0] = Ch;
+    NumDifferences += ILI9341_GetTextWidth(Chars) != GetTextWidthByGlyph(&FreeSans9pt7b, Chars);
+  }
+  for (uint8_t Index = 0; Index < NumLabels; ++Index)
+    NumDifferences += ILI9341_GetTextWidth(Labels[Index]) != GetTextWidthByGlyph(&FreeSans9pt7b, Labels[Index]);
+
+  StartTime_s = HostTest_GetTime_s();
+  for (uint32_t Count = 0; Count < NumBenchmarkLayouts; ++Count)
+    Sink += 120 - ILI9341_GetTextWidth(Labels[Count % NumLabels]) / 2;
+  Table_ns = (HostTest_GetTime_s() - StartTime_s) * 1e9 / NumBenchmarkLayouts;
+
+  StartTime_s = HostTest_GetTime_s();
+  for (uint32_t Count = 0; Count < NumBenchmarkLayouts; ++Count)
+    Sink += 120 - GetTextWidthByGlyph(&FreeSans9pt7b, Labels[Count % NumLabels]) / 2;
+  ByGlyph_ns = (HostTest_GetTime_s() - StartTime_s) * 1e9 / NumBenchmarkLayouts;
+
+  // As DrawButton(), which sets the label font and then sets the title font back:
+  StartTime_s = HostTest_GetTime_s();
+  for (uint32_t Count = 0; Count < NumBenchmarkLayouts; ++Count)
+  {
+    const GFXfont *pFont = ILI9341_SetFont(&FreeSans9pt7b);
+
+    Sink += 120 - ILI9341_GetTextWidth(Labels[Count % NumLabels]) / 2;
+    ILI9341_SetFont((Count & 1) ? pFont : &FreeSans12pt7b);
+  }
+  Switching_ns = (HostTest_GetTime_s() - StartTime_s) * 1e9 / NumBenchmarkLayouts;
+
+  HostTest_Report("Time to centre a label, width table (host)", Table_ns, "ns");
+  HostTest_Report("Time to centre a label, glyph table (host)", ByGlyph_ns, "ns");
+  HostTest_Report("Time to centre a label, with DrawButton()'s font switches", Switching_ns, "ns");
+  HostTest_Check("Widths that differ from the glyph table's", NumDifferences, 0);
+  (void)Sink;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const HostTest_Test_t Tests[] =
+{
+  { "Text", Test_Text },
+  { "Throughput", Test_Throughput },
+  { "GlyphCache", Test_GlyphCache },
+  { "Merge", Test_Merge },
+  { "Antialiased", Test_Antialiased },
+  { "Layout", Test_Layout }
+};
+
+int main(int argc, char **argv)
+{
+  return HostTest_Main(argc, argv, Tests, sizeof(Tests) / sizeof(Tests[0]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,991 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp server tests, on the simulated hardware (see Shared/JSB_HAL_Linux.h), with clients on the host's loopback interface:
+//
+// => The app is included whole, as for JSB_LampTest.cpp. Its servers run as tasks (threads), as on the ESP32, and so does Go(), which moves
+//    simulated time on about as fast as real time, so that timeouts happen as they would.
+// => Each run of the program serves on ports of its own, so that tests run at once, or one straight after another, do not clash.
+// => Times are of the host's loopback interface and CPU, so are for comparing one way of serving with another, not a prediction of the ESP32's.
+// => Run as e.g. JSB_LampServerTest Stack. See JSB_HostTest.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <unistd.h>
+
+static uint16_t GetPortNumber()
+{
+  return 20000 + getpid() % 20000;
+}
+
+#define WiFi_PortNumber (GetPortNumber())
+#define UdpServer_PortNumber (GetPortNumber())
+
+#include "../02_Emma_DT_lamp_ConvertedToCPPAndRegEx/main/main.cpp"
+//
+#include "JSB_HostTest.h"
+#include <poll.h>
+#include <ctype.h>
+#include <strings.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define Client_Timeout_ms 2000
+#define Client_MaxNumResponseChars 2048
+
+static std::atomic<uint32_t> Go_SkipTime_ms(0); // Moves simulated time on at once, e.g. past a timeout.
+
+static void GoTask(void *)
+// As Go(), but in step with real time.
+{
+  while (1)
+  {
+    Go_Iterate();
+    HAL_Delay_ms(Go_Period_ms + Go_SkipTime_ms.exchange(0));
+    vTaskDelay(Go_Period_ms / portTICK_PERIOD_MS);
+  }
+}
+
+static void StartLamp()
+{
+  HAL_Linux_AttachDisplay(Display_CSX_GPIO, Display_D_CX_GPIO);
+  HAL_Linux_AttachTouchPanel(TouchPanel_CSX_GPIO);
+  InitializeLamp();
+  Go_Begin();
+
+  xTaskCreate(GoTask, "Go", 8192, NULL, tskIDLE_PRIORITY, NULL);
+  xTaskCreate(WifiServer_Go, "WifiServer", WifiServer_StackSize, NULL, tskIDLE_PRIORITY, NULL);
+  xTaskCreate(UdpServer_Go, "UdpServer", UdpServer_StackSize, NULL, tskIDLE_PRIORITY, NULL);
+}
+
+static int CompareDoubles(const void *pA, const void *pB)
+{
+  double A = *(const double *)pA, B = *(const double *)pB;
+
+  return (A > B) - (A < B);
+}
+
+static double GetPercentile(double *pValues, uint32_t NumValues, double Percentile)
+// Sorts pValues.
+{
+  qsort(pValues, NumValues, sizeof(double), CompareDoubles);
+  return pValues[(uint32_t)(Percentile / 100.0 * (NumValues - 1) + 0.5)];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Clients:
+
+static int Client_Connect()
+// Returns -1 on failure. Tries again while the server is starting.
+{
+  struct sockaddr_in Address;
+
+  memset(&Address, 0, sizeof(Address));
+  Address.sin_family = AF_INET;
+  Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  Address.sin_port = htons(WiFi_PortNumber);
+
+  for (uint32_t Count = 0; Count < Client_Timeout_ms / 10; ++Count)
+  {
+    int Socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    int NoDelay = 1;
+
+    setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &NoDelay, sizeof(NoDelay));
+    if (connect(Socket, (struct sockaddr *)&Address, sizeof(Address)) == 0)
+      return Socket;
+    close(Socket);
+    usleep(10000);
+  }
+  return -1;
+}
+
+static uint8_t Client_Send(int Socket, const void *pData, uint32_t NumBytes)
+{
+  while (NumBytes)
+  {
+    ssize_t NumBytesSent = send(Socket, pData, NumBytes, MSG_NOSIGNAL);
+
+    if (NumBytesSent <= 0)
+      return 0;
+    pData = (const char *)pData + NumBytesSent;
+    NumBytes -= NumBytesSent;
+  }
+  return 1;
+}
+
+static int32_t Client_Receive(int Socket, char *pChars, uint32_t MaxNumChars)
+// Waits for something to arrive. Returns the number of chars, 0 if the connection was closed, or -1 on timeout or error.
+{
+  struct pollfd PollFD = { Socket, POLLIN, 0 };
+
+  if (poll(&PollFD, 1, Client_Timeout_ms) <= 0)
+    return -1;
+  return recv(Socket, pChars, MaxNumChars, 0);
+}
+
+typedef struct
+{
+  int Socket;
+  uint32_t NumChars; // Received.
+  uint32_t NumResponseChars; // Of those, the response read last, which is discarded when the next is read.
+  uint8_t HEAD; // The response is to a HEAD request, so has no body.
+  char Chars[Client_MaxNumResponseChars + 1];
+} Client_t;
+
+static uint16_t Client_ReadResponse(Client_t *pClient, char **ppBody, uint32_t *pBodyNumChars)
+// Returns the status code of the next response, or 0 if none arrived. Any that follow it are kept.
+{
+  pClient->NumChars -= pClient->NumResponseChars;
+  memmove(pClient->Chars, pClient->Chars + pClient->NumResponseChars, pClient->NumChars);
+  pClient->NumResponseChars = 0;
+
+  while (1)
+  {
+    char *pEnd, *pContentLength;
+    uint32_t HeadNumChars, ContentLength = 0;
+    int32_t NumCharsRead;
+
+    pClient->Chars[pClient->NumChars] = '\0';
+    if ((pEnd = strstr(pClient->Chars, "\r\n\r\n")) != NULL)
+    {
+      HeadNumChars = pEnd + 4 - pClient->Chars;
+      if (((pContentLength = strstr(pClient->Chars, "Content-Length: ")) != NULL) && (pContentLength < pEnd) && !pClient->HEAD)
+        ContentLength = strtoul(pContentLength + 16, NULL, 10);
+      if (pClient->NumChars >= HeadNumChars + ContentLength)
+      {
+        if (ppBody)
+          *ppBody = pClient->Chars + HeadNumChars;
+        if (pBodyNumChars)
+          *pBodyNumChars = ContentLength;
+        pClient->NumResponseChars = HeadNumChars + ContentLength;
+        return strtoul(pClient->Chars + 9, NULL, 10); // After "HTTP/1.1 ".
+      }
+    }
+
+    if (pClient->NumChars == Client_MaxNumResponseChars)
+      return 0;
+    NumCharsRead = Client_Receive(pClient->Socket, pClient->Chars + pClient->NumChars, Client_MaxNumResponseChars - pClient->NumChars);
+    if (NumCharsRead <= 0)
+      return 0;
+    pClient->NumChars += NumCharsRead;
+  }
+}
+
+static uint8_t Client_Open(Client_t *pClient)
+{
+  pClient->NumChars = pClient->NumResponseChars = 0;
+  pClient->HEAD = 0;
+  pClient->Socket = Client_Connect();
+  return pClient->Socket >= 0;
+}
+
+static void Client_Close(Client_t *pClient)
+{
+  close(pClient->Socket);
+  pClient->Socket = -1;
+}
+
+static uint16_t Client_Request(Client_t *pClient, const char *pRequest)
+// Returns the status code of the response, or 0 if none arrived.
+{
+  pClient->HEAD = strncmp(pRequest, "HEAD ", 5) == 0;
+  if (!Client_Send(pClient->Socket, pRequest, strlen(pRequest)))
+    return 0;
+  return Client_ReadResponse(pClient, NULL, NULL);
+}
+
+static uint16_t Client_Post(Client_t *pClient, const char *pPath, const char *pContent)
+{
+  char Request[Client_MaxNumResponseChars];
+
+  snprintf(Request, sizeof(Request), "POST /%s HTTP/1.1\r\nContent-Length: %u\r\n\r\n%s", pPath, (unsigned)strlen(pContent), pContent);
+  return Client_Request(pClient, Request);
+}
+
+static uint8_t Client_IsClosed(int Socket)
+// Waits for the server to close the connection.
+{
+  char Chars[256];
+  int32_t NumCharsRead;
+
+  while ((NumCharsRead = Client_Receive(Socket, Chars, sizeof(Chars))) > 0)
+    ;
+  return NumCharsRead == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WebSocket clients:
+
+static uint8_t WebSocketClient_Open(Client_t *pClient)
+{
+  static const char Request[] = "GET /WebSocket HTTP/1.1\r\nHost: lamp\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+
+  if (!Client_Open(pClient) || (Client_Request(pClient, Request) != 101))
+    return 0;
+
+  // Frames follow the response:
+  pClient->NumChars -= pClient->NumResponseChars;
+  memmove(pClient->Chars, pClient->Chars + pClient->NumResponseChars, pClient->NumChars);
+  pClient->NumResponseChars = 0;
+  return 1;
+}
+
+static uint8_t WebSocketClient_SendFrame(Client_t *pClient, WebSocket_Opcode_t Opcode, const char *pPayload)
+// Masked, as a client's frames must be. Payloads are short.
+{
+  static const uint8_t Mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+  uint8_t Frame[6 + 125];
+  uint8_t NumChars = strlen(pPayload);
+
+  assert(NumChars <= 125);
+  Frame[0] = 0x80 | Opcode;
+  Frame[1] = 0x80 | NumChars;
+  memcpy(Frame + 2, Mask, 4);
+  for (uint8_t Index = 0; Index < NumChars; ++Index)
+    Frame[6 + Index] = pPayload[Index] ^ Mask[Index & 3];
+  return Client_Send(pClient->Socket, Frame, 6 + NumChars);
+}
+
+static int16_t WebSocketClient_ReadFrame(Client_t *pClient, char *pPayload, uint32_t MaxNumChars)
+// Returns the opcode of the next frame, its payload nul terminated, or -1 if none arrived. Frames from the server are short and not masked.
+{
+  while (1)
+  {
+    if (pClient->NumChars >= 2)
+    {
+      uint32_t PayloadNumChars = pClient->Chars[1] & 0x7F, HeaderNumBytes = 2, NumChars;
+
+      if (PayloadNumChars == 126)
+      {
+        PayloadNumChars = ((uint8_t)pClient->Chars[2] << 8) | (uint8_t)pClient->Chars[3];
+        HeaderNumBytes = 4;
+      }
+      NumChars = HeaderNumBytes + PayloadNumChars;
+      if ((pClient->NumChars >= NumChars) && (PayloadNumChars < MaxNumChars))
+      {
+        int16_t Opcode = pClient->Chars[0] & 0x0F;
+
+        memcpy(pPayload, pClient->Chars + HeaderNumBytes, PayloadNumChars);
+        pPayload[PayloadNumChars] = '\0';
+        pClient->NumChars -= NumChars;
+        memmove(pClient->Chars, pClient->Chars + NumChars, pClient->NumChars);
+        return Opcode;
+      }
+    }
+
+    int32_t NumCharsRead = Client_Receive(pClient->Socket, pClient->Chars + pClient->NumChars, Client_MaxNumResponseChars - pClient->NumChars);
+
+    if (NumCharsRead <= 0)
+      return -1;
+    pClient->NumChars += NumCharsRead;
+  }
+}
+
+static uint8_t UdpClient_Send(uint32_t Sequence, uint8_t ChannelMask, uint16_t Intensity)
+{
+  struct sockaddr_in Address;
+  LampPacket_t Packet;
+  uint8_t Bytes[LampPacket_MaxNumBytes];
+  uint8_t NumBytes;
+  int Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  ssize_t NumBytesSent;
+
+  memset(&Packet, 0, sizeof(Packet));
+  Packet.Sequence = Sequence;
+  Packet.ChannelMask = ChannelMask;
+  for (uint8_t Channel = 0; Channel < lcNumChannels; ++Channel)
+    Packet.Intensities[Channel] = Intensity;
+  NumBytes = LampPacket_Encode(&Packet, Bytes);
+
+  memset(&Address, 0, sizeof(Address));
+  Address.sin_family = AF_INET;
+  Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  Address.sin_port = htons(UdpServer_PortNumber);
+  NumBytesSent = sendto(Socket, Bytes, NumBytes, 0, (struct sockaddr *)&Address, sizeof(Address));
+  close(Socket);
+  return NumBytesSent == NumBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Test_Stack()
+// The server task's stack, having served every kind of request and frame. A guide to the ESP32's, which the server logs (see JSB_HostPlatform.h).
+{
+  static const char *Requests[] =
+  {
+    "GET / HTTP/1.1\r\n\r\n",
+    "GET /Night HTTP/1.1\r\n\r\n",
+    "GET /State?N=0.5&W=0.25&R=0.1&G=0.2&B=0.3 HTTP/1.1\r\n\r\n",
+    "GET /Nonsense HTTP/1.1\r\n\r\n",
+    "HEAD / HTTP/1.1\r\n\r\n",
+    "GET /State HTTP/1.1\r\n\r\n",
+    "GET /State HTTP/1.1\r\nIf-None-Match: \"0-0-state\", *\r\n\r\n",
+  };
+  static const char *StateChanges[] =
+  {
+    "{\"Natural\":0.5,\"Warm\":0.25,\"Off\":false}",
+    "{\"CCT\":2700,\"Intensity\":0.4}",
+    "{\"RGB\":\"#FF8000\",\"HSV\":[30,1,0.8]}",
+    "{]"
+  };
+  Client_t Client, WebSocket;
+  char Payload[256];
+  uint32_t Peak_bytes;
+  LampState_t State;
+
+  StartLamp();
+
+  HostTest_CheckTrue("Connected", Client_Open(&Client));
+  for (uint32_t Index = 0; Index < sizeof(Requests) / sizeof(Requests[0]); ++Index)
+  {
+    char Name[64];
+
+    snprintf(Name, sizeof(Name), "%.*s", (int)strcspn(Requests[Index], "\r"), Requests[Index]);
+    HostTest_CheckTrue(Name, Client_Request(&Client, Requests[Index]) != 0);
+  }
+  for (uint32_t Index = 0; Index < sizeof(StateChanges) / sizeof(StateChanges[0]); ++Index)
+    HostTest_CheckTrue(StateChanges[Index], Client_Post(&Client, "State", StateChanges[Index]) != 0);
+  Client_Close(&Client);
+
+  // A request with headers too large, which the server answers and closes:
+  HostTest_CheckTrue("Connected", Client_Open(&Client));
+  memset(Client.Chars, 'X', WifiServer_InputBuffer_SizeInBytes);
+  memcpy(Client.Chars, "GET / HTTP/1.1\r\nX: ", 19);
+  Client_Send(Client.Socket, Client.Chars, WifiServer_InputBuffer_SizeInBytes);
+  HostTest_CheckTrue("Headers too large", Client_ReadResponse(&Client, NULL, NULL) == 431);
+  HostTest_CheckTrue("Headers too large closed", Client_IsClosed(Client.Socket));
+  Client_Close(&Client);
+
+  // WebSocket, with a change pushed back to it, a ping and a close:
+  HostTest_CheckTrue("WebSocket", WebSocketClient_Open(&WebSocket));
+  WebSocketClient_ReadFrame(&WebSocket, Payload, sizeof(Payload));
+  WebSocketClient_SendFrame(&WebSocket, woText, "{\"Blue\":0.75}");
+  HostTest_CheckTrue("WebSocket push", WebSocketClient_ReadFrame(&WebSocket, Payload, sizeof(Payload)) == woText);
+  WebSocketClient_SendFrame(&WebSocket, woPing, "ping");
+  HostTest_CheckTrue("WebSocket pong", WebSocketClient_ReadFrame(&WebSocket, Payload, sizeof(Payload)) == woPong);
+  WebSocketClient_SendFrame(&WebSocket, woClose, "");
+  HostTest_CheckTrue("WebSocket close", WebSocketClient_ReadFrame(&WebSocket, Payload, sizeof(Payload)) == woClose);
+  Client_Close(&WebSocket);
+
+  // UDP:
+  for (uint32_t Sequence = 1; Sequence <= 10; ++Sequence)
+    UdpClient_Send(Sequence, 0x1F, 1000 * Sequence);
+  usleep(100000);
+  HostTest_CheckTrue("UDP", UdpServer_NumApplied != 0);
+  LampState_Get(&State);
+  HostTest_CheckTrue("UDP newest applied", State.Brightnesses[lcBlue] == 10000 / 65535.0f);
+
+  // Half the stack, as the ESP32's frames are larger than the host's, and lwip's socket calls use the calling task's stack:
+  Peak_bytes = HostPlatform_GetTaskStackPeak_bytes("WifiServer");
+  HostTest_Report("WifiServer stack size", WifiServer_StackSize, "bytes");
+  HostTest_Check("WifiServer stack peak (host)", Peak_bytes, WifiServer_StackSize / 2);
+  Peak_bytes = HostPlatform_GetTaskStackPeak_bytes("UdpServer");
+  HostTest_Report("UdpServer stack size", UdpServer_StackSize, "bytes");
+  HostTest_Check("UdpServer stack peak (host)", Peak_bytes, UdpServer_StackSize / 2);
+}
+
+static uint16_t Client_Get(Client_t *pClient, const char *pPath, uint8_t *pInvalidCommand)
+// *pInvalidCommand: Set if the status page says the command was not valid.
+{
+  char Request[256];
+  char *pBody;
+  uint32_t BodyNumChars;
+  uint16_t Status;
+
+  snprintf(Request, sizeof(Request), "GET /%s HTTP/1.1\r\n\r\n", pPath);
+  if (!Client_Send(pClient->Socket, Request, strlen(Request)) || !(Status = Client_ReadResponse(pClient, &pBody, &BodyNumChars)))
+    return 0;
+  *pInvalidCommand = memmem(pBody, BodyNumChars, "Invalid command", 15) != NULL;
+  return Status;
+}
+
+static const LampCommand_t *FindLampCommandByScan(HTTP_String_t Name)
+// As the commands were found before LampCommandTable.
+{
+  for (uint16_t Index = 0; Index < LampCommands_NumCommands; ++Index)
+    if ((strlen(LampCommands[Index].pName) == Name.NumChars) && (strncasecmp(LampCommands[Index].pName, Name.pChars, Name.NumChars) == 0))
+      return &LampCommands[Index];
+  return NULL;
+}
+
+static void Test_Commands()
+// Every command and parameter name, in either case, over HTTP, and names that are not quite them. Then the time to find a name.
+{
+  static const char *NotNames[] = { "Nat", "Naturals", "NaturalBrightnes", "O", "Of", "Nigh", "Stat", "Bright_" }; // Not "State", which is /State.
+  const uint32_t NumBenchmarkLookups = 1000000;
+  const uint16_t NumNames = LampCommands_NumCommands + sizeof(NotNames) / sizeof(NotNames[0]);
+  HTTP_String_t Names[NumNames];
+  char UpperNames[LampCommands_NumCommands][32];
+  uint32_t NumWrong = 0, NumFailed = 0;
+  volatile uintptr_t Sink = 0; // So that the lookups are not optimized away.
+  double StartTime_s, Table_ns, Scan_ns;
+  Client_t Client;
+  LampState_t State;
+
+  StartLamp();
+  HostTest_CheckTrue("Connected", Client_Open(&Client));
+
+  for (uint16_t Index = 0; Index < LampCommands_NumCommands; ++Index)
+  {
+    const LampCommand_t *pLampCommand = &LampCommands[Index];
+    char Path[64];
+    uint8_t InvalidCommand = 1;
+
+    for (uint8_t CharIndex = 0; CharIndex <= strlen(pLampCommand->pName); ++CharIndex)
+      UpperNames[Index][CharIndex] = toupper(pLampCommand->pName[CharIndex]);
+
+    if (pLampCommand->pParameter)
+    {
+      float Value = (Index + 1) / 32.0f; // Exact in decimal, and different for each name.
+      int8_t Channel = LampState_FindChannel(pLampCommand->pParameter);
+
+      snprintf(Path, sizeof(Path), "State?%.31s=%g", (Index & 1) ? UpperNames[Index] : pLampCommand->pName, Value);
+      NumFailed += (Client_Get(&Client, Path, &InvalidCommand) != 200) || InvalidCommand;
+      LampState_Get(&State);
+      NumWrong += (Channel < 0) || (State.Brightnesses[Channel] != Value);
+    }
+    else
+    {
+      snprintf(Path, sizeof(Path), "%.31s", (Index & 1) ? UpperNames[Index] : pLampCommand->pName);
+      NumFailed += (Client_Get(&Client, Path, &InvalidCommand) != 200) || InvalidCommand;
+      LampState_Get(&State);
+      if (pLampCommand->pHandler == LampCommand_Off)
+        NumWrong += !State.Off;
+      else if (pLampCommand->pHandler == LampCommand_On)
+        NumWrong += State.Off;
+      else if (pLampCommand->pHandler == LampCommand_Night)
+        NumWrong += (State.Brightnesses[lcNatural] != 0.0f) || (State.Brightnesses[lcWarm] != 0.3f);
+      else if (pLampCommand->pHandler == LampCommand_Bright)
+        NumWrong += State.Off || (State.Brightnesses[lcNatural] != 1.0f) || (State.Brightnesses[lcWarm] != 1.0f);
+      else
+        ++NumWrong; // A new command, to be added here.
+    }
+  }
+  HostTest_Check("Names not accepted", NumFailed, 0);
+  HostTest_Check("Names with the wrong effect", NumWrong, 0);
+
+  NumFailed = 0;
+  for (uint16_t Index = 0; Index < sizeof(NotNames) / sizeof(NotNames[0]); ++Index)
+  {
+    char Path[64];
+    uint8_t InvalidCommand = 0;
+
+    NumFailed += (Client_Get(&Client, NotNames[Index], &InvalidCommand) != 200) || !InvalidCommand;
+    snprintf(Path, sizeof(Path), "State?%s=0.5", NotNames[Index]);
+    NumFailed += (Client_Get(&Client, Path, &InvalidCommand) != 200) || !InvalidCommand;
+  }
+  HostTest_Check("Not quite names accepted", NumFailed, 0);
+  Client_Close(&Client);
+
+  // Lookups, of every name and of some that are not names:
+  for (uint16_t Index = 0; Index < NumNames; ++Index)
+  {
+    const char *pName = (Index < LampCommands_NumCommands) ? UpperNames[Index] : NotNames[Index - LampCommands_NumCommands];
+
+    Names[Index] = { (char *)pName, (uint16_t)strlen(pName) };
+  }
+
+  StartTime_s = HostTest_GetTime_s();
+  for (uint32_t Count = 0; Count < NumBenchmarkLookups; ++Count)
+    Sink = Sink + (uintptr_t)FindLampCommand(Names[Count % NumNames]);
+  Table_ns = (HostTest_GetTime_s() - StartTime_s) * 1e9 / NumBenchmarkLookups;
+
+  StartTime_s = HostTest_GetTime_s();
+  for (uint32_t Count = 0; Count < NumBenchmarkLookups; ++Count)
+    Sink = Sink + (uintptr_t)FindLampCommandByScan(Names[Count % NumNames]);
+  Scan_ns = (HostTest_GetTime_s() - StartTime_s) * 1e9 / NumBenchmarkLookups;
+
+  HostTest_Report("Time to find a name, perfect hash table (host)", Table_ns, "ns");
+  HostTest_Report("Time to find a name, scanning LampCommands (host)", Scan_ns, "ns");
+  (void)Sink;
+}
+
+static void Test_KeepAlive()
+// Round trip times of GET /State, on one kept alive connection, and on a new connection each time. Then pipelined requests.
+{
+  const uint32_t NumRequests = 1000, NumPipelined = 10;
+  static double KeepAlive_us[NumRequests], Reconnect_us[NumRequests];
+  uint32_t NumConnections, NumFailed = 0;
+  char Requests[NumPipelined * 32] = "";
+  Client_t Client;
+
+  StartLamp();
+  HostTest_CheckTrue("Connected", Client_Open(&Client));
+  NumFailed += Client_Request(&Client, "GET /State HTTP/1.1\r\n\r\n") != 200; // So that the server has accepted the connection.
+  NumConnections = WifiServer_NumConnections;
+  for (uint32_t Index = 0; Index < NumRequests; ++Index)
+  {
+    double StartTime_s = HostTest_GetTime_s();
+
+    NumFailed += Client_Request(&Client, "GET /State HTTP/1.1\r\n\r\n") != 200;
+    KeepAlive_us[Index] = (HostTest_GetTime_s() - StartTime_s) * 1e6;
+  }
+  HostTest_Check("Connections made for kept alive requests", WifiServer_NumConnections - NumConnections, 0);
+  Client_Close(&Client);
+
+  for (uint32_t Index = 0; Index < NumRequests; ++Index)
+  {
+    double StartTime_s = HostTest_GetTime_s();
+
+    NumFailed += !Client_Open(&Client) || (Client_Request(&Client, "GET /State HTTP/1.1\r\nConnection: close\r\n\r\n") != 200);
+    Client_Close(&Client);
+    Reconnect_us[Index] = (HostTest_GetTime_s() - StartTime_s) * 1e6;
+  }
+  HostTest_Check("Requests failed", NumFailed, 0);
+
+  HostTest_Report("Round trip, kept alive, median (host)", GetPercentile(KeepAlive_us, NumRequests, 50), "us");
+  HostTest_Report("Round trip, kept alive, 99th percentile (host)", GetPercentile(KeepAlive_us, NumRequests, 99), "us");
+  HostTest_Report("Round trip, connecting each time, median (host)", GetPercentile(Reconnect_us, NumRequests, 50), "us");
+  HostTest_Report("Round trip, connecting each time, 99th percentile (host)", GetPercentile(Reconnect_us, NumRequests, 99), "us");
+
+  // Pipelined, sent at once:
+  HostTest_CheckTrue("Connected", Client_Open(&Client));
+  for (uint32_t Index = 0; Index < NumPipelined; ++Index)
+    strcat(Requests, "GET /State HTTP/1.1\r\n\r\n");
+  Client_Send(Client.Socket, Requests, strlen(Requests));
+  NumFailed = 0;
+  for (uint32_t Index = 0; Index < NumPipelined; ++Index)
+    NumFailed += Client_ReadResponse(&Client, NULL, NULL) != 200;
+  HostTest_Check("Pipelined requests failed", NumFailed, 0);
+  Client_Close(&Client);
+}
+
+#define Load_NumRequestsPerClient 2000
+
+typedef struct
+{
+  pthread_t Thread;
+  uint32_t NumFailed;
+  double Times_us[Load_NumRequestsPerClient];
+} LoadClient_t;
+
+static void *LoadClient_Run(void *pArgument)
+// Requests GET /State over and over on one connection, as fast as the server answers.
+{
+  LoadClient_t *pLoadClient = (LoadClient_t *)pArgument;
+  Client_t Client;
+
+  pLoadClient->NumFailed = !Client_Open(&Client);
+  for (uint32_t Index = 0; Index < Load_NumRequestsPerClient; ++Index)
+  {
+    double StartTime_s = HostTest_GetTime_s();
+
+    pLoadClient->NumFailed += Client_Request(&Client, "GET /State HTTP/1.1\r\n\r\n") != 200;
+    pLoadClient->Times_us[Index] = (HostTest_GetTime_s() - StartTime_s) * 1e6;
+  }
+  Client_Close(&Client);
+  return NULL;
+}
+
+static void Test_Load()
+// Round trip times with several clients at once, up to as many as are served at once. Then with a client that sends requests but does not read the
+// responses, which must not hold up another client, and must be disconnected.
+{
+  static LoadClient_t LoadClients[WifiServer_MaxNumConnections];
+  static double Times_us[WifiServer_MaxNumConnections * Load_NumRequestsPerClient];
+  char Name[80], Requests[20 * 32] = "";
+  uint32_t NumFailed = 0, NumOpenConnections;
+  int StalledSocket, ReceiveBufferSize = 4096;
+  struct sockaddr_in Address;
+
+  StartLamp();
+
+  for (uint32_t NumClients = 1; NumClients <= WifiServer_MaxNumConnections; NumClients *= 2)
+  {
+    for (uint32_t Index = 0; Index < NumClients; ++Index)
+      pthread_create(&LoadClients[Index].Thread, NULL, LoadClient_Run, &LoadClients[Index]);
+    for (uint32_t Index = 0; Index < NumClients; ++Index)
+    {
+      pthread_join(LoadClients[Index].Thread, NULL);
+      NumFailed += LoadClients[Index].NumFailed;
+      memcpy(Times_us + Index * Load_NumRequestsPerClient, LoadClients[Index].Times_us, sizeof(LoadClients[Index].Times_us));
+    }
+    snprintf(Name, sizeof(Name), "Round trip, %u clients, median (host)", (unsigned)NumClients);
+    HostTest_Report(Name, GetPercentile(Times_us, NumClients * Load_NumRequestsPerClient, 50), "us");
+    snprintf(Name, sizeof(Name), "Round trip, %u clients, 99th percentile (host)", (unsigned)NumClients);
+    HostTest_Report(Name, GetPercentile(Times_us, NumClients * Load_NumRequestsPerClient, 99), "us");
+  }
+  HostTest_Check("Requests failed", NumFailed, 0);
+
+  // A client that sends pipelined requests until the server stops taking them, as it has not read the responses:
+  memset(&Address, 0, sizeof(Address));
+  Address.sin_family = AF_INET;
+  Address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  Address.sin_port = htons(WiFi_PortNumber);
+  StalledSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  setsockopt(StalledSocket, SOL_SOCKET, SO_RCVBUF, &ReceiveBufferSize, sizeof(ReceiveBufferSize)); // So that the server's output backs up sooner.
+  HostTest_CheckTrue("Stalled client connected", connect(StalledSocket, (struct sockaddr *)&Address, sizeof(Address)) == 0);
+  fcntl(StalledSocket, F_SETFL, fcntl(StalledSocket, F_GETFL, 0) | O_NONBLOCK);
+  for (uint32_t Index = 0; Index < 20; ++Index)
+    strcat(Requests, "GET /State HTTP/1.1\r\n\r\n");
+  for (uint32_t Count = 0; Count < 50; ++Count)
+    if (send(StalledSocket, Requests, strlen(Requests), MSG_NOSIGNAL) > 0)
+      Count = 0;
+    else
+      usleep(1000);
+  HostTest_CheckTrue("Stalled client's output backlogged", WifiServer_NumBacklogged != 0);
+
+  pthread_create(&LoadClients[0].Thread, NULL, LoadClient_Run, &LoadClients[0]);
+  pthread_join(LoadClients[0].Thread, NULL);
+  HostTest_Check("Requests failed, with a stalled client", LoadClients[0].NumFailed, 0);
+  HostTest_Report("Round trip, with a stalled client, median (host)", GetPercentile(LoadClients[0].Times_us, Load_NumRequestsPerClient, 50), "us");
+  HostTest_Check("Round trip, with a stalled client, 99th percentile (host)", GetPercentile(LoadClients[0].Times_us, Load_NumRequestsPerClient, 99),
+    WifiServer_SendTimeout_s * 1e6 / 10);
+
+  // Past the send timeout:
+  Go_SkipTime_ms = WifiServer_SendTimeout_s * 1000 + 100;
+  for (uint32_t Count = 0; ((NumOpenConnections = WifiServer_NumOpenConnections) != 0) && (Count < Client_Timeout_ms); ++Count) // The server checks at least once a second.
+    usleep(1000);
+  HostTest_Check("Stalled connections left open", NumOpenConnections, 0);
+  close(StalledSocket);
+}
+
+static uint32_t Replay(const char *pStream, uint32_t NumChars, uint32_t FirstFragmentNumChars, uint32_t FragmentNumChars, char *pOutput, uint32_t MaxNumOutputChars)
+// Hands the server's request reader a stream of requests a fragment at a time, handling every request complete after each. Returns what it sent back.
+{
+  static WifiServer_Connection_t Connection;
+  static char OutputBuffer[1024];
+  int Sockets[2];
+  uint32_t NumOutputChars = 0;
+  ssize_t NumCharsRead;
+
+  socketpair(AF_UNIX, SOCK_STREAM, 0, Sockets);
+  fcntl(Sockets[1], F_SETFL, fcntl(Sockets[1], F_GETFL, 0) | O_NONBLOCK);
+  memset(&Connection, 0, sizeof(Connection));
+  Connection.Socket = Sockets[0];
+
+  for (uint32_t Index = 0; Index < NumChars; )
+  {
+    uint32_t NumFragmentChars = Index ? FragmentNumChars : FirstFragmentNumChars;
+    WifiServer_HandleResult_t Result;
+
+    if (NumFragmentChars > NumChars - Index)
+      NumFragmentChars = NumChars - Index;
+    assert(Connection.InputBuffer_NumBytes + NumFragmentChars <= WifiServer_InputBuffer_SizeInBytes);
+    memcpy(Connection.InputBuffer + Connection.InputBuffer_NumBytes, pStream + Index, NumFragmentChars);
+    Connection.InputBuffer_NumBytes += NumFragmentChars;
+    Index += NumFragmentChars;
+
+    while ((Result = WifiServer_HandleNextRequest(&Connection, OutputBuffer, sizeof(OutputBuffer))) == hrHandled)
+      ;
+    if (Result == hrClose)
+      break;
+  }
+
+  while ((NumOutputChars < MaxNumOutputChars) && ((NumCharsRead = recv(Sockets[1], pOutput + NumOutputChars, MaxNumOutputChars - NumOutputChars, 0)) > 0))
+    NumOutputChars += NumCharsRead;
+  close(Sockets[0]);
+  close(Sockets[1]);
+  return NumOutputChars;
+}
+
+static void Test_Fragments()
+// Pipelined requests, as if they arrived split at every possible point, and one char at a time. The responses must be as for the stream arriving whole.
+{
+  static const char Stream[] =
+    "POST /State HTTP/1.1\r\nHost: lamp\r\nContent-Type: application/json\r\nContent-Length: 28\r\n\r\n{\"Natural\":0.5,\"Warm\":0.25} "
+    "GET /State?R=0.125 HTTP/1.1\r\nHost: lamp\r\n\r\n"
+    "GET /On HTTP/1.1\r\n\r\n"
+    "HEAD / HTTP/1.1\r\nIf-None-Match: \"nothing\"\r\n\r\n"
+    "GET /State HTTP/1.1\r\nConnection: keep-alive\r\n\r\n"
+    "POST /State HTTP/1.1\r\nContent-Length: 0\r\n\r\n"
+    "GET /Nonsense HTTP/1.0\r\n\r\n"; // Closes the connection.
+  const uint32_t NumChars = sizeof(Stream) - 1;
+  static char Expected[8192], Output[8192];
+  uint32_t ExpectedNumChars, NumDifferent = 0, NumResponses = 0;
+  LampState_t State;
+
+  // Twice, so that the lamp state has settled, and so has the version in the ETags:
+  Replay(Stream, NumChars, NumChars, NumChars, Expected, sizeof(Expected));
+  ExpectedNumChars = Replay(Stream, NumChars, NumChars, NumChars, Expected, sizeof(Expected));
+  for (const char *pResponse = Expected; (pResponse = (const char *)memmem(pResponse, Expected + ExpectedNumChars - pResponse, "HTTP/1.1 ", 9)) != NULL; ++pResponse)
+    ++NumResponses;
+  HostTest_CheckTrue("Responses to the stream whole", NumResponses == 7);
+  LampState_Get(&State);
+  HostTest_CheckTrue("Lamp state changed by the stream", !State.Off && (State.Brightnesses[lcNatural] == 0.5f) && (State.Brightnesses[lcWarm] == 0.25f) &&
+    (State.Brightnesses[lcRed] == 0.125f));
+
+  for (uint32_t Split = 1; Split < NumChars; ++Split)
+  {
+    uint32_t OutputNumChars = Replay(Stream, NumChars, Split, NumChars, Output, sizeof(Output));
+
+    NumDifferent += (OutputNumChars != ExpectedNumChars) || (memcmp(Output, Expected, ExpectedNumChars) != 0);
+  }
+  HostTest_Check("Splits with different responses", NumDifferent, 0);
+
+  NumDifferent = 0;
+  for (uint32_t FragmentNumChars = 1; FragmentNumChars <= 16; ++FragmentNumChars)
+  {
+    uint32_t OutputNumChars = Replay(Stream, NumChars, FragmentNumChars, FragmentNumChars, Output, sizeof(Output));
+
+    NumDifferent += (OutputNumChars != ExpectedNumChars) || (memcmp(Output, Expected, ExpectedNumChars) != 0);
+  }
+  HostTest_Check("Fragment sizes (1 to 16 chars) with different responses", NumDifferent, 0);
+}
+
+static uint8_t IsNotModified(const char *pResponse, uint32_t NumChars)
+// A 304 status line, then headers, and no body.
+{
+  return (NumChars >= 31) && (strncmp(pResponse, "HTTP/1.1 304 Not Modified\r\n", 27) == 0) && !strstr(pResponse, "Content-Length") &&
+    (strstr(pResponse, "\r\n\r\n") == pResponse + NumChars - 4);
+}
+
+static void GetETag(const char *pResponse, char *pETag, uint32_t MaxNumChars)
+// Sets *pETag to the response's ETag, quotes and all, or to "" if it has none.
+{
+  const char *pStart = strstr(pResponse, "\r\nETag: "), *pEnd;
+
+  *pETag = '\0';
+  if (!pStart || ((pEnd = strstr(pStart + 8, "\r\n")) == NULL) || (pEnd - (pStart + 8) >= (int32_t)MaxNumChars))
+    return;
+  memcpy(pETag, pStart + 8, pEnd - (pStart + 8));
+  pETag[pEnd - (pStart + 8)] = '\0';
+}
+
+static void Test_Responses()
+// send() calls and bytes for each kind of response. Each must be sent with one call. Then conditional requests, against the ETags and the
+// cached bodies.
+{
+  static const char *Requests[][2] =
+  {
+    { "Status page", "GET / HTTP/1.1\r\n\r\n" },
+    { "Status page, not modified", "GET / HTTP/1.1\r\nIf-None-Match: *\r\n\r\n" },
+    { "Status page, HEAD", "HEAD / HTTP/1.1\r\n\r\n" },
+    { "Command", "GET /Night HTTP/1.1\r\n\r\n" },
+    { "Invalid command", "GET /Nonsense HTTP/1.1\r\n\r\n" },
+    { "State", "GET /State HTTP/1.1\r\n\r\n" },
+    { "State, not modified", "GET /State HTTP/1.1\r\nIf-None-Match: *\r\n\r\n" },
+    { "State change", "POST /State HTTP/1.1\r\nContent-Length: 15\r\n\r\n{\"Natural\":0.5}" },
+    { "Bad state change", "POST /State HTTP/1.1\r\nContent-Length: 2\r\n\r\n{]" },
+    { "Bad request", "GET\r\n\r\n" },
+    { "WebSocket handshake", "GET /WebSocket HTTP/1.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+      "Sec-WebSocket-Version: 13\r\n\r\n" }
+  };
+  static char Output[4096];
+  char Name[80];
+  uint32_t MaxNumSends = 0;
+
+  for (uint32_t Index = 0; Index < sizeof(Requests) / sizeof(Requests[0]); ++Index)
+  {
+    uint32_t NumSends = WifiServer_NumSends, NumBytesSent = WifiServer_NumBytesSent;
+    uint32_t NumOutputChars = Replay(Requests[Index][1], strlen(Requests[Index][1]), 1024, 1024, Output, sizeof(Output) - 1);
+
+    NumSends = WifiServer_NumSends - NumSends;
+    NumBytesSent = WifiServer_NumBytesSent - NumBytesSent;
+    snprintf(Name, sizeof(Name), "%s, send() calls", Requests[Index][0]);
+    HostTest_Report(Name, NumSends, "calls");
+    snprintf(Name, sizeof(Name), "%s, sent", Requests[Index][0]);
+    HostTest_Report(Name, NumBytesSent, "bytes");
+    HostTest_CheckTrue(Requests[Index][0], NumOutputChars && (NumOutputChars == NumBytesSent));
+    Output[NumOutputChars] = '\0';
+    if (strstr(Requests[Index][0], "not modified"))
+    {
+      snprintf(Name, sizeof(Name), "%s, 304 with no body", Requests[Index][0]);
+      HostTest_CheckTrue(Name, IsNotModified(Output, NumOutputChars));
+    }
+    if (NumSends > MaxNumSends)
+      MaxNumSends = NumSends;
+  }
+  HostTest_Check("Most sends for a response", MaxNumSends, 1);
+
+  // Conditional requests, for each cached body:
+  for (uint8_t Index = 0; Index < 2; ++Index)
+  {
+    static const char *pPaths[] = { "/", "/State" };
+    static const char *pNames[] = { "Status page", "State" };
+    LampState_Change_t Change = {};
+    LampState_t State;
+    char Request[128], ETag[40], NewETag[40];
+    uint32_t NumOutputChars, NumHits, NumMisses, NumNotModified;
+    uint8_t NotModified, Modified;
+
+    NumOutputChars = Replay(Request, snprintf(Request, sizeof(Request), "GET %s HTTP/1.1\r\n\r\n", pPaths[Index]), 1024, 1024, Output, sizeof(Output) - 1);
+    Output[NumOutputChars] = '\0';
+    GetETag(Output, ETag, sizeof(ETag));
+
+    // Repeated at the same version: served from the cached body, and not modified for its ETag:
+    NumHits = WifiServer_NumCacheHits;
+    NumMisses = WifiServer_NumCacheMisses;
+    NumNotModified = WifiServer_NumNotModified;
+    Replay(Request, snprintf(Request, sizeof(Request), "GET %s HTTP/1.1\r\n\r\n", pPaths[Index]), 1024, 1024, Output, sizeof(Output));
+    NumOutputChars = Replay(Request, snprintf(Request, sizeof(Request), "GET %s HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n", pPaths[Index], ETag), 1024, 1024,
+      Output, sizeof(Output) - 1);
+    Output[NumOutputChars] = '\0';
+    NotModified = IsNotModified(Output, NumOutputChars);
+    snprintf(Name, sizeof(Name), "%s, repeated, cache hits", pNames[Index]);
+    HostTest_CheckMin(Name, WifiServer_NumCacheHits - NumHits, 2);
+    snprintf(Name, sizeof(Name), "%s, repeated, bodies rendered", pNames[Index]);
+    HostTest_Check(Name, WifiServer_NumCacheMisses - NumMisses, 0);
+    snprintf(Name, sizeof(Name), "%s, its ETag, 304 with no body", pNames[Index]);
+    HostTest_CheckTrue(Name, NotModified && ETag[0]);
+    snprintf(Name, sizeof(Name), "%s, its ETag, counted not modified", pNames[Index]);
+    HostTest_CheckTrue(Name, WifiServer_NumNotModified - NumNotModified == 1);
+
+    // After a change, a new ETag, and the old one is stale:
+    Change.ChannelMask = 1 << lcRed;
+    LampState_Get(&State);
+    Change.State.Brightnesses[lcRed] = (State.Brightnesses[lcRed] < 0.5f) ? 0.75f : 0.25f;
+    LampState_Apply(&Change);
+    NumMisses = WifiServer_NumCacheMisses;
+    NumOutputChars = Replay(Request, snprintf(Request, sizeof(Request), "GET %s HTTP/1.1\r\nIf-None-Match: %s\r\n\r\n", pPaths[Index], ETag), 1024, 1024,
+      Output, sizeof(Output) - 1);
+    Output[NumOutputChars] = '\0';
+    Modified = (strncmp(Output, "HTTP/1.1 200 OK\r\n", 17) == 0) && strstr(Output, "Content-Length");
+    GetETag(Output, NewETag, sizeof(NewETag));
+    snprintf(Name, sizeof(Name), "%s, changed, stale ETag, 200 with the body", pNames[Index]);
+    HostTest_CheckTrue(Name, Modified);
+    snprintf(Name, sizeof(Name), "%s, changed, ETag changed", pNames[Index]);
+    HostTest_CheckTrue(Name, NewETag[0] && (strcmp(NewETag, ETag) != 0));
+    snprintf(Name, sizeof(Name), "%s, changed, bodies rendered", pNames[Index]);
+    HostTest_Check(Name, WifiServer_NumCacheMisses - NumMisses, 1);
+  }
+}
+
+static void *AtomicChanger_Run(void *pArgument)
+// Sets the natural and warm brightnesses together, to one value then another, over and over.
+{
+  uint32_t *pNumFailed = (uint32_t *)pArgument;
+  Client_t Client;
+
+  *pNumFailed = !Client_Open(&Client);
+  for (uint32_t Count = 0; Count < 2000; ++Count)
+    *pNumFailed += Client_Request(&Client, (Count & 1) ? "GET /State?N=0.75&W=0.75 HTTP/1.1\r\n\r\n" : "GET /State?N=0.25&W=0.25 HTTP/1.1\r\n\r\n") != 200;
+  Client_Close(&Client);
+  return NULL;
+}
+
+static void Test_Atomic()
+// Changes to several channels are made as one: one version for each, whether asked for by a command, by parameters, or as JSON. Then they are
+// seen whole by another task (as the LED loop) reading the lamp state over and over, and by the status page and state JSON served meanwhile.
+{
+  static const char *Changes[] =
+  {
+    "GET /Bright HTTP/1.1\r\n\r\n",
+    "GET /Night HTTP/1.1\r\n\r\n",
+    "GET /State?N=0.5&W=0.5&R=0.5&Off=1 HTTP/1.1\r\n\r\n", // Not valid, as Off is not a parameter, so not applied.
+    "GET /State?N=0.5&W=0.5&R=0.5 HTTP/1.1\r\n\r\n",
+    "POST /State HTTP/1.1\r\nContent-Length: 39\r\n\r\n{\"Natural\":0.25,\"Warm\":0.75,\"Off\":true}",
+    "GET /On HTTP/1.1\r\n\r\n",
+    "GET /State?N=0.5&W=0.5 HTTP/1.1\r\n\r\n" // Natural and Warm equal, as they stay below.
+  };
+  static const uint8_t NumVersions[] = { 1, 1, 0, 1, 1, 1, 1 };
+  pthread_t Thread;
+  uint32_t NumChangerFailed, NumFailed = 0, NumTorn = 0, NumReads = 0, NumPages = 0, NumWrongVersions = 0;
+  Client_t Client;
+
+  StartLamp();
+  HostTest_CheckTrue("Connected", Client_Open(&Client));
+  for (uint8_t Index = 0; Index < sizeof(Changes) / sizeof(Changes[0]); ++Index)
+  {
+    uint32_t Version = LampState_Version;
+
+    NumFailed += Client_Request(&Client, Changes[Index]) != 200;
+    NumWrongVersions += LampState_Version - Version != NumVersions[Index];
+  }
+  HostTest_Check("Changes made as other than one version", NumWrongVersions, 0);
+
+  pthread_create(&Thread, NULL, AtomicChanger_Run, &NumChangerFailed);
+  while (pthread_tryjoin_np(Thread, NULL) != 0)
+  {
+    char *pBody, Body[Client_MaxNumResponseChars + 1], Natural[8], Warm[8];
+    uint32_t BodyNumChars;
+    const char *pNatural, *pWarm;
+    uint8_t JSON = NumReads & 1;
+    LampState_t State;
+
+    LampState_Get(&State);
+    NumTorn += State.Brightnesses[lcNatural] != State.Brightnesses[lcWarm];
+    if (++NumReads % 256)
+      continue;
+
+    // The page and the JSON give brightnesses to 2 and 3 decimals:
+    if (!Client_Send(Client.Socket, JSON ? "GET /State HTTP/1.1\r\n\r\n" : "GET / HTTP/1.1\r\n\r\n", JSON ? 23 : 18) ||
+      (Client_ReadResponse(&Client, &pBody, &BodyNumChars) != 200))
+    {
+      ++NumFailed;
+      continue;
+    }
+    memcpy(Body, pBody, BodyNumChars);
+    Body[BodyNumChars] = '\0';
+    pNatural = strstr(Body, JSON ? "\"Natural\":" : "Natural brightness: ");
+    pWarm = strstr(Body, JSON ? "\"Warm\":" : "Warm brightness: ");
+    if (!pNatural || !pWarm)
+    {
+      ++NumFailed;
+      continue;
+    }
+    sscanf(strchr(pNatural, ':') + 1, " %7[0-9.]", Natural);
+    sscanf(strchr(pWarm, ':') + 1, " %7[0-9.]", Warm);
+    NumTorn += strcmp(Natural, Warm) != 0;
+    ++NumPages;
+  }
+  Client_Close(&Client);
+
+  HostTest_Report("Lamp state reads while changing", NumReads, "");
+  HostTest_Report("Pages and state JSON read while changing", NumPages, "");
+  HostTest_Check("Requests failed", NumChangerFailed + NumFailed, 0);
+  HostTest_Check("Changes seen in part", NumTorn, 0);
+}
+
+static void WaitForFrames(uint32_t NumFrames)
+// Until the server has handled NumFrames WebSocket frames in all.
+{
+  for (uint32_t Count = 0; (Count < Client_Timeout_ms) && (WifiServer_NumFramesReceived < NumFrames); ++Count)
+    usleep(1000);
+}
+
+static void Test_Ping()
+// WebSocket clients that send nothing are pinged. One that answers with a pong is kept, and one that does not is closed.
+{
+  Client_t Answering, Silent;
+  char Payload[256];
+  uint32_t NumPings = 0, NumFrames;
+
+  StartLamp();
+  HostTest_CheckTrue("Answering WebSocket", WebSocketClient_Open(&Answering));
+  HostTest_CheckTrue("Silent WebSocket", WebSocketClient_Open(&Silent));
+  WebSocketClient_ReadFrame(&Answering, Payload, sizeof(Payload)); // The whole state.
+  WebSocketClient_ReadFrame(&Silent, Payload, sizeof(Payload));
+
+  for (uint8_t Count = 0; Count < 3; ++Count)
+  {
+    Go_SkipTime_ms = WifiServer_PingInterval_s * 1000;
+    if (WebSocketClient_ReadFrame(&Answering, Payload, sizeof(Payload)) != woPing)
+      break;
+    ++NumPings;
+    NumFrames = WifiServer_NumFramesReceived;
+    WebSocketClient_SendFrame(&Answering, woPong, Payload);
+    WaitForFrames(NumFrames + 1); // Before time moves on again.
+  }
+  HostTest_CheckMin("Pings answered", NumPings, 3);
+
+  WebSocketClient_SendFrame(&Answering, woText, "{\"Blue\":0.5}");
+  HostTest_CheckTrue("Answering WebSocket kept", WebSocketClient_ReadFrame(&Answering, Payload, sizeof(Payload)) == woText);
+  HostTest_CheckTrue("Silent WebSocket closed", Client_IsClosed(Silent.Socket));
+  HostTest_CheckMin("Closed as not answered", WifiServer_NumPingTimeouts, 1);
+  Client_Close(&Answering);
+  Client_Close(&Silent);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const HostTest_Test_t Tests[] =
+{
+  { "Stack", Test_Stack },
+  { "Commands", Test_Commands },
+  { "KeepAlive", Test_KeepAlive },
+  { "Load", Test_Load },
+  { "Fragments", Test_Fragments },
+  { "Responses", Test_Responses },
+  { "Atomic", Test_Atomic },
+  { "Ping", Test_Ping }
+};
+
+int main(int argc, char **argv)
+{
+  return HostTest_Main(argc, argv, Tests, sizeof(Tests) / sizeof(Tests[0]));
+}
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,544 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp app tests, on the simulated hardware (see Shared/JSB_HAL_Linux.h):
+//
+// => The app is included whole, so that its state can be set and inspected directly. Go() is run a time round at a time, in simulated
+//    time, so that each run is the same.
+// => Run as e.g. JSB_LampTest Display. See JSB_HostTest.h.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../02_Emma_DT_lamp_ConvertedToCPPAndRegEx/main/main.cpp"
+//
+#include <math.h>
+//
+#include "JSB_HostTest.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void StartLamp()
+{
+  HAL_Linux_AttachDisplay(Display_CSX_GPIO, Display_D_CX_GPIO);
+  HAL_Linux_AttachTouchPanel(TouchPanel_CSX_GPIO);
+  InitializeLamp();
+  Go_Begin();
+}
+
+static void RunGo_ms(uint32_t Time_ms)
+{
+  for (uint32_t Count = 0; Count < Time_ms / Go_Period_ms; ++Count)
+  {
+    Go_Iterate();
+    HAL_Delay_ms(Go_Period_ms);
+  }
+}
+
+static HAL_Linux_TouchSample_t GetTouchSample(int64_t Time_us, int16_t X, int16_t Y)
+// The raw reading for a touch at X, Y on the screen: XPT2046_ConvertRawToScreen() and the driver's swaps, inverted. X < 0 => not touched.
+{
+  HAL_Linux_TouchSample_t Sample = { Time_us, X >= 0, 0, 0, 0 };
+
+  if (X < 0)
+    return Sample;
+
+  Sample.RawX = XPT2046_RawX_Min + (X + 0.5) * (XPT2046_RawX_Max - XPT2046_RawX_Min) / XPT2046_Width;
+  Sample.RawY = XPT2046_RawY_Min + (Y + 0.5) * (XPT2046_RawY_Max - XPT2046_RawY_Min) / XPT2046_Height;
+#if XPT2046_Swap_XL_and_XR
+  Sample.RawX = 4095 - Sample.RawX;
+#endif
+#if XPT2046_Swap_YD_and_YU
+  Sample.RawY = 4095 - Sample.RawY;
+#endif
+  Sample.RawZ = 1000;
+  return Sample;
+}
+
+static uint32_t CountPixels(uint16_t Left, uint16_t Top, uint16_t Width, uint16_t Height, uint16_t Color)
+{
+  uint32_t NumPixels = 0;
+
+  for (uint16_t Y = Top; Y < Top + Height; ++Y)
+    for (uint16_t X = Left; X < Left + Width; ++X)
+      NumPixels += HAL_Linux_Framebuffer[Y][X] == Color;
+  return NumPixels;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Test_Display()
+// The first screen, as decoded from the SPI transactions.
+{
+  const HAL_Linux_SPIRecord_t *pRecords;
+  uint32_t NumRecords, NumButtonPixels = Button_Off_Width * Button_Off_Height;
+
+  StartLamp();
+  RunGo_ms(100);
+
+  NumRecords = HAL_Linux_GetSPIRecords(&pRecords);
+  HostTest_CheckTrue("Display sent a command first", NumRecords && (pRecords[0].CSX_GPIO == Display_CSX_GPIO) && !pRecords[0].DC);
+
+  // The buttons are bars of their colour, less their labels, and the title is drawn:
+  HostTest_CheckMin("Off button pixels in its colour (fraction)", (double)CountPixels(Button_Off_Left, Button_Off_Top, Button_Off_Width, Button_Off_Height,
+    Button_Off_Color) / NumButtonPixels, 0.7);
+  HostTest_CheckMin("Colour button pixels in its colour (fraction)", (double)CountPixels(Button_Color_Left, Button_Color_Top, Button_Color_Width, Button_Color_Height,
+    Button_Color_Color) / NumButtonPixels, 0.7);
+  HostTest_CheckMin("Whites area pixels in its colour (fraction)", (double)CountPixels(Button_Whites_Left, Button_Whites_Top, Button_Whites_Width,
+    Button_Whites_Height, Button_Whites_Color) / (Button_Whites_Width * Button_Whites_Height), 0.99);
+  HostTest_CheckMin("Title pixels drawn", ILI9341_Width * 40 - CountPixels(0, 0, ILI9341_Width, 40, ILI9341_COLOR_BLACK), 100);
+  HostTest_Check("Pixels drawn between the buttons", ILI9341_Width * 4 - CountPixels(0, Button_Off_Top - 10, ILI9341_Width, 4, ILI9341_COLOR_BLACK), 0);
+}
+
+static void Test_Touch()
+// A scripted touch of the Off button, then of anywhere, which turns the lamp back on.
+{
+  static HAL_Linux_TouchSample_t Script[4];
+  int64_t Time_us;
+  uint8_t OffAfterOff, BacklightAfterOff;
+
+  StartLamp();
+  RunGo_ms(100);
+  Time_us = HAL_GetTime_us();
+  Script[0] = GetTouchSample(Time_us + 50000, Button_Off_Left + Button_Off_Width / 2, Button_Off_Top + Button_Off_Height / 2);
+  Script[1] = GetTouchSample(Time_us + 150000, -1, -1);
+  Script[2] = GetTouchSample(Time_us + 300000, 120, 160);
+  Script[3] = GetTouchSample(Time_us + 400000, -1, -1);
+  HAL_Linux_SetTouchScript(Script, 4);
+
+  RunGo_ms(250);
+  OffAfterOff = Off;
+  BacklightAfterOff = HAL_Linux_GPIO_GetLevel(Display_BacklightX_GPIO);
+  RunGo_ms(250);
+
+  HostTest_CheckTrue("Off button turned the lamp off", OffAfterOff == 1);
+  HostTest_CheckTrue("Backlight off", BacklightAfterOff == 0);
+  HostTest_CheckTrue("Touch turned the lamp on again", Off == 0);
+  HostTest_CheckTrue("Backlight on again", HAL_Linux_GPIO_GetLevel(Display_BacklightX_GPIO) == 1);
+}
+
+static void Test_LEDs()
+// A lamp state change reaches the LEDC.
+{
+  LampState_Change_t Change = {};
+
+  StartLamp();
+  RunGo_ms(100);
+
+  Change.ChannelMask = 1 << lcWarm;
+  Change.State.Brightnesses[lcWarm] = 1.0f;
+  LampState_Apply(&Change);
+  RunGo_ms(LED_FadeTime_ms + 100);
+
+  HostTest_Check("Warm white duty, from fully on", LED_MaxDuty - HAL_Linux_LEDC_GetDuty(LED_WarmWhite), 0);
+  HostTest_Check("Natural white duty", HAL_Linux_LEDC_GetDuty(LED_NaturalWhite), 0);
+}
+
+static void Test_Curves()
+// Each brightness table, interpolated at every position, against its curve worked out in floating point. The static_assert in the app
+// only samples them.
+{
+  static const char *pCurveNames[bcNumCurves] = { "CIE L*", "gamma 2.2", "cubic" };
+
+  for (uint8_t Curve = 0; Curve < bcNumCurves; ++Curve)
+  {
+    uint32_t NumDecreases = 0, NumDutyDecreases = 0, LastDrive = 0, LastDuty = 0, FirstDutyPosition = 0;
+    double MaxError = 0, MaxDutyError = 0;
+    char Name[64];
+
+    for (uint32_t Position = 0; Position <= LED_Position_Max; ++Position)
+    {
+      double Reference = GetCurveDrive((BrightnessCurve_t)Curve, (double)Position / LED_Position_Max);
+      uint32_t Drive = InterpolateBrightnessTable((BrightnessCurve_t)Curve, Position);
+      uint32_t Duty = ((uint64_t)Drive * (LED_MaxDuty << LED_Dither_bits) + BrightnessTable_MaxDrive / 2) / BrightnessTable_MaxDrive; // As GetLEDDuty().
+      double Error = fabs(Drive - Reference * BrightnessTable_MaxDrive), DutyError = fabs((double)Duty / (1 << LED_Dither_bits) - Reference * LED_MaxDuty);
+
+      NumDecreases += Drive < LastDrive;
+      NumDutyDecreases += Duty < LastDuty;
+      MaxError = (Error > MaxError) ? Error : MaxError;
+      MaxDutyError = (DutyError > MaxDutyError) ? DutyError : MaxDutyError;
+      if (!FirstDutyPosition && Duty)
+        FirstDutyPosition = Position;
+      LastDrive = Drive;
+      LastDuty = Duty;
+    }
+
+    snprintf(Name, sizeof(Name), "Drive decreases, %s", pCurveNames[Curve]);
+    HostTest_Check(Name, NumDecreases, 0);
+    snprintf(Name, sizeof(Name), "Duty decreases, %s", pCurveNames[Curve]);
+    HostTest_Check(Name, NumDutyDecreases, 0);
+    snprintf(Name, sizeof(Name), "Drive error, %s", pCurveNames[Curve]);
+    HostTest_Check(Name, MaxError, BrightnessTable_MaxError);
+    snprintf(Name, sizeof(Name), "Duty error, %s (steps)", pCurveNames[Curve]);
+    HostTest_Check(Name, MaxDutyError, 0.5 / (1 << LED_Dither_bits) + (double)BrightnessTable_MaxError * LED_MaxDuty / BrightnessTable_MaxDrive); // Rounding, plus the drive's error.
+    snprintf(Name, sizeof(Name), "Lowest brightness with a duty, %s", pCurveNames[Curve]);
+    HostTest_Report(Name, 100.0 * FirstDutyPosition / LED_Position_Max, "%");
+  }
+}
+
+#define Fade_MaxNumSamples 1000
+
+static uint32_t RunGoSampling_ms(uint32_t Time_ms, LED_t LED, uint32_t *pDuties, uint32_t NumSamples)
+// As RunGo_ms(), sampling the LED's duty every 1 ms, part way through any hardware ramp, after the samples already taken. Returns the
+// number taken in all.
+{
+  for (uint32_t Count = 0; Count < Time_ms / Go_Period_ms; ++Count)
+  {
+    Go_Iterate();
+    for (uint32_t Time_ms = 0; Time_ms < Go_Period_ms; ++Time_ms)
+    {
+      if (NumSamples < Fade_MaxNumSamples)
+        pDuties[NumSamples++] = HAL_Linux_LEDC_GetDuty(LED);
+      HAL_Delay_ms(1);
+    }
+  }
+  return NumSamples;
+}
+
+static double GetFadeDuty(double FromBrightness, double ToBrightness, double Fraction)
+// The fade as specified, in floating point, in LEDC steps: eased, and linear in brightness as perceived.
+{
+  double Eased = Fraction * Fraction * (3 - 2 * Fraction);
+
+  static_assert(LED_FadeEasing == feSmoothStep, "Only the smooth step easing is modelled.");
+  return GetCurveDrive(LampChannel_Curves[lcWarm], FromBrightness + (ToBrightness - FromBrightness) * Eased) * LED_MaxDuty;
+}
+
+static void CheckFade(const char *pName, const uint32_t *pDuties, uint32_t NumSamples, double FromBrightness, double ToBrightness,
+  uint32_t Time_ms, uint32_t KnotInterval_ms)
+// Samples from the start of a fade, against it as specified. Every KnotInterval_ms, where a hardware ramp ends or Go() writes the duty,
+// it should be on the fade. In between it is interpolated or held, and its furthest from the fade is reported.
+{
+  uint32_t ToDuty = (uint32_t)(GetFadeDuty(FromBrightness, ToBrightness, 1) + 0.5), EndTime_ms = NumSamples;
+  uint32_t NumReversals = 0;
+  double MaxError = 0, MaxKnotError = 0;
+  char Name[96];
+
+  for (uint32_t Index = 0; Index < NumSamples; ++Index)
+  {
+    double Error = fabs(pDuties[Index] - GetFadeDuty(FromBrightness, ToBrightness, (Index < Time_ms) ? (double)Index / Time_ms : 1));
+
+    MaxError = (Error > MaxError) ? Error : MaxError;
+    if (!(Index % KnotInterval_ms))
+      MaxKnotError = (Error > MaxKnotError) ? Error : MaxKnotError;
+    if (Index && ((ToDuty > pDuties[0]) ? (pDuties[Index] < pDuties[Index - 1]) : (pDuties[Index] > pDuties[Index - 1])))
+      ++NumReversals;
+    if ((pDuties[Index] == ToDuty) && (EndTime_ms == NumSamples))
+      EndTime_ms = Index;
+  }
+
+  snprintf(Name, sizeof(Name), "%s, reversals", pName);
+  HostTest_Check(Name, NumReversals, 0);
+  snprintf(Name, sizeof(Name), "%s, error every %lu ms (steps)", pName, (unsigned long)KnotInterval_ms);
+  HostTest_Check(Name, MaxKnotError, 1.0);
+  snprintf(Name, sizeof(Name), "%s, error in between (%% of full)", pName);
+  HostTest_Report(Name, 100.0 * MaxError / LED_MaxDuty, "%");
+  snprintf(Name, sizeof(Name), "%s, time to the end (ms)", pName);
+  HostTest_Check(Name, EndTime_ms, Time_ms);
+  HostTest_CheckMin(Name, EndTime_ms, Time_ms - Go_Period_ms);
+}
+
+static void Test_Fades()
+// The fades the LEDC is given, as it would run them, against the fades specified: whole, retargeted part way, and in software.
+{
+  static uint32_t Duties[Fade_MaxNumSamples];
+  LampState_Change_t Change = {};
+  const HAL_Linux_LEDCEvent_t *pEvents;
+  uint32_t NumSamples, NumEvents, NumRamps = 0, NumTurns = 0, MaxStep = 0, RetargetMaxStep = 0;
+  int8_t Direction = 0;
+
+  // Whole, from off to fully on, by hardware ramps:
+  StartLamp();
+  Change.ChannelMask = 1 << lcWarm;
+  LampState_Apply(&Change);
+  RunGo_ms(LED_FadeTime_ms + 100);
+  Change.State.Brightnesses[lcWarm] = 1.0f;
+  LampState_Apply(&Change);
+  HAL_Linux_LEDC_ClearEvents();
+  NumSamples = RunGoSampling_ms(LED_FadeTime_ms + 100, LED_WarmWhite, Duties, 0);
+  CheckFade("Fade, hardware", Duties, NumSamples, 0, 1, LED_FadeTime_ms, LED_FadeSegment_ms);
+  NumEvents = HAL_Linux_LEDC_GetEvents(&pEvents);
+  for (uint32_t Index = 0; Index < NumEvents; ++Index)
+    NumRamps += pEvents[Index].FadeTime_ms != 0;
+  HostTest_CheckTrue("Fade, hardware, by ramps alone", NumRamps && (NumRamps == NumEvents));
+  for (uint32_t Index = 1; Index < NumSamples; ++Index)
+    MaxStep = (Duties[Index] - Duties[Index - 1] > MaxStep) ? Duties[Index] - Duties[Index - 1] : MaxStep;
+
+  // Down again, retargeted back up half way. The ramp in progress is finished, and then the LED turns once, without a jump:
+  Change.State.Brightnesses[lcWarm] = 0.0f;
+  LampState_Apply(&Change);
+  NumSamples = RunGoSampling_ms(LED_FadeTime_ms / 2, LED_WarmWhite, Duties, 0);
+  Change.State.Brightnesses[lcWarm] = 1.0f;
+  LampState_Apply(&Change);
+  NumSamples = RunGoSampling_ms(LED_FadeTime_ms + 100, LED_WarmWhite, Duties, NumSamples);
+  for (uint32_t Index = 1; Index < NumSamples; ++Index)
+  {
+    int32_t Step = Duties[Index] - Duties[Index - 1];
+
+    if (Step && (Direction != ((Step > 0) ? 1 : -1)))
+    {
+      NumTurns += Direction != 0;
+      Direction = (Step > 0) ? 1 : -1;
+    }
+    RetargetMaxStep = ((uint32_t)abs(Step) > RetargetMaxStep) ? abs(Step) : RetargetMaxStep;
+  }
+  HostTest_CheckTrue("Fade, retargeted, turns once", NumTurns == 1);
+  HostTest_Check("Fade, retargeted, duty at the end", LED_MaxDuty - Duties[NumSamples - 1], 0);
+  HostTest_Check("Fade, retargeted, largest step in 1 ms, over the whole fade's", (double)RetargetMaxStep / MaxStep, 2.0); // Over half the time.
+
+  // In software, when the hardware fade is not available:
+  HAL_Linux_LEDC_SetFadeAvailable(0);
+  InitializeLEDControl(); // Again, now without it.
+  Change.State.Brightnesses[lcWarm] = 0.0f;
+  LampState_Apply(&Change);
+  RunGo_ms(LED_FadeTime_ms + 100);
+  Change.State.Brightnesses[lcWarm] = 1.0f;
+  LampState_Apply(&Change);
+  HAL_Linux_LEDC_ClearEvents();
+  NumSamples = RunGoSampling_ms(LED_FadeTime_ms + 100, LED_WarmWhite, Duties, 0);
+  CheckFade("Fade, software", Duties, NumSamples, 0, 1, LED_FadeTime_ms, Go_Period_ms);
+  NumRamps = 0;
+  NumEvents = HAL_Linux_LEDC_GetEvents(&pEvents);
+  for (uint32_t Index = 0; Index < NumEvents; ++Index)
+    NumRamps += pEvents[Index].FadeTime_ms != 0;
+  HostTest_Check("Fade, software, hardware ramps", NumRamps, 0);
+  HostTest_Check("Fade, software, duty writes", NumEvents, LED_FadeTime_ms / Go_Period_ms + 1); // One each time round Go(), at most.
+  HAL_Linux_LEDC_SetFadeAvailable(1);
+}
+
+static void Test_Idle()
+// The LEDC is only written when a duty is to change: not at all while the lamp is idle, and only for the channels a change touches.
+{
+  LampState_Change_t Change = {};
+  uint32_t NumUpdates, NumDutyWrites, NumFadeRamps, NumEvents, NumOtherEvents = 0;
+  const HAL_Linux_LEDCEvent_t *pEvents;
+
+  StartLamp();
+  Change.ChannelMask = (1 << lcWarm) | (1 << lcNatural) | (1 << lcRed) | (1 << lcGreen) | (1 << lcBlue);
+  Change.State.Brightnesses[lcWarm] = 0.7f;
+  Change.State.Brightnesses[lcNatural] = 0.4f;
+  Change.State.Brightnesses[lcRed] = 0.3f;
+  Change.State.Brightnesses[lcGreen] = 0.5f;
+  Change.State.Brightnesses[lcBlue] = 0.9f;
+  LampState_Apply(&Change);
+  RunGo_ms(LED_FadeTime_ms + 100);
+
+  // Idle, and then the same state applied again:
+  NumUpdates = LED_NumUpdates;
+  NumDutyWrites = LED_NumDutyWrites;
+  NumFadeRamps = LED_NumFadeRamps;
+  HAL_Linux_LEDC_ClearEvents();
+  RunGo_ms(1000);
+  LampState_Apply(&Change);
+  RunGo_ms(1000);
+  NumEvents = HAL_Linux_LEDC_GetEvents(&pEvents);
+  HostTest_Check("LEDC writes in 2 s idle", NumEvents, 0);
+  HostTest_Check("Duty writes counted in 2 s idle", LED_NumDutyWrites - NumDutyWrites, 0);
+  HostTest_Check("Fade ramps counted in 2 s idle", LED_NumFadeRamps - NumFadeRamps, 0);
+  HostTest_Check("Lamp state changes shown in 2 s idle", LED_NumUpdates - NumUpdates, 0);
+
+  // One channel changed:
+  Change.ChannelMask = 1 << lcRed;
+  Change.State.Brightnesses[lcRed] = 0.6f;
+  LampState_Apply(&Change);
+  RunGo_ms(LED_FadeTime_ms + 100);
+  NumEvents = HAL_Linux_LEDC_GetEvents(&pEvents);
+  for (uint32_t Index = 0; Index < NumEvents; ++Index)
+    NumOtherEvents += pEvents[Index].Channel != LED_Red;
+  HostTest_CheckMin("LEDC writes for a red change", NumEvents, 1);
+  HostTest_Check("LEDC writes for a red change, to other channels", NumOtherEvents, 0);
+  HostTest_Check("LEDC writes for a red change, at most a ramp per fade segment", NumEvents, (LED_FadeTime_ms + LED_FadeSegment_ms - 1) / LED_FadeSegment_ms);
+}
+
+static double GetAverageDuty(uint8_t Channel, int64_t StartTime_us, uint32_t StartDuty, int64_t EndTime_us)
+// A model of the light: the duty written to the LEDC, on average over the time, from its log. Only duties written, not fades.
+{
+  const HAL_Linux_LEDCEvent_t *pEvents;
+  uint32_t NumEvents = HAL_Linux_LEDC_GetEvents(&pEvents);
+  uint32_t Duty = StartDuty;
+  int64_t Time_us = StartTime_us;
+  double Total = 0;
+
+  for (uint32_t Index = 0; Index < NumEvents; ++Index)
+    if (pEvents[Index].Channel == Channel)
+    {
+      Total += (double)Duty * (pEvents[Index].Time_us - Time_us);
+      Duty = pEvents[Index].Duty;
+      Time_us = pEvents[Index].Time_us;
+    }
+  Total += (double)Duty * (EndTime_us - Time_us);
+  return Total / (EndTime_us - StartTime_us);
+}
+
+static void Test_Dither()
+// Dithered, each LED's duty averages to its fractional one. Only the bottom of the range is dithered, so a constant state above it
+// writes nothing, and fades there still use the hardware. The HAL stops the test if the LEDC is called with LED_DitherLock held.
+{
+  static const float Brightnesses[] = { 0.05f, 0.1f, 0.13f, 0.15f, 0.18f, 0.2f }; // Duties from 0.5 to 33 steps, through the curve.
+  LampState_Change_t Change = {};
+  double MaxError = 0, MaxUnditheredError = 0, StartTime_s;
+  uint32_t NumDithered = 0, NumEvents, NumRamps;
+  const HAL_Linux_LEDCEvent_t *pEvents;
+
+  StartLamp();
+  RunGo_ms(100);
+  LED_SetDithering(1);
+
+  Change.ChannelMask = 1 << lcWarm;
+  for (uint8_t Index = 0; Index < sizeof(Brightnesses) / sizeof(Brightnesses[0]); ++Index)
+  {
+    double Target, Error;
+    int64_t StartTime_us;
+    uint32_t StartDuty;
+
+    Change.State.Brightnesses[lcWarm] = Brightnesses[Index];
+    LampState_Apply(&Change);
+    RunGo_ms(LED_FadeTime_ms + 100);
+
+    Target = (double)LED_Duties[LED_WarmWhite] / (1 << LED_Dither_bits);
+    NumDithered += LED_Dithered[LED_WarmWhite];
+    StartTime_us = HAL_GetTime_us();
+    StartDuty = HAL_Linux_LEDC_GetDuty(LED_WarmWhite);
+    HAL_Linux_LEDC_ClearEvents();
+    RunGo_ms(100);
+
+    Error = fabs(GetAverageDuty(LED_WarmWhite, StartTime_us, StartDuty, HAL_GetTime_us()) - Target);
+    MaxError = (Error > MaxError) ? Error : MaxError;
+    Error = fabs(round(Target) - Target);
+    MaxUnditheredError = (Error > MaxUnditheredError) ? Error : MaxUnditheredError;
+  }
+  HostTest_CheckTrue("Dithered below LED_DitherMaxDuty only", NumDithered == sizeof(Brightnesses) / sizeof(Brightnesses[0]) - 1); // All but the last.
+  HostTest_Report("Duty error, not dithered (steps)", MaxUnditheredError, "");
+  HostTest_Check("Duty error, dithered and averaged over 100 ms (steps)", MaxError, 0.01);
+
+  // Above the bottom of the range, a constant state writes nothing, and a fade is run by the hardware:
+  LampCommand_Night();
+  RunGo_ms(LED_FadeTime_ms + 100);
+  HAL_Linux_LEDC_ClearEvents();
+  RunGo_ms(1000);
+  NumEvents = HAL_Linux_LEDC_GetEvents(&pEvents);
+  HostTest_Check("LEDC writes in 1 s of the Night preset, dithering on", NumEvents, 0);
+  NumRamps = LED_NumFadeRamps;
+  LampCommand_Bright();
+  RunGo_ms(LED_FadeTime_ms + 100);
+  HostTest_CheckMin("Hardware ramps fading to Bright, dithering on", LED_NumFadeRamps - NumRamps, 1);
+
+  // Turned off, the LEDs are handed back:
+  LED_SetDithering(0);
+  LampCommand_Night();
+  RunGo_ms(100);
+  NumDithered = 0;
+  for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+    NumDithered += LED_Dithered[LED] + LED_DitherReleases[LED];
+  HostTest_Check("LEDs dithered, or still to be given back, once dithering is off", NumDithered, 0);
+
+  // The tick's cost, with every LED dithered:
+  for (uint8_t LED = 0; LED < LED_NumLEDs; ++LED)
+  {
+    LED_Dithered[LED] = 1;
+    LED_DitherDuties[LED] = 7;
+  }
+  StartTime_s = HostTest_GetTime_s();
+  for (uint32_t Count = 0; Count < 100000; ++Count)
+    LED_DitherTick(NULL);
+  HostTest_Report("Dither tick, all LEDs dithered (host)", (HostTest_GetTime_s() - StartTime_s) * 1e9 / 100000, "ns");
+}
+
+static void Test_Palette()
+// A frame with more colors than the compositor's palette holds is shown exactly, and what was drawn directly is redrawn when drawn over.
+{
+  const uint16_t TextColor = 0xFFE1, TextBackgroundColor = 0x07FF, Top = 100;
+  ILI9341_CompositorStatistics_t Statistics;
+  uint32_t NumExactBarPixels = 0, NumOtherTextPixels = 0;
+
+  StartLamp();
+  RunGo_ms(100);
+  ILI9341_Clear(ILI9341_COLOR_BLACK);
+  ILI9341_Compositor_ResetStatistics();
+
+  // 15 bars fill the palette with black, so the text's colors do not fit:
+  ILI9341_Compositor_BeginFrame();
+  for (uint16_t Bar = 0; Bar < 15; ++Bar)
+    ILI9341_DrawBar(Bar * 16, Top, 16, 40, ((2 * Bar) << 11) | ((4 * Bar + 1) << 5) | (31 - Bar));
+  ILI9341_SetTextColor(TextColor);
+  ILI9341_SetTextBackgroundColor(TextBackgroundColor);
+  ILI9341_DrawTextAtXY("Palette", 10, Top + 100, tpLeft);
+  ILI9341_Compositor_EndFrame();
+
+  for (uint16_t Bar = 0; Bar < 15; ++Bar)
+    NumExactBarPixels += CountPixels(Bar * 16, Top, 16, 40, ((2 * Bar) << 11) | ((4 * Bar + 1) << 5) | (31 - Bar));
+  for (uint16_t Y = Top + 40; Y < ILI9341_Height; ++Y)
+    for (uint16_t X = 0; X < ILI9341_Width; ++X)
+      NumOtherTextPixels += (HAL_Linux_Framebuffer[Y][X] != ILI9341_COLOR_BLACK) && (HAL_Linux_Framebuffer[Y][X] != TextColor) &&
+        (HAL_Linux_Framebuffer[Y][X] != TextBackgroundColor);
+  ILI9341_Compositor_GetStatistics(&Statistics);
+
+  HostTest_Check("Bar pixels not in their exact colors", 15 * 16 * 40 - NumExactBarPixels, 0);
+  HostTest_CheckMin("Text pixels", CountPixels(0, Top + 40, ILI9341_Width, ILI9341_Height - Top - 40, TextColor), 50);
+  HostTest_Check("Text area pixels in none of the text's colors or black", NumOtherTextPixels, 0);
+  HostTest_CheckMin("Primitives drawn directly", Statistics.NumDirectPrimitives, 1);
+
+  // Clearing what was drawn directly to black, which the shadow may already have, is sent:
+  ILI9341_DrawBar(0, Top, ILI9341_Width, ILI9341_Height - Top, ILI9341_COLOR_BLACK);
+  HostTest_Check("Pixels not cleared", ILI9341_Width * (ILI9341_Height - Top) - CountPixels(0, Top, ILI9341_Width, ILI9341_Height - Top,
+    ILI9341_COLOR_BLACK), 0);
+
+  // And once cleared, it is composited again:
+  ILI9341_Compositor_ResetStatistics();
+  ILI9341_DrawBar(0, Top, ILI9341_Width, ILI9341_Height - Top, ILI9341_COLOR_BLACK);
+  ILI9341_Compositor_GetStatistics(&Statistics);
+  HostTest_Check("Pixels sent for an unchanged bar", Statistics.NumPixelsFlushed, 0);
+}
+
+static void Test_Allocations()
+// DrawScreen() in each mode, once the glyph cache has the screen's glyphs, does not use the heap.
+{
+  const Mode_t Modes[] = { mdNone, mdWhites, mdColor };
+  HAL_Linux_MemoryStatistics_t MemoryStatistics;
+  uint32_t NumHeapAllocations = HostTest_GetNumHeapAllocations(), NumMemoryAllocations;
+
+  StartLamp();
+  RunGo_ms(100);
+  for (uint8_t Index = 0; Index < sizeof(Modes) / sizeof(Modes[0]); ++Index)
+  {
+    Mode = Modes[Index];
+    DrawScreen(); // Fills the glyph cache.
+  }
+  HostTest_CheckMin("Heap allocations in starting, as counted", HostTest_GetNumHeapAllocations() - NumHeapAllocations, 1);
+
+  HAL_Linux_GetMemoryStatistics(&MemoryStatistics);
+  NumMemoryAllocations = MemoryStatistics.NumAllocations;
+  NumHeapAllocations = HostTest_GetNumHeapAllocations();
+  for (uint8_t Index = 0; Index < sizeof(Modes) / sizeof(Modes[0]); ++Index)
+  {
+    Mode = Modes[Index];
+    ILI9341_Compositor_Invalidate(); // So that all of it is sent again.
+    DrawScreen();
+  }
+  HAL_Linux_GetMemoryStatistics(&MemoryStatistics);
+
+  HostTest_Check("Heap allocations in DrawScreen()", HostTest_GetNumHeapAllocations() - NumHeapAllocations, 0);
+  HostTest_Check("HAL_Memory_Allocate() calls in DrawScreen()", MemoryStatistics.NumAllocations - NumMemoryAllocations, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static const HostTest_Test_t Tests[] =
+{
+  { "Display", Test_Display },
+  { "Touch", Test_Touch },
+  { "LEDs", Test_LEDs },
+  { "Curves", Test_Curves },
+  { "Fades", Test_Fades },
+  { "Idle", Test_Idle },
+  { "Dither", Test_Dither },
+  { "Palette", Test_Palette },
+  { "Allocations", Test_Allocations }
+};
+
+int main(int argc, char **argv)
+{
+  return HostTest_Main(argc, argv, Tests, sizeof(Tests) / sizeof(Tests[0]));
+}
+
+///////////////////////////////////////////////////////////////////////////////
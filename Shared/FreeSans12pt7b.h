@@ -270,7 +270,8 @@ static const GFXfont FreeSans12pt7b =
   (uint8_t  *)FreeSans12pt7bBitmaps,
   (GFXglyph *)FreeSans12pt7bGlyphs,
   0x20, 0x7E, 29,
-  -17, 6 // JSB added.
+  -17, 6, // JSB added.
+  gffBitmap // JSB added.
 };
 
 // Approx. 2641 bytes
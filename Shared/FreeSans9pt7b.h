@@ -201,7 +201,8 @@ static const GFXfont FreeSans9pt7b =
   (uint8_t  *)FreeSans9pt7bBitmaps,
   (GFXglyph *)FreeSans9pt7bGlyphs,
   0x20, 0x7E, 22,
-  -12, 5 // JSB added.
+  -12, 5, // JSB added.
+  gffBitmap // JSB added.
 };
 
 // Approx. 1822 bytes
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Hardware abstraction layer:
+//
+// => The Shared drivers and the app's LED control only access the hardware through these functions.
+// => A backend implements them, and provides the types in its own header: JSB_HAL_ESP32.c / JSB_HAL_ESP32.h for esp-idf, and
+//    JSB_HAL_Linux.c / JSB_HAL_Linux.h, selected by defining JSB_HAL_Linux, which simulates the hardware on a host.
+// => A backend's HAL_SPI_Transaction_t provides the esp-idf spi_transaction_t fields that the drivers use:
+//    flags (HAL_SPI_TRANS_USE_TXDATA), length and rxlength (in bits), tx_buffer, tx_data, rx_buffer and user.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_HAL_H
+#define __JSB_HAL_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>
+//
+#ifdef JSB_HAL_Linux
+#include "JSB_HAL_Linux.h"
+#else
+#include "JSB_HAL_ESP32.h"
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  uint32_t ClockSpeed_Hz;
+  uint8_t Mode; // SPI mode.
+  int CSX_GPIO;
+  uint8_t QueueSize; // Transactions that may be queued at once.
+  uint8_t HalfDuplex;
+  HAL_SPI_Callback_t PreTransferCallback; // May be NULL. May be called from an ISR.
+  HAL_SPI_Callback_t PostTransferCallback; // May be NULL. May be called from an ISR.
+} HAL_SPI_DeviceConfiguration_t;
+
+// Time:
+int64_t HAL_GetTime_us();
+void HAL_Delay_ms(uint32_t Delay_ms);
+void HAL_StartPeriodicTimer(void (*pCallback)(void *pArgument), void *pArgument, uint32_t Period_us); // pCallback is called from a task above every application task. It must be brief.
+
+// Memory:
+void *HAL_Memory_Allocate(size_t NumBytes, uint8_t DMACapable);
+void HAL_Memory_Free(void *pMemory);
+
+// GPIO:
+void HAL_GPIO_SetOutput(int GPIO);
+void HAL_GPIO_SetLevel(int GPIO, uint32_t Level);
+
+// SPI:
+void HAL_SPI_InitializeBus(HAL_SPI_Host_t Host, int MOSI_GPIO, int MISO_GPIO, int SCK_GPIO, int DMAChannel);
+void HAL_SPI_AddDevice(HAL_SPI_Host_t Host, const HAL_SPI_DeviceConfiguration_t *pConfiguration, HAL_SPI_Device_t *pDevice);
+void HAL_SPI_AcquireBus(HAL_SPI_Device_t Device);
+void HAL_SPI_ReleaseBus(HAL_SPI_Device_t Device);
+void HAL_SPI_Transmit(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction); // Waits until the transfer is complete.
+void HAL_SPI_QueueTransaction(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction); // *pTransaction must persist until its result has been collected.
+void HAL_SPI_CollectTransactionResult(HAL_SPI_Device_t Device); // Waits for the oldest queued transaction to complete.
+
+// LEDC (PWM):
+void HAL_LEDC_InitializeTimer(uint32_t Frequency_Hz, uint8_t Resolution_bits);
+void HAL_LEDC_InitializeChannel(uint8_t Channel, int GPIO);
+void HAL_LEDC_SetDuty(uint8_t Channel, uint32_t Duty); // Waits for any fade on the channel to end.
+uint8_t HAL_LEDC_InstallFade(uint8_t NumChannels); // For channels [0, NumChannels). Returns 0 if fades are not available.
+void HAL_LEDC_StartFade(uint8_t Channel, uint32_t Duty, uint32_t Time_ms); // Linear in duty, from the current duty. Returns at once. Cannot be stopped.
+uint8_t HAL_LEDC_IsFading(uint8_t Channel);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Hardware abstraction layer: esp-idf backend.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+//
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "driver/spi_master.h"
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+//
+#include "JSB_HAL.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define LEDC_SpeedMode LEDC_HIGH_SPEED_MODE
+#define LEDC_Timer LEDC_TIMER_0
+
+///////////////////////////////////////////////////////////////////////////////
+
+static volatile uint8_t LEDC_Fading[LEDC_CHANNEL_MAX]; // Set when a fade is started, and cleared by LEDC_FadeEnded().
+
+///////////////////////////////////////////////////////////////////////////////
+// Time:
+
+int64_t HAL_GetTime_us()
+{
+  return esp_timer_get_time();
+}
+
+void HAL_Delay_ms(uint32_t Delay_ms)
+{
+  vTaskDelay(Delay_ms / portTICK_PERIOD_MS);
+}
+
+void HAL_StartPeriodicTimer(void (*pCallback)(void *pArgument), void *pArgument, uint32_t Period_us)
+{
+  esp_timer_create_args_t Arguments;
+  esp_timer_handle_t Timer;
+
+  memset(&Arguments, 0, sizeof(Arguments));
+  Arguments.callback = pCallback;
+  Arguments.arg = pArgument;
+  Arguments.dispatch_method = ESP_TIMER_TASK;
+  Arguments.name = "HAL";
+  Arguments.skip_unhandled_events = true; // A late call is not followed by a burst of catch up calls.
+  ESP_ERROR_CHECK(esp_timer_create(&Arguments, &Timer));
+  ESP_ERROR_CHECK(esp_timer_start_periodic(Timer, Period_us));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory:
+
+void *HAL_Memory_Allocate(size_t NumBytes, uint8_t DMACapable)
+// Returns NULL on failure.
+{
+  return heap_caps_malloc(NumBytes, DMACapable ? MALLOC_CAP_DMA : MALLOC_CAP_8BIT);
+}
+
+void HAL_Memory_Free(void *pMemory)
+{
+  heap_caps_free(pMemory);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GPIO:
+
+void HAL_GPIO_SetOutput(int GPIO)
+{
+  gpio_set_direction(GPIO, GPIO_MODE_OUTPUT);
+}
+
+void HAL_GPIO_SetLevel(int GPIO, uint32_t Level)
+{
+  gpio_set_level(GPIO, Level);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SPI:
+
+void HAL_SPI_InitializeBus(HAL_SPI_Host_t Host, int MOSI_GPIO, int MISO_GPIO, int SCK_GPIO, int DMAChannel)
+{
+  esp_err_t ret;
+  spi_bus_config_t BusConfiguration;
+
+  memset(&BusConfiguration, 0, sizeof(BusConfiguration));
+  BusConfiguration.mosi_io_num = MOSI_GPIO;
+  BusConfiguration.miso_io_num = MISO_GPIO;
+  BusConfiguration.sclk_io_num = SCK_GPIO;
+  BusConfiguration.quadwp_io_num = -1;
+  BusConfiguration.quadhd_io_num = -1;
+  BusConfiguration.data4_io_num = -1;
+  BusConfiguration.data5_io_num = -1;
+  BusConfiguration.data6_io_num = -1;
+  BusConfiguration.data7_io_num = -1;
+  BusConfiguration.isr_cpu_id = ESP_INTR_CPU_AFFINITY_AUTO;
+
+  ret = spi_bus_initialize(Host, &BusConfiguration, DMAChannel);
+  assert(ret==ESP_OK);
+}
+
+void HAL_SPI_AddDevice(HAL_SPI_Host_t Host, const HAL_SPI_DeviceConfiguration_t *pConfiguration, HAL_SPI_Device_t *pDevice)
+{
+  esp_err_t ret;
+  spi_device_interface_config_t DeviceConfiguration;
+
+  memset(&DeviceConfiguration, 0, sizeof(DeviceConfiguration));
+  DeviceConfiguration.clock_speed_hz = pConfiguration->ClockSpeed_Hz;
+  DeviceConfiguration.mode = pConfiguration->Mode;
+  DeviceConfiguration.spics_io_num = pConfiguration->CSX_GPIO;
+  DeviceConfiguration.queue_size = pConfiguration->QueueSize;
+  DeviceConfiguration.pre_cb = pConfiguration->PreTransferCallback;
+  DeviceConfiguration.post_cb = pConfiguration->PostTransferCallback;
+  DeviceConfiguration.flags = pConfiguration->HalfDuplex ? SPI_DEVICE_HALFDUPLEX : 0;
+
+  ret = spi_bus_add_device(Host, &DeviceConfiguration, pDevice);
+  assert(ret==ESP_OK);
+}
+
+void HAL_SPI_AcquireBus(HAL_SPI_Device_t Device)
+{
+  ESP_ERROR_CHECK(spi_device_acquire_bus(Device, portMAX_DELAY));
+}
+
+void HAL_SPI_ReleaseBus(HAL_SPI_Device_t Device)
+{
+  spi_device_release_bus(Device);
+}
+
+void HAL_SPI_Transmit(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction)
+{
+  esp_err_t ret;
+
+  ret = spi_device_polling_transmit(Device, pTransaction); // JSB 20240709: Was spi_device_transmit()
+  assert(ret==ESP_OK);
+}
+
+void HAL_SPI_QueueTransaction(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction)
+{
+  esp_err_t ret;
+
+  ret = spi_device_queue_trans(Device, pTransaction, portMAX_DELAY);
+  assert(ret==ESP_OK);
+}
+
+void HAL_SPI_CollectTransactionResult(HAL_SPI_Device_t Device)
+{
+  spi_transaction_t *pTransaction;
+  esp_err_t ret;
+
+  ret = spi_device_get_trans_result(Device, &pTransaction, portMAX_DELAY);
+  assert(ret==ESP_OK);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LEDC (PWM):
+
+void HAL_LEDC_InitializeTimer(uint32_t Frequency_Hz, uint8_t Resolution_bits)
+{
+  ledc_timer_config_t TimerConfiguration;
+
+  memset(&TimerConfiguration, 0, sizeof(TimerConfiguration));
+  TimerConfiguration.duty_resolution = (ledc_timer_bit_t)Resolution_bits;
+  TimerConfiguration.freq_hz = Frequency_Hz;
+  TimerConfiguration.speed_mode = LEDC_SpeedMode;
+  TimerConfiguration.timer_num = LEDC_Timer;
+  TimerConfiguration.clk_cfg = LEDC_USE_APB_CLK;
+  ESP_ERROR_CHECK(ledc_timer_config(&TimerConfiguration));
+}
+
+void HAL_LEDC_InitializeChannel(uint8_t Channel, int GPIO)
+{
+  ledc_channel_config_t ChannelConfiguration;
+
+  memset(&ChannelConfiguration, 0, sizeof(ChannelConfiguration));
+  ChannelConfiguration.channel = (ledc_channel_t)Channel;
+  ChannelConfiguration.duty = 0;
+  ChannelConfiguration.gpio_num = GPIO;
+  ChannelConfiguration.intr_type = LEDC_INTR_DISABLE;
+  ChannelConfiguration.speed_mode = LEDC_SpeedMode;
+  ChannelConfiguration.timer_sel = LEDC_Timer;
+  ledc_channel_config(&ChannelConfiguration);
+}
+
+void HAL_LEDC_SetDuty(uint8_t Channel, uint32_t Duty)
+{
+  ledc_set_duty(LEDC_SpeedMode, (ledc_channel_t)Channel, Duty);
+  ledc_update_duty(LEDC_SpeedMode, (ledc_channel_t)Channel);
+}
+
+static bool LEDC_FadeEnded(const ledc_cb_param_t *pParameter, void *pArgument)
+// From the LEDC interrupt.
+{
+  if (pParameter->event == LEDC_FADE_END_EVT)
+    LEDC_Fading[pParameter->channel] = 0;
+  return false; // No task woken.
+}
+
+uint8_t HAL_LEDC_InstallFade(uint8_t NumChannels)
+{
+  ledc_cbs_t Callbacks = { .fade_cb = LEDC_FadeEnded };
+
+  if (ledc_fade_func_install(0) != ESP_OK)
+    return 0;
+
+  for (uint8_t Channel = 0; Channel < NumChannels; ++Channel)
+    if (ledc_cb_register(LEDC_SpeedMode, (ledc_channel_t)Channel, &Callbacks, NULL) != ESP_OK)
+      return 0;
+  return 1;
+}
+
+void HAL_LEDC_StartFade(uint8_t Channel, uint32_t Duty, uint32_t Time_ms)
+{
+  LEDC_Fading[Channel] = 1;
+  if ((ledc_set_fade_with_time(LEDC_SpeedMode, (ledc_channel_t)Channel, Duty, Time_ms) != ESP_OK) ||
+      (ledc_fade_start(LEDC_SpeedMode, (ledc_channel_t)Channel, LEDC_FADE_NO_WAIT) != ESP_OK))
+  {
+    LEDC_Fading[Channel] = 0;
+    HAL_LEDC_SetDuty(Channel, Duty);
+  }
+}
+
+uint8_t HAL_LEDC_IsFading(uint8_t Channel)
+{
+  return LEDC_Fading[Channel];
+}
+
+///////////////////////////////////////////////////////////////////////////////
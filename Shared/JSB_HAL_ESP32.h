@@ -0,0 +1,28 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Hardware abstraction layer: esp-idf backend types. Include JSB_HAL.h rather than this.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_HAL_ESP32_H
+#define __JSB_HAL_ESP32_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include "driver/spi_master.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef spi_host_device_t HAL_SPI_Host_t;
+typedef spi_device_handle_t HAL_SPI_Device_t;
+typedef spi_transaction_t HAL_SPI_Transaction_t;
+typedef transaction_cb_t HAL_SPI_Callback_t;
+
+#define HAL_SPI_TRANS_USE_TXDATA SPI_TRANS_USE_TXDATA
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
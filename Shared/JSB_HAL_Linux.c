@@ -0,0 +1,654 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Hardware abstraction layer: Linux backend.
+//
+// => Simulates the lamp's hardware, so that the Shared drivers and the app can be run and measured on a host (see Host/CMakeLists.txt).
+// => See JSB_HAL_Linux.h for what is simulated, and how tests drive and inspect it.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+//
+#include "JSB_HAL.h"
+#include "JSB_HostPlatform.h" // For the critical sections held.
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define GPIO_NumGPIOs 40
+#define SPI_MaxNumDevices 4
+#define SPI_MaxQueueSize 64
+#define Timer_MaxNumTimers 4
+
+// ILI9341 commands:
+#define ILI9341_CASET 0x2A
+#define ILI9341_PASET 0x2B
+#define ILI9341_RAMWR 0x2C
+#define ILI9341_WRITE_MEM_CONTINUE 0x3C
+
+// XPT2046 channels, from bits 6-4 of the control byte:
+#define XPT2046_Channel_Y 1
+#define XPT2046_Channel_Z1 3
+#define XPT2046_Channel_Z2 4
+#define XPT2046_Channel_X 5
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef enum
+{
+  drNone,
+  drDisplay,
+  drTouchPanel
+} DeviceRole_t;
+
+struct HAL_Linux_SPI_Device_s
+{
+  HAL_SPI_DeviceConfiguration_t Configuration;
+  DeviceRole_t Role;
+  HAL_SPI_Transaction_t *pQueue[SPI_MaxQueueSize]; // Completed, and waiting to be collected, oldest first.
+  uint32_t QueueNumTransactions;
+  uint64_t ClockRemainder; // Of the bits' time, in 1 / ClockSpeed_Hz us, short of a whole us. See HAL_Linux_SetSPITimed().
+};
+
+typedef struct
+{
+  void (*pCallback)(void *pArgument);
+  void *pArgument;
+  uint32_t Period_us;
+  int64_t NextTime_us;
+} Timer_t;
+
+typedef struct
+{
+  uint32_t Duty; // At the start of any fade.
+  uint32_t FadeDuty; // At its end.
+  int64_t FadeStartTime_us, FadeEndTime_us; // Equal => not fading.
+} LEDCChannel_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static pthread_mutex_t Time_Lock = PTHREAD_MUTEX_INITIALIZER; // Servers run in threads of their own, and read the time.
+static int64_t Time_us = 0;
+static Timer_t Timers[Timer_MaxNumTimers];
+static uint8_t NumTimers = 0;
+
+static HAL_Linux_MemoryStatistics_t MemoryStatistics;
+static uint32_t MemoryLimit = 0;
+
+static uint32_t GPIO_Levels[GPIO_NumGPIOs];
+
+static struct HAL_Linux_SPI_Device_s SPI_Devices[SPI_MaxNumDevices];
+static uint8_t SPI_NumDevices = 0;
+static HAL_Linux_SPIStatistics_t SPI_Statistics;
+static HAL_Linux_SPIRecord_t *pSPI_Records = NULL;
+static uint32_t SPI_NumRecords = 0;
+static uint8_t SPI_Timed = 0;
+
+static int Display_CSX_GPIO = -1, Display_D_CX_GPIO = -1;
+static uint8_t Display_Command = 0;
+static uint8_t Display_Arguments[4];
+static uint8_t Display_NumArguments = 0;
+static uint16_t Display_Left = 0, Display_Right = HAL_Linux_Display_Width - 1;
+static uint16_t Display_Top = 0, Display_Bottom = HAL_Linux_Display_Height - 1;
+static uint16_t Display_X = 0, Display_Y = 0;
+static int16_t Display_PixelHighByte = -1; // -1 => none yet.
+uint16_t HAL_Linux_Framebuffer[HAL_Linux_Display_Height][HAL_Linux_Display_Width];
+
+static int TouchPanel_CSX_GPIO = -1;
+static const HAL_Linux_TouchSample_t *pTouchScript = NULL;
+static uint32_t TouchScript_NumSamples = 0;
+
+static LEDCChannel_t LEDC_Channels[HAL_Linux_LEDC_NumChannels];
+static HAL_Linux_LEDCEvent_t *pLEDC_Events = NULL;
+static uint32_t LEDC_NumEvents = 0, LEDC_MaxNumEvents = 0;
+static uint8_t LEDC_FadeAvailable = 1;
+static uint8_t LEDC_FadeInstalled = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Fail(const char *pMessage)
+// A driver has used the HAL in a way that the hardware would not allow.
+{
+  fprintf(stderr, "JSB_HAL_Linux: %s\n", pMessage);
+  abort();
+}
+
+static void FailIfCritical(const char *pMessage)
+// Calls that may block on the ESP32 must not be made in a critical section.
+{
+  if (HostPlatform_GetNumCriticalSections())
+    Fail(pMessage);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Time:
+
+int64_t HAL_GetTime_us()
+{
+  int64_t Result;
+
+  pthread_mutex_lock(&Time_Lock);
+  Result = Time_us;
+  pthread_mutex_unlock(&Time_Lock);
+  return Result;
+}
+
+void HAL_Linux_AdvanceTime_us(int64_t Delay_us)
+// Timers due within the delay are called in time order, with the time set to when each is due.
+{
+  int64_t EndTime_us = HAL_GetTime_us() + Delay_us;
+
+  while (1)
+  {
+    Timer_t *pTimer = NULL;
+
+    for (uint8_t Index = 0; Index < NumTimers; ++Index)
+      if ((Timers[Index].NextTime_us <= EndTime_us) && (!pTimer || (Timers[Index].NextTime_us < pTimer->NextTime_us)))
+        pTimer = &Timers[Index];
+
+    if (!pTimer)
+      break;
+
+    pthread_mutex_lock(&Time_Lock);
+    Time_us = pTimer->NextTime_us;
+    pthread_mutex_unlock(&Time_Lock);
+
+    pTimer->NextTime_us += pTimer->Period_us;
+    pTimer->pCallback(pTimer->pArgument);
+  }
+
+  pthread_mutex_lock(&Time_Lock);
+  Time_us = EndTime_us;
+  pthread_mutex_unlock(&Time_Lock);
+}
+
+void HAL_Delay_ms(uint32_t Delay_ms)
+{
+  FailIfCritical("Delay in a critical section");
+  HAL_Linux_AdvanceTime_us(Delay_ms * 1000LL);
+}
+
+void HAL_StartPeriodicTimer(void (*pCallback)(void *pArgument), void *pArgument, uint32_t Period_us)
+{
+  Timer_t *pTimer;
+
+  if (NumTimers == Timer_MaxNumTimers)
+    Fail("Too many timers");
+
+  pTimer = &Timers[NumTimers++];
+  pTimer->pCallback = pCallback;
+  pTimer->pArgument = pArgument;
+  pTimer->Period_us = Period_us;
+  pTimer->NextTime_us = HAL_GetTime_us() + Period_us;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory:
+
+void *HAL_Memory_Allocate(size_t NumBytes, uint8_t DMACapable)
+// Returns NULL on failure.
+{
+  void *pMemory;
+
+  if (MemoryLimit && (MemoryStatistics.NumBytesAllocated + NumBytes > MemoryLimit))
+    return NULL;
+
+  pMemory = malloc(NumBytes);
+  if (!pMemory)
+    return NULL;
+
+  ++MemoryStatistics.NumAllocations;
+  MemoryStatistics.NumBytesAllocated += NumBytes;
+  return pMemory;
+}
+
+void HAL_Memory_Free(void *pMemory)
+{
+  if (!pMemory)
+    return;
+
+  ++MemoryStatistics.NumFrees;
+  free(pMemory);
+}
+
+void HAL_Linux_GetMemoryStatistics(HAL_Linux_MemoryStatistics_t *pStatistics)
+{
+  *pStatistics = MemoryStatistics;
+}
+
+void HAL_Linux_SetMemoryLimit(uint32_t NumBytes)
+{
+  MemoryLimit = NumBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GPIO:
+
+void HAL_GPIO_SetOutput(int GPIO)
+{
+  if ((GPIO < 0) || (GPIO >= GPIO_NumGPIOs))
+    Fail("No such GPIO");
+}
+
+void HAL_GPIO_SetLevel(int GPIO, uint32_t Level)
+{
+  if ((GPIO < 0) || (GPIO >= GPIO_NumGPIOs))
+    Fail("No such GPIO");
+
+  GPIO_Levels[GPIO] = Level != 0;
+}
+
+uint32_t HAL_Linux_GPIO_GetLevel(int GPIO)
+{
+  return ((GPIO >= 0) && (GPIO < GPIO_NumGPIOs)) ? GPIO_Levels[GPIO] : 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Display:
+
+static void Display_WritePixel(uint16_t Color)
+{
+  if ((Display_X < HAL_Linux_Display_Width) && (Display_Y < HAL_Linux_Display_Height))
+    HAL_Linux_Framebuffer[Display_Y][Display_X] = Color;
+  ++SPI_Statistics.NumDisplayPixels;
+
+  if (++Display_X > Display_Right)
+  {
+    Display_X = Display_Left;
+    if (++Display_Y > Display_Bottom)
+      Display_Y = Display_Top;
+  }
+}
+
+static void Display_Receive(uint8_t DC, const uint8_t *pBytes, uint32_t NumBytes)
+{
+  for (uint32_t Index = 0; Index < NumBytes; ++Index)
+  {
+    uint8_t Byte = pBytes[Index];
+
+    if (!DC)
+    {
+      Display_Command = Byte;
+      Display_NumArguments = 0;
+      Display_PixelHighByte = -1;
+      ++SPI_Statistics.NumDisplayCommands;
+
+      if (Byte == ILI9341_RAMWR)
+      {
+        Display_X = Display_Left;
+        Display_Y = Display_Top;
+        ++SPI_Statistics.NumDisplayWindows;
+      }
+      continue;
+    }
+
+    switch (Display_Command)
+    {
+      case ILI9341_CASET:
+      case ILI9341_PASET:
+        if (Display_NumArguments == sizeof(Display_Arguments))
+          break;
+        Display_Arguments[Display_NumArguments++] = Byte;
+        if (Display_NumArguments < sizeof(Display_Arguments))
+          break;
+
+        if (Display_Command == ILI9341_CASET)
+        {
+          Display_Left = (Display_Arguments[0] << 8) | Display_Arguments[1];
+          Display_Right = (Display_Arguments[2] << 8) | Display_Arguments[3];
+        }
+        else
+        {
+          Display_Top = (Display_Arguments[0] << 8) | Display_Arguments[1];
+          Display_Bottom = (Display_Arguments[2] << 8) | Display_Arguments[3];
+        }
+        break;
+
+      case ILI9341_RAMWR:
+      case ILI9341_WRITE_MEM_CONTINUE:
+        if (Display_PixelHighByte < 0)
+        {
+          Display_PixelHighByte = Byte;
+          break;
+        }
+        Display_WritePixel((Display_PixelHighByte << 8) | Byte); // MSB first.
+        Display_PixelHighByte = -1;
+        break;
+
+      default:
+        break;
+    }
+  }
+}
+
+void HAL_Linux_AttachDisplay(int CSX_GPIO, int D_CX_GPIO)
+{
+  Display_CSX_GPIO = CSX_GPIO;
+  Display_D_CX_GPIO = D_CX_GPIO;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Touch panel:
+
+static const HAL_Linux_TouchSample_t *TouchPanel_GetSample()
+// Returns NULL if not touched.
+{
+  int64_t Now_us = HAL_GetTime_us();
+  const HAL_Linux_TouchSample_t *pSample = NULL;
+
+  for (uint32_t Index = 0; (Index < TouchScript_NumSamples) && (pTouchScript[Index].Time_us <= Now_us); ++Index)
+    pSample = &pTouchScript[Index];
+
+  return (pSample && pSample->Touched) ? pSample : NULL;
+}
+
+static void TouchPanel_Transfer(const uint8_t *pTxBytes, uint8_t *pRxBytes, uint32_t NumBytes)
+// A conversion's 12 bit result is clocked out over the 16 clocks after its control byte: 7 bits in the next byte, 5 in the one after.
+{
+  const HAL_Linux_TouchSample_t *pSample = TouchPanel_GetSample();
+  uint16_t Z1 = pSample ? pSample->RawZ : 0;
+  uint16_t Z2 = 4095; // So that 4095 + Z1 - Z2 is the pressure.
+
+  if (pRxBytes)
+    memset(pRxBytes, 0, NumBytes);
+  ++SPI_Statistics.NumTouchSamples;
+
+  for (uint32_t Index = 0; Index < NumBytes; ++Index)
+  {
+    uint16_t Value;
+
+    if (!(pTxBytes[Index] & 0x80)) // Not a control byte.
+      continue;
+
+    switch ((pTxBytes[Index] >> 4) & 0x07)
+    {
+      case XPT2046_Channel_X:
+        Value = pSample ? pSample->RawX : 0;
+        break;
+      case XPT2046_Channel_Y:
+        Value = pSample ? pSample->RawY : 0;
+        break;
+      case XPT2046_Channel_Z1:
+        Value = Z1;
+        break;
+      case XPT2046_Channel_Z2:
+        Value = Z2;
+        break;
+      default:
+        Value = 0;
+        break;
+    }
+
+    if (pRxBytes && (Index + 1 < NumBytes))
+      pRxBytes[Index + 1] |= (Value >> 5) & 0x7F;
+    if (pRxBytes && (Index + 2 < NumBytes))
+      pRxBytes[Index + 2] |= (Value & 0x1F) << 3;
+  }
+}
+
+void HAL_Linux_AttachTouchPanel(int CSX_GPIO)
+{
+  TouchPanel_CSX_GPIO = CSX_GPIO;
+}
+
+void HAL_Linux_SetTouchScript(const HAL_Linux_TouchSample_t *pSamples, uint32_t NumSamples)
+{
+  pTouchScript = pSamples;
+  TouchScript_NumSamples = NumSamples;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SPI:
+
+static void SPI_Execute(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction)
+{
+  const uint8_t *pTxBytes = (pTransaction->flags & HAL_SPI_TRANS_USE_TXDATA) ? pTransaction->tx_data : (const uint8_t *)pTransaction->tx_buffer;
+  uint32_t NumBytes = pTransaction->length / 8;
+  uint8_t DC = 0;
+
+  if ((pTransaction->flags & HAL_SPI_TRANS_USE_TXDATA) && (NumBytes > sizeof(pTransaction->tx_data)))
+    Fail("Too much data for tx_data");
+
+  if (Device->Configuration.PreTransferCallback)
+    Device->Configuration.PreTransferCallback(pTransaction);
+
+  switch (Device->Role)
+  {
+    case drDisplay:
+      DC = HAL_Linux_GPIO_GetLevel(Display_D_CX_GPIO);
+      Display_Receive(DC, pTxBytes, NumBytes);
+      break;
+    case drTouchPanel:
+      TouchPanel_Transfer(pTxBytes, (uint8_t *)pTransaction->rx_buffer, pTransaction->rxlength / 8);
+      break;
+    default:
+      break;
+  }
+
+  ++SPI_Statistics.NumTransactions;
+  SPI_Statistics.NumBytes += NumBytes;
+
+  if (SPI_NumRecords < HAL_Linux_SPI_MaxNumRecords)
+  {
+    HAL_Linux_SPIRecord_t *pRecord;
+
+    if (!pSPI_Records)
+      pSPI_Records = (HAL_Linux_SPIRecord_t *)malloc(HAL_Linux_SPI_MaxNumRecords * sizeof(HAL_Linux_SPIRecord_t));
+    pRecord = &pSPI_Records[SPI_NumRecords++];
+    pRecord->Time_us = HAL_GetTime_us();
+    pRecord->CSX_GPIO = Device->Configuration.CSX_GPIO;
+    pRecord->DC = DC;
+    pRecord->FirstByte = NumBytes ? pTxBytes[0] : 0;
+    pRecord->NumBytes = NumBytes;
+  }
+
+  if (SPI_Timed && Device->Configuration.ClockSpeed_Hz)
+  {
+    Device->ClockRemainder += (uint64_t)pTransaction->length * 1000000;
+    HAL_Linux_AdvanceTime_us(Device->ClockRemainder / Device->Configuration.ClockSpeed_Hz);
+    Device->ClockRemainder %= Device->Configuration.ClockSpeed_Hz;
+  }
+
+  if (Device->Configuration.PostTransferCallback)
+    Device->Configuration.PostTransferCallback(pTransaction);
+}
+
+void HAL_SPI_InitializeBus(HAL_SPI_Host_t Host, int MOSI_GPIO, int MISO_GPIO, int SCK_GPIO, int DMAChannel)
+{
+}
+
+void HAL_SPI_AddDevice(HAL_SPI_Host_t Host, const HAL_SPI_DeviceConfiguration_t *pConfiguration, HAL_SPI_Device_t *pDevice)
+{
+  HAL_SPI_Device_t Device;
+
+  if (SPI_NumDevices == SPI_MaxNumDevices)
+    Fail("Too many SPI devices");
+  if (pConfiguration->QueueSize > SPI_MaxQueueSize)
+    Fail("SPI queue too large");
+
+  Device = &SPI_Devices[SPI_NumDevices++];
+  memset(Device, 0, sizeof(*Device));
+  Device->Configuration = *pConfiguration;
+  if (pConfiguration->CSX_GPIO == Display_CSX_GPIO)
+    Device->Role = drDisplay;
+  else if (pConfiguration->CSX_GPIO == TouchPanel_CSX_GPIO)
+    Device->Role = drTouchPanel;
+
+  *pDevice = Device;
+}
+
+void HAL_SPI_AcquireBus(HAL_SPI_Device_t Device)
+{
+}
+
+void HAL_SPI_ReleaseBus(HAL_SPI_Device_t Device)
+{
+  if (Device->QueueNumTransactions)
+    Fail("Bus released with transaction results uncollected");
+}
+
+void HAL_SPI_Transmit(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction)
+{
+  FailIfCritical("SPI transmit in a critical section");
+  if (Device->QueueNumTransactions)
+    Fail("Transmit with transactions queued");
+
+  SPI_Execute(Device, pTransaction);
+}
+
+void HAL_SPI_QueueTransaction(HAL_SPI_Device_t Device, HAL_SPI_Transaction_t *pTransaction)
+{
+  FailIfCritical("SPI queue in a critical section");
+  if (Device->QueueNumTransactions == Device->Configuration.QueueSize)
+    Fail("SPI queue overflow");
+
+  SPI_Execute(Device, pTransaction);
+  Device->pQueue[Device->QueueNumTransactions++] = pTransaction;
+  ++SPI_Statistics.NumQueuedTransactions;
+}
+
+void HAL_SPI_CollectTransactionResult(HAL_SPI_Device_t Device)
+{
+  FailIfCritical("SPI result collected in a critical section");
+  if (!Device->QueueNumTransactions)
+    Fail("No transaction result to collect");
+
+  memmove(Device->pQueue, Device->pQueue + 1, --Device->QueueNumTransactions * sizeof(Device->pQueue[0]));
+}
+
+void HAL_Linux_GetSPIStatistics(HAL_Linux_SPIStatistics_t *pStatistics)
+{
+  *pStatistics = SPI_Statistics;
+}
+
+uint32_t HAL_Linux_GetSPIRecords(const HAL_Linux_SPIRecord_t **ppRecords)
+{
+  *ppRecords = pSPI_Records;
+  return SPI_NumRecords;
+}
+
+void HAL_Linux_ResetSPIStatistics()
+{
+  memset(&SPI_Statistics, 0, sizeof(SPI_Statistics));
+  SPI_NumRecords = 0;
+}
+
+void HAL_Linux_SetSPITimed(uint8_t Timed)
+{
+  SPI_Timed = Timed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LEDC (PWM):
+
+static void LEDC_Log(uint8_t Channel, uint32_t Duty, uint32_t FadeTime_ms)
+{
+  HAL_Linux_LEDCEvent_t *pEvent;
+
+  if (LEDC_NumEvents == LEDC_MaxNumEvents)
+  {
+    LEDC_MaxNumEvents = LEDC_MaxNumEvents ? 2 * LEDC_MaxNumEvents : 1024;
+    pLEDC_Events = (HAL_Linux_LEDCEvent_t *)realloc(pLEDC_Events, LEDC_MaxNumEvents * sizeof(HAL_Linux_LEDCEvent_t));
+    if (!pLEDC_Events)
+      Fail("Out of memory for the LEDC log");
+  }
+
+  pEvent = &pLEDC_Events[LEDC_NumEvents++];
+  pEvent->Time_us = HAL_GetTime_us();
+  pEvent->Channel = Channel;
+  pEvent->Duty = Duty;
+  pEvent->FadeTime_ms = FadeTime_ms;
+}
+
+static void LEDC_EndFade(LEDCChannel_t *pChannel)
+{
+  pChannel->Duty = pChannel->FadeDuty;
+  pChannel->FadeStartTime_us = pChannel->FadeEndTime_us = 0;
+}
+
+void HAL_LEDC_InitializeTimer(uint32_t Frequency_Hz, uint8_t Resolution_bits)
+{
+}
+
+void HAL_LEDC_InitializeChannel(uint8_t Channel, int GPIO)
+{
+  if (Channel >= HAL_Linux_LEDC_NumChannels)
+    Fail("No such LEDC channel");
+
+  memset(&LEDC_Channels[Channel], 0, sizeof(LEDC_Channels[Channel]));
+}
+
+void HAL_LEDC_SetDuty(uint8_t Channel, uint32_t Duty)
+{
+  LEDCChannel_t *pChannel = &LEDC_Channels[Channel];
+
+  FailIfCritical("LEDC duty set in a critical section");
+  if (HAL_LEDC_IsFading(Channel))
+    LEDC_EndFade(pChannel);
+
+  pChannel->Duty = pChannel->FadeDuty = Duty;
+  LEDC_Log(Channel, Duty, 0);
+}
+
+uint8_t HAL_LEDC_InstallFade(uint8_t NumChannels)
+{
+  FailIfCritical("LEDC fade installed in a critical section");
+  LEDC_FadeInstalled = LEDC_FadeAvailable;
+  return LEDC_FadeInstalled;
+}
+
+void HAL_LEDC_StartFade(uint8_t Channel, uint32_t Duty, uint32_t Time_ms)
+{
+  LEDCChannel_t *pChannel = &LEDC_Channels[Channel];
+  int64_t Now_us = HAL_GetTime_us();
+
+  FailIfCritical("LEDC fade started in a critical section");
+  if (!LEDC_FadeInstalled)
+    Fail("Fade started without HAL_LEDC_InstallFade()");
+  if (HAL_LEDC_IsFading(Channel))
+    Fail("Fade started on a fading channel"); // It cannot be stopped, so this would be ignored or wait.
+
+  pChannel->Duty = pChannel->FadeDuty; // Any fade before has ended.
+  pChannel->FadeDuty = Duty;
+  pChannel->FadeStartTime_us = Now_us;
+  pChannel->FadeEndTime_us = Now_us + Time_ms * 1000LL;
+  LEDC_Log(Channel, Duty, Time_ms);
+}
+
+uint8_t HAL_LEDC_IsFading(uint8_t Channel)
+{
+  return HAL_GetTime_us() < LEDC_Channels[Channel].FadeEndTime_us;
+}
+
+uint32_t HAL_Linux_LEDC_GetDuty(uint8_t Channel)
+{
+  const LEDCChannel_t *pChannel = &LEDC_Channels[Channel];
+  int64_t Now_us = HAL_GetTime_us();
+
+  if (Now_us >= pChannel->FadeEndTime_us)
+    return pChannel->FadeDuty;
+
+  return pChannel->Duty + ((int64_t)pChannel->FadeDuty - pChannel->Duty) * (Now_us - pChannel->FadeStartTime_us) / (pChannel->FadeEndTime_us - pChannel->FadeStartTime_us);
+}
+
+uint32_t HAL_Linux_LEDC_GetEvents(const HAL_Linux_LEDCEvent_t **ppEvents)
+{
+  *ppEvents = pLEDC_Events;
+  return LEDC_NumEvents;
+}
+
+void HAL_Linux_LEDC_ClearEvents()
+{
+  LEDC_NumEvents = 0;
+}
+
+void HAL_Linux_LEDC_SetFadeAvailable(uint8_t Available)
+{
+  LEDC_FadeAvailable = Available;
+}
+
+///////////////////////////////////////////////////////////////////////////////
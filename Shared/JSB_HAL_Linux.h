@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Hardware abstraction layer: Linux backend types, and the functions that tests use to drive and inspect the simulated hardware.
+// Include JSB_HAL.h rather than this, and build with JSB_HAL_Linux defined (see Host/CMakeLists.txt).
+// Calls that may block on the ESP32, HAL_Delay_ms() and the SPI and LEDC ones, stop with a message if made in a critical section
+// (portENTER_CRITICAL(), see Host/JSB_HostPlatform.h).
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_HAL_LINUX_H
+#define __JSB_HAL_LINUX_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef int HAL_SPI_Host_t;
+typedef struct HAL_Linux_SPI_Device_s *HAL_SPI_Device_t;
+
+typedef struct
+{
+  uint32_t flags;
+  size_t length; // Bits.
+  size_t rxlength; // Bits.
+  void *user;
+  const void *tx_buffer;
+  uint8_t tx_data[4];
+  void *rx_buffer;
+} HAL_SPI_Transaction_t;
+
+typedef void (*HAL_SPI_Callback_t)(HAL_SPI_Transaction_t *pTransaction);
+
+#define HAL_SPI_TRANS_USE_TXDATA (1 << 3)
+
+// As esp-idf, so that apps name the SPI hosts the same way with either backend:
+#define HSPI_HOST 1
+#define VSPI_HOST 2
+
+///////////////////////////////////////////////////////////////////////////////
+// Time:
+//
+// => Simulated. It only moves on when HAL_Delay_ms() or HAL_Linux_AdvanceTime_us() is called, so that runs are repeatable.
+// => Periodic timers (HAL_StartPeriodicTimer()) are called as it passes their times, by the thread moving it on.
+
+void HAL_Linux_AdvanceTime_us(int64_t Time_us);
+
+///////////////////////////////////////////////////////////////////////////////
+// Memory:
+
+typedef struct
+{
+  uint32_t NumAllocations;
+  uint32_t NumFrees;
+  uint32_t NumBytesAllocated;
+} HAL_Linux_MemoryStatistics_t;
+
+void HAL_Linux_GetMemoryStatistics(HAL_Linux_MemoryStatistics_t *pStatistics);
+void HAL_Linux_SetMemoryLimit(uint32_t NumBytes); // Allocations that would take the total allocated over this fail. 0 => no limit.
+
+///////////////////////////////////////////////////////////////////////////////
+// GPIO:
+
+uint32_t HAL_Linux_GPIO_GetLevel(int GPIO);
+
+///////////////////////////////////////////////////////////////////////////////
+// SPI:
+//
+// => Transactions complete as soon as they are queued, but their results must still be collected in order, as with esp-idf.
+//    A driver that queues more than its device's QueueSize, collects results that were never queued, or releases the bus with results
+//    uncollected, is stopped with a message.
+// => Every transaction is recorded. Those to the display (see HAL_Linux_AttachDisplay()) are also decoded, as the ILI9341 would:
+//    CASET and PASET set the window, and RAMWR and RAMWR continue write RGB565 pixels into HAL_Linux_Framebuffer.
+//    The framebuffer is in the display's address space. MADCTL is not modelled.
+// => Those to the touch panel (see HAL_Linux_AttachTouchPanel()) are answered as the XPT2046 would, from the touch script.
+// => Transfers take no time, unless HAL_Linux_SetSPITimed() is called. Then each moves the time on by its bits at the device's clock
+//    speed, before its post transfer callback, as the bus would.
+
+#define HAL_Linux_Display_Width 240
+#define HAL_Linux_Display_Height 320
+
+extern uint16_t HAL_Linux_Framebuffer[HAL_Linux_Display_Height][HAL_Linux_Display_Width];
+
+typedef struct
+{
+  uint32_t NumTransactions;
+  uint32_t NumQueuedTransactions; // Of those, queued rather than transmitted.
+  uint32_t NumBytes;
+  uint32_t NumDisplayCommands;
+  uint32_t NumDisplayWindows; // RAMWRs.
+  uint32_t NumDisplayPixels;
+  uint32_t NumTouchSamples;
+} HAL_Linux_SPIStatistics_t;
+
+typedef struct
+{
+  int64_t Time_us;
+  int CSX_GPIO; // Identifies the device.
+  uint8_t DC; // Level of the display's D/C line. 0 for other devices.
+  uint8_t FirstByte;
+  uint32_t NumBytes;
+} HAL_Linux_SPIRecord_t;
+
+void HAL_Linux_AttachDisplay(int CSX_GPIO, int D_CX_GPIO); // Before the device is added.
+void HAL_Linux_AttachTouchPanel(int CSX_GPIO);
+void HAL_Linux_GetSPIStatistics(HAL_Linux_SPIStatistics_t *pStatistics);
+uint32_t HAL_Linux_GetSPIRecords(const HAL_Linux_SPIRecord_t **ppRecords); // Returns the number recorded, up to HAL_Linux_SPI_MaxNumRecords.
+void HAL_Linux_ResetSPIStatistics(); // And the records.
+void HAL_Linux_SetSPITimed(uint8_t Timed);
+
+#define HAL_Linux_SPI_MaxNumRecords 65536
+
+///////////////////////////////////////////////////////////////////////////////
+// Touch panel:
+//
+// => Raw XPT2046 readings, which the driver's XPT2046_Swap_XL_and_XR and XPT2046_Swap_YD_and_YU are then applied to.
+// => Each sample holds from its time until the next one's. Before the first, the panel is not touched.
+
+typedef struct
+{
+  int64_t Time_us;
+  uint8_t Touched;
+  uint16_t RawX, RawY; // 12 bit.
+  uint16_t RawZ; // Pressure, as XPT2046_Sample() works it out, up to 2047. Below its threshold reads as not touched.
+} HAL_Linux_TouchSample_t;
+
+void HAL_Linux_SetTouchScript(const HAL_Linux_TouchSample_t *pSamples, uint32_t NumSamples); // *pSamples must persist. In time order.
+
+///////////////////////////////////////////////////////////////////////////////
+// LEDC:
+//
+// => Every duty written and fade started is logged, with the time.
+// => Fades ramp linearly over their time, and end then. HAL_LEDC_SetDuty() on a fading channel ends the fade first, as esp-idf waits for it.
+
+#define HAL_Linux_LEDC_NumChannels 8
+
+typedef struct
+{
+  int64_t Time_us;
+  uint8_t Channel;
+  uint32_t Duty; // Written, or at the end of the fade.
+  uint32_t FadeTime_ms; // 0 => written.
+} HAL_Linux_LEDCEvent_t;
+
+uint32_t HAL_Linux_LEDC_GetDuty(uint8_t Channel); // Now, part way through any fade.
+uint32_t HAL_Linux_LEDC_GetEvents(const HAL_Linux_LEDCEvent_t **ppEvents); // Returns the number logged.
+void HAL_Linux_LEDC_ClearEvents();
+void HAL_Linux_LEDC_SetFadeAvailable(uint8_t Available); // Before HAL_LEDC_InstallFade(), to test the fallback. Available by default.
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,411 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// HTTP request parsing:
+//
+// => Works in place on the receive buffer: results are HTTP_String_t's pointing into it. Nothing is allocated.
+// => Percent-decoding shortens strings in place, so the buffer must be writable.
+// => Each function makes a single pass, with a fixed amount of stack, so any line that fits in the buffer can be parsed.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+//
+#include "JSB_HTTP.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define MaxNumFloatChars 31
+
+///////////////////////////////////////////////////////////////////////////////
+// Lines:
+
+uint8_t HTTP_GetNextLine(HTTP_String_t *pRemaining, HTTP_String_t *pLine)
+// Splits the next line off *pRemaining, without its "\r\n" (or "\n"). Returns 0 if *pRemaining holds no complete line.
+{
+  char *pLineEnd = (char *)memchr(pRemaining->pChars, '\n', pRemaining->NumChars);
+  uint16_t NumChars;
+
+  if (!pLineEnd)
+    return 0;
+
+  NumChars = pLineEnd - pRemaining->pChars;
+  pLine->pChars = pRemaining->pChars;
+  pLine->NumChars = ((NumChars > 0) && (pLineEnd[-1] == '\r')) ? NumChars - 1 : NumChars;
+
+  pRemaining->pChars += NumChars + 1;
+  pRemaining->NumChars -= NumChars + 1;
+
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Requests:
+
+HTTP_ReadResult_t HTTP_ReadRequest(HTTP_RequestReader_t *pReader, HTTP_String_t Received, uint16_t MaxNumChars)
+// Received: Everything received so far, from the start of the buffer. Only chars not seen by an earlier call are scanned,
+// so a request can be read as it arrives, however it is fragmented.
+// MaxNumChars: Size of the buffer. A request that cannot fit in it is rejected as soon as that is known.
+// On rrComplete, the request is the HeadNumChars chars at StartIndex, followed by ContentLength chars of body.
+{
+  if (!pReader->HeadNumChars)
+  {
+    // Skip blank lines between requests:
+    while ((pReader->ScanIndex == pReader->StartIndex) && (pReader->StartIndex < Received.NumChars) &&
+      ((Received.pChars[pReader->StartIndex] == '\r') || (Received.pChars[pReader->StartIndex] == '\n')))
+    {
+      pReader->ScanIndex = pReader->LineStart = ++pReader->StartIndex;
+    }
+
+    // Scan complete lines, up to the blank line at the end of the headers:
+    while (!pReader->HeadNumChars && (pReader->ScanIndex < Received.NumChars))
+    {
+      HTTP_String_t Line, Name, Value;
+      uint16_t LineEnd = pReader->ScanIndex++;
+
+      if (Received.pChars[LineEnd] != '\n')
+        continue;
+
+      Line.pChars = &Received.pChars[pReader->LineStart];
+      Line.NumChars = LineEnd - pReader->LineStart;
+      if (Line.NumChars && (Line.pChars[Line.NumChars - 1] == '\r'))
+        --Line.NumChars;
+
+      if (!Line.NumChars)
+        pReader->HeadNumChars = pReader->ScanIndex - pReader->StartIndex;
+      else if ((pReader->LineStart != pReader->StartIndex) && HTTP_ParseHeader(Line, &Name, &Value) && HTTP_StringEquals(Name, "Content-Length"))
+      {
+        if (!HTTP_StringToUnsigned(Value, &pReader->ContentLength))
+          return rrBadContentLength;
+      }
+
+      pReader->LineStart = pReader->ScanIndex;
+    }
+
+    if (!pReader->HeadNumChars)
+      return (Received.NumChars >= MaxNumChars) ? rrHeadersTooLarge : rrNeedMoreInput;
+    if (pReader->ContentLength > (uint32_t)(MaxNumChars - pReader->StartIndex - pReader->HeadNumChars))
+      return rrContentTooLarge;
+  }
+
+  return (Received.NumChars >= pReader->StartIndex + pReader->HeadNumChars + pReader->ContentLength) ? rrComplete : rrNeedMoreInput;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Request line:
+
+static HTTP_Method_t GetMethod(HTTP_String_t Method)
+{
+  static const struct { const char *pName; HTTP_Method_t Method; } Methods[] =
+  {
+    { "GET", hmGET }, { "HEAD", hmHEAD }, { "POST", hmPOST }, { "PUT", hmPUT }, { "DELETE", hmDELETE }, { "OPTIONS", hmOPTIONS }
+  };
+
+  for (uint8_t Index = 0; Index < sizeof(Methods) / sizeof(Methods[0]); ++Index)
+    if (HTTP_StringEquals(Method, Methods[Index].pName))
+      return Methods[Index].Method;
+
+  return hmUnknown;
+}
+
+static HTTP_String_t GetToken(HTTP_String_t *pRemaining)
+// Splits the next space delimited token off *pRemaining.
+{
+  HTTP_String_t Token;
+
+  while (pRemaining->NumChars && (*pRemaining->pChars == ' '))
+  {
+    ++pRemaining->pChars;
+    --pRemaining->NumChars;
+  }
+
+  Token.pChars = pRemaining->pChars;
+  Token.NumChars = 0;
+  while (pRemaining->NumChars && (*pRemaining->pChars != ' '))
+  {
+    ++pRemaining->pChars;
+    --pRemaining->NumChars;
+    ++Token.NumChars;
+  }
+
+  return Token;
+}
+
+uint8_t HTTP_ParseRequestLine(HTTP_String_t Line, HTTP_RequestLine_t *pRequestLine)
+// E.g. "GET /State?N=0.5 HTTP/1.1". Returns 0 if Line is not a request line.
+{
+  HTTP_String_t Method = GetToken(&Line);
+  HTTP_String_t Target = GetToken(&Line);
+  char *pQuery;
+
+  memset(pRequestLine, 0, sizeof(*pRequestLine));
+
+  if (!Method.NumChars || !Target.NumChars || (*Target.pChars != '/'))
+    return 0;
+
+  pRequestLine->Method = GetMethod(Method);
+  pRequestLine->Version = GetToken(&Line);
+  if (GetToken(&Line).NumChars) // Trailing junk.
+    return 0;
+
+  // Path and query:
+  ++Target.pChars;
+  --Target.NumChars;
+  pRequestLine->Path = Target;
+  pQuery = (char *)memchr(Target.pChars, '?', Target.NumChars);
+  if (pQuery)
+  {
+    pRequestLine->Path.NumChars = pQuery - Target.pChars;
+    pRequestLine->Query.pChars = pQuery + 1;
+    pRequestLine->Query.NumChars = Target.NumChars - pRequestLine->Path.NumChars - 1;
+  }
+  pRequestLine->Path.NumChars = HTTP_PercentDecode(pRequestLine->Path.pChars, pRequestLine->Path.NumChars, 0);
+
+  return 1;
+}
+
+uint8_t HTTP_GetNextQueryParameter(HTTP_String_t *pQuery, HTTP_String_t *pName, HTTP_String_t *pValue)
+// Splits the next "Name=Value" parameter off *pQuery and percent-decodes it. Value is empty if there is no '='. Returns 0 when there are no more.
+{
+  while (pQuery->NumChars)
+  {
+    char *pEnd = (char *)memchr(pQuery->pChars, '&', pQuery->NumChars);
+    uint16_t NumChars = pEnd ? pEnd - pQuery->pChars : pQuery->NumChars;
+    char *pEquals = (char *)memchr(pQuery->pChars, '=', NumChars);
+
+    pName->pChars = pQuery->pChars;
+    pName->NumChars = pEquals ? pEquals - pQuery->pChars : NumChars;
+    pValue->pChars = pEquals ? pEquals + 1 : pQuery->pChars + NumChars;
+    pValue->NumChars = pEquals ? NumChars - pName->NumChars - 1 : 0;
+
+    pQuery->pChars += pEnd ? NumChars + 1 : NumChars;
+    pQuery->NumChars -= pEnd ? NumChars + 1 : NumChars;
+
+    if (!NumChars) // Empty parameter, e.g. "&&".
+      continue;
+
+    pName->NumChars = HTTP_PercentDecode(pName->pChars, pName->NumChars, 1);
+    pValue->NumChars = HTTP_PercentDecode(pValue->pChars, pValue->NumChars, 1);
+    return 1;
+  }
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Headers:
+
+static HTTP_String_t Trim(HTTP_String_t String)
+{
+  while (String.NumChars && ((*String.pChars == ' ') || (*String.pChars == '\t')))
+  {
+    ++String.pChars;
+    --String.NumChars;
+  }
+  while (String.NumChars && ((String.pChars[String.NumChars - 1] == ' ') || (String.pChars[String.NumChars - 1] == '\t')))
+    --String.NumChars;
+
+  return String;
+}
+
+uint8_t HTTP_ParseHeader(HTTP_String_t Line, HTTP_String_t *pName, HTTP_String_t *pValue)
+// E.g. "Connection: keep-alive". Returns 0 if Line is not a header.
+{
+  char *pColon = (char *)memchr(Line.pChars, ':', Line.NumChars);
+
+  if (!pColon || (pColon == Line.pChars))
+    return 0;
+
+  pName->pChars = Line.pChars;
+  pName->NumChars = pColon - Line.pChars;
+  pValue->pChars = pColon + 1;
+  pValue->NumChars = Line.NumChars - pName->NumChars - 1;
+  *pValue = Trim(*pValue);
+
+  return 1;
+}
+
+uint8_t HTTP_HasToken(HTTP_String_t List, const char *pToken)
+// Whether a comma separated header value, e.g. "keep-alive, Upgrade", includes pToken. Case insensitive.
+{
+  while (List.NumChars)
+  {
+    char *pComma = (char *)memchr(List.pChars, ',', List.NumChars);
+    HTTP_String_t Item = { List.pChars, (uint16_t)(pComma ? pComma - List.pChars : List.NumChars) };
+
+    if (HTTP_StringEquals(Trim(Item), pToken))
+      return 1;
+
+    List.pChars += pComma ? Item.NumChars + 1 : Item.NumChars;
+    List.NumChars -= pComma ? Item.NumChars + 1 : Item.NumChars;
+  }
+
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Responses:
+//
+// => A response is assembled in one buffer from constant text and a few formatted numbers, so that it can be sent with one send().
+// => Numbers are formatted directly, rather than with printf.
+
+void HTTP_Buffer_Initialize(HTTP_Buffer_t *pBuffer, char *pChars, uint16_t MaxNumChars)
+{
+  pBuffer->pChars = pChars;
+  pBuffer->NumChars = 0;
+  pBuffer->MaxNumChars = MaxNumChars;
+  pBuffer->Overflowed = 0;
+}
+
+void HTTP_Buffer_Append(HTTP_Buffer_t *pBuffer, const char *pChars, uint16_t NumChars)
+{
+  if (NumChars > pBuffer->MaxNumChars - pBuffer->NumChars)
+  {
+    NumChars = pBuffer->MaxNumChars - pBuffer->NumChars;
+    pBuffer->Overflowed = 1;
+  }
+
+  memcpy(&pBuffer->pChars[pBuffer->NumChars], pChars, NumChars);
+  pBuffer->NumChars += NumChars;
+}
+
+void HTTP_Buffer_AppendText(HTTP_Buffer_t *pBuffer, const char *pText)
+{
+  HTTP_Buffer_Append(pBuffer, pText, strlen(pText));
+}
+
+void HTTP_Buffer_AppendUnsigned(HTTP_Buffer_t *pBuffer, uint32_t Value)
+{
+  char Digits[10];
+  uint8_t NumDigits = 0;
+
+  do
+  {
+    Digits[sizeof(Digits) - ++NumDigits] = '0' + Value % 10;
+    Value /= 10;
+  } while (Value);
+
+  HTTP_Buffer_Append(pBuffer, &Digits[sizeof(Digits) - NumDigits], NumDigits);
+}
+
+void HTTP_Buffer_AppendFixedPoint(HTTP_Buffer_t *pBuffer, float Value, uint8_t NumDecimals)
+// As printf("%.*f"), except that exact ties (e.g. 0.125) round away from zero. NumDecimals: 0..4.
+{
+  static const uint16_t Scales[] = { 1, 10, 100, 1000, 10000 };
+  uint32_t Scale, ScaledValue;
+  char Fraction[4];
+
+  if (NumDecimals > 4)
+    NumDecimals = 4;
+  Scale = Scales[NumDecimals];
+
+  if (Value < 0.0f)
+  {
+    HTTP_Buffer_Append(pBuffer, "-", 1);
+    Value = -Value;
+  }
+  ScaledValue = ((double)Value * Scale < 4000000000.0) ? (uint32_t)((double)Value * Scale + 0.5) : 4000000000u; // Double, so that e.g. 0.00499999989f rounds down as printf does.
+
+  HTTP_Buffer_AppendUnsigned(pBuffer, ScaledValue / Scale);
+  if (Scale == 1)
+    return;
+
+  HTTP_Buffer_Append(pBuffer, ".", 1);
+  for (int8_t Index = NumDecimals - 1; Index >= 0; --Index, ScaledValue /= 10)
+    Fraction[Index] = '0' + ScaledValue % 10;
+  HTTP_Buffer_Append(pBuffer, Fraction, NumDecimals);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Strings:
+
+static int8_t GetHexDigitValue(char Ch)
+{
+  if ((Ch >= '0') && (Ch <= '9'))
+    return Ch - '0';
+  if ((Ch >= 'a') && (Ch <= 'f'))
+    return Ch - 'a' + 10;
+  if ((Ch >= 'A') && (Ch <= 'F'))
+    return Ch - 'A' + 10;
+  return -1;
+}
+
+uint16_t HTTP_PercentDecode(char *pChars, uint16_t NumChars, uint8_t PlusIsSpace)
+// In place. Returns the decoded length. Malformed escapes are left as they are.
+{
+  uint16_t SourceIndex = 0, DestinationIndex = 0;
+
+  while (SourceIndex < NumChars)
+  {
+    char Ch = pChars[SourceIndex++];
+
+    if ((Ch == '%') && (SourceIndex + 2 <= NumChars))
+    {
+      int8_t High = GetHexDigitValue(pChars[SourceIndex]), Low = GetHexDigitValue(pChars[SourceIndex + 1]);
+
+      if ((High >= 0) && (Low >= 0))
+      {
+        Ch = (High << 4) | Low;
+        SourceIndex += 2;
+      }
+    }
+    else if ((Ch == '+') && PlusIsSpace)
+      Ch = ' ';
+
+    pChars[DestinationIndex++] = Ch;
+  }
+
+  return DestinationIndex;
+}
+
+uint8_t HTTP_StringEquals(HTTP_String_t String, const char *pText)
+// Case insensitive.
+{
+  uint16_t Index;
+
+  for (Index = 0; Index < String.NumChars; ++Index)
+    if (!pText[Index] || (tolower((unsigned char)String.pChars[Index]) != tolower((unsigned char)pText[Index])))
+      return 0;
+
+  return pText[Index] == '\0';
+}
+
+uint8_t HTTP_StringToFloat(HTTP_String_t String, float *pValue)
+// Returns 0 if String does not start with a number. As sscanf("%f"), anything after the number is ignored.
+{
+  char Chars[MaxNumFloatChars + 1];
+  char *pEnd;
+  uint16_t NumChars = (String.NumChars > MaxNumFloatChars) ? MaxNumFloatChars : String.NumChars;
+
+  memcpy(Chars, String.pChars, NumChars);
+  Chars[NumChars] = '\0';
+
+  *pValue = strtof(Chars, &pEnd);
+  return pEnd != Chars;
+}
+
+uint8_t HTTP_StringToUnsigned(HTTP_String_t String, uint32_t *pValue)
+// Decimal digits only. Returns 0 if String is empty, has anything else in it or overflows.
+{
+  uint32_t Value = 0;
+
+  if (!String.NumChars)
+    return 0;
+
+  for (uint16_t Index = 0; Index < String.NumChars; ++Index)
+  {
+    char Ch = String.pChars[Index];
+
+    if ((Ch < '0') || (Ch > '9') || (Value > (UINT32_MAX - (Ch - '0')) / 10))
+      return 0;
+    Value = Value * 10 + (Ch - '0');
+  }
+
+  *pValue = Value;
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
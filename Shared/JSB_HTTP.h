@@ -0,0 +1,109 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_HTTP_H
+#define __JSB_HTTP_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  char *pChars; // Not terminated. Points into the caller's buffer.
+  uint16_t NumChars;
+} HTTP_String_t;
+
+typedef enum
+{
+  hmUnknown,
+  hmGET,
+  hmHEAD,
+  hmPOST,
+  hmPUT,
+  hmDELETE,
+  hmOPTIONS
+} HTTP_Method_t;
+
+typedef struct
+{
+  HTTP_Method_t Method;
+  HTTP_String_t Path; // Without the leading '/'. Percent-decoded.
+  HTTP_String_t Query; // Without the '?'. Empty if none. Not decoded: use HTTP_GetNextQueryParameter().
+  HTTP_String_t Version; // E.g. "HTTP/1.1". Empty for a HTTP/0.9 style request.
+} HTTP_RequestLine_t;
+
+typedef struct
+{
+  char *pChars;
+  uint16_t NumChars;
+  uint16_t MaxNumChars;
+  uint8_t Overflowed; // Something did not fit, and was truncated.
+} HTTP_Buffer_t;
+
+typedef enum
+{
+  rrNeedMoreInput,
+  rrComplete,
+  rrHeadersTooLarge,
+  rrContentTooLarge,
+  rrBadContentLength
+} HTTP_ReadResult_t;
+
+typedef struct
+{
+  // Zero to start reading a request:
+  uint16_t StartIndex; // Where the request starts, after any blank lines before it.
+  uint16_t HeadNumChars; // Request line and headers, including the blank line after them. 0 => not received yet.
+  uint32_t ContentLength;
+  uint16_t ScanIndex; // Chars before this have been scanned.
+  uint16_t LineStart;
+} HTTP_RequestReader_t;
+
+// Lines:
+uint8_t HTTP_GetNextLine(HTTP_String_t *pRemaining, HTTP_String_t *pLine);
+
+// Requests:
+HTTP_ReadResult_t HTTP_ReadRequest(HTTP_RequestReader_t *pReader, HTTP_String_t Received, uint16_t MaxNumChars);
+
+// Request line:
+uint8_t HTTP_ParseRequestLine(HTTP_String_t Line, HTTP_RequestLine_t *pRequestLine);
+uint8_t HTTP_GetNextQueryParameter(HTTP_String_t *pQuery, HTTP_String_t *pName, HTTP_String_t *pValue);
+
+// Headers:
+uint8_t HTTP_ParseHeader(HTTP_String_t Line, HTTP_String_t *pName, HTTP_String_t *pValue);
+uint8_t HTTP_HasToken(HTTP_String_t List, const char *pToken);
+
+// Responses:
+void HTTP_Buffer_Initialize(HTTP_Buffer_t *pBuffer, char *pChars, uint16_t MaxNumChars);
+void HTTP_Buffer_Append(HTTP_Buffer_t *pBuffer, const char *pChars, uint16_t NumChars);
+void HTTP_Buffer_AppendText(HTTP_Buffer_t *pBuffer, const char *pText);
+void HTTP_Buffer_AppendUnsigned(HTTP_Buffer_t *pBuffer, uint32_t Value);
+void HTTP_Buffer_AppendFixedPoint(HTTP_Buffer_t *pBuffer, float Value, uint8_t NumDecimals);
+
+// Strings:
+uint16_t HTTP_PercentDecode(char *pChars, uint16_t NumChars, uint8_t PlusIsSpace);
+uint8_t HTTP_StringEquals(HTTP_String_t String, const char *pText);
+uint8_t HTTP_StringToFloat(HTTP_String_t String, float *pValue);
+uint8_t HTTP_StringToUnsigned(HTTP_String_t String, uint32_t *pValue);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
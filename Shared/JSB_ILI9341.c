@@ -16,13 +16,12 @@
 //
 #include "esp_system.h"
 #include "esp_log.h"
-#include "soc/gpio_struct.h"
-#include "driver/spi_master.h"
-#include "driver/gpio.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "esp_attr.h"
 //
+#include "JSB_HAL.h"
 #include "JSB_ILI9341.h"
+#include "JSB_ILI9341_Compositor.h"
+#include "JSB_ILI9341_GlyphCache.h"
 
 #define LOG_TAG "JSB_ILI9341"
 
@@ -33,16 +32,29 @@
 #define TextDrawMode_Default tdmThisCharBar
 ///////////////////////////////////////////////////////////////////////////////
 
-#define SPI_MaxNumTransactions 6
+#define SPI_ClockSpeed_Hz 20000000 // Nominally 20000000. Can it be higher? Set to 10000000 for debugging with 24MHz logic analyzer.
+#define SPI_MaxNumTransactions 16 // Transactions that may be in flight at once.
+#define SPI_User_DC 1 // Bits of a transaction's user value. The level of the D/~C line.
+#define SPI_User_Queued 2 // Set by SPI_Transactions_AddToQueue().
+
+#define PixelBuffer_NumBuffers 3 // One can be filled while the others are on the wire.
+
+#define GlyphArena_NumSlots 2 // One glyph can be rasterized while the previous one is on the wire.
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static spi_device_handle_t spi;
+static HAL_SPI_Device_t spi;
 static int D_CX_GPIO;
 static uint16_t TextColor = TextColor_Default;
 static uint16_t TextBackgroundColor = TextBackgroundColor_Default;
 static TextDrawMode_t TextDrawMode = TextDrawMode_Default;
 static const GFXfont *pFont = NULL;
+static ILI9341_Statistics_t Statistics;
+
+// Maintained by the post-transfer callback:
+static volatile uint32_t SPI_NumTransactionsQueued = 0;
+static volatile uint32_t SPI_NumTransactionsTransferred = 0;
+static volatile int64_t SPI_BusyStartTime_us = 0;
 
 ///////////////////////////////////////////////////////////////////////////////
 // ILI9341 commands, mostly from Adafruit IPI9341 library:
@@ -163,39 +175,45 @@ uint32_t min32(uint32_t A, uint32_t B)
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static void ILI9341_SendCommand(spi_device_handle_t spi, const uint8_t cmd)
+static void ILI9341_SendCommand(HAL_SPI_Device_t spi, const uint8_t cmd)
 // Waits until the transfer is complete.
 {
-  esp_err_t ret;
-  spi_transaction_t t;
+  HAL_SPI_Transaction_t t;
   memset(&t, 0, sizeof(t));       //Zero out the transaction
   t.length = 8;                     //Command is 8 bits
   t.tx_buffer = &cmd;               //The data is the cmd itself
   t.user = (void*) 0;                //D/C needs to be set to 0
-  ret = spi_device_polling_transmit(spi, &t);  //Transmit! // JSB 20240709: Was spi_device_transmit()
-  assert(ret==ESP_OK);            //Should have had no issues.
+  HAL_SPI_Transmit(spi, &t);  //Transmit!
 }
 
-static void ILI9341_SendData(spi_device_handle_t spi, const uint8_t *data, int len)
+static void ILI9341_SendData(HAL_SPI_Device_t spi, const uint8_t *data, int len)
 // Waits until the transfer is complete.
 {
-  esp_err_t ret;
-  spi_transaction_t t;
+  HAL_SPI_Transaction_t t;
   if (len == 0)
     return;             //no need to send anything
   memset(&t, 0, sizeof(t));       //Zero out the transaction
   t.length = len * 8;                 //Len is in bytes, transaction length is in bits.
   t.tx_buffer = data;               //Data
   t.user = (void*) 1;                //D/C needs to be set to 1
-  ret = spi_device_polling_transmit(spi, &t);  //Transmit! // JSB 20240709: Was spi_device_transmit()
-  assert(ret==ESP_OK);            //Should have had no issues.
+  HAL_SPI_Transmit(spi, &t);  //Transmit!
 }
 
-void ILI9341_SPI_PreTransferCallback(spi_transaction_t *t)
+void ILI9341_SPI_PreTransferCallback(HAL_SPI_Transaction_t *t)
 // Set D/~C GPIO output just prior to transfer.
 {
-  int dc = (int) t->user;
-  gpio_set_level(D_CX_GPIO, dc);
+  int dc = (int)((intptr_t)t->user & SPI_User_DC);
+  HAL_GPIO_SetLevel(D_CX_GPIO, dc);
+}
+
+void ILI9341_SPI_PostTransferCallback(HAL_SPI_Transaction_t *t)
+// Called from the SPI ISR. Accumulates the time for which the bus has had transactions in flight. Only queued transactions are counted:
+// those transmitted by ILI9341_SendCommand() and ILI9341_SendData() are waited for, and are not in SPI_NumTransactionsQueued.
+{
+  if (!((intptr_t)t->user & SPI_User_Queued))
+    return;
+  if (++SPI_NumTransactionsTransferred == SPI_NumTransactionsQueued)
+    Statistics.BusyTime_us += HAL_GetTime_us() - SPI_BusyStartTime_us;
 }
 
 void ILI9341_SetDefaults()
@@ -246,38 +264,36 @@ DRAM_ATTR static const ILI9341_InitializationCommand_t ILI9341_InitializationCom
     { 0, { 0 }, 0xff }
 };
 
-void ILI9341_Initialize(spi_host_device_t HostDevice, int i_ResetX_GPIO, int i_CSX_GPIO, int i_D_CX_GPIO, int i_BacklightX_GPIO)
+void ILI9341_Initialize(HAL_SPI_Host_t HostDevice, int i_ResetX_GPIO, int i_CSX_GPIO, int i_D_CX_GPIO, int i_BacklightX_GPIO)
 {
-  esp_err_t ret;
-
   D_CX_GPIO = i_D_CX_GPIO;
 
   // Attach the LCD to the SPI bus:
-  spi_device_interface_config_t devcfg =
+  HAL_SPI_DeviceConfiguration_t devcfg =
   {
-    .clock_speed_hz = 20000000, // Nominally 20000000. Can it be higher? Set to 10000000 for debugging with 24MHz logic analyzer.
-    .mode = 0, // SPI mode 0.
-    .spics_io_num = i_CSX_GPIO,
-    .queue_size = SPI_MaxNumTransactions,
-    .pre_cb = ILI9341_SPI_PreTransferCallback,  // Specify pre-transfer callback to set chip D/C pin.
-    .flags = SPI_DEVICE_HALFDUPLEX // JSB: Added. Required for high speed operation (above 26 MHz)?
+    .ClockSpeed_Hz = SPI_ClockSpeed_Hz,
+    .Mode = 0, // SPI mode 0.
+    .CSX_GPIO = i_CSX_GPIO,
+    .QueueSize = SPI_MaxNumTransactions,
+    .HalfDuplex = 1, // JSB: Added. Required for high speed operation (above 26 MHz)?
+    .PreTransferCallback = ILI9341_SPI_PreTransferCallback,  // Specify pre-transfer callback to set chip D/C pin.
+    .PostTransferCallback = ILI9341_SPI_PostTransferCallback
   };
-  ret = spi_bus_add_device(HostDevice, &devcfg, &spi);
-  assert(ret==ESP_OK);
+  HAL_SPI_AddDevice(HostDevice, &devcfg, &spi);
 
   int CommandIndex = 0;
   const ILI9341_InitializationCommand_t *pCommand;
 
   // Initialize the non-SPI GPIOs:
-  gpio_set_direction(i_D_CX_GPIO, GPIO_MODE_OUTPUT);
-  gpio_set_direction(i_ResetX_GPIO, GPIO_MODE_OUTPUT);
-  gpio_set_direction(i_BacklightX_GPIO, GPIO_MODE_OUTPUT);
+  HAL_GPIO_SetOutput(i_D_CX_GPIO);
+  HAL_GPIO_SetOutput(i_ResetX_GPIO);
+  HAL_GPIO_SetOutput(i_BacklightX_GPIO);
 
   // Reset the display:
-  gpio_set_level(i_ResetX_GPIO, 0);
-  vTaskDelay(100 / portTICK_PERIOD_MS); // !!!JSB: Longer than necessary?
-  gpio_set_level(i_ResetX_GPIO, 1);
-  vTaskDelay(100 / portTICK_PERIOD_MS); // !!!JSB: Longer than necessary?
+  HAL_GPIO_SetLevel(i_ResetX_GPIO, 0);
+  HAL_Delay_ms(100); // !!!JSB: Longer than necessary?
+  HAL_GPIO_SetLevel(i_ResetX_GPIO, 1);
+  HAL_Delay_ms(100); // !!!JSB: Longer than necessary?
 
   // Send the initialization commands:
   while (1)
@@ -291,13 +307,13 @@ void ILI9341_Initialize(spi_host_device_t HostDevice, int i_ResetX_GPIO, int i_C
     ILI9341_SendData(spi, pCommand->Data, pCommand->NumDataBytes & 0x1F);
 
     if (pCommand->NumDataBytes & 0x80)
-      vTaskDelay(100 / portTICK_PERIOD_MS);
+      HAL_Delay_ms(100);
 
     ++CommandIndex;
   }
 
   // Enable backlight:
-  gpio_set_level(i_BacklightX_GPIO, 1); // JSB: Displays vary as to whether they require 0 or 1 here.
+  HAL_GPIO_SetLevel(i_BacklightX_GPIO, 1); // JSB: Displays vary as to whether they require 0 or 1 here.
 }
 
 //void ILI9341_Initialize()
@@ -441,62 +457,99 @@ void ILI9341_Initialize(spi_host_device_t HostDevice, int i_ResetX_GPIO, int i_C
 //  ILI9341_CSX_High();
 //}
 
-static spi_transaction_t SPI_Transactions[SPI_MaxNumTransactions]; // These must persist for the duration of the transaction. Store them so that the DMA can access them.
-static int16_t SPI_NumTransactions = 0;
+static HAL_SPI_Transaction_t SPI_Transactions[SPI_MaxNumTransactions]; // Ring. These must persist for the duration of the transaction. Store them so that the DMA can access them.
+static uint32_t SPI_NumTransactionsCompleted = 0; // Results collected. Transactions complete in the order in which they are queued.
 
-void SPI_Transactions_AddToQueue(spi_transaction_t *i_pTransaction)
+void ILI9341_GetStatistics(ILI9341_Statistics_t *pStatistics)
 {
-  spi_transaction_t *pTransaction;
-  esp_err_t ret;
+  *pStatistics = Statistics;
+}
 
-  assert(SPI_NumTransactions < SPI_MaxNumTransactions);
+void ILI9341_ResetStatistics()
+{
+  memset(&Statistics, 0, sizeof(Statistics));
+}
 
-  pTransaction = &SPI_Transactions[SPI_NumTransactions];
+void ILI9341_GetThroughput(float *pPixelsPerSecond, float *pBusUtilization)
+// Bus utilization is the fraction of the time that transactions were in flight for which bits were actually being clocked.
+{
+  if (Statistics.BusyTime_us == 0)
+  {
+    *pPixelsPerSecond = 0.0f;
+    *pBusUtilization = 0.0f;
+    return;
+  }
 
-  *pTransaction = *i_pTransaction;
+  *pPixelsPerSecond = Statistics.NumPixels * 1000000.0f / Statistics.BusyTime_us;
+  *pBusUtilization = (Statistics.NumBytes * 8.0f / SPI_ClockSpeed_Hz) * 1000000.0f / Statistics.BusyTime_us;
+}
 
-  ret = spi_device_queue_trans(spi, pTransaction, portMAX_DELAY);
-  assert(ret==ESP_OK);
+static void SPI_Transactions_CollectResult()
+// Waits for the oldest transaction in flight to complete.
+{
+  HAL_SPI_CollectTransactionResult(spi);
 
-  ++SPI_NumTransactions;
+  ++SPI_NumTransactionsCompleted;
 }
 
-void SPI_Transactions_WaitForCompletion()
+static void SPI_Transactions_WaitUntilCompleted(uint32_t TransactionNumber)
 {
-  int16_t TransactionIndex;
-  spi_transaction_t *pTransaction;
-  esp_err_t ret;
+  while ((int32_t)(SPI_NumTransactionsCompleted - TransactionNumber) < 0)
+    SPI_Transactions_CollectResult();
+}
 
-  for (TransactionIndex = 0; TransactionIndex < SPI_NumTransactions; ++TransactionIndex)
-  {
-    ret = spi_device_get_trans_result(spi, &pTransaction, portMAX_DELAY);
-    assert(ret == ESP_OK);
-  }
+uint32_t SPI_Transactions_AddToQueue(HAL_SPI_Transaction_t *i_pTransaction)
+// Returns the transaction number, for use with SPI_Transactions_WaitUntilCompleted().
+// Only blocks if SPI_MaxNumTransactions transactions are already in flight.
+{
+  HAL_SPI_Transaction_t *pTransaction;
+
+  if (SPI_NumTransactionsQueued - SPI_NumTransactionsCompleted == SPI_MaxNumTransactions)
+    SPI_Transactions_CollectResult();
+
+  pTransaction = &SPI_Transactions[SPI_NumTransactionsQueued % SPI_MaxNumTransactions];
+
+  *pTransaction = *i_pTransaction;
+  pTransaction->user = (void *)((intptr_t)pTransaction->user | SPI_User_Queued);
 
-  SPI_NumTransactions = 0;
+  if (SPI_NumTransactionsTransferred == SPI_NumTransactionsQueued) // Bus idle.
+    SPI_BusyStartTime_us = HAL_GetTime_us();
+  ++SPI_NumTransactionsQueued;
+
+  HAL_SPI_QueueTransaction(spi, pTransaction);
+
+  ++Statistics.NumTransactions;
+  Statistics.NumBytes += pTransaction->length / 8;
+
+  return SPI_NumTransactionsQueued;
+}
+
+void SPI_Transactions_WaitForCompletion()
+{
+  SPI_Transactions_WaitUntilCompleted(SPI_NumTransactionsQueued);
 }
 
 static void ILI9341_SetColumnAddresses(int16_t X, int16_t Width)
 {
   int16_t X1, X2;
-  spi_transaction_t Transaction;
+  HAL_SPI_Transaction_t Transaction;
 
   X1 = X;
   X2 = X + Width - 1;
 
-  memset(&Transaction, 0, sizeof(spi_transaction_t));
+  memset(&Transaction, 0, sizeof(HAL_SPI_Transaction_t));
   Transaction.tx_data[0] = ILI9341_CASET; // Column address set
-  Transaction.flags = SPI_TRANS_USE_TXDATA;
+  Transaction.flags = HAL_SPI_TRANS_USE_TXDATA;
   Transaction.length = 8; // Data length (in bits)
   Transaction.user = (void *) 0; // Command.
   SPI_Transactions_AddToQueue(&Transaction);
   //
-  memset(&Transaction, 0, sizeof(spi_transaction_t));
+  memset(&Transaction, 0, sizeof(HAL_SPI_Transaction_t));
   Transaction.tx_data[0] = X1 >> 8; // Start column (High byte)
   Transaction.tx_data[1] = X1 & 0xFF; // Start column (Low byte)
   Transaction.tx_data[2] = X2 >> 8; // End column (High byte)
   Transaction.tx_data[3] = X2 & 0xFF; // End column (Low byte)
-  Transaction.flags = SPI_TRANS_USE_TXDATA;
+  Transaction.flags = HAL_SPI_TRANS_USE_TXDATA;
   Transaction.length = 4 * 8; // Data length (in bits)
   Transaction.user = (void *) 1; // Data
   SPI_Transactions_AddToQueue(&Transaction);
@@ -505,24 +558,24 @@ static void ILI9341_SetColumnAddresses(int16_t X, int16_t Width)
 static void ILI9341_SetPageAddresses(int16_t Y, int16_t Height)
 {
   int16_t Y1, Y2;
-  spi_transaction_t Transaction;
+  HAL_SPI_Transaction_t Transaction;
 
   Y1 = Y;
   Y2 = Y + Height - 1;
 
-  memset(&Transaction, 0, sizeof(spi_transaction_t));
+  memset(&Transaction, 0, sizeof(HAL_SPI_Transaction_t));
   Transaction.tx_data[0] = ILI9341_PASET; // Page address set
-  Transaction.flags = SPI_TRANS_USE_TXDATA;
+  Transaction.flags = HAL_SPI_TRANS_USE_TXDATA;
   Transaction.length = 8; // Data length (in bits)
   Transaction.user = (void *) 0; // Command
   SPI_Transactions_AddToQueue(&Transaction);
   //
-  memset(&Transaction, 0, sizeof(spi_transaction_t));
+  memset(&Transaction, 0, sizeof(HAL_SPI_Transaction_t));
   Transaction.tx_data[0] = Y1 >> 8; // Start page (High byte)
   Transaction.tx_data[1] = Y1 & 0xFF; // Start page (Low byte)
   Transaction.tx_data[2] = Y2 >> 8; // End page (High byte)
   Transaction.tx_data[3] = Y2 & 0xFF; // End page (Low byte)
-  Transaction.flags = SPI_TRANS_USE_TXDATA;
+  Transaction.flags = HAL_SPI_TRANS_USE_TXDATA;
   Transaction.length = 4 * 8; // Data length (in bits)
   Transaction.user = (void *) 1; // Data
   SPI_Transactions_AddToQueue(&Transaction);
@@ -530,32 +583,128 @@ static void ILI9341_SetPageAddresses(int16_t Y, int16_t Height)
 
 static void ILI9341_RAMWrite_ComandOnly()
 {
-  spi_transaction_t Transaction;
+  HAL_SPI_Transaction_t Transaction;
 
-  memset(&Transaction, 0, sizeof(spi_transaction_t));
+  memset(&Transaction, 0, sizeof(HAL_SPI_Transaction_t));
   Transaction.tx_data[0] = ILI9341_RAMWR;
-  Transaction.flags = SPI_TRANS_USE_TXDATA;
+  Transaction.flags = HAL_SPI_TRANS_USE_TXDATA;
   Transaction.length = 8; // Data length (in bits)
   Transaction.user = (void *) 0; // Command
   SPI_Transactions_AddToQueue(&Transaction);
 }
 
-static void ILI9341_RAMWrite_DataOnly(uint16_t *pPixels, int16_t NumPixels)
+static uint32_t ILI9341_RAMWrite_DataOnly(uint16_t *pPixels, int16_t NumPixels)
+// Returns the transaction number.
 {
-  spi_transaction_t Transaction;
+  HAL_SPI_Transaction_t Transaction;
+  uint32_t TransactionNumber;
 
-  memset(&Transaction, 0, sizeof(spi_transaction_t));
+  memset(&Transaction, 0, sizeof(HAL_SPI_Transaction_t));
   Transaction.tx_buffer = pPixels;
   Transaction.flags = 0;
   Transaction.length = 2 * NumPixels * 8;
   Transaction.user = (void *) 1; // Data
-  SPI_Transactions_AddToQueue(&Transaction);
+  TransactionNumber = SPI_Transactions_AddToQueue(&Transaction);
+
+  Statistics.NumPixels += NumPixels;
+
+  return TransactionNumber;
 }
 
-static void ILI9341_RAMWrite(uint16_t *pPixels, int16_t NumPixels)
+void ILI9341_RAMWrite_Begin(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height)
+// Acquires the bus and opens a window. Follow with ILI9341_RAMWrite_Pixels_MSBFirst() calls totalling Width * Height pixels, then ILI9341_RAMWrite_End().
 {
+  HAL_SPI_AcquireBus(spi);
+  ILI9341_SetColumnAddresses(X, Width);
+  ILI9341_SetPageAddresses(Y, Height);
   ILI9341_RAMWrite_ComandOnly();
-  ILI9341_RAMWrite_DataOnly(pPixels, NumPixels);
+}
+
+WORD_ALIGNED_ATTR static uint16_t PixelBuffers[PixelBuffer_NumBuffers][ILI9341_PixelBuffer_MaxNumPixels];
+static uint32_t PixelBuffer_TransactionNumbers[PixelBuffer_NumBuffers]; // Last transaction to use each buffer.
+static uint8_t PixelBuffer_NextIndex = 0;
+
+uint16_t *ILI9341_AcquirePixelBuffer()
+// Returns a DMA-capable buffer of ILI9341_PixelBuffer_MaxNumPixels pixels that may be filled by the caller.
+// The buffers are used in rotation, so only waits if the DMA has not yet finished with the buffer from PixelBuffer_NumBuffers calls ago.
+{
+  uint8_t Index = PixelBuffer_NextIndex;
+
+  PixelBuffer_NextIndex = (PixelBuffer_NextIndex + 1) % PixelBuffer_NumBuffers;
+  SPI_Transactions_WaitUntilCompleted(PixelBuffer_TransactionNumbers[Index]);
+  return PixelBuffers[Index];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Glyph arena:
+//
+// Static, DMA-capable scratch memory for rasterizing glyphs, so that drawing text does not use the heap.
+// Each slot holds the largest glyph cell of any font that may be passed to ILI9341_SetFont().
+
+WORD_ALIGNED_ATTR static uint16_t GlyphArena[GlyphArena_NumSlots][ILI9341_GlyphArena_MaxNumPixels];
+static uint32_t GlyphArena_TransactionNumbers[GlyphArena_NumSlots]; // Last transaction to use each slot.
+static uint8_t GlyphArena_NextSlot = 0;
+
+static uint16_t *GlyphArena_Acquire(uint16_t NumPixels)
+// Returns NULL if the glyph does not fit.
+{
+  uint8_t Slot = GlyphArena_NextSlot;
+
+  if (NumPixels > ILI9341_GlyphArena_MaxNumPixels)
+    return NULL;
+
+  GlyphArena_NextSlot = (GlyphArena_NextSlot + 1) % GlyphArena_NumSlots;
+  SPI_Transactions_WaitUntilCompleted(GlyphArena_TransactionNumbers[Slot]);
+  return GlyphArena[Slot];
+}
+
+static uint32_t *GetBufferTransactionNumber(const uint16_t *pPixels)
+// Returns NULL if pPixels is not one of the driver's own buffers, which are tracked so that they can be sent without waiting.
+{
+  for (uint8_t Index = 0; Index < PixelBuffer_NumBuffers; ++Index)
+    if (pPixels == PixelBuffers[Index])
+      return &PixelBuffer_TransactionNumbers[Index];
+
+  for (uint8_t Slot = 0; Slot < GlyphArena_NumSlots; ++Slot)
+    if (pPixels == GlyphArena[Slot])
+      return &GlyphArena_TransactionNumbers[Slot];
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ILI9341_RAMWrite_Pixels_MSBFirst(uint16_t *pPixels, uint16_t NumPixels)
+// Supplied pixel data must be byte swapped and must remain untouched until the transaction has completed.
+// Pixels in the driver's own buffers (e.g. from ILI9341_AcquirePixelBuffer()) are sent without waiting. Other pixels are waited for.
+{
+  uint32_t TransactionNumber;
+  uint32_t *pTransactionNumber;
+
+  if (NumPixels == 0)
+    return;
+
+  TransactionNumber = ILI9341_RAMWrite_DataOnly(pPixels, NumPixels);
+
+  pTransactionNumber = GetBufferTransactionNumber(pPixels);
+  if (pTransactionNumber)
+    *pTransactionNumber = TransactionNumber;
+  else
+    SPI_Transactions_WaitForCompletion();
+}
+
+void ILI9341_RAMWrite_End()
+{
+  SPI_Transactions_WaitForCompletion();
+  HAL_SPI_ReleaseBus(spi);
+}
+
+static void ILI9341_DrawPixels_MSBFirst_Direct(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t *pPixels)
+{
+  ILI9341_SetColumnAddresses(X, Width);
+  ILI9341_SetPageAddresses(Y, Height);
+  ILI9341_RAMWrite_ComandOnly();
+  ILI9341_RAMWrite_Pixels_MSBFirst(pPixels, Width * Height); // Only waits if pPixels is not one of the driver's own buffers.
 }
 
 void ILI9341_DrawPixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t *pPixels)
@@ -564,10 +713,13 @@ void ILI9341_DrawPixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_
   if ((Width == 0) || (Height == 0))
     return;
 
-  ILI9341_SetColumnAddresses(X, Width);
-  ILI9341_SetPageAddresses(Y, Height);
-  ILI9341_RAMWrite(pPixels, Width * Height);
-  SPI_Transactions_WaitForCompletion(); // !!! Keep this?
+  if (ILI9341_Compositor_IsEnabled())
+  {
+    ILI9341_Compositor_DrawPixels_MSBFirst(X, Y, Width, Height, pPixels);
+    return;
+  }
+
+  ILI9341_DrawPixels_MSBFirst_Direct(X, Y, Width, Height, pPixels);
 }
 
 void ILI9341_DrawPixel(int16_t X, int16_t Y, uint16_t Color)
@@ -579,45 +731,42 @@ void ILI9341_DrawPixel(int16_t X, int16_t Y, uint16_t Color)
   SPI_Transactions_WaitForCompletion();
 }
 
-#define PixelBuffer_MaxNumPixels 512
-static uint16_t PixelBuffer[PixelBuffer_MaxNumPixels];
-
 void ILI9341_DrawBar(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Color)
 {
   uint32_t RemainingNumPixelsToSend, NumPixelsToSetupInPixelBuffer, NumPixelsToSend;
   uint16_t Color_MSBFirst;
+  uint16_t *pPixelBuffer;
 
   if ((Width == 0) || (Height == 0))
     return;
 
+  if (ILI9341_Compositor_IsEnabled())
+  {
+    ILI9341_Compositor_DrawBar(X, Y, Width, Height, Color);
+    return;
+  }
+
   ESP_LOGV(LOG_TAG, "DrawBar: Begin");
-	{
-		RemainingNumPixelsToSend = Width * Height;
-		NumPixelsToSetupInPixelBuffer = min32(RemainingNumPixelsToSend, PixelBuffer_MaxNumPixels);
-
-		// Setup buffer:
-		Color_MSBFirst = ILI9341_SwapBytes(Color);
-		for (int16_t PixelIndex = 0; PixelIndex < NumPixelsToSetupInPixelBuffer; ++PixelIndex)
-			PixelBuffer[PixelIndex] = Color_MSBFirst;
-
-		ESP_ERROR_CHECK(spi_device_acquire_bus(spi, portMAX_DELAY));
-		{
-		// Setup chip addresses:
-		ILI9341_SetColumnAddresses(X, Width);
-		ILI9341_SetPageAddresses(Y, Height);
-
-		// Send pixels:
-		ILI9341_RAMWrite_ComandOnly();
-		while (RemainingNumPixelsToSend > 0)
-		{
-				NumPixelsToSend = min32(RemainingNumPixelsToSend, PixelBuffer_MaxNumPixels);
-			ILI9341_RAMWrite_DataOnly(PixelBuffer, NumPixelsToSend);
-			SPI_Transactions_WaitForCompletion(); // Wait here so that PixelBuffer is not overwritten before the DMA has finished with it.
-			RemainingNumPixelsToSend -= NumPixelsToSend;
-		}
-		}
-		spi_device_release_bus(spi);
-	}
+  {
+    RemainingNumPixelsToSend = Width * Height;
+    NumPixelsToSetupInPixelBuffer = min32(RemainingNumPixelsToSend, ILI9341_PixelBuffer_MaxNumPixels);
+
+    // Setup buffer:
+    pPixelBuffer = ILI9341_AcquirePixelBuffer();
+    Color_MSBFirst = ILI9341_SwapBytes(Color);
+    for (int16_t PixelIndex = 0; PixelIndex < NumPixelsToSetupInPixelBuffer; ++PixelIndex)
+      pPixelBuffer[PixelIndex] = Color_MSBFirst;
+
+    // Send pixels. Every chunk has the same content, so the one buffer is queued repeatedly without waiting:
+    ILI9341_RAMWrite_Begin(X, Y, Width, Height);
+    while (RemainingNumPixelsToSend > 0)
+    {
+      NumPixelsToSend = min32(RemainingNumPixelsToSend, ILI9341_PixelBuffer_MaxNumPixels);
+      ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, NumPixelsToSend);
+      RemainingNumPixelsToSend -= NumPixelsToSend;
+    }
+    ILI9341_RAMWrite_End();
+  }
   ESP_LOGV(LOG_TAG, "DrawBar: End");
 }
 
@@ -626,12 +775,80 @@ void ILI9341_Clear(uint16_t Color)
   ILI9341_DrawBar(0, 0, ILI9341_Width, ILI9341_Height, Color);
 }
 
+uint16_t ILI9341_GetFontMaxGlyphNumPixels(const GFXfont *i_pFont)
+// Returns the number of pixels needed to rasterize the largest glyph of the font in any text draw mode.
+{
+  uint16_t Result = 0;
+  uint16_t CharHeight = i_pFont->yOffsetMax - i_pFont->yOffsetMin + 1;
+
+  for (uint16_t GlyphIndex = 0; GlyphIndex <= i_pFont->last - i_pFont->first; ++GlyphIndex)
+  {
+    const GFXglyph *pGlyph = &i_pFont->pGlyph[GlyphIndex];
+    uint16_t ThisCharBarNumPixels = pGlyph->width * pGlyph->height;
+    uint16_t AnyCharBarNumPixels = pGlyph->xAdvance * CharHeight;
+
+    if (ThisCharBarNumPixels > Result)
+      Result = ThisCharBarNumPixels;
+    if (AnyCharBarNumPixels > Result)
+      Result = AnyCharBarNumPixels;
+  }
+
+  return Result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Text metrics:
+//
+// Width of every char of recently used fonts, so that measuring text (e.g. for tpCentre and tpRight) is one table lookup per char.
+
+#define TextMetrics_NumFonts 4
+
+typedef struct
+{
+  const GFXfont *pFont;
+  uint8_t CharWidths[256]; // Indexed by char. 0 for non printing chars.
+} TextMetrics_t;
+
+static TextMetrics_t TextMetrics[TextMetrics_NumFonts];
+static uint8_t TextMetrics_NextIndex = 0;
+static const TextMetrics_t *pTextMetrics = NULL; // For pFont.
+
+static const TextMetrics_t *GetTextMetrics(const GFXfont *i_pFont)
+{
+  TextMetrics_t *pMetrics;
+
+  for (uint8_t Index = 0; Index < TextMetrics_NumFonts; ++Index)
+    if (TextMetrics[Index].pFont == i_pFont)
+      return &TextMetrics[Index];
+
+  pMetrics = &TextMetrics[TextMetrics_NextIndex];
+  TextMetrics_NextIndex = (TextMetrics_NextIndex + 1) % TextMetrics_NumFonts;
+
+  // Checked here, rather than on every ILI9341_SetFont(), as it looks at every glyph:
+  if (ILI9341_GetFontMaxGlyphNumPixels(i_pFont) > ILI9341_GlyphArena_MaxNumPixels)
+    ESP_LOGE(LOG_TAG, "Font needs %d pixel glyph arena. Increase ILI9341_GlyphArena_MaxNumPixels.", ILI9341_GetFontMaxGlyphNumPixels(i_pFont));
+
+  memset(pMetrics, 0, sizeof(*pMetrics));
+  pMetrics->pFont = i_pFont;
+  for (uint16_t Ch = i_pFont->first; Ch <= i_pFont->last; ++Ch)
+  {
+    const GFXglyph *pGlyph = &i_pFont->pGlyph[Ch - i_pFont->first];
+
+    pMetrics->CharWidths[Ch] = pGlyph->width ? pGlyph->xOffset + pGlyph->width : pGlyph->xAdvance; // As the X advance returned by ILI9341_DrawCharAtXY().
+  }
+
+  return pMetrics;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
 const GFXfont *ILI9341_SetFont(const GFXfont *i_pFont)
 {
   const GFXfont *Result;
 
   Result = pFont;
   pFont = i_pFont;
+  pTextMetrics = pFont ? GetTextMetrics(pFont) : NULL;
   return Result;
 }
 
@@ -645,39 +862,422 @@ static uint8_t IsNonPrintingChar(uint8_t Ch)
   return ((Ch < pFont->first) || (Ch > pFont->last));
 }
 
-uint16_t GetCharWidth(uint8_t Ch)
+uint16_t ILI9341_GetCharWidth(uint8_t Ch)
 {
-  if (IsNonPrintingChar(Ch))
+  if (!pTextMetrics)
     return 0;
 
-  Ch -= pFont->first;
-  GFXglyph *pGlyph = &pFont->pGlyph[Ch];
-  uint8_t w = pGlyph->width;
-  int8_t xo = pGlyph->xOffset;
-
-  if (w == 0)
-    return pGlyph->xAdvance;
-
-  return xo + w;
+  return pTextMetrics->CharWidths[Ch];
 }
 
 uint16_t ILI9341_GetTextWidth(const char *Text)
 {
-  uint16_t TotalWidth, NumChars;
-  const char *pText;
+  uint16_t TotalWidth;
+  const uint8_t *pText;
 
-  NumChars = strlen(Text);
+  if (!pTextMetrics)
+    return 0;
 
-  pText = Text;
+  pText = (const uint8_t *)Text;
 
-  TotalWidth=0;
+  TotalWidth = 0;
 
-  for (uint16_t CharIndex = 0; CharIndex < NumChars; ++CharIndex)
-    TotalWidth += GetCharWidth(*pText++);
+  while (*pText)
+    TotalWidth += pTextMetrics->CharWidths[*pText++];
 
   return TotalWidth;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Glyph run reader:
+//
+// Returns the horizontal runs of set pixels of a glyph, in any font format (see gfxfont.h), so that glyphs are drawn by filling spans.
+// gffAntialiased4bpp pixels count as set if they are at least half covered. This is only used where there is no known background to blend against.
+
+typedef struct
+{
+  const GFXglyph *pGlyph;
+  const uint8_t *pData; // Glyph data.
+  uint16_t PixelIndex; // gffBitmap and gffAntialiased4bpp.
+  const uint8_t *pRow, *pPreviousRow; // gffRuns. pRow is NULL between rows.
+  uint8_t Row, X;
+} GlyphRunReader_t;
+
+static void GlyphRunReader_Begin(GlyphRunReader_t *pReader, const GFXglyph *pGlyph)
+{
+  memset(pReader, 0, sizeof(*pReader));
+  pReader->pGlyph = pGlyph;
+  pReader->pData = &pFont->pBitmap[pGlyph->bitmapOffset];
+}
+
+static uint8_t GetGlyphAlpha(const uint8_t *pData, uint16_t PixelIndex)
+// gffAntialiased4bpp.
+{
+  return (PixelIndex & 1) ? pData[PixelIndex >> 1] & 0x0F : pData[PixelIndex >> 1] >> 4;
+}
+
+static uint8_t GlyphRunReader_IsPixelSet(const GlyphRunReader_t *pReader)
+// gffBitmap and gffAntialiased4bpp.
+{
+  if (pFont->format == gffAntialiased4bpp)
+    return GetGlyphAlpha(pReader->pData, pReader->PixelIndex) >= 8;
+  return pReader->pData[pReader->PixelIndex >> 3] & (0x80 >> (pReader->PixelIndex & 7));
+}
+
+static uint8_t GlyphRunReader_Next(GlyphRunReader_t *pReader, uint8_t *pRow, uint8_t *pX, uint8_t *pLength)
+// Returns 0 when there are no more runs. Runs are returned row by row, left to right, and adjacent runs are merged.
+{
+  uint8_t w = pReader->pGlyph->width, h = pReader->pGlyph->height;
+
+  if (pFont->format == gffRuns)
+  {
+    while (pReader->Row < h)
+    {
+      uint8_t RunByte, Length;
+
+      if (!pReader->pRow) // Start of row.
+      {
+        if (*pReader->pData == 0x00) // Repeated row.
+        {
+          pReader->pRow = pReader->pPreviousRow;
+          ++pReader->pData;
+        }
+        else
+          pReader->pRow = pReader->pPreviousRow = pReader->pData;
+        pReader->X = 0;
+      }
+
+      RunByte = *pReader->pRow++;
+      pReader->X += (RunByte >> 4) & 7;
+      Length = RunByte & 15;
+      while (!(RunByte & 0x80) && !(*pReader->pRow & 0x70)) // Continued run.
+      {
+        RunByte = *pReader->pRow++;
+        Length += RunByte & 15;
+      }
+
+      *pRow = pReader->Row;
+      *pX = pReader->X;
+      *pLength = Length;
+      pReader->X += Length;
+
+      if (RunByte & 0x80) // End of row.
+      {
+        if (pReader->pRow > pReader->pData)
+          pReader->pData = pReader->pRow;
+        pReader->pRow = NULL;
+        ++pReader->Row;
+      }
+
+      if (Length)
+        return 1;
+    }
+    return 0;
+  }
+
+  while (pReader->Row < h)
+  {
+    while ((pReader->X < w) && !GlyphRunReader_IsPixelSet(pReader))
+    {
+      ++pReader->X;
+      ++pReader->PixelIndex;
+    }
+
+    if (pReader->X < w)
+    {
+      *pRow = pReader->Row;
+      *pX = pReader->X;
+      while ((pReader->X < w) && GlyphRunReader_IsPixelSet(pReader))
+      {
+        ++pReader->X;
+        ++pReader->PixelIndex;
+      }
+      *pLength = pReader->X - *pX;
+      return 1;
+    }
+
+    ++pReader->Row;
+    pReader->X = 0;
+  }
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define GlyphSpans_MaxNumOpenRectangles 16
+
+typedef struct
+{
+  uint8_t X, Width, Top;
+} GlyphSpan_Rectangle_t;
+
+static void DrawGlyphSpanRectangle(uint16_t X, uint16_t Y, const GlyphSpan_Rectangle_t *pRectangle, uint8_t Bottom, uint16_t Color, uint16_t *pColors)
+{
+  uint16_t Height = Bottom - pRectangle->Top;
+
+  if (!pColors) // Compositing.
+  {
+    ILI9341_Compositor_DrawBar(X + pRectangle->X, Y + pRectangle->Top, pRectangle->Width, Height, Color);
+    return;
+  }
+
+  ILI9341_SetColumnAddresses(X + pRectangle->X, pRectangle->Width);
+  ILI9341_SetPageAddresses(Y + pRectangle->Top, Height);
+  ILI9341_RAMWrite_ComandOnly();
+  ILI9341_RAMWrite_Pixels_MSBFirst(pColors, pRectangle->Width * Height);
+}
+
+static void DrawGlyphSpans(const GFXglyph *pGlyph, uint16_t X, uint16_t Y, uint16_t Color)
+// Draws only the set pixels of a glyph.
+// Each horizontal run of set pixels becomes a window. A run with the same extent as a run in the row above extends that run's window downwards.
+// All the windows are queued before waiting.
+{
+  uint8_t w = pGlyph->width, h = pGlyph->height;
+  GlyphRunReader_t Reader;
+  GlyphSpan_Rectangle_t Run;
+  uint8_t HaveRun, RunRow;
+  uint16_t *pColors = NULL;
+  GlyphSpan_Rectangle_t OpenRectangles[2][GlyphSpans_MaxNumOpenRectangles];
+  uint8_t NumOpenRectangles[2] = { 0, 0 };
+  uint8_t Current = 0;
+  uint8_t MergeRows = (w * h <= ILI9341_PixelBuffer_MaxNumPixels); // Otherwise a window could be larger than the buffer of colors.
+
+  if ((w == 0) || (h == 0))
+    return;
+
+  if (ILI9341_Compositor_IsEnabled())
+    ILI9341_Compositor_BeginFrame();
+  else
+  {
+    uint16_t Color_MSBFirst = ILI9341_SwapBytes(Color);
+
+    pColors = ILI9341_AcquirePixelBuffer(); // A window is at most w * h pixels, or w pixels if rows are not merged.
+    for (uint16_t PixelIndex = 0; PixelIndex < (MergeRows ? w * h : w); ++PixelIndex)
+      pColors[PixelIndex] = Color_MSBFirst;
+
+    HAL_SPI_AcquireBus(spi);
+  }
+
+  GlyphRunReader_Begin(&Reader, pGlyph);
+  HaveRun = GlyphRunReader_Next(&Reader, &RunRow, &Run.X, &Run.Width);
+
+  for (uint8_t yy = 0; yy <= h; ++yy) // Extra row closes the remaining rectangles.
+  {
+    GlyphSpan_Rectangle_t *pPrevious = OpenRectangles[Current];
+    GlyphSpan_Rectangle_t *pNext = OpenRectangles[!Current];
+    uint8_t NumPrevious = NumOpenRectangles[Current], NumNext = 0;
+
+    for (; HaveRun && (RunRow == yy); HaveRun = GlyphRunReader_Next(&Reader, &RunRow, &Run.X, &Run.Width))
+    {
+      Run.Top = yy;
+
+      for (uint8_t Index = 0; MergeRows && (Index < NumPrevious); ++Index)
+      {
+        if ((pPrevious[Index].X == Run.X) && (pPrevious[Index].Width == Run.Width))
+        {
+          Run.Top = pPrevious[Index].Top;
+          pPrevious[Index].Width = 0; // Carried forward.
+          break;
+        }
+      }
+
+      if (NumNext < GlyphSpans_MaxNumOpenRectangles)
+        pNext[NumNext++] = Run;
+      else
+        DrawGlyphSpanRectangle(X, Y, &Run, yy + 1, Color, pColors);
+    }
+
+    for (uint8_t Index = 0; Index < NumPrevious; ++Index)
+      if (pPrevious[Index].Width)
+        DrawGlyphSpanRectangle(X, Y, &pPrevious[Index], yy, Color, pColors);
+
+    NumOpenRectangles[!Current] = NumNext;
+    Current = !Current;
+  }
+
+  if (pColors)
+    ILI9341_RAMWrite_End();
+  else
+    ILI9341_Compositor_EndFrame();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Blend tables:
+//
+// The 16 colors from a text background color (level 0) to a text color (level 15), MSB first, for gffAntialiased4bpp fonts.
+// 1-bpp fonts use levels 0 and 15 only. Recently used tables are kept, so a redraw in the same colors does not recompute them.
+
+#define BlendTable_NumTables 4
+
+typedef struct
+{
+  uint8_t Valid;
+  uint16_t Color, BackgroundColor;
+  uint16_t Levels_MSBFirst[16];
+} BlendTable_t;
+
+static BlendTable_t BlendTables[BlendTable_NumTables];
+static uint8_t BlendTable_NextIndex = 0;
+
+static const uint16_t *GetBlendTable(uint16_t Color, uint16_t BackgroundColor)
+{
+  BlendTable_t *pTable;
+
+  for (uint8_t Index = 0; Index < BlendTable_NumTables; ++Index)
+  {
+    pTable = &BlendTables[Index];
+    if (pTable->Valid && (pTable->Color == Color) && (pTable->BackgroundColor == BackgroundColor))
+      return pTable->Levels_MSBFirst;
+  }
+
+  pTable = &BlendTables[BlendTable_NextIndex];
+  BlendTable_NextIndex = (BlendTable_NextIndex + 1) % BlendTable_NumTables;
+
+  pTable->Valid = 1;
+  pTable->Color = Color;
+  pTable->BackgroundColor = BackgroundColor;
+  for (uint8_t Level = 0; Level < 16; ++Level)
+  {
+    uint16_t R = ((BackgroundColor >> 11) * (15 - Level) + (Color >> 11) * Level + 7) / 15;
+    uint16_t G = (((BackgroundColor >> 5) & 0x3F) * (15 - Level) + ((Color >> 5) & 0x3F) * Level + 7) / 15;
+    uint16_t B = ((BackgroundColor & 0x1F) * (15 - Level) + (Color & 0x1F) * Level + 7) / 15;
+
+    pTable->Levels_MSBFirst[Level] = ILI9341_SwapBytes((R << 11) | (G << 5) | B);
+  }
+
+  return pTable->Levels_MSBFirst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void FillGlyphSpan(uint16_t *pRow, int16_t Left, int16_t Right, int16_t MinX, int16_t MaxX, uint16_t Color_MSBFirst)
+// Fills [Left, Right) of a row, clipped to [MinX, MaxX).
+{
+  if (Left < MinX)
+    Left = MinX;
+  if (Right > MaxX)
+    Right = MaxX;
+  for (int16_t X = Left; X < Right; ++X)
+    pRow[X] = Color_MSBFirst;
+}
+
+static void RasterizeGlyphPixels(const GFXglyph *pGlyph, uint16_t *pPixels, uint16_t Stride, int16_t X0, int16_t Y0, int16_t MinX, int16_t MaxX, int16_t NumRows, const uint16_t *pLevels_MSBFirst)
+// Draws the glyph's pixels with its top left corner at (X0, Y0) of a block Stride pixels wide, clipped to columns [MinX, MaxX) and rows [0, NumRows). Some glyphs extend beyond their cell.
+// Uncovered pixels are left as they are, so the caller fills the background first.
+{
+  if (pFont->format == gffAntialiased4bpp)
+  {
+    const uint8_t *pData = &pFont->pBitmap[pGlyph->bitmapOffset];
+    uint16_t PixelIndex = 0;
+
+    for (int16_t yy = 0; yy < pGlyph->height; ++yy)
+    {
+      int16_t Row = Y0 + yy;
+
+      if ((Row < 0) || (Row >= NumRows))
+      {
+        PixelIndex += pGlyph->width;
+        continue;
+      }
+
+      for (int16_t xx = 0; xx < pGlyph->width; ++xx, ++PixelIndex)
+      {
+        uint8_t Alpha = GetGlyphAlpha(pData, PixelIndex);
+        int16_t X = X0 + xx;
+
+        if (Alpha && (X >= MinX) && (X < MaxX))
+          pPixels[Row * Stride + X] = pLevels_MSBFirst[Alpha];
+      }
+    }
+    return;
+  }
+
+  GlyphRunReader_t Reader;
+  uint8_t GlyphRow, GlyphX, Length;
+
+  GlyphRunReader_Begin(&Reader, pGlyph);
+  while (GlyphRunReader_Next(&Reader, &GlyphRow, &GlyphX, &Length))
+  {
+    int16_t Row = Y0 + GlyphRow;
+
+    if ((Row >= 0) && (Row < NumRows))
+      FillGlyphSpan(&pPixels[Row * Stride], X0 + GlyphX, X0 + GlyphX + Length, MinX, MaxX, pLevels_MSBFirst[15]);
+  }
+}
+
+static void RasterizeGlyph(const GFXglyph *pGlyph, const uint16_t *pLevels_MSBFirst, uint16_t *pPixels)
+// Rasterizes the glyph's own bounding box (tdmThisCharBar).
+{
+  for (uint16_t PixelIndex = 0; PixelIndex < pGlyph->width * pGlyph->height; ++PixelIndex)
+    pPixels[PixelIndex] = pLevels_MSBFirst[0];
+
+  RasterizeGlyphPixels(pGlyph, pPixels, pGlyph->width, 0, 0, 0, pGlyph->width, pGlyph->height, pLevels_MSBFirst);
+}
+
+static void RasterizeGlyphCell(const GFXglyph *pGlyph, const uint16_t *pLevels_MSBFirst, uint16_t *pPixels)
+// Rasterizes the glyph's whole character cell (tdmAnyCharBar): xAdvance wide and as high as the font's tallest glyph.
+{
+  uint8_t CharWidth = pGlyph->xAdvance;
+  uint8_t CharHeight = pFont->yOffsetMax - pFont->yOffsetMin + 1;
+
+  for (uint16_t PixelIndex = 0; PixelIndex < CharWidth * CharHeight; ++PixelIndex)
+    pPixels[PixelIndex] = pLevels_MSBFirst[0];
+
+  RasterizeGlyphPixels(pGlyph, pPixels, CharWidth, pGlyph->xOffset, - pFont->yOffsetMin + pGlyph->yOffset, 0, CharWidth, CharHeight, pLevels_MSBFirst);
+}
+
+static uint16_t *GetRasterizedGlyph(const GFXglyph *pGlyph, TextDrawMode_t Kind, uint16_t Color, uint8_t *pCached)
+// Kind: tdmThisCharBar or tdmAnyCharBar.
+// Returns the glyph's pixels from the glyph cache if possible, otherwise rasterized into the cache or the glyph arena. Returns NULL if neither can hold it.
+// *pCached is set if the pixels are in the glyph cache, in which case they may be sent without waiting.
+{
+  uint16_t NumPixels;
+  uint16_t *pPixels;
+
+  if (Kind == tdmThisCharBar)
+    NumPixels = pGlyph->width * pGlyph->height;
+  else
+    NumPixels = pGlyph->xAdvance * (pFont->yOffsetMax - pFont->yOffsetMin + 1);
+
+  pPixels = ILI9341_GlyphCache_Find(pGlyph, Kind, Color, TextBackgroundColor);
+  *pCached = (pPixels != NULL);
+  if (pPixels)
+    return pPixels;
+
+  if (ILI9341_GlyphCache_IsEnabled())
+  {
+    SPI_Transactions_WaitForCompletion(); // Inserting may evict entries that are still being sent.
+    pPixels = ILI9341_GlyphCache_Insert(pGlyph, Kind, Color, TextBackgroundColor, NumPixels);
+    *pCached = (pPixels != NULL);
+  }
+  if (!pPixels)
+    pPixels = GlyphArena_Acquire(NumPixels);
+  if (!pPixels)
+    return NULL;
+
+  if (Kind == tdmThisCharBar)
+    RasterizeGlyph(pGlyph, GetBlendTable(Color, TextBackgroundColor), pPixels);
+  else
+    RasterizeGlyphCell(pGlyph, GetBlendTable(Color, TextBackgroundColor), pPixels);
+
+  return pPixels;
+}
+
+static void DrawGlyphPixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t *pPixels, uint8_t Cached)
+// Pixels in the glyph cache are queued without waiting, as they are not modified until evicted.
+{
+  if (!Cached || (Width == 0) || (Height == 0) || ILI9341_Compositor_IsEnabled())
+  {
+    ILI9341_DrawPixels_MSBFirst(X, Y, Width, Height, pPixels);
+    return;
+  }
+
+  ILI9341_SetColumnAddresses(X, Width);
+  ILI9341_SetPageAddresses(Y, Height);
+  ILI9341_RAMWrite_ComandOnly();
+  ILI9341_RAMWrite_DataOnly(pPixels, Width * Height);
+}
+
 uint8_t ILI9341_DrawCharAtXY(uint8_t Ch, uint16_t X, uint16_t Y, uint16_t Color)
 // X: X position of left edge of char.
 // Y: Y position of line on which the char sits. The char may go below this line (e.g. g j p q y).
@@ -691,17 +1291,13 @@ uint8_t ILI9341_DrawCharAtXY(uint8_t Ch, uint16_t X, uint16_t Y, uint16_t Color)
 
   Ch -= pFont->first;
   GFXglyph *pGlyph = &pFont->pGlyph[Ch];
-  uint8_t *pBitmap = pFont->pBitmap;
 
-  uint16_t bo = pGlyph->bitmapOffset;
   uint8_t w = pGlyph->width, h = pGlyph->height;
   int8_t xo = pGlyph->xOffset, yo = pGlyph->yOffset;
-  uint8_t xx, yy, bits = 0, bit = 0;
   int8_t yo_min = pFont->yOffsetMin, yo_max = pFont->yOffsetMax;
 
-  uint16_t Color_MSBFirst, TextBackgroundColor_MSBFirst;
-  uint16_t *pMemChar, *pMemCharPixel;
-  uint8_t CharWidth, CharHeight;
+  uint16_t *pMemChar;
+  uint8_t Cached;
 
   switch(TextDrawMode)
   {
@@ -709,70 +1305,19 @@ uint8_t ILI9341_DrawCharAtXY(uint8_t Ch, uint16_t X, uint16_t Y, uint16_t Color)
       break;
 
     case tdmThisCharBar:
-      Color_MSBFirst = ILI9341_SwapBytes(Color);
-      TextBackgroundColor_MSBFirst = ILI9341_SwapBytes(TextBackgroundColor);
-      pMemChar = (uint16_t *)malloc(w * h * 2);
-      pMemCharPixel = pMemChar;
-
-      for (yy = 0; yy < h; ++yy)
-      {
-        for (xx = 0; xx < w; ++xx)
-        {
-          if (!(bit++ & 7))
-            bits = pBitmap[bo++];
-          *pMemCharPixel = bits & 0x80 ? Color_MSBFirst : TextBackgroundColor_MSBFirst;
-          ++pMemCharPixel;
-          bits <<= 1;
-        }
-      }
-      ILI9341_DrawPixels_MSBFirst(X + xo, Y + yo, w, h, pMemChar);
-      SPI_Transactions_WaitForCompletion();
-      free(pMemChar);
+      pMemChar = GetRasterizedGlyph(pGlyph, tdmThisCharBar, Color, &Cached);
+      if (pMemChar)
+        DrawGlyphPixels_MSBFirst(X + xo, Y + yo, w, h, pMemChar, Cached);
       break;
 
     case tdmAnyCharBar:
-      Color_MSBFirst = ILI9341_SwapBytes(Color);
-      TextBackgroundColor_MSBFirst = ILI9341_SwapBytes(TextBackgroundColor);
-      CharWidth = pGlyph->xAdvance;
-      CharHeight = yo_max - yo_min + 1;
-      pMemChar = (uint16_t *)malloc(CharWidth * CharHeight * sizeof(uint16_t));
-
-      // Slow?
-      pMemCharPixel = pMemChar;
-      for (uint16_t PixelIndex = 0; PixelIndex < CharWidth * CharHeight; ++PixelIndex)
-        *pMemCharPixel++ = TextBackgroundColor_MSBFirst;
-
-      for (yy = 0; yy < h; ++yy)
-      {
-        pMemCharPixel = &pMemChar[(- yo_min + yo + yy) * CharWidth + xo];
-
-        for (xx = 0; xx < w; ++xx)
-        {
-          if (!(bit++ & 7))
-            bits = pBitmap[bo++];
-          if (bits & 0x80)
-            *pMemCharPixel = Color_MSBFirst;
-          ++pMemCharPixel;
-          bits <<= 1;
-        }
-      }
-      ILI9341_DrawPixels_MSBFirst(X, Y + yo_min, CharWidth, CharHeight, pMemChar);
-      SPI_Transactions_WaitForCompletion();
-      free(pMemChar);
+      pMemChar = GetRasterizedGlyph(pGlyph, tdmAnyCharBar, Color, &Cached);
+      if (pMemChar)
+        DrawGlyphPixels_MSBFirst(X, Y + yo_min, pGlyph->xAdvance, yo_max - yo_min + 1, pMemChar, Cached);
       break;
 
     case tdmMergeWithExistingPixels:
-      for (yy = 0; yy < h; ++yy)
-      {
-        for (xx = 0; xx < w; ++xx)
-        {
-          if (!(bit++ & 7))
-            bits = pBitmap[bo++];
-          if (bits & 0x80)
-            ILI9341_DrawPixel(X + xo + xx, Y + yo + yy, Color);
-          bits <<= 1;
-        }
-      }
+      DrawGlyphSpans(pGlyph, X + xo, Y + yo, Color);
       break;
   }
 
@@ -808,7 +1353,124 @@ TextDrawMode_t ILI9341_SetTextDrawMode(TextDrawMode_t Value)
   return Result;
 }
 
+static uint16_t GetTextRunWidth(const uint8_t *pText, uint16_t NumChars)
+// Returns the width covered by the character cells of a tdmAnyCharBar text run.
+{
+  uint16_t CharX = 0, RunWidth = 0;
+
+  for (uint16_t CharIndex = 0; CharIndex < NumChars; ++CharIndex)
+  {
+    uint8_t Ch = pText[CharIndex];
+
+    if (IsNonPrintingChar(Ch))
+      continue;
+
+    GFXglyph *pGlyph = &pFont->pGlyph[Ch - pFont->first];
+    if (CharX + pGlyph->xAdvance > RunWidth)
+      RunWidth = CharX + pGlyph->xAdvance;
+    CharX += pGlyph->width ? pGlyph->xOffset + pGlyph->width : pGlyph->xAdvance;
+  }
+
+  return RunWidth;
+}
+
+static void RasterizeTextRunBand(const uint8_t *pText, uint16_t NumChars, uint16_t RunWidth, int16_t FirstRow, int16_t NumRows, const uint16_t *pLevels_MSBFirst, uint16_t *pPixels)
+// Rasterizes rows [FirstRow, FirstRow + NumRows) of a text run, relative to the top of the character cells.
+// Characters are drawn in order, each filling its whole cell, so the result matches drawing them with ILI9341_DrawCharAtXY().
+// When the glyph cache is enabled, cells are copied from it rather than rasterized.
+{
+  uint16_t CharX = 0;
+
+  for (uint16_t PixelIndex = 0; PixelIndex < RunWidth * NumRows; ++PixelIndex) // Gaps between cells.
+    pPixels[PixelIndex] = pLevels_MSBFirst[0];
+
+  for (uint16_t CharIndex = 0; CharIndex < NumChars; ++CharIndex)
+  {
+    uint8_t Ch = pText[CharIndex];
+
+    if (IsNonPrintingChar(Ch))
+      continue;
+
+    GFXglyph *pGlyph = &pFont->pGlyph[Ch - pFont->first];
+    uint8_t w = pGlyph->width;
+    int8_t xo = pGlyph->xOffset, yo = pGlyph->yOffset;
+    uint16_t CellEnd = CharX + pGlyph->xAdvance;
+
+    if (CellEnd > RunWidth)
+      CellEnd = RunWidth;
+
+    // Cached cell:
+    uint16_t *pCell = NULL;
+    uint8_t Cached = 0;
+
+    if (FirstRow == 0)
+      pCell = ILI9341_GlyphCache_IsEnabled() ? GetRasterizedGlyph(pGlyph, tdmAnyCharBar, TextColor, &Cached) : NULL;
+    else // Only insert in the first band, so that a run larger than the cache cannot thrash it. Cells evicted since then are rasterized below.
+      Cached = ((pCell = ILI9341_GlyphCache_Find(pGlyph, tdmAnyCharBar, TextColor, TextBackgroundColor)) != NULL);
+    if (Cached)
+    {
+      for (int16_t Row = 0; (Row < NumRows) && (CellEnd > CharX); ++Row)
+        memcpy(&pPixels[Row * RunWidth + CharX], &pCell[(FirstRow + Row) * pGlyph->xAdvance], (CellEnd - CharX) * sizeof(uint16_t));
+      CharX += w ? xo + w : pGlyph->xAdvance;
+      continue;
+    }
+
+    // Cell background:
+    for (int16_t Row = 0; Row < NumRows; ++Row)
+      for (uint16_t X = CharX; X < CellEnd; ++X)
+        pPixels[Row * RunWidth + X] = pLevels_MSBFirst[0];
+
+    // Glyph:
+    RasterizeGlyphPixels(pGlyph, pPixels, RunWidth, CharX + xo, - pFont->yOffsetMin + yo - FirstRow, CharX, CellEnd, NumRows, pLevels_MSBFirst);
+
+    CharX += w ? xo + w : pGlyph->xAdvance;
+  }
+}
+
+static void DrawTextRun_AnyCharBar(const uint8_t *pText, uint16_t NumChars, uint16_t X, uint16_t Y)
+// Draws a whole text run as one window, streamed in bands of rows through the pixel buffers.
+{
+  uint16_t RunWidth, RunHeight, BandNumRows;
+  const uint16_t *pLevels_MSBFirst;
+  uint16_t *pPixelBuffer;
+  uint8_t Compositing = ILI9341_Compositor_IsEnabled();
+
+  RunWidth = GetTextRunWidth(pText, NumChars);
+  if (X >= ILI9341_Width)
+    return;
+  if (RunWidth > ILI9341_Width - X)
+    RunWidth = ILI9341_Width - X;
+  if (RunWidth == 0)
+    return;
+
+  RunHeight = pFont->yOffsetMax - pFont->yOffsetMin + 1;
+  BandNumRows = ILI9341_PixelBuffer_MaxNumPixels / RunWidth;
+  pLevels_MSBFirst = GetBlendTable(TextColor, TextBackgroundColor);
+
+  if (!Compositing)
+    ILI9341_RAMWrite_Begin(X, Y + pFont->yOffsetMin, RunWidth, RunHeight);
+
+  for (uint16_t FirstRow = 0; FirstRow < RunHeight; FirstRow += BandNumRows)
+  {
+    uint16_t NumRows = (RunHeight - FirstRow < BandNumRows) ? RunHeight - FirstRow : BandNumRows;
+
+    pPixelBuffer = ILI9341_AcquirePixelBuffer();
+    RasterizeTextRunBand(pText, NumChars, RunWidth, FirstRow, NumRows, pLevels_MSBFirst, pPixelBuffer);
+
+    if (Compositing)
+      ILI9341_Compositor_DrawPixels_MSBFirst(X, Y + pFont->yOffsetMin + FirstRow, RunWidth, NumRows, pPixelBuffer);
+    else
+      ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, RunWidth * NumRows);
+  }
+
+  if (!Compositing)
+    ILI9341_RAMWrite_End();
+}
+
 void ILI9341_DrawTextAtXY(const char *Text, uint16_t X, uint16_t Y, TextPosition_t TextPosition)
+// When the compositor is enabled, the whole string is flushed as one frame.
+// In tdmAnyCharBar mode, the whole string is sent as one window. Any gaps between character cells are filled with the text background color.
+// In other modes, glyphs are rasterized in the glyph arena, alternating between slots, so the next glyph is prepared while the previous one is being sent.
 {
   uint8_t *pText;
   uint8_t Ch;
@@ -834,6 +1496,13 @@ void ILI9341_DrawTextAtXY(const char *Text, uint16_t X, uint16_t Y, TextPosition
       break;
   }
 
+  if ((TextDrawMode == tdmAnyCharBar) && pFont)
+  {
+    DrawTextRun_AnyCharBar(pText, NumChars, X, Y);
+    return;
+  }
+
+  ILI9341_Compositor_BeginFrame();
   for (uint16_t CharIndex = 0; CharIndex < NumChars; ++CharIndex)
   {
     Ch = *pText;
@@ -841,6 +1510,7 @@ void ILI9341_DrawTextAtXY(const char *Text, uint16_t X, uint16_t Y, TextPosition
     ++pText;
     X += DX;
   }
+  ILI9341_Compositor_EndFrame();
 }
 
 void ILI9341_Test_DrawGrid()
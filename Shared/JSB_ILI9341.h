@@ -14,6 +14,7 @@ extern "C"
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include "JSB_HAL.h"
 #include "gfxfont.h"
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -21,6 +22,12 @@ extern "C"
 #define ILI9341_Width 240
 #define ILI9341_Height 320
 
+#define ILI9341_PixelBuffer_MaxNumPixels 512
+
+#ifndef ILI9341_GlyphArena_MaxNumPixels
+#define ILI9341_GlyphArena_MaxNumPixels 576 // Largest glyph cell of FreeSans12pt7b (24 x 24). See ILI9341_GetFontMaxGlyphNumPixels().
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // Colors:
 
@@ -49,6 +56,14 @@ extern "C"
 
 ///////////////////////////////////////////////////////////////////////////////
 
+typedef struct
+{
+  uint32_t NumTransactions; // SPI transactions queued.
+  uint32_t NumPixels; // Pixels sent to display RAM.
+  uint32_t NumBytes; // Bytes sent, including commands and addresses.
+  int64_t BusyTime_us; // Time for which transactions have been in flight.
+} ILI9341_Statistics_t;
+
 typedef enum
 {
   tpNone,
@@ -62,21 +77,28 @@ typedef enum
   tdmNone,
   tdmThisCharBar,
   tdmAnyCharBar,
-  tdmMergeWithExistingPixels
+  tdmMergeWithExistingPixels // The background is unknown, so gffAntialiased4bpp fonts are drawn without antialiasing.
 } TextDrawMode_t;
 
 // Administration:
-void ILI9341_Initialize(spi_host_device_t HostDevice, int i_ResetX_GPIO, int i_CSX_GPIO, int i_D_CX_GPIO, int i_BacklightX_GPIO);
+void ILI9341_Initialize(HAL_SPI_Host_t HostDevice, int i_ResetX_GPIO, int i_CSX_GPIO, int i_D_CX_GPIO, int i_BacklightX_GPIO);
 void ILI9341_SetDefaults();
 
 // Utilities:
 uint16_t ILI9341_SwapBytes(uint16_t Value);
+void ILI9341_GetStatistics(ILI9341_Statistics_t *pStatistics);
+void ILI9341_ResetStatistics();
+void ILI9341_GetThroughput(float *pPixelsPerSecond, float *pBusUtilization);
 
 // Primitives:
 void ILI9341_SendLine(int ypos, uint16_t *line);
 void ILI9341_SendLine_WaitForCompletion();
 void ILI9341_DrawPixel(int16_t X, int16_t Y, uint16_t Color);
 void ILI9341_DrawPixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t *pPixels);
+uint16_t *ILI9341_AcquirePixelBuffer();
+void ILI9341_RAMWrite_Begin(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height);
+void ILI9341_RAMWrite_Pixels_MSBFirst(uint16_t *pPixels, uint16_t NumPixels);
+void ILI9341_RAMWrite_End();
 void ILI9341_DrawBar(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Color);
 void ILI9341_Clear(uint16_t Color);
 
@@ -84,6 +106,7 @@ void ILI9341_Clear(uint16_t Color);
 uint16_t ILI9341_SetTextColor(uint16_t Value);
 uint16_t ILI9341_SetTextBackgroundColor(uint16_t Value);
 TextDrawMode_t ILI9341_SetTextDrawMode(TextDrawMode_t Value);
+uint16_t ILI9341_GetFontMaxGlyphNumPixels(const GFXfont *i_pFont);
 const GFXfont *ILI9341_SetFont(const GFXfont *i_pFont);
 uint8_t ILI9341_GetFontYSpacing();
 uint16_t ILI9341_GetCharWidth(uint8_t Ch);
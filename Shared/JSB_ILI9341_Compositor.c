@@ -0,0 +1,663 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Compositor:
+//
+// => Drawing is rendered into a 4 bit per pixel shadow of the display (38400 bytes) using a palette of up to 16 colors.
+// => The display is divided into tiles. A tile is marked dirty only if a pixel in it actually changes value.
+// => At the end of a frame, a dirty tile whose hash matches the hash of what was last sent is dropped (pixels may change and change back within a frame).
+// => The remaining runs of dirty tiles are coalesced into rectangles, which are the only pixels sent to the display.
+// => Primitives drawn outside a frame are treated as a frame on their own, so the shadow always matches the display.
+// => A primitive that needs more colors than the palette holds is drawn directly to the display, in its exact colors, as is anything drawn
+//    over it until it is covered (see DrawnDirectly()). Such primitives are counted in NumDirectPrimitives.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+//
+#include "esp_system.h"
+#include "esp_log.h"
+//
+#include "JSB_HAL.h"
+#include "JSB_ILI9341.h"
+#include "JSB_ILI9341_Compositor.h"
+
+#define LOG_TAG "JSB_ILI9341_Compositor"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define Tile_Size 16
+#define NumTileColumns (ILI9341_Width / Tile_Size)
+#define NumTileRows (ILI9341_Height / Tile_Size)
+
+#define Shadow_NumBytesPerRow (ILI9341_Width / 2)
+#define Shadow_NumBytes (Shadow_NumBytesPerRow * ILI9341_Height)
+
+#define Palette_MaxNumEntries 16
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint8_t *pShadow = NULL; // Two pixels per byte. Even X in the high nibble.
+static uint16_t DirtyTiles[NumTileRows]; // Bit n => tile column n.
+static uint16_t KnownTiles[NumTileRows]; // Bit n => TileHashes is valid for tile column n.
+static uint16_t StaleTiles[NumTileRows]; // Bit n => tile column n shows colors that the shadow only approximates. See DrawnDirectly().
+static uint32_t TileHashes[NumTileRows][NumTileColumns]; // Hashes of the tiles as last sent to the display.
+static int16_t FrameDepth = 0;
+
+static uint16_t Palette[Palette_MaxNumEntries];
+static uint16_t Palette_MSBFirst[Palette_MaxNumEntries];
+static uint16_t Palette_UsedEntries = 0; // Bit n => Palette[n] is in use.
+static uint8_t Palette_LastIndex = 0;
+static uint8_t Palette_Compacted = 0; // During this frame. Compacting scans the whole shadow, so is done at most once a frame.
+static uint8_t Palette_OverflowReported = 0;
+
+static ILI9341_CompositorStatistics_t Statistics;
+
+///////////////////////////////////////////////////////////////////////////////
+// Administration:
+
+void ILI9341_Compositor_Invalidate()
+// Marks the whole display as dirty. Use if the display has been changed without the compositor's knowledge.
+{
+  for (int16_t TileRow = 0; TileRow < NumTileRows; ++TileRow)
+  {
+    DirtyTiles[TileRow] = (1 << NumTileColumns) - 1;
+    KnownTiles[TileRow] = 0;
+    StaleTiles[TileRow] = 0; // The shadow is all that is known.
+  }
+}
+
+uint8_t ILI9341_Compositor_Initialize()
+// Returns 1 if successful. If not, drawing continues to go directly to the display.
+{
+  pShadow = (uint8_t *)HAL_Memory_Allocate(Shadow_NumBytes, 0);
+  if (!pShadow)
+  {
+    ESP_LOGE(LOG_TAG, "Unable to allocate %d byte shadow frame buffer", Shadow_NumBytes);
+    return 0;
+  }
+
+  memset(pShadow, 0, Shadow_NumBytes);
+  Palette[0] = ILI9341_COLOR_BLACK;
+  Palette_MSBFirst[0] = ILI9341_SwapBytes(ILI9341_COLOR_BLACK);
+  Palette_UsedEntries = 1;
+  Palette_LastIndex = 0;
+
+  ILI9341_Compositor_Invalidate(); // Display contents are unknown.
+
+  return 1;
+}
+
+uint8_t ILI9341_Compositor_IsEnabled()
+{
+  return pShadow != NULL;
+}
+
+void ILI9341_Compositor_GetStatistics(ILI9341_CompositorStatistics_t *pStatistics)
+{
+  *pStatistics = Statistics;
+}
+
+void ILI9341_Compositor_ResetStatistics()
+{
+  memset(&Statistics, 0, sizeof(Statistics));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Palette:
+
+static void Palette_Compact()
+// Frees palette entries that are no longer used by any pixel in the shadow.
+// Reads all of the shadow, 38400 bytes, so is only done when the palette is full, and at most once a frame.
+{
+  uint16_t UsedEntries = 0;
+
+  for (uint32_t ByteIndex = 0; ByteIndex < Shadow_NumBytes; ++ByteIndex)
+  {
+    uint8_t Byte = pShadow[ByteIndex];
+    UsedEntries |= (1 << (Byte >> 4)) | (1 << (Byte & 0x0F));
+  }
+
+  Palette_UsedEntries = UsedEntries;
+}
+
+static uint8_t Palette_GetNearestIndex(uint16_t Color)
+// Only for the shadow's copy of pixels drawn directly, which the display shows in their exact colors.
+{
+  int32_t BestDistance = INT32_MAX;
+  uint8_t BestIndex = 0;
+
+  for (uint8_t Index = 0; Index < Palette_MaxNumEntries; ++Index)
+  {
+    if (!(Palette_UsedEntries & (1 << Index)))
+      continue;
+
+    int32_t DR = ((Palette[Index] >> 11) & 0x1F) - ((Color >> 11) & 0x1F);
+    int32_t DG = ((Palette[Index] >> 5) & 0x3F) - ((Color >> 5) & 0x3F);
+    int32_t DB = (Palette[Index] & 0x1F) - (Color & 0x1F);
+    int32_t Distance = 4 * DR * DR + DG * DG + 4 * DB * DB;
+
+    if (Distance < BestDistance)
+    {
+      BestDistance = Distance;
+      BestIndex = Index;
+    }
+  }
+
+  return BestIndex;
+}
+
+static int8_t Palette_GetIndex(uint16_t Color)
+// Returns -1 if the palette is full.
+{
+  uint8_t Index;
+
+  if ((Palette_UsedEntries & (1 << Palette_LastIndex)) && (Palette[Palette_LastIndex] == Color))
+    return Palette_LastIndex;
+
+  for (Index = 0; Index < Palette_MaxNumEntries; ++Index)
+  {
+    if ((Palette_UsedEntries & (1 << Index)) && (Palette[Index] == Color))
+    {
+      Palette_LastIndex = Index;
+      return Index;
+    }
+  }
+
+  if ((Palette_UsedEntries == 0xFFFF) && !Palette_Compacted)
+  {
+    Palette_Compact();
+    Palette_Compacted = 1;
+  }
+
+  if (Palette_UsedEntries == 0xFFFF)
+  {
+    if (!Palette_OverflowReported)
+    {
+      ESP_LOGW(LOG_TAG, "Palette full. Primitives with other colors are drawn directly.");
+      Palette_OverflowReported = 1;
+    }
+    return -1;
+  }
+
+  for (Index = 0; Palette_UsedEntries & (1 << Index); ++Index)
+    ;
+
+  Palette[Index] = Color;
+  Palette_MSBFirst[Index] = ILI9341_SwapBytes(Color);
+  Palette_UsedEntries |= 1 << Index;
+  memset(KnownTiles, 0, sizeof(KnownTiles)); // Tile hashes are of palette indices, and this index may previously have had a different color.
+  Palette_LastIndex = Index;
+  return Index;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Shadow:
+
+static void Shadow_SetPixel(uint16_t X, uint16_t Y, uint8_t Index)
+{
+  uint8_t *pByte = &pShadow[Y * Shadow_NumBytesPerRow + X / 2];
+  uint8_t Shift = (X & 1) ? 0 : 4;
+
+  if (((*pByte >> Shift) & 0x0F) == Index)
+    return;
+
+  *pByte = (*pByte & ~(0x0F << Shift)) | (Index << Shift);
+  DirtyTiles[Y / Tile_Size] |= 1 << (X / Tile_Size);
+}
+
+static void Shadow_FillRow(uint16_t X, uint16_t Y, uint16_t Width, uint8_t Index)
+{
+  uint8_t Byte = Index | (Index << 4);
+  uint8_t *pByte;
+
+  if ((X & 1) && Width)
+  {
+    Shadow_SetPixel(X++, Y, Index);
+    --Width;
+  }
+
+  pByte = &pShadow[Y * Shadow_NumBytesPerRow + X / 2];
+  for (; Width >= 2; Width -= 2, X += 2, ++pByte)
+  {
+    if (*pByte != Byte)
+    {
+      *pByte = Byte;
+      DirtyTiles[Y / Tile_Size] |= 1 << (X / Tile_Size);
+    }
+  }
+
+  if (Width)
+    Shadow_SetPixel(X, Y, Index);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Flushing:
+
+static uint32_t GetTileHash(uint8_t TileX, uint8_t TileY)
+// FNV-1a.
+{
+  uint32_t Hash = 2166136261u;
+
+  for (uint16_t Row = TileY * Tile_Size; Row < (TileY + 1) * Tile_Size; ++Row)
+  {
+    const uint8_t *pByte = &pShadow[Row * Shadow_NumBytesPerRow + TileX * Tile_Size / 2];
+
+    for (uint8_t ByteIndex = 0; ByteIndex < Tile_Size / 2; ++ByteIndex)
+      Hash = (Hash ^ *pByte++) * 16777619u;
+  }
+
+  return Hash;
+}
+
+static void DropUnchangedTiles()
+{
+  for (uint8_t TileRow = 0; TileRow < NumTileRows; ++TileRow)
+  {
+    for (uint8_t TileColumn = 0; TileColumn < NumTileColumns; ++TileColumn)
+    {
+      uint16_t Bit = 1 << TileColumn;
+
+      if (!(DirtyTiles[TileRow] & Bit))
+        continue;
+
+      uint32_t Hash = GetTileHash(TileColumn, TileRow);
+      if ((KnownTiles[TileRow] & Bit) && (TileHashes[TileRow][TileColumn] == Hash))
+      {
+        DirtyTiles[TileRow] &= ~Bit;
+        continue;
+      }
+
+      TileHashes[TileRow][TileColumn] = Hash;
+      KnownTiles[TileRow] |= Bit;
+    }
+  }
+}
+
+static void SendRectangle(uint8_t TileX, uint8_t TileY, uint8_t TileWidth, uint8_t TileHeight)
+{
+  uint16_t X = TileX * Tile_Size, Y = TileY * Tile_Size;
+  uint16_t Width = TileWidth * Tile_Size, Height = TileHeight * Tile_Size;
+  uint16_t *pPixelBuffer, NumPixelsInBuffer = 0;
+
+  ILI9341_RAMWrite_Begin(X, Y, Width, Height);
+  pPixelBuffer = ILI9341_AcquirePixelBuffer();
+
+  for (uint16_t Row = Y; Row < Y + Height; ++Row)
+  {
+    const uint8_t *pByte = &pShadow[Row * Shadow_NumBytesPerRow + X / 2]; // X is even.
+
+    for (uint16_t ByteIndex = 0; ByteIndex < Width / 2; ++ByteIndex, ++pByte)
+    {
+      pPixelBuffer[NumPixelsInBuffer++] = Palette_MSBFirst[*pByte >> 4];
+      pPixelBuffer[NumPixelsInBuffer++] = Palette_MSBFirst[*pByte & 0x0F];
+
+      if (NumPixelsInBuffer == ILI9341_PixelBuffer_MaxNumPixels)
+      {
+        ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, NumPixelsInBuffer);
+        pPixelBuffer = ILI9341_AcquirePixelBuffer();
+        NumPixelsInBuffer = 0;
+      }
+    }
+  }
+
+  ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, NumPixelsInBuffer);
+  ILI9341_RAMWrite_End();
+
+  ++Statistics.NumRectangles;
+  Statistics.NumPixelsFlushed += Width * Height;
+}
+
+static void Flush()
+// Each row of tiles is split into runs of dirty tiles. A run with the same horizontal extent as a run in the row above extends that run's rectangle.
+{
+  uint8_t OpenWidth[NumTileColumns], OpenTop[NumTileColumns]; // Indexed by first tile column. OpenWidth 0 => no rectangle.
+  uint8_t RunWidth[NumTileColumns];
+  uint8_t AnyDirty = 0;
+
+  DropUnchangedTiles();
+
+  for (uint8_t TileRow = 0; TileRow < NumTileRows; ++TileRow)
+    AnyDirty |= DirtyTiles[TileRow] != 0;
+  if (!AnyDirty)
+    return;
+
+  memset(OpenWidth, 0, sizeof(OpenWidth));
+
+  for (uint8_t TileRow = 0; TileRow <= NumTileRows; ++TileRow)
+  {
+    uint16_t Bits = (TileRow < NumTileRows) ? DirtyTiles[TileRow] : 0;
+
+    // Find runs in this row:
+    memset(RunWidth, 0, sizeof(RunWidth));
+    for (uint8_t TileColumn = 0; TileColumn < NumTileColumns;)
+    {
+      if (!(Bits & (1 << TileColumn)))
+      {
+        ++TileColumn;
+        continue;
+      }
+
+      uint8_t First = TileColumn;
+      while ((TileColumn < NumTileColumns) && (Bits & (1 << TileColumn)))
+        ++TileColumn;
+      RunWidth[First] = TileColumn - First;
+    }
+
+    // Extend or close the rectangles from the rows above:
+    for (uint8_t TileColumn = 0; TileColumn < NumTileColumns; ++TileColumn)
+    {
+      if (!OpenWidth[TileColumn])
+        continue;
+
+      if (RunWidth[TileColumn] == OpenWidth[TileColumn])
+      {
+        RunWidth[TileColumn] = 0; // Consumed.
+        continue;
+      }
+
+      SendRectangle(TileColumn, OpenTop[TileColumn], OpenWidth[TileColumn], TileRow - OpenTop[TileColumn]);
+      OpenWidth[TileColumn] = 0;
+    }
+
+    // Open rectangles for the remaining runs:
+    for (uint8_t TileColumn = 0; TileColumn < NumTileColumns; ++TileColumn)
+    {
+      if (!RunWidth[TileColumn])
+        continue;
+
+      OpenWidth[TileColumn] = RunWidth[TileColumn];
+      OpenTop[TileColumn] = TileRow;
+    }
+  }
+
+  memset(DirtyTiles, 0, sizeof(DirtyTiles));
+  ++Statistics.NumFrames;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Direct drawing:
+//
+// => A primitive with a color that is not in the palette is drawn into the shadow with the nearest colors in the palette, and sent directly.
+//    It is sent before anything is flushed, as its pixels may be in one of the driver's pixel buffers, which flushing reuses. What is pending
+//    in the tiles it overlaps is then sent around it.
+// => Those tiles are then stale: the display shows colors that the shadow only approximates. Anything drawn over part of a stale tile is
+//    drawn directly too. A stale tile is fresh again once a bar of a color in the palette covers it.
+
+static void SendPixels(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height)
+// Any rectangle of the shadow, a pixel at a time.
+{
+  uint16_t *pPixelBuffer, NumPixelsInBuffer = 0;
+
+  if (!Width || !Height)
+    return;
+
+  ILI9341_RAMWrite_Begin(X, Y, Width, Height);
+  pPixelBuffer = ILI9341_AcquirePixelBuffer();
+
+  for (uint16_t Row = Y; Row < Y + Height; ++Row)
+  {
+    for (uint16_t Column = X; Column < X + Width; ++Column)
+    {
+      uint8_t Byte = pShadow[Row * Shadow_NumBytesPerRow + Column / 2];
+
+      pPixelBuffer[NumPixelsInBuffer++] = Palette_MSBFirst[(Column & 1) ? Byte & 0x0F : Byte >> 4];
+
+      if (NumPixelsInBuffer == ILI9341_PixelBuffer_MaxNumPixels)
+      {
+        ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, NumPixelsInBuffer);
+        pPixelBuffer = ILI9341_AcquirePixelBuffer();
+        NumPixelsInBuffer = 0;
+      }
+    }
+  }
+
+  ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, NumPixelsInBuffer);
+  ILI9341_RAMWrite_End();
+
+  ++Statistics.NumRectangles;
+  Statistics.NumPixelsFlushed += Width * Height;
+}
+
+static uint16_t GetOverlappedTileColumns(uint16_t X, uint16_t Width)
+// Bit n => tile column n. Width > 0.
+{
+  uint8_t First = X / Tile_Size, Last = (X + Width - 1) / Tile_Size;
+
+  return ((1 << (Last + 1)) - 1) & ~((1 << First) - 1);
+}
+
+static uint16_t GetCoveredTileColumns(uint16_t X, uint16_t Width)
+{
+  uint8_t First = (X + Tile_Size - 1) / Tile_Size, End = (X + Width) / Tile_Size;
+
+  return (End > First) ? ((1 << End) - 1) & ~((1 << First) - 1) : 0;
+}
+
+static uint8_t IsTileRowCovered(uint8_t TileRow, uint16_t Y, uint16_t Height)
+{
+  return (Y <= TileRow * Tile_Size) && (Y + Height >= (TileRow + 1) * Tile_Size);
+}
+
+static uint8_t Stale_IsDrawnOver(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint8_t Covering)
+// Covering => the primitive is a bar of a color in the palette, so the stale tiles it covers do not count.
+{
+  for (uint8_t TileRow = Y / Tile_Size; TileRow <= (Y + Height - 1) / Tile_Size; ++TileRow)
+  {
+    uint16_t Columns = GetOverlappedTileColumns(X, Width);
+
+    if (Covering && IsTileRowCovered(TileRow, Y, Height))
+      Columns &= ~GetCoveredTileColumns(X, Width);
+    if (StaleTiles[TileRow] & Columns)
+      return 1;
+  }
+
+  return 0;
+}
+
+static void Stale_Cover(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint8_t Sent)
+// A bar of a color in the palette has been drawn. The stale tiles it covers are fresh. Sent => the bar was drawn directly, so they are as sent.
+{
+  for (uint8_t TileRow = Y / Tile_Size; TileRow <= (Y + Height - 1) / Tile_Size; ++TileRow)
+  {
+    uint16_t Columns = IsTileRowCovered(TileRow, Y, Height) ? GetCoveredTileColumns(X, Width) : 0;
+
+    for (uint8_t TileColumn = 0; TileColumn < NumTileColumns; ++TileColumn)
+    {
+      uint16_t Bit = 1 << TileColumn;
+
+      if (!(Columns & StaleTiles[TileRow] & Bit))
+        continue;
+
+      StaleTiles[TileRow] &= ~Bit;
+      if (Sent)
+      {
+        TileHashes[TileRow][TileColumn] = GetTileHash(TileColumn, TileRow);
+        KnownTiles[TileRow] |= Bit;
+      }
+      else
+        DirtyTiles[TileRow] |= Bit; // Not known, so not dropped.
+    }
+  }
+}
+
+static void DrawnDirectly(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height)
+// The primitive at X, Y, Width, Height (clipped) has been drawn into the shadow and sent directly.
+{
+  uint16_t Right = X + Width, Bottom = Y + Height;
+
+  ++Statistics.NumDirectPrimitives;
+
+  for (uint8_t TileRow = Y / Tile_Size; TileRow <= (Bottom - 1) / Tile_Size; ++TileRow)
+  {
+    for (uint8_t TileColumn = X / Tile_Size; TileColumn <= (Right - 1) / Tile_Size; ++TileColumn)
+    {
+      uint16_t Bit = 1 << TileColumn;
+      uint16_t TileLeft = TileColumn * Tile_Size, TileTop = TileRow * Tile_Size;
+      uint16_t Left = (X > TileLeft) ? X : TileLeft, Top = (Y > TileTop) ? Y : TileTop;
+      uint16_t InnerRight = (Right < TileLeft + Tile_Size) ? Right : TileLeft + Tile_Size;
+      uint16_t InnerBottom = (Bottom < TileTop + Tile_Size) ? Bottom : TileTop + Tile_Size;
+
+      // Send what is pending around the primitive. A stale tile has nothing pending, as it is only drawn over directly:
+      if ((DirtyTiles[TileRow] & Bit) && !(StaleTiles[TileRow] & Bit))
+      {
+        SendPixels(TileLeft, TileTop, Tile_Size, Top - TileTop);
+        SendPixels(TileLeft, Top, Left - TileLeft, InnerBottom - Top);
+        SendPixels(InnerRight, Top, TileLeft + Tile_Size - InnerRight, InnerBottom - Top);
+        SendPixels(TileLeft, InnerBottom, Tile_Size, TileTop + Tile_Size - InnerBottom);
+      }
+
+      DirtyTiles[TileRow] &= ~Bit;
+      KnownTiles[TileRow] &= ~Bit;
+      StaleTiles[TileRow] |= Bit;
+    }
+  }
+}
+
+static void DrawDirect_Bar(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Color)
+// Clipped by the caller.
+{
+  uint32_t NumPixels = Width * Height;
+  uint16_t *pPixelBuffer = ILI9341_AcquirePixelBuffer();
+  uint16_t Color_MSBFirst = ILI9341_SwapBytes(Color);
+
+  for (uint16_t PixelIndex = 0; PixelIndex < ILI9341_PixelBuffer_MaxNumPixels; ++PixelIndex)
+    pPixelBuffer[PixelIndex] = Color_MSBFirst;
+
+  ILI9341_RAMWrite_Begin(X, Y, Width, Height);
+  for (; NumPixels > ILI9341_PixelBuffer_MaxNumPixels; NumPixels -= ILI9341_PixelBuffer_MaxNumPixels)
+    ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, ILI9341_PixelBuffer_MaxNumPixels);
+  ILI9341_RAMWrite_Pixels_MSBFirst(pPixelBuffer, NumPixels);
+  ILI9341_RAMWrite_End();
+}
+
+static void DrawDirect_Pixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t ClippedWidth, uint16_t ClippedHeight,
+  const uint16_t *pPixels)
+// A row at a time if clipped.
+{
+  if (ClippedWidth == Width)
+  {
+    ILI9341_RAMWrite_Begin(X, Y, Width, ClippedHeight);
+    ILI9341_RAMWrite_Pixels_MSBFirst((uint16_t *)pPixels, Width * ClippedHeight);
+    ILI9341_RAMWrite_End();
+    return;
+  }
+
+  ILI9341_RAMWrite_Begin(X, Y, ClippedWidth, ClippedHeight);
+  for (uint16_t Row = 0; Row < ClippedHeight; ++Row)
+    ILI9341_RAMWrite_Pixels_MSBFirst((uint16_t *)&pPixels[Row * Width], ClippedWidth);
+  ILI9341_RAMWrite_End();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Frames:
+
+void ILI9341_Compositor_BeginFrame()
+// Frames may be nested. Only the outermost frame is flushed.
+{
+  if (!pShadow)
+    return;
+
+  if (++FrameDepth == 1)
+    Palette_Compacted = 0;
+}
+
+void ILI9341_Compositor_EndFrame()
+{
+  if (!pShadow)
+    return;
+
+  assert(FrameDepth > 0);
+
+  if (--FrameDepth > 0)
+    return;
+
+  Flush();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Primitives:
+
+void ILI9341_Compositor_DrawBar(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Color)
+{
+  int8_t PaletteIndex;
+  uint8_t Index, Direct;
+
+  if ((X >= ILI9341_Width) || (Y >= ILI9341_Height))
+    return;
+  if (Width > ILI9341_Width - X)
+    Width = ILI9341_Width - X;
+  if (Height > ILI9341_Height - Y)
+    Height = ILI9341_Height - Y;
+  if (!Width || !Height)
+    return;
+
+  ILI9341_Compositor_BeginFrame();
+  {
+    PaletteIndex = Palette_GetIndex(Color);
+    Index = (PaletteIndex >= 0) ? PaletteIndex : Palette_GetNearestIndex(Color);
+
+    for (uint16_t Row = Y; Row < Y + Height; ++Row)
+      Shadow_FillRow(X, Row, Width, Index);
+
+    Direct = (PaletteIndex < 0) || Stale_IsDrawnOver(X, Y, Width, Height, 1);
+    if (Direct)
+    {
+      DrawDirect_Bar(X, Y, Width, Height, Color);
+      DrawnDirectly(X, Y, Width, Height);
+    }
+    if (PaletteIndex >= 0)
+      Stale_Cover(X, Y, Width, Height, Direct);
+
+    Statistics.NumPixelsDrawn += Width * Height;
+  }
+  ILI9341_Compositor_EndFrame();
+}
+
+void ILI9341_Compositor_DrawPixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, const uint16_t *pPixels)
+{
+  uint16_t ClippedWidth, ClippedHeight, Color_MSBFirst = 0;
+  uint8_t Index = 0, Direct;
+
+  if ((X >= ILI9341_Width) || (Y >= ILI9341_Height) || !Width || !Height)
+    return;
+  ClippedWidth = (Width > ILI9341_Width - X) ? ILI9341_Width - X : Width;
+  ClippedHeight = (Height > ILI9341_Height - Y) ? ILI9341_Height - Y : Height;
+
+  ILI9341_Compositor_BeginFrame();
+  {
+    Direct = Stale_IsDrawnOver(X, Y, ClippedWidth, ClippedHeight, 0);
+
+    for (uint16_t Row = 0; Row < ClippedHeight; ++Row)
+    {
+      const uint16_t *pPixel = &pPixels[Row * Width];
+
+      for (uint16_t Column = 0; Column < ClippedWidth; ++Column, ++pPixel)
+      {
+        if ((*pPixel != Color_MSBFirst) || (Row + Column == 0))
+        {
+          int8_t PaletteIndex = Palette_GetIndex(ILI9341_SwapBytes(*pPixel));
+
+          Direct |= PaletteIndex < 0;
+          Color_MSBFirst = *pPixel;
+          Index = (PaletteIndex >= 0) ? PaletteIndex : Palette_GetNearestIndex(ILI9341_SwapBytes(Color_MSBFirst));
+        }
+        Shadow_SetPixel(X + Column, Y + Row, Index);
+      }
+    }
+
+    if (Direct)
+    {
+      DrawDirect_Pixels_MSBFirst(X, Y, Width, Height, ClippedWidth, ClippedHeight, pPixels); // Before pPixels' buffer can be reused.
+      DrawnDirectly(X, Y, ClippedWidth, ClippedHeight);
+    }
+
+    Statistics.NumPixelsDrawn += Width * Height;
+  }
+  ILI9341_Compositor_EndFrame();
+}
+
+///////////////////////////////////////////////////////////////////////////////
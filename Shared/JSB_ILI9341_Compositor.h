@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_ILI9341_COMPOSITOR_H
+#define __JSB_ILI9341_COMPOSITOR_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  uint32_t NumFrames; // Frames flushed.
+  uint32_t NumRectangles; // Rectangles sent to the display.
+  uint32_t NumPixelsDrawn; // Pixels drawn into the shadow frame buffer.
+  uint32_t NumPixelsFlushed; // Pixels sent to the display.
+  uint32_t NumDirectPrimitives; // Primitives drawn directly, as they needed more colors than the palette holds, or were drawn over such.
+} ILI9341_CompositorStatistics_t;
+
+// Administration:
+uint8_t ILI9341_Compositor_Initialize();
+uint8_t ILI9341_Compositor_IsEnabled();
+void ILI9341_Compositor_Invalidate();
+
+// Frames:
+void ILI9341_Compositor_BeginFrame();
+void ILI9341_Compositor_EndFrame();
+
+// Primitives (called by JSB_ILI9341.c when the compositor is enabled):
+void ILI9341_Compositor_DrawBar(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, uint16_t Color);
+void ILI9341_Compositor_DrawPixels_MSBFirst(uint16_t X, uint16_t Y, uint16_t Width, uint16_t Height, const uint16_t *pPixels);
+
+// Statistics:
+void ILI9341_Compositor_GetStatistics(ILI9341_CompositorStatistics_t *pStatistics);
+void ILI9341_Compositor_ResetStatistics();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,174 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Glyph cache:
+//
+// => Holds glyphs already expanded to MSB first RGB565 pixels, so that redrawing them needs no bit decoding or byte swapping.
+// => Entries are keyed by glyph (which identifies the font too), kind of block (text draw mode), text color and background color.
+// => Pixel memory is DMA-capable heap memory, bounded by a byte budget. The least recently used entries are evicted to make room.
+// => The heap is only used on a miss, so once the UI's glyphs are cached, redrawing it does not use the heap.
+// => The caller must ensure that no transaction is still reading an entry when ILI9341_GlyphCache_Insert() is called, as it may evict it.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+//
+#include "esp_system.h"
+#include "esp_log.h"
+//
+#include "JSB_HAL.h"
+#include "JSB_ILI9341_GlyphCache.h"
+
+#define LOG_TAG "JSB_ILI9341_GlyphCache"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define GlyphCache_MaxNumEntries 96
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  const void *pGlyph; // NULL => entry not in use.
+  uint8_t Kind;
+  uint16_t Color, BackgroundColor;
+  uint16_t NumPixels;
+  uint32_t LastUsed;
+  uint16_t *pPixels;
+} GlyphCache_Entry_t;
+
+static GlyphCache_Entry_t Entries[GlyphCache_MaxNumEntries];
+static uint32_t MaxNumBytes = 0; // 0 => disabled.
+static uint32_t UseCounter = 0;
+static ILI9341_GlyphCacheStatistics_t Statistics;
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void FreeEntry(GlyphCache_Entry_t *pEntry)
+{
+  HAL_Memory_Free(pEntry->pPixels);
+  Statistics.NumBytes -= pEntry->NumPixels * sizeof(uint16_t);
+  --Statistics.NumEntries;
+  memset(pEntry, 0, sizeof(*pEntry));
+}
+
+void ILI9341_GlyphCache_Clear()
+{
+  for (uint16_t Index = 0; Index < GlyphCache_MaxNumEntries; ++Index)
+    if (Entries[Index].pGlyph)
+      FreeEntry(&Entries[Index]);
+}
+
+void ILI9341_GlyphCache_Initialize(uint32_t i_MaxNumBytes)
+// i_MaxNumBytes: Budget for pixel memory. 0 => disabled.
+{
+  ILI9341_GlyphCache_Clear();
+  MaxNumBytes = i_MaxNumBytes;
+  Statistics.MaxNumBytes = i_MaxNumBytes;
+}
+
+uint8_t ILI9341_GlyphCache_IsEnabled()
+{
+  return MaxNumBytes != 0;
+}
+
+void ILI9341_GlyphCache_GetStatistics(ILI9341_GlyphCacheStatistics_t *pStatistics)
+{
+  *pStatistics = Statistics;
+}
+
+void ILI9341_GlyphCache_ResetStatistics()
+// Resets the counters only.
+{
+  Statistics.NumHits = 0;
+  Statistics.NumMisses = 0;
+  Statistics.NumEvictions = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint16_t *ILI9341_GlyphCache_Find(const void *pGlyph, uint8_t Kind, uint16_t Color, uint16_t BackgroundColor)
+// Returns NULL on a miss.
+{
+  if (!MaxNumBytes)
+    return NULL;
+
+  for (uint16_t Index = 0; Index < GlyphCache_MaxNumEntries; ++Index)
+  {
+    GlyphCache_Entry_t *pEntry = &Entries[Index];
+
+    if ((pEntry->pGlyph == pGlyph) && (pEntry->Kind == Kind) && (pEntry->Color == Color) && (pEntry->BackgroundColor == BackgroundColor))
+    {
+      pEntry->LastUsed = ++UseCounter;
+      ++Statistics.NumHits;
+      return pEntry->pPixels;
+    }
+  }
+
+  ++Statistics.NumMisses;
+  return NULL;
+}
+
+static GlyphCache_Entry_t *GetLeastRecentlyUsedEntry()
+{
+  GlyphCache_Entry_t *pResult = NULL;
+
+  for (uint16_t Index = 0; Index < GlyphCache_MaxNumEntries; ++Index)
+  {
+    GlyphCache_Entry_t *pEntry = &Entries[Index];
+
+    if (pEntry->pGlyph && (!pResult || (int32_t)(pEntry->LastUsed - pResult->LastUsed) < 0))
+      pResult = pEntry;
+  }
+
+  return pResult;
+}
+
+uint16_t *ILI9341_GlyphCache_Insert(const void *pGlyph, uint8_t Kind, uint16_t Color, uint16_t BackgroundColor, uint16_t NumPixels)
+// Returns a buffer of NumPixels pixels for the caller to fill, or NULL if the glyph cannot be cached.
+{
+  uint32_t NumBytes = NumPixels * sizeof(uint16_t);
+  GlyphCache_Entry_t *pEntry = NULL;
+
+  if (!MaxNumBytes || (NumBytes == 0) || (NumBytes > MaxNumBytes))
+    return NULL;
+
+  // Make room:
+  while (1)
+  {
+    pEntry = NULL;
+    for (uint16_t Index = 0; (Index < GlyphCache_MaxNumEntries) && !pEntry; ++Index)
+      if (!Entries[Index].pGlyph)
+        pEntry = &Entries[Index];
+
+    if (pEntry && (Statistics.NumBytes + NumBytes <= MaxNumBytes))
+      break;
+
+    FreeEntry(GetLeastRecentlyUsedEntry());
+    ++Statistics.NumEvictions;
+  }
+
+  pEntry->pPixels = (uint16_t *)HAL_Memory_Allocate(NumBytes, 1);
+  if (!pEntry->pPixels)
+  {
+    ESP_LOGW(LOG_TAG, "Unable to allocate %lu bytes", (unsigned long)NumBytes);
+    return NULL;
+  }
+
+  pEntry->pGlyph = pGlyph;
+  pEntry->Kind = Kind;
+  pEntry->Color = Color;
+  pEntry->BackgroundColor = BackgroundColor;
+  pEntry->NumPixels = NumPixels;
+  pEntry->LastUsed = ++UseCounter;
+
+  Statistics.NumBytes += NumBytes;
+  ++Statistics.NumEntries;
+
+  return pEntry->pPixels;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_ILI9341_GLYPHCACHE_H
+#define __JSB_ILI9341_GLYPHCACHE_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  uint32_t NumHits; // Lookups. A tdmAnyCharBar text run looks each cell up once per band.
+  uint32_t NumMisses;
+  uint32_t NumEvictions;
+  uint32_t NumEntries;
+  uint32_t NumBytes; // Pixel memory currently allocated.
+  uint32_t MaxNumBytes;
+} ILI9341_GlyphCacheStatistics_t;
+
+// Administration:
+void ILI9341_GlyphCache_Initialize(uint32_t MaxNumBytes);
+uint8_t ILI9341_GlyphCache_IsEnabled();
+void ILI9341_GlyphCache_Clear();
+
+// Entries (used by JSB_ILI9341.c):
+uint16_t *ILI9341_GlyphCache_Find(const void *pGlyph, uint8_t Kind, uint16_t Color, uint16_t BackgroundColor);
+uint16_t *ILI9341_GlyphCache_Insert(const void *pGlyph, uint8_t Kind, uint16_t Color, uint16_t BackgroundColor, uint16_t NumPixels);
+
+// Statistics:
+void ILI9341_GlyphCache_GetStatistics(ILI9341_GlyphCacheStatistics_t *pStatistics);
+void ILI9341_GlyphCache_ResetStatistics();
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
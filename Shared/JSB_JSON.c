@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// JSON tokenizer:
+//
+// => Returns one token per call, so the caller acts on each as it is read, rather than on a tree built from the whole text.
+// => Works in place: tokens point into the text. Nothing is allocated, and the state is a few bytes, however deep the nesting.
+// => Checks the grammar (RFC 8259) as it goes, so a caller that reads up to jtEnd has seen valid JSON.
+// => Strings are not unescaped. Escapes are checked, so a key with none can be compared directly.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+//
+#include "JSB_JSON.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef enum
+{
+  exValue,
+  exValueOrArrayEnd, // After '['.
+  exKey, // After ',' in an object.
+  exKeyOrObjectEnd, // After '{'.
+  exCommaOrEnd, // After a value: ',', the end of its container, or the end of the text.
+  exNothing // After an error.
+} Expect_t;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void JSON_Tokenizer_Initialize(JSON_Tokenizer_t *pTokenizer, char *pChars, uint16_t NumChars)
+{
+  pTokenizer->pChars = pChars;
+  pTokenizer->NumChars = NumChars;
+  pTokenizer->Index = 0;
+  pTokenizer->Depth = 0;
+  pTokenizer->ObjectBits = 0;
+  pTokenizer->Expect = exValue;
+}
+
+static void SkipWhitespace(JSON_Tokenizer_t *pTokenizer)
+{
+  while (pTokenizer->Index < pTokenizer->NumChars)
+  {
+    char Ch = pTokenizer->pChars[pTokenizer->Index];
+
+    if ((Ch != ' ') && (Ch != '\t') && (Ch != '\r') && (Ch != '\n'))
+      break;
+    ++pTokenizer->Index;
+  }
+}
+
+static uint8_t IsInObject(JSON_Tokenizer_t *pTokenizer)
+{
+  return pTokenizer->Depth && (pTokenizer->ObjectBits & (1u << (pTokenizer->Depth - 1)));
+}
+
+static uint8_t IsDigit(char Ch)
+{
+  return (Ch >= '0') && (Ch <= '9');
+}
+
+static uint8_t IsHexDigit(char Ch)
+{
+  return IsDigit(Ch) || ((Ch >= 'a') && (Ch <= 'f')) || ((Ch >= 'A') && (Ch <= 'F'));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint8_t ReadString(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken)
+// From the opening '"'. Returns 0 if the string is unterminated or malformed.
+{
+  uint16_t Index = pTokenizer->Index + 1;
+
+  while (Index < pTokenizer->NumChars)
+  {
+    char Ch = pTokenizer->pChars[Index];
+
+    if (Ch == '"')
+    {
+      pToken->pChars = pTokenizer->pChars + pTokenizer->Index + 1;
+      pToken->NumChars = Index - pTokenizer->Index - 1;
+      pTokenizer->Index = Index + 1;
+      return 1;
+    }
+
+    if ((uint8_t)Ch < 0x20) // Control chars must be escaped.
+      return 0;
+
+    if (Ch == '\\')
+    {
+      if (++Index == pTokenizer->NumChars)
+        return 0;
+
+      Ch = pTokenizer->pChars[Index];
+      if (Ch == 'u')
+      {
+        for (uint8_t DigitIndex = 0; DigitIndex < 4; ++DigitIndex)
+          if ((++Index == pTokenizer->NumChars) || !IsHexDigit(pTokenizer->pChars[Index]))
+            return 0;
+      }
+      else if (!strchr("\"\\/bfnrt", Ch) || !Ch)
+        return 0;
+    }
+
+    ++Index;
+  }
+
+  return 0;
+}
+
+static uint8_t ReadNumber(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken)
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+{
+  const char *pChars = pTokenizer->pChars;
+  uint16_t NumChars = pTokenizer->NumChars;
+  uint16_t Index = pTokenizer->Index;
+
+  if ((Index < NumChars) && (pChars[Index] == '-'))
+    ++Index;
+
+  if ((Index < NumChars) && (pChars[Index] == '0'))
+    ++Index;
+  else if ((Index < NumChars) && IsDigit(pChars[Index]))
+    while ((Index < NumChars) && IsDigit(pChars[Index]))
+      ++Index;
+  else
+    return 0;
+
+  if ((Index < NumChars) && (pChars[Index] == '.'))
+  {
+    if ((++Index == NumChars) || !IsDigit(pChars[Index]))
+      return 0;
+    while ((Index < NumChars) && IsDigit(pChars[Index]))
+      ++Index;
+  }
+
+  if ((Index < NumChars) && ((pChars[Index] == 'e') || (pChars[Index] == 'E')))
+  {
+    if ((++Index < NumChars) && ((pChars[Index] == '+') || (pChars[Index] == '-')))
+      ++Index;
+    if ((Index == NumChars) || !IsDigit(pChars[Index]))
+      return 0;
+    while ((Index < NumChars) && IsDigit(pChars[Index]))
+      ++Index;
+  }
+
+  pToken->pChars = pTokenizer->pChars + pTokenizer->Index;
+  pToken->NumChars = Index - pTokenizer->Index;
+  pTokenizer->Index = Index;
+  return 1;
+}
+
+static uint8_t ReadLiteral(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken, const char *pLiteral)
+{
+  uint16_t NumChars = strlen(pLiteral);
+
+  if ((pTokenizer->NumChars - pTokenizer->Index < NumChars) || memcmp(pTokenizer->pChars + pTokenizer->Index, pLiteral, NumChars))
+    return 0;
+
+  pToken->pChars = pTokenizer->pChars + pTokenizer->Index;
+  pToken->NumChars = NumChars;
+  pTokenizer->Index += NumChars;
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static JSON_TokenType_t SetTokenType(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken, JSON_TokenType_t Type)
+{
+  if (Type == jtError)
+    pTokenizer->Expect = exNothing;
+  pToken->Type = Type;
+  return Type;
+}
+
+static JSON_TokenType_t StartContainer(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken, uint8_t IsObject)
+{
+  if (pTokenizer->Depth == JSON_MaxDepth)
+    return SetTokenType(pTokenizer, pToken, jtError);
+
+  if (IsObject)
+    pTokenizer->ObjectBits |= 1u << pTokenizer->Depth;
+  else
+    pTokenizer->ObjectBits &= ~(1u << pTokenizer->Depth);
+  ++pTokenizer->Depth;
+
+  pToken->pChars = pTokenizer->pChars + pTokenizer->Index++;
+  pToken->NumChars = 1;
+  pTokenizer->Expect = IsObject ? exKeyOrObjectEnd : exValueOrArrayEnd;
+  return SetTokenType(pTokenizer, pToken, IsObject ? jtObjectStart : jtArrayStart);
+}
+
+static JSON_TokenType_t EndContainer(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken)
+{
+  uint8_t IsObject = IsInObject(pTokenizer);
+
+  --pTokenizer->Depth;
+  pToken->pChars = pTokenizer->pChars + pTokenizer->Index++;
+  pToken->NumChars = 1;
+  pTokenizer->Expect = exCommaOrEnd;
+  return SetTokenType(pTokenizer, pToken, IsObject ? jtObjectEnd : jtArrayEnd);
+}
+
+JSON_TokenType_t JSON_GetNextToken(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken)
+{
+  char Ch;
+
+  pToken->pChars = NULL;
+  pToken->NumChars = 0;
+
+  if (pTokenizer->Expect == exNothing)
+    return SetTokenType(pTokenizer, pToken, jtError);
+
+  SkipWhitespace(pTokenizer);
+
+  if (pTokenizer->Expect == exCommaOrEnd)
+  {
+    if (!pTokenizer->Depth) // After the top level value, there must be nothing more.
+      return SetTokenType(pTokenizer, pToken, (pTokenizer->Index == pTokenizer->NumChars) ? jtEnd : jtError);
+
+    if (pTokenizer->Index == pTokenizer->NumChars)
+      return SetTokenType(pTokenizer, pToken, jtError);
+
+    Ch = pTokenizer->pChars[pTokenizer->Index];
+    if (Ch == (IsInObject(pTokenizer) ? '}' : ']'))
+      return EndContainer(pTokenizer, pToken);
+    if (Ch != ',')
+      return SetTokenType(pTokenizer, pToken, jtError);
+
+    ++pTokenizer->Index;
+    pTokenizer->Expect = IsInObject(pTokenizer) ? exKey : exValue;
+    SkipWhitespace(pTokenizer);
+  }
+
+  if (pTokenizer->Index == pTokenizer->NumChars)
+    return SetTokenType(pTokenizer, pToken, jtError);
+  Ch = pTokenizer->pChars[pTokenizer->Index];
+
+  if (((pTokenizer->Expect == exKeyOrObjectEnd) && (Ch == '}')) || ((pTokenizer->Expect == exValueOrArrayEnd) && (Ch == ']')))
+    return EndContainer(pTokenizer, pToken);
+
+  if ((pTokenizer->Expect == exKey) || (pTokenizer->Expect == exKeyOrObjectEnd))
+  {
+    if ((Ch != '"') || !ReadString(pTokenizer, pToken))
+      return SetTokenType(pTokenizer, pToken, jtError);
+
+    SkipWhitespace(pTokenizer);
+    if ((pTokenizer->Index == pTokenizer->NumChars) || (pTokenizer->pChars[pTokenizer->Index] != ':'))
+      return SetTokenType(pTokenizer, pToken, jtError);
+    ++pTokenizer->Index;
+
+    pTokenizer->Expect = exValue;
+    return SetTokenType(pTokenizer, pToken, jtKey);
+  }
+
+  // A value:
+  pTokenizer->Expect = exCommaOrEnd;
+  switch (Ch)
+  {
+    case '{':
+      return StartContainer(pTokenizer, pToken, 1);
+    case '[':
+      return StartContainer(pTokenizer, pToken, 0);
+    case '"':
+      return SetTokenType(pTokenizer, pToken, ReadString(pTokenizer, pToken) ? jtString : jtError);
+    case 't':
+      return SetTokenType(pTokenizer, pToken, ReadLiteral(pTokenizer, pToken, "true") ? jtTrue : jtError);
+    case 'f':
+      return SetTokenType(pTokenizer, pToken, ReadLiteral(pTokenizer, pToken, "false") ? jtFalse : jtError);
+    case 'n':
+      return SetTokenType(pTokenizer, pToken, ReadLiteral(pTokenizer, pToken, "null") ? jtNull : jtError);
+    default:
+      return SetTokenType(pTokenizer, pToken, ReadNumber(pTokenizer, pToken) ? jtNumber : jtError);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,68 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_JSON_H
+#define __JSB_JSON_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define JSON_MaxDepth 32 // Objects and arrays nested deeper than this are rejected.
+
+typedef enum
+{
+  jtEnd, // The whole text has been read.
+  jtError, // The text is not valid JSON. Every call after this returns it too.
+  jtObjectStart,
+  jtObjectEnd,
+  jtArrayStart,
+  jtArrayEnd,
+  jtKey, // A member name. Its ':' has been read.
+  jtString,
+  jtNumber,
+  jtTrue,
+  jtFalse,
+  jtNull
+} JSON_TokenType_t;
+
+typedef struct
+{
+  JSON_TokenType_t Type;
+  char *pChars; // Not terminated. Points into the text. For a key or string, without the quotes, and still escaped.
+  uint16_t NumChars;
+} JSON_Token_t;
+
+typedef struct
+{
+  char *pChars;
+  uint16_t NumChars;
+  uint16_t Index; // Next char to read.
+  uint8_t Depth;
+  uint32_t ObjectBits; // Bit n set => the container at depth n + 1 is an object, rather than an array.
+  uint8_t Expect; // What may come next.
+} JSON_Tokenizer_t;
+
+void JSON_Tokenizer_Initialize(JSON_Tokenizer_t *pTokenizer, char *pChars, uint16_t NumChars);
+JSON_TokenType_t JSON_GetNextToken(JSON_Tokenizer_t *pTokenizer, JSON_Token_t *pToken);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,297 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp colour mixing:
+//
+// => Works out the channel levels that give a colour temperature (from the whites), or an sRGB or HSV colour (from red, green and
+//    blue), from each channel's chromaticity and flux: its calibration.
+// => LampMix_Initialize() does the colour science, in float, and leaves tables and a matrix, so that each mix is a few integer
+//    multiplies. Cheap enough to run every step of a fade or effect.
+// => Tools/JSB_LampMixTest.c checks the mixes against the calibration, and times them.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+#include <math.h>
+//
+#include "JSB_LampMix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define SRGBTable_NumEntries 257 // By the top 8 bits of a 16 bit value, plus the end point.
+#define Matrix_Fraction_bits 14
+#define Temperature_Fraction_bits 8 // Of a mired, and of a table position.
+#define NumBisections 32
+
+// Typical datasheet values, for want of the lamp's own:
+const LampMix_Emitter_t LampMix_DefaultEmitters[LampMix_NumChannels] =
+{
+  { 0.3805f, 0.3768f, 110.0f }, // Natural: 4000 K.
+  { 0.4599f, 0.4106f, 100.0f }, // Warm: 2700 K.
+  { 0.6915f, 0.3083f, 25.0f }, // Red: 625 nm.
+  { 0.1700f, 0.7000f, 60.0f }, // Green: 525 nm.
+  { 0.1355f, 0.0399f, 10.0f } // Blue: 465 nm.
+};
+
+static const float SRGBToXYZ[3][3] = // Linear sRGB, D65.
+{
+  { 0.4124f, 0.3576f, 0.1805f },
+  { 0.2126f, 0.7152f, 0.0722f },
+  { 0.0193f, 0.1192f, 0.9505f }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+static LampMix_Emitter_t Emitters[LampMix_NumChannels];
+static uint16_t SRGBTable[SRGBTable_NumEntries]; // sRGB encoded to linear.
+static int32_t Matrix[3][3]; // Linear sRGB to red, green and blue levels.
+static uint16_t TemperatureTable[LampMix_TemperatureTable_NumEntries][2]; // Natural and warm levels, at full intensity, evenly spaced in mireds.
+static uint32_t MinMired, MaxMired; // Of the natural and warm whites, in 1 / (1 << Temperature_Fraction_bits) mireds.
+
+///////////////////////////////////////////////////////////////////////////////
+
+float LampMix_GetTemperature_K(float x, float y)
+{
+  float n = (x - 0.3320f) / (0.1858f - y);
+
+  return 449.0f * n * n * n + 3525.0f * n * n + 6823.3f * n + 5520.33f;
+}
+
+static void GetXYZ(const LampMix_Emitter_t *pEmitter, float Flux, float *pXYZ)
+// Of the emitter, giving Flux.
+{
+  pXYZ[0] = pEmitter->x / pEmitter->y * Flux;
+  pXYZ[1] = Flux;
+  pXYZ[2] = (1.0f - pEmitter->x - pEmitter->y) / pEmitter->y * Flux;
+}
+
+void LampMix_GetChromaticity(const uint16_t *pLevels, float *px, float *py, float *pFlux)
+{
+  float XYZ[3] = { 0.0f, 0.0f, 0.0f };
+  float Sum;
+
+  for (uint8_t Channel = 0; Channel < LampMix_NumChannels; ++Channel)
+  {
+    float ChannelXYZ[3];
+
+    GetXYZ(&Emitters[Channel], Emitters[Channel].Flux * pLevels[Channel] / LampMix_MaxLevel, ChannelXYZ);
+    for (uint8_t Index = 0; Index < 3; ++Index)
+      XYZ[Index] += ChannelXYZ[Index];
+  }
+
+  Sum = XYZ[0] + XYZ[1] + XYZ[2];
+  *px = (Sum > 0.0f) ? XYZ[0] / Sum : 0.0f;
+  *py = (Sum > 0.0f) ? XYZ[1] / Sum : 0.0f;
+  *pFlux = XYZ[1];
+}
+
+static uint8_t Invert3x3(const float m[3][3], float Inverse[3][3])
+// Returns 0 if m is singular.
+{
+  float Determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+    m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+  if (fabsf(Determinant) < 1e-9f)
+    return 0;
+
+  for (uint8_t Row = 0; Row < 3; ++Row)
+    for (uint8_t Column = 0; Column < 3; ++Column)
+    {
+      // Cofactor of m[Column][Row]:
+      uint8_t r0 = (Column + 1) % 3, r1 = (Column + 2) % 3, c0 = (Row + 1) % 3, c1 = (Row + 2) % 3;
+
+      Inverse[Row][Column] = (m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0]) / Determinant;
+    }
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void InitializeSRGBTable()
+{
+  for (uint16_t Index = 0; Index < SRGBTable_NumEntries; ++Index)
+  {
+    float Value = (Index < SRGBTable_NumEntries - 1) ? Index / 256.0f : 1.0f;
+
+    Value = (Value <= 0.04045f) ? Value / 12.92f : powf((Value + 0.055f) / 1.055f, 2.4f);
+    SRGBTable[Index] = (uint16_t)(Value * LampMix_MaxLevel + 0.5f);
+  }
+}
+
+static void InitializeMatrix()
+// Red, green and blue levels = (emitters' XYZ)^-1 * (sRGB to XYZ) * linear sRGB, scaled so that no colour needs more than a
+// channel's full output. Colours outside the emitters' gamut need negative levels, which are clipped to 0.
+{
+  float EmitterXYZ[3][3], Inverse[3][3], Product[3][3];
+  float MaxRowSum = 0.0f;
+
+  for (uint8_t Column = 0; Column < 3; ++Column)
+  {
+    float XYZ[3];
+
+    GetXYZ(&Emitters[lmcRed + Column], Emitters[lmcRed + Column].Flux, XYZ);
+    for (uint8_t Row = 0; Row < 3; ++Row)
+      EmitterXYZ[Row][Column] = XYZ[Row];
+  }
+
+  if (!Invert3x3(EmitterXYZ, Inverse))
+  {
+    memset(Matrix, 0, sizeof(Matrix));
+    return;
+  }
+
+  for (uint8_t Row = 0; Row < 3; ++Row)
+  {
+    float RowSum = 0.0f;
+
+    for (uint8_t Column = 0; Column < 3; ++Column)
+    {
+      Product[Row][Column] = Inverse[Row][0] * SRGBToXYZ[0][Column] + Inverse[Row][1] * SRGBToXYZ[1][Column] + Inverse[Row][2] * SRGBToXYZ[2][Column];
+      if (Product[Row][Column] > 0.0f)
+        RowSum += Product[Row][Column];
+    }
+    if (RowSum > MaxRowSum)
+      MaxRowSum = RowSum;
+  }
+
+  for (uint8_t Row = 0; Row < 3; ++Row)
+    for (uint8_t Column = 0; Column < 3; ++Column)
+      Matrix[Row][Column] = lroundf(Product[Row][Column] / MaxRowSum * (1 << Matrix_Fraction_bits));
+}
+
+static void GetWhiteMixChromaticity(float WarmFraction, float *px, float *py)
+// Of the whites mixed, WarmFraction of the flux from the warm one.
+{
+  float Natural[3], Warm[3], Sum;
+
+  GetXYZ(&Emitters[lmcNatural], 1.0f - WarmFraction, Natural);
+  GetXYZ(&Emitters[lmcWarm], WarmFraction, Warm);
+  Sum = Natural[0] + Natural[1] + Natural[2] + Warm[0] + Warm[1] + Warm[2];
+  *px = (Natural[0] + Warm[0]) / Sum;
+  *py = (Natural[1] + Warm[1]) / Sum;
+}
+
+static void InitializeTemperatureTable()
+// For each temperature, the flux from each white that gives it is found by bisection: the mix's temperature falls as more of it is
+// from the warm one.
+{
+  float MinMired_f = 1e6f / LampMix_GetTemperature_K(Emitters[lmcNatural].x, Emitters[lmcNatural].y);
+  float MaxMired_f = 1e6f / LampMix_GetTemperature_K(Emitters[lmcWarm].x, Emitters[lmcWarm].y);
+
+  MinMired = lroundf(MinMired_f * (1 << Temperature_Fraction_bits));
+  MaxMired = lroundf(MaxMired_f * (1 << Temperature_Fraction_bits));
+
+  for (uint16_t Index = 0; Index < LampMix_TemperatureTable_NumEntries; ++Index)
+  {
+    float Temperature_K = 1e6f / (MinMired_f + (MaxMired_f - MinMired_f) * Index / (LampMix_TemperatureTable_NumEntries - 1));
+    float Low = 0.0f, High = 1.0f, Natural, Warm, Max;
+
+    for (uint8_t Bisection = 0; Bisection < NumBisections; ++Bisection)
+    {
+      float Middle = 0.5f * (Low + High), x, y;
+
+      GetWhiteMixChromaticity(Middle, &x, &y);
+      if (LampMix_GetTemperature_K(x, y) > Temperature_K)
+        Low = Middle;
+      else
+        High = Middle;
+    }
+
+    // Outputs, as fractions of full, then scaled so that the greater is full:
+    Warm = 0.5f * (Low + High) / Emitters[lmcWarm].Flux;
+    Natural = (1.0f - 0.5f * (Low + High)) / Emitters[lmcNatural].Flux;
+    Max = (Warm > Natural) ? Warm : Natural;
+    TemperatureTable[Index][0] = lroundf(Natural / Max * LampMix_MaxLevel);
+    TemperatureTable[Index][1] = lroundf(Warm / Max * LampMix_MaxLevel);
+  }
+}
+
+void LampMix_Initialize(const LampMix_Emitter_t *pEmitters)
+{
+  memcpy(Emitters, pEmitters, sizeof(Emitters));
+  InitializeSRGBTable();
+  InitializeMatrix();
+  InitializeTemperatureTable();
+}
+
+uint16_t LampMix_GetMinTemperature_K()
+{
+  return (1000000u << Temperature_Fraction_bits) / MaxMired;
+}
+
+uint16_t LampMix_GetMaxTemperature_K()
+{
+  return (1000000u << Temperature_Fraction_bits) / MinMired;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void LampMix_FromTemperature(uint16_t Temperature_K, uint16_t Intensity, uint16_t *pLevels)
+{
+  uint32_t Mired = Temperature_K ? (1000000u << Temperature_Fraction_bits) / Temperature_K : MaxMired;
+  uint32_t Position, Index, Fraction;
+
+  if (Mired < MinMired)
+    Mired = MinMired;
+  if (Mired > MaxMired)
+    Mired = MaxMired;
+
+  memset(pLevels, 0, LampMix_NumChannels * sizeof(*pLevels));
+  Position = (MaxMired > MinMired) ? ((uint64_t)(Mired - MinMired) * ((LampMix_TemperatureTable_NumEntries - 1) << Temperature_Fraction_bits)) / (MaxMired - MinMired) : 0;
+  Index = Position >> Temperature_Fraction_bits;
+  Fraction = Position & ((1 << Temperature_Fraction_bits) - 1);
+
+  for (uint8_t White = 0; White < 2; ++White)
+  {
+    uint32_t Level = TemperatureTable[Index][White];
+
+    if (Index < LampMix_TemperatureTable_NumEntries - 1)
+      Level = (Level * ((1 << Temperature_Fraction_bits) - Fraction) + TemperatureTable[Index + 1][White] * Fraction) >> Temperature_Fraction_bits;
+    pLevels[lmcNatural + White] = (Level * Intensity + LampMix_MaxLevel / 2) / LampMix_MaxLevel;
+  }
+}
+
+static uint32_t DecodeSRGB(uint16_t Value)
+{
+  uint32_t Index = Value >> 8;
+  uint32_t Fraction = Value & 0xFF;
+
+  return (SRGBTable[Index] * (256 - Fraction) + SRGBTable[Index + 1] * Fraction) >> 8;
+}
+
+void LampMix_FromSRGB(uint16_t R, uint16_t G, uint16_t B, uint16_t *pLevels)
+{
+  uint32_t Linear[3] = { DecodeSRGB(R), DecodeSRGB(G), DecodeSRGB(B) };
+
+  pLevels[lmcNatural] = 0;
+  pLevels[lmcWarm] = 0;
+  for (uint8_t Row = 0; Row < 3; ++Row)
+  {
+    int64_t Level = ((int64_t)Matrix[Row][0] * Linear[0] + (int64_t)Matrix[Row][1] * Linear[1] + (int64_t)Matrix[Row][2] * Linear[2] +
+      (1 << (Matrix_Fraction_bits - 1))) >> Matrix_Fraction_bits;
+
+    pLevels[lmcRed + Row] = (Level < 0) ? 0 : (Level > LampMix_MaxLevel) ? LampMix_MaxLevel : Level;
+  }
+}
+
+void LampMix_FromHSV(uint16_t Hue, uint16_t Saturation, uint16_t Value, uint16_t *pLevels)
+{
+  uint32_t Hue6 = (uint32_t)Hue * 6; // Sextant, and fraction of it.
+  uint32_t Fraction = Hue6 & 0xFFFF;
+  uint32_t Low = ((uint32_t)Value * (65535 - Saturation)) / 65535;
+  uint32_t Falling = ((uint32_t)Value * (65535 - (((uint64_t)Saturation * Fraction) >> 16))) / 65535;
+  uint32_t Rising = ((uint32_t)Value * (65535 - (((uint64_t)Saturation * (65536 - Fraction)) >> 16))) / 65535;
+
+  switch (Hue6 >> 16)
+  {
+    case 0: LampMix_FromSRGB(Value, Rising, Low, pLevels); break;
+    case 1: LampMix_FromSRGB(Falling, Value, Low, pLevels); break;
+    case 2: LampMix_FromSRGB(Low, Value, Rising, pLevels); break;
+    case 3: LampMix_FromSRGB(Low, Falling, Value, pLevels); break;
+    case 4: LampMix_FromSRGB(Rising, Low, Value, pLevels); break;
+    default: LampMix_FromSRGB(Value, Low, Falling, pLevels); break;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,65 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_LAMPMIX_H
+#define __JSB_LAMPMIX_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define LampMix_NumChannels 5
+#define LampMix_MaxLevel 65535 // A channel's full output.
+#define LampMix_TemperatureTable_NumEntries 65
+
+typedef enum
+{
+  lmcNatural, // As the lamp's channels.
+  lmcWarm,
+  lmcRed,
+  lmcGreen,
+  lmcBlue
+} LampMix_Channel_t;
+
+typedef struct
+{
+  float x, y; // CIE 1931 chromaticity.
+  float Flux; // Luminous flux at full output. In any unit, as long as it is the same for every channel.
+} LampMix_Emitter_t;
+
+extern const LampMix_Emitter_t LampMix_DefaultEmitters[LampMix_NumChannels];
+
+// Setting up, with float maths, once:
+void LampMix_Initialize(const LampMix_Emitter_t *pEmitters);
+uint16_t LampMix_GetMinTemperature_K();
+uint16_t LampMix_GetMaxTemperature_K();
+
+// Mixing, with integer maths. Levels are linear in light output, [0, LampMix_MaxLevel], by LampMix_Channel_t:
+void LampMix_FromTemperature(uint16_t Temperature_K, uint16_t Intensity, uint16_t *pLevels); // Whites only, the rest 0. Temperature_K is clamped to the whites' range.
+void LampMix_FromSRGB(uint16_t R, uint16_t G, uint16_t B, uint16_t *pLevels); // Colours only, the whites 0. 16 bit, sRGB encoded.
+void LampMix_FromHSV(uint16_t Hue, uint16_t Saturation, uint16_t Value, uint16_t *pLevels); // As LampMix_FromSRGB(). Hue: 65536 => a full turn.
+
+// Checking:
+float LampMix_GetTemperature_K(float x, float y); // Correlated colour temperature (McCamy).
+void LampMix_GetChromaticity(const uint16_t *pLevels, float *px, float *py, float *pFlux); // Of the light the levels give, by the calibration.
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,104 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp packets: a compact binary protocol for driving the lamp's channels many times a second, e.g. over UDP.
+//
+// => Byte layout, multi-byte values big endian:
+//      0   'L', 'P'
+//      2   Version (LampPacket_Version)
+//      3   Flags (lpf...)
+//      4   Sequence (4 bytes)
+//      8   ChannelMask
+//      9   One intensity (2 bytes) for each bit set in ChannelMask, lowest bit first.
+// => Packets may be lost, duplicated or reordered, so each carries a sequence number. Only packets newer than the newest accepted are accepted.
+// => Shared by the lamp and host tools, so has no dependencies.
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JSB_LampPacket.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Packets:
+
+uint8_t LampPacket_Encode(const LampPacket_t *pPacket, uint8_t *pBytes)
+// pBytes: Room for LampPacket_MaxNumBytes. Returns the number used.
+{
+  uint8_t NumBytes = LampPacket_HeaderNumBytes;
+
+  pBytes[0] = 'L';
+  pBytes[1] = 'P';
+  pBytes[2] = LampPacket_Version;
+  pBytes[3] = pPacket->Flags;
+  pBytes[4] = pPacket->Sequence >> 24;
+  pBytes[5] = pPacket->Sequence >> 16;
+  pBytes[6] = pPacket->Sequence >> 8;
+  pBytes[7] = pPacket->Sequence;
+  pBytes[8] = pPacket->ChannelMask;
+
+  for (uint8_t Channel = 0; Channel < LampPacket_MaxNumChannels; ++Channel)
+    if (pPacket->ChannelMask & (1 << Channel))
+    {
+      pBytes[NumBytes++] = pPacket->Intensities[Channel] >> 8;
+      pBytes[NumBytes++] = pPacket->Intensities[Channel];
+    }
+
+  return NumBytes;
+}
+
+uint8_t LampPacket_Decode(const uint8_t *pBytes, uint16_t NumBytes, LampPacket_t *pPacket)
+// Returns 0 if pBytes is not exactly one packet of this version.
+{
+  uint16_t Index = LampPacket_HeaderNumBytes;
+
+  if ((NumBytes < LampPacket_HeaderNumBytes) || (pBytes[0] != 'L') || (pBytes[1] != 'P') || (pBytes[2] != LampPacket_Version))
+    return 0;
+
+  pPacket->Flags = pBytes[3];
+  pPacket->Sequence = ((uint32_t)pBytes[4] << 24) | ((uint32_t)pBytes[5] << 16) | ((uint32_t)pBytes[6] << 8) | pBytes[7];
+  pPacket->ChannelMask = pBytes[8];
+
+  for (uint8_t Channel = 0; Channel < LampPacket_MaxNumChannels; ++Channel)
+  {
+    pPacket->Intensities[Channel] = 0;
+    if (pPacket->ChannelMask & (1 << Channel))
+    {
+      if (Index + 2 > NumBytes)
+        return 0;
+      pPacket->Intensities[Channel] = (pBytes[Index] << 8) | pBytes[Index + 1];
+      Index += 2;
+    }
+  }
+
+  return Index == NumBytes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sequencing:
+
+void LampPacket_RestartSequence(LampPacket_Sequencer_t *pSequencer)
+// E.g. when the sender changes, or has been silent for a while, so may have restarted its sequence.
+{
+  pSequencer->Started = 0;
+}
+
+uint8_t LampPacket_AcceptSequence(LampPacket_Sequencer_t *pSequencer, uint32_t Sequence)
+// Returns 1 if a packet with this sequence number is newer than any accepted, so is to be applied.
+{
+  int32_t Difference = (int32_t)(Sequence - pSequencer->LastSequence); // Serial number arithmetic, so the sequence can wrap.
+
+  if (pSequencer->Started && (Difference <= 0))
+  {
+    ++pSequencer->NumStale;
+    return 0;
+  }
+
+  if (pSequencer->Started)
+    pSequencer->NumLost += Difference - 1;
+  pSequencer->Started = 1;
+  pSequencer->LastSequence = Sequence;
+  ++pSequencer->NumAccepted;
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,66 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_LAMPPACKET_H
+#define __JSB_LAMPPACKET_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define LampPacket_Version 1
+#define LampPacket_MaxNumChannels 8 // Bits in ChannelMask.
+#define LampPacket_HeaderNumBytes 9
+#define LampPacket_MaxNumBytes (LampPacket_HeaderNumBytes + 2 * LampPacket_MaxNumChannels)
+
+// Flags:
+#define lpfSetOff 0x01 // Set the lamp on or off, as lpfOff.
+#define lpfOff 0x02
+
+typedef struct
+{
+  uint32_t Sequence; // One more than the sender's previous packet. Wraps.
+  uint8_t Flags;
+  uint8_t ChannelMask; // Bit n set => Intensities[n] is to be set.
+  uint16_t Intensities[LampPacket_MaxNumChannels]; // 0 => off, 65535 => full.
+} LampPacket_t;
+
+typedef struct
+{
+  // Zero to start a stream:
+  uint8_t Started;
+  uint32_t LastSequence; // Of the newest packet accepted.
+  // Statistics, kept when a stream is restarted:
+  uint32_t NumAccepted;
+  uint32_t NumStale; // Duplicated, or overtaken by a newer packet.
+  uint32_t NumLost; // Skipped over by a newer packet. Those that arrive later are counted as stale too.
+} LampPacket_Sequencer_t;
+
+// Packets:
+uint8_t LampPacket_Encode(const LampPacket_t *pPacket, uint8_t *pBytes);
+uint8_t LampPacket_Decode(const uint8_t *pBytes, uint16_t NumBytes, LampPacket_t *pPacket);
+
+// Sequencing:
+void LampPacket_RestartSequence(LampPacket_Sequencer_t *pSequencer);
+uint8_t LampPacket_AcceptSequence(LampPacket_Sequencer_t *pSequencer, uint32_t Sequence);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,120 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// WebSocket (RFC 6455) framing, for a server:
+//
+// => The opening handshake is an HTTP request, so is parsed with JSB_HTTP. Only its accept key is computed here.
+// => Frames are read in place from the connection's receive buffer, as HTTP requests are, and unmasked there.
+// => A frame's header is built separately, so that it can be put in front of a payload already in the output buffer, and the frame sent with one send().
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string.h>
+//
+#include "mbedtls/sha1.h"
+#include "mbedtls/base64.h"
+//
+#include "JSB_WebSocket.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define MaxKeyNumChars 64 // A client's key is 24 chars: base64 of 16 random bytes.
+
+static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+///////////////////////////////////////////////////////////////////////////////
+// Opening handshake:
+
+uint8_t WebSocket_GetAcceptKey(const char *pKey, uint16_t KeyNumChars, char *pAcceptKey)
+// pKey: The client's Sec-WebSocket-Key.
+// pAcceptKey: Sec-WebSocket-Accept is put here, terminated, so room for WebSocket_AcceptKey_NumChars + 1 chars is needed.
+// Returns 0 if pKey is not plausible.
+{
+  unsigned char Chars[MaxKeyNumChars + sizeof(GUID) - 1];
+  unsigned char Hash[20];
+  size_t NumChars;
+
+  if (!KeyNumChars || (KeyNumChars > MaxKeyNumChars))
+    return 0;
+
+  memcpy(Chars, pKey, KeyNumChars);
+  memcpy(Chars + KeyNumChars, GUID, sizeof(GUID) - 1);
+  if (mbedtls_sha1(Chars, KeyNumChars + sizeof(GUID) - 1, Hash) != 0)
+    return 0;
+
+  return mbedtls_base64_encode((unsigned char *)pAcceptKey, WebSocket_AcceptKey_NumChars + 1, &NumChars, Hash, sizeof(Hash)) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Frames:
+
+WebSocket_ReadResult_t WebSocket_ReadFrame(char *pChars, uint32_t NumChars, uint32_t MaxNumChars, WebSocket_Frame_t *pFrame)
+// pChars: Everything received so far. Can be called again as more arrives: nothing is changed until the whole frame has been.
+// MaxNumChars: Size of the buffer. A frame that cannot fit in it is rejected as soon as its header has been received.
+{
+  const uint8_t *pBytes = (const uint8_t *)pChars;
+  uint32_t HeaderNumChars = 2;
+  uint64_t PayloadNumChars;
+  uint8_t Mask[4];
+
+  if (NumChars < 2)
+    return wrNeedMoreInput;
+
+  if ((pBytes[0] & 0x70) || !(pBytes[1] & 0x80)) // No extensions are agreed, and a client must mask.
+    return wrBad;
+
+  pFrame->Final = pBytes[0] >> 7;
+  pFrame->Opcode = (WebSocket_Opcode_t)(pBytes[0] & 0x0F);
+  PayloadNumChars = pBytes[1] & 0x7F;
+
+  if ((pFrame->Opcode & 0x8) && (!pFrame->Final || (PayloadNumChars > 125))) // Control frames are short, and not fragmented.
+    return wrBad;
+
+  if (PayloadNumChars >= 126)
+  {
+    uint8_t NumLengthBytes = (PayloadNumChars == 126) ? 2 : 8;
+
+    if (NumChars < HeaderNumChars + NumLengthBytes)
+      return wrNeedMoreInput;
+
+    PayloadNumChars = 0;
+    for (uint8_t Index = 0; Index < NumLengthBytes; ++Index)
+      PayloadNumChars = (PayloadNumChars << 8) | pBytes[HeaderNumChars + Index];
+    HeaderNumChars += NumLengthBytes;
+  }
+  HeaderNumChars += sizeof(Mask);
+
+  if ((PayloadNumChars > MaxNumChars) || (HeaderNumChars + PayloadNumChars > MaxNumChars))
+    return wrTooLarge;
+  if (NumChars < HeaderNumChars + PayloadNumChars)
+    return wrNeedMoreInput;
+
+  memcpy(Mask, pBytes + HeaderNumChars - sizeof(Mask), sizeof(Mask));
+  pFrame->pPayload = pChars + HeaderNumChars;
+  pFrame->PayloadNumChars = PayloadNumChars;
+  pFrame->NumChars = HeaderNumChars + PayloadNumChars;
+  for (uint32_t Index = 0; Index < pFrame->PayloadNumChars; ++Index)
+    pFrame->pPayload[Index] ^= Mask[Index & 3];
+
+  return wrComplete;
+}
+
+uint8_t WebSocket_GetFrameHeader(WebSocket_Opcode_t Opcode, uint16_t PayloadNumChars, uint8_t *pHeader)
+// A complete (final) unmasked frame. pHeader needs room for WebSocket_MaxFrameHeaderNumBytes bytes. Returns the number used.
+{
+  pHeader[0] = 0x80 | Opcode;
+
+  if (PayloadNumChars < 126)
+  {
+    pHeader[1] = PayloadNumChars;
+    return 2;
+  }
+
+  pHeader[1] = 126;
+  pHeader[2] = PayloadNumChars >> 8;
+  pHeader[3] = PayloadNumChars & 0xFF;
+  return 4;
+}
+
+///////////////////////////////////////////////////////////////////////////////
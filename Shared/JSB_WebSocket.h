@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef __JSB_WEBSOCKET_H
+#define __JSB_WEBSOCKET_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define WebSocket_AcceptKey_NumChars 28 // Base64 of a SHA-1 hash.
+#define WebSocket_MaxFrameHeaderNumBytes 4 // Of a server frame, which is never masked, and never has more than 65535 bytes of payload.
+
+typedef enum
+{
+  woContinuation = 0x0,
+  woText = 0x1,
+  woBinary = 0x2,
+  woClose = 0x8,
+  woPing = 0x9,
+  woPong = 0xA
+} WebSocket_Opcode_t;
+
+typedef enum
+{
+  wrNeedMoreInput,
+  wrComplete,
+  wrTooLarge, // The frame cannot fit in the buffer.
+  wrBad // Not a valid frame from a client.
+} WebSocket_ReadResult_t;
+
+typedef struct
+{
+  uint8_t Final; // Last frame of a message.
+  WebSocket_Opcode_t Opcode;
+  char *pPayload; // Unmasked, in place.
+  uint32_t PayloadNumChars;
+  uint32_t NumChars; // Of the whole frame, from the start of the buffer.
+} WebSocket_Frame_t;
+
+// Opening handshake:
+uint8_t WebSocket_GetAcceptKey(const char *pKey, uint16_t KeyNumChars, char *pAcceptKey);
+
+// Frames:
+WebSocket_ReadResult_t WebSocket_ReadFrame(char *pChars, uint32_t NumChars, uint32_t MaxNumChars, WebSocket_Frame_t *pFrame);
+uint8_t WebSocket_GetFrameHeader(WebSocket_Opcode_t Opcode, uint16_t PayloadNumChars, uint8_t *pHeader);
+
+///////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+}
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+
+#endif
+///////////////////////////////////////////////////////////////////////////////
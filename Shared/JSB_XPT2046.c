@@ -14,12 +14,9 @@
 //
 #include "esp_system.h"
 #include "esp_log.h"
-#include "soc/gpio_struct.h"
-#include "driver/spi_master.h"
-#include "driver/gpio.h"
-#include "freertos/FreeRTOS.h"
-#include "freertos/task.h"
+#include "esp_attr.h"
 //
+#include "JSB_HAL.h"
 #include "JSB_XPT2046.h"
 
 #define LOG_TAG "JSB_XPT2046"
@@ -48,25 +45,22 @@ int XPT2046_RawY_Max = 3660;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-static spi_device_handle_t spi;
+static HAL_SPI_Device_t spi;
 
 ///////////////////////////////////////////////////////////////////////////////
 
-void XPT2046_Initialize(spi_host_device_t HostDevice, int i_CSX_GPIO)
+void XPT2046_Initialize(HAL_SPI_Host_t HostDevice, int i_CSX_GPIO)
 {
-  esp_err_t ret;
-
   // Attach the LCD to the SPI bus:
-  spi_device_interface_config_t devcfg =
+  HAL_SPI_DeviceConfiguration_t devcfg =
   {
-    .clock_speed_hz = 2000000, /* There are strict requirements for this. See datasheet for more information */
-    .mode = 0, // SPI mode 0.
-    .spics_io_num = i_CSX_GPIO,
-    .queue_size = SPI_MaxNumTransactions,
-    .pre_cb = NULL
+    .ClockSpeed_Hz = 2000000, /* There are strict requirements for this. See datasheet for more information */
+    .Mode = 0, // SPI mode 0.
+    .CSX_GPIO = i_CSX_GPIO,
+    .QueueSize = SPI_MaxNumTransactions,
+    .PreTransferCallback = NULL
   };
-  ret = spi_bus_add_device(HostDevice, &devcfg, &spi);
-  assert(ret==ESP_OK);
+  HAL_SPI_AddDevice(HostDevice, &devcfg, &spi);
 }
 
 static int16_t GetBest(int16_t A, int16_t B, int16_t C)
@@ -120,8 +114,7 @@ uint8_t XPT2046_Sample(int16_t *pRawX, int16_t *pRawY, int16_t *pRawZ)
 // None of the touch screens I've encountered so far are correctly wired. Use compiler defines to reverse the coordinates as required.
 {
   int16_t x, y, z;
-  spi_transaction_t Transaction;
-  esp_err_t ret;
+  HAL_SPI_Transaction_t Transaction;
 
   *pRawX = 0;
   *pRawY = 0;
@@ -131,17 +124,16 @@ uint8_t XPT2046_Sample(int16_t *pRawX, int16_t *pRawY, int16_t *pRawZ)
   int16_t X_Positions[3];
   int16_t Y_Positions[3];
 
-  ESP_ERROR_CHECK(spi_device_acquire_bus(spi, portMAX_DELAY));
+  HAL_SPI_AcquireBus(spi);
   //
   memset(&Transaction, 0, sizeof(Transaction));
   Transaction.length = 19 * 8;
   Transaction.tx_buffer = SampleCommand;
   Transaction.rxlength = 19 * 8;
   Transaction.rx_buffer = RxData;
-  ret = spi_device_polling_transmit(spi, &Transaction); // JSB 20240709: Was spi_device_transmit()
-  assert(ret == ESP_OK);
+  HAL_SPI_Transmit(spi, &Transaction);
   //
-  spi_device_release_bus(spi);
+  HAL_SPI_ReleaseBus(spi);
 
   int16_t z1 = GetUnsigned12bitValue(&RxData[1]);
   int16_t z2 = GetUnsigned12bitValue(&RxData[3]);
@@ -14,6 +14,7 @@ extern "C"
 
 ///////////////////////////////////////////////////////////////////////////////
 
+#include "JSB_HAL.h"
 #include "UserDefines.h"
 
 extern const int XPT2046_Width;
@@ -24,7 +25,7 @@ extern int XPT2046_RawX_Max;
 extern int XPT2046_RawY_Min;
 extern int XPT2046_RawY_Max;
 
-void XPT2046_Initialize(spi_host_device_t HostDevice, int i_CSX_GPIO);
+void XPT2046_Initialize(HAL_SPI_Host_t HostDevice, int i_CSX_GPIO);
 uint8_t XPT2046_Sample(int16_t *pRawX, int16_t *pRawY, int16_t *pRawZ);
 void XPT2046_ConvertRawToScreen(int16_t RawX, int16_t RawY, int16_t *pX, int16_t *pY);
 
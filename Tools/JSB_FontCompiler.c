@@ -0,0 +1,239 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Font compiler:
+//
+// => Host tool. Converts an Adafruit 1-bpp GFXfont header into a gffRuns font header (see gfxfont.h).
+// => The font is compiled in, so build the tool once per font. E.g. from the repository folder:
+//      gcc -IShared -DFONT_HEADER='"FreeSans12pt7b.h"' -DFONT=FreeSans12pt7b Tools/JSB_FontCompiler.c -o JSB_FontCompiler
+//      ./JSB_FontCompiler > Shared/FreeSans12pt7bRuns.h
+// => Every glyph is decoded again and compared with the original bitmap. Nothing is output if any pixel differs.
+// => Runs are opt-in per font: they only pay for fonts with thick strokes, as their size goes with the number of runs rather than the glyph area.
+//    For the FreeSans fonts they are larger than the bitmaps (1501 vs 1150 bytes at 9pt, 2108 vs 1969 at 12pt), and the driver draws bitmaps
+//    as spans too, so those are used as bitmaps. Nothing is output for a font whose runs would be larger, unless FONT_RUNS_EVEN_IF_LARGER
+//    is defined (-DFONT_RUNS_EVEN_IF_LARGER).
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+//
+#include "gfxfont.h"
+#include FONT_HEADER
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define Stringify(X) #X
+#define FontName(X) Stringify(X)
+
+#define MaxNumRunBytes 65536
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint8_t RunBytes[MaxNumRunBytes];
+static uint32_t NumRunBytes = 0;
+
+static uint8_t GetBitmapPixel(const GFXglyph *pGlyph, uint8_t X, uint8_t Y)
+{
+  uint16_t BitIndex = Y * pGlyph->width + X;
+
+  return (FONT.pBitmap[pGlyph->bitmapOffset + (BitIndex >> 3)] >> (7 - (BitIndex & 7))) & 1;
+}
+
+static void AddRunByte(uint8_t Value)
+{
+  if (NumRunBytes >= MaxNumRunBytes)
+  {
+    fprintf(stderr, "Too many run bytes.\n");
+    exit(1);
+  }
+  RunBytes[NumRunBytes++] = Value;
+}
+
+static void EncodeGlyph(const GFXglyph *pGlyph)
+{
+  uint32_t PreviousRowStart = 0, PreviousRowNumBytes = 0;
+
+  for (uint8_t Y = 0; Y < pGlyph->height; ++Y)
+  {
+    uint32_t RowStart = NumRunBytes;
+    uint8_t X = 0, RunEnd = 0;
+
+    while (X < pGlyph->width)
+    {
+      uint8_t Start, Skip, Length;
+
+      if (!GetBitmapPixel(pGlyph, X, Y))
+      {
+        ++X;
+        continue;
+      }
+
+      Start = X;
+      while ((X < pGlyph->width) && GetBitmapPixel(pGlyph, X, Y))
+        ++X;
+
+      Skip = Start - RunEnd;
+      Length = X - Start;
+      for (; Skip > 7; Skip -= 7)
+        AddRunByte(0x70);
+      for (; Length > 15; Length -= 15, Skip = 0)
+        AddRunByte((Skip << 4) | 15);
+      AddRunByte((Skip << 4) | Length);
+      RunEnd = X;
+    }
+
+    if (NumRunBytes == RowStart)
+      AddRunByte(0x80); // Empty row.
+    else
+      RunBytes[NumRunBytes - 1] |= 0x80;
+
+    // Repeated row:
+    if ((Y > 0) && (NumRunBytes - RowStart == PreviousRowNumBytes) && !memcmp(&RunBytes[RowStart], &RunBytes[PreviousRowStart], PreviousRowNumBytes))
+    {
+      NumRunBytes = RowStart;
+      AddRunByte(0x00);
+    }
+    else
+    {
+      PreviousRowStart = RowStart;
+      PreviousRowNumBytes = NumRunBytes - RowStart;
+    }
+  }
+}
+
+static uint8_t VerifyGlyph(const GFXglyph *pGlyph, uint16_t RunOffset)
+// Decodes the glyph's runs as the driver does. Returns 0 if they do not reproduce the bitmap.
+{
+  static uint8_t Pixels[256][256];
+  const uint8_t *pRunByte = &RunBytes[RunOffset];
+  const uint8_t *pPreviousRow = NULL;
+
+  memset(Pixels, 0, sizeof(Pixels));
+
+  for (uint8_t Y = 0; Y < pGlyph->height; ++Y)
+  {
+    const uint8_t *pRow;
+    uint16_t X = 0;
+
+    if (*pRunByte == 0x00)
+    {
+      if (!pPreviousRow)
+        return 0;
+      pRow = pPreviousRow;
+      ++pRunByte;
+    }
+    else
+      pPreviousRow = pRow = pRunByte;
+
+    while (1)
+    {
+      uint8_t RunByte = *pRow++;
+
+      X += (RunByte >> 4) & 7;
+      for (uint8_t Index = 0; Index < (RunByte & 15); ++Index, ++X)
+      {
+        if (X >= pGlyph->width)
+          return 0;
+        Pixels[Y][X] = 1;
+      }
+      if (RunByte & 0x80)
+        break;
+    }
+
+    if (pRow > pRunByte)
+      pRunByte = pRow;
+  }
+
+  for (uint8_t Y = 0; Y < pGlyph->height; ++Y)
+    for (uint8_t X = 0; X < pGlyph->width; ++X)
+      if (Pixels[Y][X] != GetBitmapPixel(pGlyph, X, Y))
+        return 0;
+
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+  const char *pName = FontName(FONT);
+  uint16_t NumGlyphs = FONT.last - FONT.first + 1;
+  uint16_t *pRunOffsets = (uint16_t *)malloc(NumGlyphs * sizeof(uint16_t));
+  uint32_t NumBitmapBytes = 0;
+
+  if (FONT.format != gffBitmap)
+  {
+    fprintf(stderr, "%s is not a bitmap font.\n", pName);
+    return 1;
+  }
+
+  for (uint16_t Index = 0; Index < NumGlyphs; ++Index)
+  {
+    const GFXglyph *pGlyph = &FONT.pGlyph[Index];
+    uint32_t GlyphNumBytes = (pGlyph->width * pGlyph->height + 7) / 8;
+
+    if (pGlyph->bitmapOffset + GlyphNumBytes > NumBitmapBytes)
+      NumBitmapBytes = pGlyph->bitmapOffset + GlyphNumBytes;
+
+    if (NumRunBytes > UINT16_MAX)
+    {
+      fprintf(stderr, "Runs do not fit in 16-bit offsets.\n");
+      return 1;
+    }
+    pRunOffsets[Index] = NumRunBytes;
+    EncodeGlyph(pGlyph);
+
+    if (!VerifyGlyph(pGlyph, pRunOffsets[Index]))
+    {
+      fprintf(stderr, "Glyph 0x%02X does not round-trip.\n", FONT.first + Index);
+      return 1;
+    }
+  }
+
+#ifndef FONT_RUNS_EVEN_IF_LARGER
+  if (NumRunBytes > NumBitmapBytes)
+  {
+    fprintf(stderr, "Runs are larger than the bitmaps (%lu vs %lu bytes), so %s is better left as it is.\n", (unsigned long)NumRunBytes,
+      (unsigned long)NumBitmapBytes, pName);
+    return 1;
+  }
+#endif
+
+  printf("// Generated from %s by Tools/JSB_FontCompiler.c. Do not edit.\n", FONT_HEADER);
+  printf("// Glyph data is in gffRuns format (see gfxfont.h): %lu bytes, vs. %lu bytes of bitmaps.\n\n", (unsigned long)NumRunBytes, (unsigned long)NumBitmapBytes);
+
+  printf("static const uint8_t %sRunsData[] = \n{", pName);
+  for (uint32_t Index = 0; Index < NumRunBytes; ++Index)
+    printf("%s0x%02X%s", (Index % 12) ? " " : "\n  ", RunBytes[Index], (Index + 1 < NumRunBytes) ? "," : "");
+  printf("\n};\n\n");
+
+  printf("static const GFXglyph %sRunsGlyphs[] = \n{\n", pName);
+  for (uint16_t Index = 0; Index < NumGlyphs; ++Index)
+  {
+    const GFXglyph *pGlyph = &FONT.pGlyph[Index];
+    uint8_t Ch = FONT.first + Index;
+
+    printf("  { %5u, %3u, %3u, %3u, %4d, %4d }%s   // 0x%02X '%c'\n", pRunOffsets[Index], pGlyph->width, pGlyph->height, pGlyph->xAdvance, pGlyph->xOffset, pGlyph->yOffset,
+      (Index + 1 < NumGlyphs) ? "," : " ", Ch, Ch);
+  }
+  printf("};\n\n");
+
+  printf("static const GFXfont %sRuns = \n{\n", pName);
+  printf("  (uint8_t  *)%sRunsData,\n", pName);
+  printf("  (GFXglyph *)%sRunsGlyphs,\n", pName);
+  printf("  0x%02X, 0x%02X, %u,\n", FONT.first, FONT.last, FONT.yAdvance);
+  printf("  %d, %d, // JSB added.\n", FONT.yOffsetMin, FONT.yOffsetMax);
+  printf("  gffRuns // JSB added.\n");
+  printf("};\n\n");
+
+  printf("// Approx. %lu bytes\n", (unsigned long)(NumRunBytes + NumGlyphs * 7 + 7));
+
+  free(pRunOffsets);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
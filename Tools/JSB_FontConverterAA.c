@@ -0,0 +1,167 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Antialiased font converter:
+//
+// => Host tool. Converts a TrueType font into a gffAntialiased4bpp font header (see gfxfont.h).
+// => Based on Adafruit fontconvert, so point sizes match Adafruit fonts of the same size.
+// => Build and run, e.g. from the repository folder:
+//      gcc Tools/JSB_FontConverterAA.c $(pkg-config --cflags --libs freetype2) -o JSB_FontConverterAA
+//      ./JSB_FontConverterAA /usr/share/fonts/truetype/dejavu/DejaVuSans.ttf 12 > Shared/DejaVuSans12pt7bAA.h
+// => No app uses an antialiased font yet. One that does needs ILI9341_GlyphArena_MaxNumPixels to hold its largest glyph cell (624 pixels for
+//    DejaVuSans at 12pt), and its blended edges need more colors than the compositor's palette holds, so are drawn directly.
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+//
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define DPI 141 // As Adafruit fontconvert: approximates the pixel density of Adafruit's displays.
+#define FirstChar 0x20
+#define LastChar 0x7E
+#define MaxNumDataBytes 65536
+
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct
+{
+  uint16_t bitmapOffset;
+  uint8_t width, height;
+  uint8_t xAdvance;
+  int8_t xOffset, yOffset;
+} Glyph_t;
+
+static uint8_t Data[MaxNumDataBytes];
+static uint32_t NumDataBytes = 0;
+
+static void AddPixel(uint32_t PixelIndex, uint8_t Alpha)
+// PixelIndex: Within the glyph, which starts on a byte boundary.
+{
+  if (NumDataBytes + (PixelIndex >> 1) >= MaxNumDataBytes)
+  {
+    fprintf(stderr, "Too much glyph data.\n");
+    exit(1);
+  }
+  if (PixelIndex & 1)
+    Data[NumDataBytes + (PixelIndex >> 1)] |= Alpha;
+  else
+    Data[NumDataBytes + (PixelIndex >> 1)] = Alpha << 4;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+  FT_Library Library;
+  FT_Face Face;
+  Glyph_t Glyphs[LastChar - FirstChar + 1];
+  char Name[128], *pName;
+  const char *pFileName;
+  int Size;
+  int8_t yOffsetMin = 127, yOffsetMax = -128;
+
+  if (argc != 3)
+  {
+    fprintf(stderr, "Usage: %s FontFile PointSize\n", argv[0]);
+    return 1;
+  }
+  Size = atoi(argv[2]);
+
+  // Name, from the file name as Adafruit fontconvert:
+  pFileName = strrchr(argv[1], '/');
+  pFileName = pFileName ? pFileName + 1 : argv[1];
+  pName = Name;
+  for (const char *pCh = pFileName; *pCh && (*pCh != '.') && (pName < Name + sizeof(Name) - 16); ++pCh)
+    if (isalnum((unsigned char)*pCh))
+      *pName++ = *pCh;
+  sprintf(pName, "%dpt7bAA", Size);
+
+  if (FT_Init_FreeType(&Library) || FT_New_Face(Library, argv[1], 0, &Face) || FT_Set_Char_Size(Face, Size << 6, 0, DPI, 0))
+  {
+    fprintf(stderr, "Unable to load %s.\n", argv[1]);
+    return 1;
+  }
+
+  for (int Ch = FirstChar; Ch <= LastChar; ++Ch)
+  {
+    Glyph_t *pGlyph = &Glyphs[Ch - FirstChar];
+    FT_GlyphSlot pSlot;
+    FT_Bitmap *pBitmap;
+
+    if (FT_Load_Char(Face, Ch, FT_LOAD_TARGET_NORMAL) || FT_Render_Glyph(Face->glyph, FT_RENDER_MODE_NORMAL))
+    {
+      fprintf(stderr, "Unable to render 0x%02X.\n", Ch);
+      return 1;
+    }
+    pSlot = Face->glyph;
+    pBitmap = &pSlot->bitmap;
+
+    if (NumDataBytes > UINT16_MAX)
+    {
+      fprintf(stderr, "Glyph data does not fit in 16-bit offsets.\n");
+      return 1;
+    }
+    pGlyph->bitmapOffset = NumDataBytes;
+    pGlyph->width = pBitmap->width;
+    pGlyph->height = pBitmap->rows;
+    pGlyph->xAdvance = pSlot->advance.x >> 6;
+    pGlyph->xOffset = pSlot->bitmap_left;
+    pGlyph->yOffset = 1 - pSlot->bitmap_top;
+
+    for (uint32_t Y = 0; Y < pBitmap->rows; ++Y)
+      for (uint32_t X = 0; X < pBitmap->width; ++X)
+        AddPixel(Y * pBitmap->width + X, (pBitmap->buffer[Y * pBitmap->pitch + X] * 15 + 127) / 255);
+    NumDataBytes += (pBitmap->width * pBitmap->rows + 1) / 2;
+
+    if (pGlyph->height)
+    {
+      if (pGlyph->yOffset < yOffsetMin)
+        yOffsetMin = pGlyph->yOffset;
+      if (pGlyph->yOffset + pGlyph->height - 1 > yOffsetMax)
+        yOffsetMax = pGlyph->yOffset + pGlyph->height - 1; // Inclusive, as the driver takes it (see gfxfont.h).
+    }
+  }
+
+  printf("// Generated from %s by Tools/JSB_FontConverterAA.c. Do not edit.\n", pFileName);
+  printf("// Glyph data is in gffAntialiased4bpp format (see gfxfont.h).\n\n");
+
+  printf("static const uint8_t %sData[] = \n{", Name);
+  for (uint32_t Index = 0; Index < NumDataBytes; ++Index)
+    printf("%s0x%02X%s", (Index % 12) ? " " : "\n  ", Data[Index], (Index + 1 < NumDataBytes) ? "," : "");
+  printf("\n};\n\n");
+
+  printf("static const GFXglyph %sGlyphs[] = \n{\n", Name);
+  for (int Ch = FirstChar; Ch <= LastChar; ++Ch)
+  {
+    Glyph_t *pGlyph = &Glyphs[Ch - FirstChar];
+
+    printf("  { %5u, %3u, %3u, %3u, %4d, %4d }%s   // 0x%02X '%c'\n", pGlyph->bitmapOffset, pGlyph->width, pGlyph->height, pGlyph->xAdvance, pGlyph->xOffset, pGlyph->yOffset,
+      (Ch < LastChar) ? "," : " ", Ch, Ch);
+  }
+  printf("};\n\n");
+
+  printf("static const GFXfont %s = \n{\n", Name);
+  printf("  (uint8_t  *)%sData,\n", Name);
+  printf("  (GFXglyph *)%sGlyphs,\n", Name);
+  printf("  0x%02X, 0x%02X, %ld,\n", FirstChar, LastChar, (long)(Face->size->metrics.height >> 6));
+  printf("  %d, %d, // JSB added.\n", yOffsetMin, yOffsetMax);
+  printf("  gffAntialiased4bpp // JSB added.\n");
+  printf("};\n\n");
+
+  printf("// Approx. %lu bytes\n", (unsigned long)(NumDataBytes + (LastChar - FirstChar + 1) * 7 + 7));
+
+  FT_Done_Face(Face);
+  FT_Done_FreeType(Library);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
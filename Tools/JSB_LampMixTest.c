@@ -0,0 +1,215 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp colour mixing test:
+//
+// => Host tool, for Shared/JSB_LampMix.c, with its default calibration. Checks:
+//      Temperatures: the whites' mix, across their range, has the temperature asked for, and its flux scales with the intensity.
+//      sRGB: colours within the emitters' gamut have the chromaticity asked for, and flux in proportion to their luminance.
+//      HSV: matches the same colour converted in float and mixed as sRGB.
+// => Then times each mix. Returns non-zero if any check fails.
+// => Build and run, e.g. from the repository folder:
+//      gcc -O2 -IShared Tools/JSB_LampMixTest.c Shared/JSB_LampMix.c -lm -o JSB_LampMixTest
+//      ./JSB_LampMixTest
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+//
+#include "JSB_LampMix.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// Limits, a little over what the default calibration measures (0.58 K, 0.00002, 0.0011, 0.00004 and 3 levels), so that a change that
+// loses accuracy shows:
+#define MaxTemperatureError_K 1.0
+#define MaxIntensityError 0.0001 // Of the flux, relative.
+#define MaxChromaticityError 0.0015 // In x and y.
+#define MaxLuminanceError 0.0002 // Relative, to that of white.
+#define MaxHSVLevelError 4 // Against the same colour converted in float, from rounding.
+#define NumTimedMixes 10000000
+
+///////////////////////////////////////////////////////////////////////////////
+
+static uint32_t NumFailures = 0;
+static volatile uint16_t Sink; // So that the timed mixes are not optimized away.
+
+static double GetTime_s()
+{
+  struct timespec Time;
+
+  clock_gettime(CLOCK_MONOTONIC, &Time);
+  return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+
+static void Check(const char *pName, double Error, double MaxError)
+{
+  uint8_t Failed = Error > MaxError;
+
+  printf("%-40s max error %.5f (limit %.5f)%s\n", pName, Error, MaxError, Failed ? " FAILED" : "");
+  NumFailures += Failed;
+}
+
+static double DecodeSRGB(double Value)
+{
+  return (Value <= 0.04045) ? Value / 12.92 : pow((Value + 0.055) / 1.055, 2.4);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void CheckTemperatures()
+{
+  uint16_t Levels[LampMix_NumChannels];
+  double MaxTemperatureError = 0.0, MaxIntensityError_ = 0.0;
+
+  for (uint16_t Temperature_K = LampMix_GetMinTemperature_K(); Temperature_K <= LampMix_GetMaxTemperature_K(); Temperature_K += 10)
+  {
+    float x, y, Flux, PartFlux;
+
+    LampMix_FromTemperature(Temperature_K, LampMix_MaxLevel, Levels);
+    LampMix_GetChromaticity(Levels, &x, &y, &Flux);
+    if (fabs(LampMix_GetTemperature_K(x, y) - Temperature_K) > MaxTemperatureError)
+      MaxTemperatureError = fabs(LampMix_GetTemperature_K(x, y) - Temperature_K);
+
+    LampMix_FromTemperature(Temperature_K, 0.4 * LampMix_MaxLevel, Levels);
+    LampMix_GetChromaticity(Levels, &x, &y, &PartFlux);
+    if (fabs(PartFlux / Flux - 0.4) / 0.4 > MaxIntensityError_)
+      MaxIntensityError_ = fabs(PartFlux / Flux - 0.4) / 0.4;
+  }
+
+  printf("Temperatures: %u K to %u K\n", LampMix_GetMinTemperature_K(), LampMix_GetMaxTemperature_K());
+  Check("Temperature (K)", MaxTemperatureError, MaxTemperatureError_K);
+  Check("Intensity", MaxIntensityError_, MaxIntensityError);
+}
+
+static void CheckSRGB()
+// The reference: sRGB to XYZ, in double. Colours that need a negative level are outside the gamut, and skipped.
+{
+  static const double SRGBToXYZ[3][3] = { { 0.4124, 0.3576, 0.1805 }, { 0.2126, 0.7152, 0.0722 }, { 0.0193, 0.1192, 0.9505 } };
+  uint16_t Levels[LampMix_NumChannels];
+  double MaxChromaticityError_ = 0.0, MaxLuminanceError_ = 0.0, WhiteFlux;
+  uint32_t NumChecked = 0, NumOutOfGamut = 0;
+  float x, y, Flux;
+
+  LampMix_FromSRGB(65535, 65535, 65535, Levels);
+  LampMix_GetChromaticity(Levels, &x, &y, &Flux);
+  WhiteFlux = Flux;
+
+  for (uint32_t R = 0; R <= 16; ++R)
+    for (uint32_t G = 0; G <= 16; ++G)
+      for (uint32_t B = 0; B <= 16; ++B)
+      {
+        double Linear[3] = { DecodeSRGB(R / 16.0), DecodeSRGB(G / 16.0), DecodeSRGB(B / 16.0) };
+        double XYZ[3], Sum;
+        uint8_t Clipped = 0;
+
+        if (R + G + B == 0)
+          continue;
+
+        for (uint8_t Row = 0; Row < 3; ++Row)
+          XYZ[Row] = SRGBToXYZ[Row][0] * Linear[0] + SRGBToXYZ[Row][1] * Linear[1] + SRGBToXYZ[Row][2] * Linear[2];
+        Sum = XYZ[0] + XYZ[1] + XYZ[2];
+
+        LampMix_FromSRGB(R * 65535 / 16, G * 65535 / 16, B * 65535 / 16, Levels);
+        for (uint8_t Channel = lmcRed; Channel <= lmcBlue; ++Channel)
+          Clipped |= !Levels[Channel];
+        LampMix_GetChromaticity(Levels, &x, &y, &Flux);
+
+        // A level of 0 may be a negative one clipped. Such colours are out of gamut if the chromaticity is then wrong:
+        if (Clipped && ((fabs(x - XYZ[0] / Sum) > MaxChromaticityError) || (fabs(y - XYZ[1] / Sum) > MaxChromaticityError)))
+        {
+          ++NumOutOfGamut;
+          continue;
+        }
+
+        ++NumChecked;
+        if (fabs(x - XYZ[0] / Sum) > MaxChromaticityError_)
+          MaxChromaticityError_ = fabs(x - XYZ[0] / Sum);
+        if (fabs(y - XYZ[1] / Sum) > MaxChromaticityError_)
+          MaxChromaticityError_ = fabs(y - XYZ[1] / Sum);
+        if (fabs(Flux / WhiteFlux - XYZ[1]) > MaxLuminanceError_) // White's luminance is 1.
+          MaxLuminanceError_ = fabs(Flux / WhiteFlux - XYZ[1]);
+      }
+
+  printf("sRGB: %u colours checked, %u outside the emitters' gamut\n", NumChecked, NumOutOfGamut);
+  Check("sRGB chromaticity (x, y)", MaxChromaticityError_, MaxChromaticityError);
+  Check("sRGB luminance", MaxLuminanceError_, MaxLuminanceError);
+}
+
+static void CheckHSV()
+{
+  uint16_t Levels[LampMix_NumChannels], ReferenceLevels[LampMix_NumChannels];
+  int32_t MaxError = 0;
+
+  for (uint32_t Hue = 0; Hue < 65536; Hue += 257)
+    for (uint32_t Saturation = 0; Saturation <= 65535; Saturation += 4369)
+      for (uint32_t Value = 0; Value <= 65535; Value += 4369)
+      {
+        double h = Hue / 65536.0 * 6.0, s = Saturation / 65535.0, v = Value / 65535.0;
+        double f = h - floor(h), p = v * (1 - s), q = v * (1 - s * f), t = v * (1 - s * (1 - f));
+        double RGB[6][3] = { { v, t, p }, { q, v, p }, { p, v, t }, { p, q, v }, { t, p, v }, { v, p, q } };
+        double *pRGB = RGB[(int)h % 6];
+
+        LampMix_FromHSV(Hue, Saturation, Value, Levels);
+        LampMix_FromSRGB(lround(pRGB[0] * 65535), lround(pRGB[1] * 65535), lround(pRGB[2] * 65535), ReferenceLevels);
+        for (uint8_t Channel = 0; Channel < LampMix_NumChannels; ++Channel)
+          if (abs(Levels[Channel] - ReferenceLevels[Channel]) > MaxError)
+            MaxError = abs(Levels[Channel] - ReferenceLevels[Channel]);
+      }
+
+  Check("HSV (levels)", MaxError, MaxHSVLevelError);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Time()
+{
+  uint16_t Levels[LampMix_NumChannels];
+  double StartTime_s;
+
+  StartTime_s = GetTime_s();
+  for (uint32_t Index = 0; Index < NumTimedMixes; ++Index)
+  {
+    LampMix_FromTemperature(2700 + (Index & 1023), Index, Levels);
+    Sink = Levels[lmcWarm];
+  }
+  printf("Temperature: %.1f ns per mix\n", (GetTime_s() - StartTime_s) * 1e9 / NumTimedMixes);
+
+  StartTime_s = GetTime_s();
+  for (uint32_t Index = 0; Index < NumTimedMixes; ++Index)
+  {
+    LampMix_FromSRGB(Index, Index * 3, Index * 7, Levels);
+    Sink = Levels[lmcRed];
+  }
+  printf("sRGB: %.1f ns per mix\n", (GetTime_s() - StartTime_s) * 1e9 / NumTimedMixes);
+
+  StartTime_s = GetTime_s();
+  for (uint32_t Index = 0; Index < NumTimedMixes; ++Index)
+  {
+    LampMix_FromHSV(Index, 65535 - (Index & 0xFFF), 40000, Levels);
+    Sink = Levels[lmcRed];
+  }
+  printf("HSV: %.1f ns per mix\n", (GetTime_s() - StartTime_s) * 1e9 / NumTimedMixes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+  LampMix_Initialize(LampMix_DefaultEmitters);
+
+  CheckTemperatures();
+  CheckSRGB();
+  CheckHSV();
+  Time();
+
+  printf(NumFailures ? "%u checks FAILED\n" : "All checks passed\n", NumFailures);
+  return NumFailures != 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp UDP test:
+//
+// => Host tool, for the lamp packets (see Shared/JSB_LampPacket.c) that the lamp receives on UDP port 4210.
+// => send: Drives a lamp, fading the red, green and blue channels round, at the given rate, for the given time.
+// => loopback: Benchmarks sending and receiving packets over loopback, with the lamp's decoding and sequencing. Some packets are sent
+//    twice or swapped with the next, so the receiver's stale count should match the number of each.
+// => Build and run, e.g. from the repository folder:
+//      gcc -O2 -IShared Tools/JSB_LampUdpTest.c Shared/JSB_LampPacket.c -lpthread -lm -o JSB_LampUdpTest
+//      ./JSB_LampUdpTest send 192.168.1.42 100 10
+//      ./JSB_LampUdpTest loopback 1000000
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+//
+#include "JSB_LampPacket.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define PortNumber 4210
+#define NumChannels 5 // Natural, warm, red, green, blue, as the lamp.
+#define DuplicateInterval 100 // In loopback, every this many packets one is sent twice...
+#define SwapInterval 250 // ...and one is swapped with the next.
+#define ReceiveTimeout_ms 500 // In loopback, the receiver stops after this long without a packet.
+
+///////////////////////////////////////////////////////////////////////////////
+
+static double GetTime_s()
+{
+  struct timespec Time;
+
+  clock_gettime(CLOCK_MONOTONIC, &Time);
+  return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+
+static int CreateSocket(struct sockaddr_in *pAddress, const char *pHost, uint16_t Port)
+{
+  int Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+  memset(pAddress, 0, sizeof(*pAddress));
+  pAddress->sin_family = AF_INET;
+  pAddress->sin_port = htons(Port);
+  if ((Socket < 0) || !inet_aton(pHost, &pAddress->sin_addr))
+  {
+    fprintf(stderr, "Bad address: %s\n", pHost);
+    exit(1);
+  }
+  return Socket;
+}
+
+static void SendPacket(int Socket, const struct sockaddr_in *pAddress, const LampPacket_t *pPacket)
+{
+  uint8_t Bytes[LampPacket_MaxNumBytes];
+  uint8_t NumBytes = LampPacket_Encode(pPacket, Bytes);
+
+  if (sendto(Socket, Bytes, NumBytes, 0, (const struct sockaddr *)pAddress, sizeof(*pAddress)) != NumBytes)
+  {
+    perror("sendto()");
+    exit(1);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// send:
+
+static int Send(const char *pHost, double Rate_Hz, double Duration_s)
+{
+  struct sockaddr_in Address;
+  int Socket = CreateSocket(&Address, pHost, PortNumber);
+  uint32_t NumPackets = Rate_Hz * Duration_s;
+  double StartTime_s = GetTime_s();
+  LampPacket_t Packet;
+
+  memset(&Packet, 0, sizeof(Packet));
+  Packet.ChannelMask = (1 << 2) | (1 << 3) | (1 << 4);
+
+  for (uint32_t Index = 0; Index < NumPackets; ++Index)
+  {
+    double Time_s = Index / Rate_Hz;
+    double SleepTime_s = StartTime_s + Time_s - GetTime_s();
+
+    if (SleepTime_s > 0)
+      usleep(SleepTime_s * 1e6);
+
+    Packet.Sequence = Index;
+    for (uint8_t Channel = 2; Channel < NumChannels; ++Channel) // A full turn every 3 s, the channels a third of a turn apart.
+      Packet.Intensities[Channel] = 65535 * (0.5 + 0.5 * sin(2 * M_PI * (Time_s / 3.0 + (Channel - 2) / 3.0)));
+    SendPacket(Socket, &Address, &Packet);
+  }
+
+  printf("Sent %u packets in %.3f s = %.1f packets/s\n", NumPackets, GetTime_s() - StartTime_s, NumPackets / (GetTime_s() - StartTime_s));
+  close(Socket);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// loopback:
+
+typedef struct
+{
+  int Socket;
+  LampPacket_Sequencer_t Sequencer;
+  uint32_t NumReceived, NumBad, NumChecksFailed;
+  double FirstTime_s, LastTime_s;
+} Receiver_t;
+
+static void *Receive(void *pParameter)
+// As the lamp, but every accepted packet is checked rather than only the newest applied.
+{
+  Receiver_t *pReceiver = (Receiver_t *)pParameter;
+  uint8_t Bytes[LampPacket_MaxNumBytes + 1];
+  struct timeval Timeout = { 0, ReceiveTimeout_ms * 1000 };
+  LampPacket_t Packet;
+
+  setsockopt(pReceiver->Socket, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+
+  while (1)
+  {
+    ssize_t NumBytes = recv(pReceiver->Socket, Bytes, sizeof(Bytes), 0);
+
+    if (NumBytes < 0)
+      break;
+
+    pReceiver->LastTime_s = GetTime_s();
+    if (!pReceiver->NumReceived++)
+      pReceiver->FirstTime_s = pReceiver->LastTime_s;
+
+    if (!LampPacket_Decode(Bytes, NumBytes, &Packet))
+    {
+      ++pReceiver->NumBad;
+      continue;
+    }
+
+    if (LampPacket_AcceptSequence(&pReceiver->Sequencer, Packet.Sequence))
+      for (uint8_t Channel = 0; Channel < NumChannels; ++Channel)
+        if (Packet.Intensities[Channel] != (uint16_t)(Packet.Sequence * (Channel + 1)))
+          ++pReceiver->NumChecksFailed;
+  }
+
+  return NULL;
+}
+
+static int Loopback(uint32_t NumPackets)
+{
+  struct sockaddr_in Address;
+  socklen_t AddressLength = sizeof(Address);
+  int Socket = CreateSocket(&Address, "127.0.0.1", 0);
+  int ReceiveBufferSize = 4 << 20; // So that the receiver, not the buffer, is measured.
+  uint32_t NumDuplicated = 0, NumSwapped = 0, NumSent = 0;
+  Receiver_t Receiver;
+  pthread_t Thread;
+  LampPacket_t Packet, SwappedPacket;
+  double StartTime_s;
+
+  memset(&Receiver, 0, sizeof(Receiver));
+  Receiver.Socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  setsockopt(Receiver.Socket, SOL_SOCKET, SO_RCVBUF, &ReceiveBufferSize, sizeof(ReceiveBufferSize));
+  if (bind(Receiver.Socket, (struct sockaddr *)&Address, sizeof(Address)) || getsockname(Receiver.Socket, (struct sockaddr *)&Address, &AddressLength))
+  {
+    perror("bind()");
+    return 1;
+  }
+  pthread_create(&Thread, NULL, Receive, &Receiver);
+
+  memset(&Packet, 0, sizeof(Packet));
+  Packet.ChannelMask = (1 << NumChannels) - 1;
+
+  StartTime_s = GetTime_s();
+  for (uint32_t Index = 0; Index < NumPackets; ++Index)
+  {
+    Packet.Sequence = Index;
+    for (uint8_t Channel = 0; Channel < NumChannels; ++Channel)
+      Packet.Intensities[Channel] = Index * (Channel + 1);
+
+    if ((Index % SwapInterval == SwapInterval - 1) && (Index + 1 < NumPackets)) // Held back, to be sent after the next.
+    {
+      SwappedPacket = Packet;
+      ++NumSwapped;
+      continue;
+    }
+
+    SendPacket(Socket, &Address, &Packet);
+    ++NumSent;
+    if (Index % DuplicateInterval == 1)
+    {
+      SendPacket(Socket, &Address, &Packet);
+      ++NumSent;
+      ++NumDuplicated;
+    }
+    if ((Index % SwapInterval == 0) && Index)
+    {
+      SendPacket(Socket, &Address, &SwappedPacket);
+      ++NumSent;
+    }
+  }
+  printf("Sent %u packets in %.3f s (%u duplicated, %u swapped)\n", NumSent, GetTime_s() - StartTime_s, NumDuplicated, NumSwapped);
+
+  pthread_join(Thread, NULL);
+  printf("Received %u packets in %.3f s = %.0f packets/s\n", Receiver.NumReceived, Receiver.LastTime_s - Receiver.FirstTime_s,
+    Receiver.NumReceived / (Receiver.LastTime_s - Receiver.FirstTime_s));
+  printf("Accepted %u, stale %u (expected %u), lost %u (UDP drops, plus %u swapped), bad %u, failed checks %u\n", Receiver.Sequencer.NumAccepted,
+    Receiver.Sequencer.NumStale, NumDuplicated + NumSwapped, Receiver.Sequencer.NumLost, NumSwapped, Receiver.NumBad, Receiver.NumChecksFailed);
+
+  close(Socket);
+  close(Receiver.Socket);
+  return Receiver.NumChecksFailed || Receiver.NumBad;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+  if ((argc >= 3) && !strcmp(argv[1], "send"))
+    return Send(argv[2], (argc > 3) ? atof(argv[3]) : 100, (argc > 4) ? atof(argv[4]) : 10);
+  if ((argc >= 2) && !strcmp(argv[1], "loopback"))
+    return Loopback((argc > 2) ? atoi(argv[2]) : 1000000);
+
+  fprintf(stderr, "Usage: %s send Host [Rate_Hz [Duration_s]]\n       %s loopback [NumPackets]\n", argv[0], argv[0]);
+  return 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
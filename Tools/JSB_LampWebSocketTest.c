@@ -0,0 +1,304 @@
+///////////////////////////////////////////////////////////////////////////////
+// Copyright 2017 J S Bladen.
+///////////////////////////////////////////////////////////////////////////////
+
+///////////////////////////////////////////////////////////////////////////////
+// Lamp WebSocket test client:
+//
+// => Host tool. Connects to a lamp's <IP_Address>/WebSocket, and measures:
+//      Latency: from sending a state change to being notified of it.
+//      Throughput: how many state changes per second can be streamed to it, as by a slider being dragged.
+// => Uses the blue channel, which is put back as it was afterwards.
+// => Answers the server's pings, as the server closes WebSocket connections that do not.
+// => Not yet run against a lamp, so the ESP32's latency and throughput over WiFi have not been measured. Against a host build of the lamp
+//    served on loopback (as by Host/JSB_LampServerTest.cpp), three runs gave:
+//      Latency: 10.9-12.3 ms average, 22-31 ms max. Changes are applied by the LED loop and pushed from the server's select() loop,
+//      each every 10 ms, which is most of this.
+//      Throughput: 97,000-330,000 changes/s, coalesced into 1-5 notifications. Bound by the client and loopback, not the lamp.
+// => Build and run, e.g. from the repository folder:
+//      gcc -O2 Tools/JSB_LampWebSocketTest.c -o JSB_LampWebSocketTest
+//      ./JSB_LampWebSocketTest 192.168.1.42
+///////////////////////////////////////////////////////////////////////////////
+
+#define _GNU_SOURCE // memmem().
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+///////////////////////////////////////////////////////////////////////////////
+
+#define DefaultPortNumber "80"
+#define DefaultNumFrames 2000
+#define DefaultNumLatencySamples 50
+#define Timeout_ms 2000
+#define MaxNumMessageChars 1024
+
+///////////////////////////////////////////////////////////////////////////////
+
+static int Socket = -1;
+static uint8_t ReceiveBuffer[4096];
+static uint32_t ReceiveBuffer_NumBytes = 0;
+static uint32_t NumMessagesReceived = 0;
+
+static double GetTime_s()
+{
+  struct timespec Time;
+
+  clock_gettime(CLOCK_MONOTONIC, &Time);
+  return Time.tv_sec + Time.tv_nsec * 1e-9;
+}
+
+static void Fail(const char *pMessage)
+{
+  fprintf(stderr, "%s\n", pMessage);
+  exit(1);
+}
+
+static void SendAll(const void *pData, uint32_t NumBytes)
+{
+  while (NumBytes)
+  {
+    ssize_t NumBytesSent = send(Socket, pData, NumBytes, 0);
+
+    if (NumBytesSent <= 0)
+      Fail("Unable to send.");
+    pData = (const uint8_t *)pData + NumBytesSent;
+    NumBytes -= NumBytesSent;
+  }
+}
+
+static uint8_t Receive(int Wait_ms)
+// Appends whatever arrives within Wait_ms to ReceiveBuffer. Returns 0 if nothing did.
+{
+  struct pollfd PollFD = { Socket, POLLIN, 0 };
+  ssize_t NumBytesRead;
+
+  if (poll(&PollFD, 1, Wait_ms) <= 0)
+    return 0;
+  if (ReceiveBuffer_NumBytes == sizeof(ReceiveBuffer))
+    Fail("Receive buffer full.");
+
+  NumBytesRead = recv(Socket, ReceiveBuffer + ReceiveBuffer_NumBytes, sizeof(ReceiveBuffer) - ReceiveBuffer_NumBytes, 0);
+  if (NumBytesRead <= 0)
+    Fail("Connection closed.");
+  ReceiveBuffer_NumBytes += NumBytesRead;
+  return 1;
+}
+
+static void Discard(uint32_t NumBytes)
+{
+  ReceiveBuffer_NumBytes -= NumBytes;
+  memmove(ReceiveBuffer, ReceiveBuffer + NumBytes, ReceiveBuffer_NumBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+static void Connect(const char *pHost, const char *pPortNumber)
+{
+  struct addrinfo Hints, *pAddresses;
+  int One = 1;
+
+  memset(&Hints, 0, sizeof(Hints));
+  Hints.ai_family = AF_INET;
+  Hints.ai_socktype = SOCK_STREAM;
+  if (getaddrinfo(pHost, pPortNumber, &Hints, &pAddresses))
+    Fail("Unable to resolve host.");
+
+  Socket = socket(pAddresses->ai_family, pAddresses->ai_socktype, pAddresses->ai_protocol);
+  if ((Socket < 0) || connect(Socket, pAddresses->ai_addr, pAddresses->ai_addrlen))
+    Fail("Unable to connect.");
+  freeaddrinfo(pAddresses);
+  setsockopt(Socket, IPPROTO_TCP, TCP_NODELAY, &One, sizeof(One)); // Frames are small, and latency is being measured.
+}
+
+static void Handshake(const char *pHost)
+// The key is fixed: the server's reply is not checked beyond its status.
+{
+  char Request[256];
+  uint8_t *pHeadEnd = NULL;
+
+  snprintf(Request, sizeof(Request), "GET /WebSocket HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n", pHost);
+  SendAll(Request, strlen(Request));
+
+  while (!pHeadEnd)
+  {
+    if (!Receive(Timeout_ms))
+      Fail("No reply to handshake.");
+    pHeadEnd = memmem(ReceiveBuffer, ReceiveBuffer_NumBytes, "\r\n\r\n", 4);
+  }
+
+  if (memcmp(ReceiveBuffer, "HTTP/1.1 101", 12))
+    Fail("Handshake refused.");
+  Discard(pHeadEnd + 4 - ReceiveBuffer);
+}
+
+static void SendFrame(uint8_t Opcode, const char *pPayload, uint16_t NumChars)
+// Client frames are masked.
+{
+  uint8_t Frame[8 + MaxNumMessageChars];
+  uint32_t HeaderNumBytes = 2;
+  uint32_t Mask = rand();
+
+  if (NumChars > MaxNumMessageChars)
+    Fail("Message too long.");
+
+  Frame[0] = 0x80 | Opcode;
+  if (NumChars < 126)
+    Frame[1] = 0x80 | NumChars;
+  else
+  {
+    Frame[1] = 0x80 | 126;
+    Frame[2] = NumChars >> 8;
+    Frame[3] = NumChars & 0xFF;
+    HeaderNumBytes = 4;
+  }
+  memcpy(Frame + HeaderNumBytes, &Mask, 4);
+  for (uint16_t Index = 0; Index < NumChars; ++Index)
+    Frame[HeaderNumBytes + 4 + Index] = pPayload[Index] ^ Frame[HeaderNumBytes + (Index & 3)];
+
+  SendAll(Frame, HeaderNumBytes + 4 + NumChars);
+}
+
+static void SetBlue(float Brightness)
+{
+  char Message[64];
+
+  snprintf(Message, sizeof(Message), "{\"Blue\":%.3f}", Brightness);
+  SendFrame(0x1, Message, strlen(Message));
+}
+
+static uint8_t GetMessage(char *pMessage, int Wait_ms)
+// A text message from the server, terminated. Returns 0 if none arrives within Wait_ms.
+{
+  while (1)
+  {
+    // A complete frame? Server frames are not masked.
+    if (ReceiveBuffer_NumBytes >= 2)
+    {
+      uint32_t HeaderNumBytes = ((ReceiveBuffer[1] & 0x7F) == 126) ? 4 : 2;
+      uint32_t NumChars = ((ReceiveBuffer[1] & 0x7F) == 126) ? (ReceiveBuffer[2] << 8) | ReceiveBuffer[3] : ReceiveBuffer[1] & 0x7F;
+
+      if ((ReceiveBuffer_NumBytes >= HeaderNumBytes) && (ReceiveBuffer_NumBytes >= HeaderNumBytes + NumChars))
+      {
+        uint8_t Opcode = ReceiveBuffer[0] & 0x0F;
+
+        if ((Opcode == 0x8) || (NumChars >= MaxNumMessageChars))
+          Fail("Closed by server.");
+
+        memcpy(pMessage, ReceiveBuffer + HeaderNumBytes, NumChars);
+        pMessage[NumChars] = '\0';
+        Discard(HeaderNumBytes + NumChars);
+        if (Opcode == 0x1)
+        {
+          ++NumMessagesReceived;
+          return 1;
+        }
+        if (Opcode == 0x9) // Ping, which the server closes the connection if not answered.
+          SendFrame(0xA, pMessage, NumChars);
+        continue;
+      }
+    }
+
+    if (!Receive(Wait_ms))
+      return 0;
+  }
+}
+
+static uint8_t WaitForBlue(float Brightness)
+// Until notified that the blue channel is Brightness. Returns 0 on timeout.
+{
+  char Message[MaxNumMessageChars];
+  char Expected[32];
+  double EndTime_s = GetTime_s() + Timeout_ms / 1000.0;
+
+  snprintf(Expected, sizeof(Expected), "\"Blue\":%.3f", Brightness);
+  while (GetTime_s() < EndTime_s)
+    if (GetMessage(Message, Timeout_ms) && strstr(Message, Expected))
+      return 1;
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+  const char *pPortNumber = (argc > 2) ? argv[2] : DefaultPortNumber;
+  uint32_t NumFrames = (argc > 3) ? atoi(argv[3]) : DefaultNumFrames;
+  uint32_t NumLatencySamples = (argc > 4) ? atoi(argv[4]) : DefaultNumLatencySamples;
+  char Message[MaxNumMessageChars];
+  float InitialBlue = 0.0f;
+  double TotalLatency_s = 0, MaxLatency_s = 0, StartTime_s, Time_s;
+  uint32_t NumLost = 0, NumMessages;
+  char *pBlue;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "Usage: %s Host [Port [NumFrames [NumLatencySamples]]]\n", argv[0]);
+    return 1;
+  }
+
+  Connect(argv[1], pPortNumber);
+  Handshake(argv[1]);
+
+  // The whole state is sent first:
+  if (!GetMessage(Message, Timeout_ms))
+    Fail("No initial state.");
+  printf("Initial state: %s\n", Message);
+  pBlue = strstr(Message, "\"Blue\":");
+  if (pBlue)
+    InitialBlue = atof(pBlue + 7);
+
+  // Latency, one change at a time:
+  for (uint32_t Index = 0; Index < NumLatencySamples; ++Index)
+  {
+    float Brightness = (Index & 1) ? 0.25f : 0.75f;
+
+    StartTime_s = GetTime_s();
+    SetBlue(Brightness);
+    if (!WaitForBlue(Brightness))
+    {
+      ++NumLost;
+      continue;
+    }
+
+    Time_s = GetTime_s() - StartTime_s;
+    TotalLatency_s += Time_s;
+    if (Time_s > MaxLatency_s)
+      MaxLatency_s = Time_s;
+  }
+  if (NumLatencySamples > NumLost)
+    printf("Latency: %.1f ms average, %.1f ms max, over %u changes. %u not notified.\n", 1000.0 * TotalLatency_s / (NumLatencySamples - NumLost), 1000.0 * MaxLatency_s,
+      NumLatencySamples - NumLost, NumLost);
+
+  // Throughput, streaming changes as fast as they are accepted. The last is one not streamed, so that being notified of it shows they have all been handled:
+  NumMessages = NumMessagesReceived;
+  StartTime_s = GetTime_s();
+  for (uint32_t Index = 0; Index < NumFrames; ++Index)
+  {
+    SetBlue((Index % 500) / 1000.0f);
+    while (GetMessage(Message, 0)) // So that notifications cannot back up and stall the server.
+      ;
+  }
+  SetBlue(0.777f);
+  if (!WaitForBlue(0.777f))
+    Fail("Streamed changes not all handled.");
+  Time_s = GetTime_s() - StartTime_s;
+  printf("Throughput: %u changes in %.3f s = %.0f changes/s, coalesced into %u notifications.\n", NumFrames + 1, Time_s, (NumFrames + 1) / Time_s, NumMessagesReceived - NumMessages);
+
+  // Tidy up:
+  SetBlue(InitialBlue);
+  SendFrame(0x8, "\x03\xE8", 2); // Normal closure.
+  close(Socket);
+  return 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////